@@ -0,0 +1,118 @@
+// vig8 - Headless controller input
+// See headless_input.h.
+
+#include "headless_input.h"
+#include "vig8_config.h"
+
+#include <rex/input/input.h>
+#include <rex/runtime/guest/context.h>
+#include <rex/runtime/guest/memory.h>
+
+#include <cstring>
+#include <mutex>
+
+using namespace rex::runtime::guest;
+using namespace rex::input;
+
+static constexpr uint32_t XINPUT_FLAG_GAMEPAD   = 0x01;
+static constexpr uint32_t XINPUT_FLAG_ANY_USER  = 0x40000000;
+static constexpr uint32_t X_INPUT_STATE_SIZE    = 16;
+static constexpr uint32_t X_INPUT_CAPS_SIZE     = 20;
+
+// Drivers aren't thread-safe and several guest threads may poll
+static std::mutex                   g_headless_mutex;
+static std::unique_ptr<InputDriver> g_headless_driver;
+
+void HeadlessInputInstall(std::unique_ptr<InputDriver> driver) {
+    std::lock_guard lock(g_headless_mutex);
+    g_headless_driver = std::move(driver);
+}
+
+bool HeadlessInputActive() {
+    std::lock_guard lock(g_headless_mutex);
+    return g_headless_driver != nullptr;
+}
+
+static inline void PutBE16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static inline void PutBE32(uint8_t* p, uint32_t v) {
+    PutBE16(p, (uint16_t)(v >> 16));
+    PutBE16(p + 2, (uint16_t)v);
+}
+
+// X_INPUT_GAMEPAD: buttons, lt, rt, lx, ly, rx, ry (12 bytes)
+static void WriteGamepad(uint8_t* p, const X_INPUT_GAMEPAD& pad) {
+    PutBE16(p + 0, (uint16_t)pad.buttons);
+    p[2] = (uint8_t)pad.left_trigger;
+    p[3] = (uint8_t)pad.right_trigger;
+    PutBE16(p + 4, (uint16_t)(int16_t)pad.thumb_lx);
+    PutBE16(p + 6, (uint16_t)(int16_t)pad.thumb_ly);
+    PutBE16(p + 8, (uint16_t)(int16_t)pad.thumb_rx);
+    PutBE16(p + 10, (uint16_t)(int16_t)pad.thumb_ry);
+}
+
+// The slot a call asks for, or -1 for a non-gamepad device query.
+static int ResolveSlot(uint32_t user_index, uint32_t flags) {
+    if ((flags & 0xFF) && !(flags & XINPUT_FLAG_GAMEPAD)) return -1;
+    if ((user_index & 0xFF) == 0xFF || (flags & XINPUT_FLAG_ANY_USER)) return 0;
+    return (int)user_index;
+}
+
+// XamInputGetCapabilities(r3=user_index, r4=flags, r5=X_INPUT_CAPABILITIES*)
+extern "C" PPC_FUNC(__imp__XamInputGetCapabilities) {
+    uint32_t caps_ptr = ctx.r5.u32;
+    int slot = ResolveSlot(ctx.r3.u32, ctx.r4.u32);
+    if (caps_ptr) std::memset(base + caps_ptr, 0, X_INPUT_CAPS_SIZE);
+
+    std::lock_guard lock(g_headless_mutex);
+    X_INPUT_CAPABILITIES caps = {};
+    rex::X_RESULT result = X_ERROR_DEVICE_NOT_CONNECTED;
+    if (slot >= 0 && g_headless_driver) {
+        result = g_headless_driver->GetCapabilities((uint32_t)slot, ctx.r4.u32, &caps);
+    }
+    if (result == X_ERROR_SUCCESS && caps_ptr) {
+        uint8_t* p = base + caps_ptr;
+        p[0] = (uint8_t)caps.type;
+        p[1] = (uint8_t)caps.sub_type;
+        PutBE16(p + 2, (uint16_t)caps.flags);
+        WriteGamepad(p + 4, caps.gamepad);
+    }
+    ctx.r3.u64 = (uint32_t)result;
+}
+
+// XamInputGetState(r3=user_index, r4=flags, r5=X_INPUT_STATE*)
+extern "C" PPC_FUNC(__imp__XamInputGetState) {
+    uint32_t state_ptr = ctx.r5.u32;
+    int slot = ResolveSlot(ctx.r3.u32, ctx.r4.u32);
+    if (state_ptr) std::memset(base + state_ptr, 0, X_INPUT_STATE_SIZE);
+
+    std::lock_guard lock(g_headless_mutex);
+    X_INPUT_STATE state = {};
+    rex::X_RESULT result = X_ERROR_DEVICE_NOT_CONNECTED;
+    if (slot >= 0 && g_headless_driver) {
+        result = g_headless_driver->GetState((uint32_t)slot, &state);
+    }
+    if (result == X_ERROR_SUCCESS && state_ptr) {
+        PutBE32(base + state_ptr, (uint32_t)state.packet_number);
+        WriteGamepad(base + state_ptr + 4, state.gamepad);
+    }
+    ctx.r3.u64 = (uint32_t)result;
+}
+
+// XamInputSetState(r3=user_index, r4=unused, r5=X_INPUT_VIBRATION*).
+// Nothing vibrates headless; only the slot's presence is reported.
+extern "C" PPC_FUNC(__imp__XamInputSetState) {
+    (void)base;
+    int slot = ResolveSlot(ctx.r3.u32, 0);
+
+    std::lock_guard lock(g_headless_mutex);
+    X_INPUT_VIBRATION vibration = {};
+    rex::X_RESULT result = X_ERROR_DEVICE_NOT_CONNECTED;
+    if (slot >= 0 && g_headless_driver) {
+        result = g_headless_driver->SetState((uint32_t)slot, &vibration);
+    }
+    ctx.r3.u64 = (uint32_t)result;
+}
@@ -0,0 +1,23 @@
+// vig8 - Headless controller input
+//
+// The runtime creates its input system only when it is given a display
+// window (set_display_window), so in vig8_test the SDK's XamInputGetState
+// has nothing to ask and the game sees no controller. This module, linked
+// into vig8_test only, overrides the guest's XamInputGetCapabilities,
+// XamInputGetState and XamInputSetState: they answer from the driver given
+// to HeadlessInputInstall (the scripted controller of [test]
+// input_script) and report every slot it doesn't serve as not connected.
+// User index 0xFF (any user) asks for slot 0.
+
+#pragma once
+
+#include <rex/input/input_driver.h>
+
+#include <memory>
+
+// Serve guest input from `driver`, which has been Setup(). Replaces any
+// earlier driver; null leaves every slot disconnected.
+void HeadlessInputInstall(std::unique_ptr<rex::input::InputDriver> driver);
+
+// True once a driver is installed.
+bool HeadlessInputActive();
@@ -0,0 +1,150 @@
+// vig8 - Input-to-present latency measurement
+// See input_latency.h.
+
+#include "input_latency.h"
+#include "present_hook.h"
+
+#include <rex/logging.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+static constexpr int64_t kBinNs = 250000;
+static constexpr int     kBins  = 1024;   // 256 ms; one more bin for overflow
+
+struct LatencyHistogram {
+    uint64_t bins[kBins + 1] = {};
+    uint64_t count = 0;
+
+    void Add(int64_t ns) {
+        int64_t bin = std::clamp<int64_t>(ns / kBinNs, 0, kBins);
+        bins[bin]++;
+        count++;
+    }
+
+    // Upper edge of the bin holding the p-th percentile, in ms.
+    double PercentileMs(double p) const {
+        if (!count) return 0.0;
+        uint64_t rank = (uint64_t)(p / 100.0 * (double)(count - 1)) + 1;
+        uint64_t seen = 0;
+        for (int i = 0; i <= kBins; i++) {
+            seen += bins[i];
+            if (seen >= rank) return (double)((i + 1) * kBinNs) / 1e6;
+        }
+        return (double)((kBins + 1) * kBinNs) / 1e6;
+    }
+};
+
+struct PendingEvent {
+    int     slot;
+    int64_t changed_ns;
+    int64_t polled_ns;
+};
+
+static std::atomic<bool>         g_active{false};
+static std::mutex                g_mutex;
+static std::vector<PendingEvent> g_pending;     // polled, not yet presented
+static LatencyHistogram          g_poll_hist;
+static LatencyHistogram          g_present_hist;
+static uint64_t                  g_frame = 0;
+static int64_t                   g_start_ns = 0;
+static FILE*                     g_csv = nullptr;
+
+int64_t InputLatencyNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void InputLatencyOnPresent(uint8_t* base);
+
+void InputLatencyStart(const std::string& csv_path) {
+    InputLatencyStop();
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_pending.clear();
+    g_poll_hist = {};
+    g_present_hist = {};
+    g_frame = 0;
+    g_start_ns = InputLatencyNowNs();
+    if (!csv_path.empty()) {
+        g_csv = fopen(csv_path.c_str(), "w");
+        if (g_csv) {
+            fprintf(g_csv, "slot,frame,changed_us,polled_us,presented_us,"
+                           "poll_latency_us,present_latency_us\n");
+        } else {
+            REXLOG_WARN("[latency] cannot write {}", csv_path);
+        }
+    }
+    PresentSubscribe(PresentStage::After, InputLatencyOnPresent);
+    g_active.store(true, std::memory_order_release);
+    REXLOG_INFO("[latency] measuring input-to-present latency{}{}",
+                g_csv ? " -> " : "", g_csv ? csv_path : std::string());
+}
+
+void InputLatencyStop() {
+    if (!g_active.exchange(false, std::memory_order_acq_rel)) return;
+    InputLatencyStats s = InputLatencyRead();
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (g_csv) {
+        fclose(g_csv);
+        g_csv = nullptr;
+    }
+    fprintf(stderr, "[latency] %llu events over %llu frames: poll p50/p95/p99 %.2f/%.2f/%.2f ms, "
+                    "present p50/p95/p99 %.2f/%.2f/%.2f ms\n",
+            (unsigned long long)s.events, (unsigned long long)g_frame,
+            s.poll_p50_ms, s.poll_p95_ms, s.poll_p99_ms,
+            s.present_p50_ms, s.present_p95_ms, s.present_p99_ms);
+    fflush(stderr);
+}
+
+bool InputLatencyActive() {
+    return g_active.load(std::memory_order_acquire);
+}
+
+void InputLatencyPolled(int slot, int64_t changed_ns) {
+    if (!g_active.load(std::memory_order_acquire) || changed_ns <= 0) return;
+    int64_t now = InputLatencyNowNs();
+    std::lock_guard<std::mutex> lock(g_mutex);
+    // Changes from before recording started have no meaningful latency
+    if (changed_ns < g_start_ns) return;
+    g_pending.push_back({slot, changed_ns, now});
+}
+
+// Present subscriber: every change polled since the previous present is
+// on screen.
+static void InputLatencyOnPresent(uint8_t* /*base*/) {
+    if (!g_active.load(std::memory_order_acquire)) return;
+    int64_t now = InputLatencyNowNs();
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_frame++;
+    for (const PendingEvent& e : g_pending) {
+        g_poll_hist.Add(e.polled_ns - e.changed_ns);
+        g_present_hist.Add(now - e.changed_ns);
+        if (g_csv) {
+            fprintf(g_csv, "%d,%llu,%lld,%lld,%lld,%lld,%lld\n", e.slot,
+                    (unsigned long long)g_frame,
+                    (long long)((e.changed_ns - g_start_ns) / 1000),
+                    (long long)((e.polled_ns - g_start_ns) / 1000),
+                    (long long)((now - g_start_ns) / 1000),
+                    (long long)((e.polled_ns - e.changed_ns) / 1000),
+                    (long long)((now - e.changed_ns) / 1000));
+        }
+    }
+    g_pending.clear();
+}
+
+InputLatencyStats InputLatencyRead() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    InputLatencyStats s = {};
+    s.events         = g_present_hist.count;
+    s.poll_p50_ms    = g_poll_hist.PercentileMs(50);
+    s.poll_p95_ms    = g_poll_hist.PercentileMs(95);
+    s.poll_p99_ms    = g_poll_hist.PercentileMs(99);
+    s.present_p50_ms = g_present_hist.PercentileMs(50);
+    s.present_p95_ms = g_present_hist.PercentileMs(95);
+    s.present_p99_ms = g_present_hist.PercentileMs(99);
+    return s;
+}
@@ -0,0 +1,43 @@
+// vig8 - Input-to-present latency measurement
+//
+// Input drivers stamp every change with the steady clock when they first
+// see it (a key event, a pad poll, a script step). When the game's
+// XamInputGetState first returns the changed packet, the driver reports
+// the change here; the next present (a PresentStage::After subscriber,
+// present_hook.h) puts the frame built from that poll on screen and closes
+// the event. Each event contributes two latencies: change -> poll and
+// change -> present.
+//
+// Histograms use 250 us bins up to 256 ms (plus an overflow bin) so
+// percentiles are a cumulative scan, cheap enough for every overlay frame.
+// Optionally each event is appended to a CSV:
+//   slot,frame,changed_us,polled_us,presented_us,poll_latency_us,present_latency_us
+// with times relative to InputLatencyStart.
+//
+// Off unless started; the driver and present hooks return immediately then.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+struct InputLatencyStats {
+    uint64_t events;
+    double   poll_p50_ms, poll_p95_ms, poll_p99_ms;
+    double   present_p50_ms, present_p95_ms, present_p99_ms;
+};
+
+// Start recording; `csv_path` may be empty. Clears earlier results.
+void InputLatencyStart(const std::string& csv_path);
+// Stop recording, close the CSV and log a summary.
+void InputLatencyStop();
+bool InputLatencyActive();
+
+// Steady clock in ns, the timebase for every stamp.
+int64_t InputLatencyNowNs();
+
+// A driver's GetState returned a new packet for `slot`; the input in it
+// changed at `changed_ns`.
+void InputLatencyPolled(int slot, int64_t changed_ns);
+
+InputLatencyStats InputLatencyRead();
@@ -1,92 +1,203 @@
 // vig8 -- Keyboard input driver
-// Uses Win32 GetAsyncKeyState for reliable polling independent of SDL event pump.
+// Key state comes from window key events; GetState reads a published
+// snapshot; the physical pad comes from the poller's snapshot (pad_poller).
 
 #include "keyboard_driver.h"
+#include "input_latency.h"
+#include "pad_poller.h"
 
 #include <rex/input/input.h>
+#include <rex/logging.h>
 #include <rex/ui/virtual_key.h>
 #include <rex/ui/window.h>
 
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cstdlib>
 #include <cstring>
+#include <string>
 
-#ifdef _WIN32
-#include <windows.h>
-
-// Load XInput dynamically to avoid conflicts with SDK's SDL controller handling.
-struct XINPUT_GAMEPAD_S {
-    WORD  wButtons;
-    BYTE  bLeftTrigger;
-    BYTE  bRightTrigger;
-    SHORT sThumbLX;
-    SHORT sThumbLY;
-    SHORT sThumbRX;
-    SHORT sThumbRY;
-};
-struct XINPUT_STATE_S {
-    DWORD          dwPacketNumber;
-    XINPUT_GAMEPAD_S Gamepad;
-};
-typedef DWORD (WINAPI *XInputGetState_t)(DWORD, XINPUT_STATE_S*);
-
-static XInputGetState_t GetXInputGetState() {
-    static XInputGetState_t fn = nullptr;
-    static bool tried = false;
-    if (!tried) {
-        tried = true;
-        HMODULE h = LoadLibraryA("xinput1_4.dll");
-        if (!h) h = LoadLibraryA("xinput1_3.dll");
-        if (!h) h = LoadLibraryA("xinput9_1_0.dll");
-        if (h) fn = (XInputGetState_t)GetProcAddress(h, "XInputGetState");
+using namespace rex::input;
+
+// Packed slot state, one atomic word per slot:
+//   bits 0-15   gamepad buttons (X_INPUT_GAMEPAD_*)
+//   bit  16/17  LT / RT fully pressed
+//   bits 18-25  stick directions, two bits per axis (LX LY RX RY):
+//               the lower bit is negative, the upper positive
+//   bits 32-63  packet number, bumped on every change
+// A binding's `control` is the bit it sets.
+static constexpr int      CONTROL_LT       = 16;
+static constexpr int      CONTROL_RT       = 17;
+static constexpr int      CONTROL_STICKS   = 18;
+static constexpr uint64_t STATE_INPUT_MASK = 0xFFFFFFFFull;
+
+static int ParseControl(const std::string& name) {
+    static const struct { const char* name; uint16_t bit; } kButtons[] = {
+        {"A", X_INPUT_GAMEPAD_A},         {"B", X_INPUT_GAMEPAD_B},
+        {"X", X_INPUT_GAMEPAD_X},         {"Y", X_INPUT_GAMEPAD_Y},
+        {"START", X_INPUT_GAMEPAD_START}, {"BACK", X_INPUT_GAMEPAD_BACK},
+        {"UP", X_INPUT_GAMEPAD_DPAD_UP},  {"DOWN", X_INPUT_GAMEPAD_DPAD_DOWN},
+        {"LEFT", X_INPUT_GAMEPAD_DPAD_LEFT}, {"RIGHT", X_INPUT_GAMEPAD_DPAD_RIGHT},
+        {"LB", X_INPUT_GAMEPAD_LEFT_SHOULDER}, {"RB", X_INPUT_GAMEPAD_RIGHT_SHOULDER},
+        {"LS", X_INPUT_GAMEPAD_LEFT_THUMB},    {"RS", X_INPUT_GAMEPAD_RIGHT_THUMB},
+    };
+    static const char* const kStickDirs[] = {
+        "LX-", "LX+", "LY-", "LY+", "RX-", "RX+", "RY-", "RY+",
+    };
+    for (auto& b : kButtons) {
+        if (name == b.name) return std::countr_zero(b.bit);
     }
-    return fn;
+    if (name == "LT") return CONTROL_LT;
+    if (name == "RT") return CONTROL_RT;
+    for (int i = 0; i < 8; i++) {
+        if (name == kStickDirs[i]) return CONTROL_STICKS + i;
+    }
+    return -1;
 }
 
-static void PollKeyboard(uint16_t& buttons, uint8_t& lt, uint8_t& rt) {
-    buttons = 0; lt = 0; rt = 0;
+// Key names to VirtualKey codes, which use the Win32 VK numbering.
+static int ParseKey(const std::string& name) {
+    if (name.size() == 1) {
+        char c = name[0];
+        if (c >= 'A' && c <= 'Z') return c;
+        if (c >= '0' && c <= '9') return c;
+        static const struct { char c; int vk; } kPunct[] = {
+            {'`', 0xC0}, {'[', 0xDB}, {']', 0xDD}, {';', 0xBA}, {'\'', 0xDE},
+            {',', 0xBC}, {'.', 0xBE}, {'/', 0xBF}, {'\\', 0xDC}, {'-', 0xBD},
+            {'=', 0xBB},
+        };
+        for (auto& p : kPunct) {
+            if (c == p.c) return p.vk;
+        }
+        return -1;
+    }
+    if (name.size() == 4 && name.compare(0, 3, "NUM") == 0 && std::isdigit((unsigned char)name[3]))
+        return 0x60 + (name[3] - '0');
+    if (name[0] == 'F' && name.size() <= 3 &&
+        std::all_of(name.begin() + 1, name.end(), [](char c) { return std::isdigit((unsigned char)c); })) {
+        int n = std::atoi(name.c_str() + 1);
+        if (n >= 1 && n <= 12) return 0x70 + n - 1;
+    }
+    static const struct { const char* name; int vk; } kNamed[] = {
+        {"UP", 0x26},     {"DOWN", 0x28},   {"LEFT", 0x25},   {"RIGHT", 0x27},
+        {"SPACE", 0x20},  {"ENTER", 0x0D},  {"ESCAPE", 0x1B}, {"BACKSPACE", 0x08},
+        {"TAB", 0x09},    {"SHIFT", 0x10},  {"CTRL", 0x11},   {"ALT", 0x12},
+        {"LSHIFT", 0xA0}, {"RSHIFT", 0xA1}, {"LCTRL", 0xA2},  {"RCTRL", 0xA3},
+    };
+    for (auto& k : kNamed) {
+        if (name == k.name) return k.vk;
+    }
+    return -1;
+}
 
-    using namespace rex::input;
+static const char* const kDefaultBindings[] = {
+    "UP=W",  "UP=Up",  "DOWN=S", "DOWN=Down", "LEFT=A", "LEFT=Left", "RIGHT=D", "RIGHT=Right",
+    "A=Space", "A=Z", "B=Escape", "B=Backspace", "X=X", "Y=C",
+    "START=Enter", "BACK=`", "LB=Q", "RB=E", "LT=[", "RT=]",
+    "LX-=J", "LX+=L", "LY-=K", "LY+=I",
+};
 
-    // D-pad: WASD + arrow keys
-    if (GetAsyncKeyState('W') & 0x8000 || GetAsyncKeyState(VK_UP)    & 0x8000) buttons |= X_INPUT_GAMEPAD_DPAD_UP;
-    if (GetAsyncKeyState('S') & 0x8000 || GetAsyncKeyState(VK_DOWN)  & 0x8000) buttons |= X_INPUT_GAMEPAD_DPAD_DOWN;
-    if (GetAsyncKeyState('A') & 0x8000 || GetAsyncKeyState(VK_LEFT)  & 0x8000) buttons |= X_INPUT_GAMEPAD_DPAD_LEFT;
-    if (GetAsyncKeyState('D') & 0x8000 || GetAsyncKeyState(VK_RIGHT) & 0x8000) buttons |= X_INPUT_GAMEPAD_DPAD_RIGHT;
+KeyboardInputDriver::KeyboardInputDriver(rex::ui::Window* window,
+                                         const Vig8Settings& settings)
+    : InputDriver(window, 0), window_(window) {
+    const std::vector<std::string>* keys[4] = {
+        &settings.keys_1, &settings.keys_2, &settings.keys_3, &settings.keys_4,
+    };
+    for (int slot = 0; slot < 4; slot++) {
+        std::vector<std::string> specs = *keys[slot];
+        if (slot == 0 && specs.empty())
+            specs.assign(std::begin(kDefaultBindings), std::end(kDefaultBindings));
+        for (auto& spec : specs) {
+            std::string upper = spec;
+            std::transform(upper.begin(), upper.end(), upper.begin(),
+                           [](unsigned char c) { return (char)std::toupper(c); });
+            auto eq = upper.find('=', 1);  // "-" and "=" are keys too
+            int control = eq == std::string::npos ? -1 : ParseControl(upper.substr(0, eq));
+            int key     = eq == std::string::npos ? -1 : ParseKey(upper.substr(eq + 1));
+            if (control < 0 || key < 0) {
+                REXLOG_WARN("[input] keys_{}: ignoring binding \"{}\"", slot + 1, spec);
+                continue;
+            }
+            bindings_[slot].push_back({(uint16_t)key, (uint8_t)control});
+        }
+    }
+}
+
+KeyboardInputDriver::~KeyboardInputDriver() {
+    Detach();
+}
 
-    // Face buttons
-    if (GetAsyncKeyState(VK_SPACE) & 0x8000 || GetAsyncKeyState('Z') & 0x8000) buttons |= X_INPUT_GAMEPAD_A;
-    if (GetAsyncKeyState(VK_ESCAPE) & 0x8000 || GetAsyncKeyState(VK_BACK) & 0x8000) buttons |= X_INPUT_GAMEPAD_B;
-    if (GetAsyncKeyState('X') & 0x8000) buttons |= X_INPUT_GAMEPAD_X;
-    if (GetAsyncKeyState('C') & 0x8000) buttons |= X_INPUT_GAMEPAD_Y;
+X_STATUS KeyboardInputDriver::Setup() {
+    if (window_ && !listening_) {
+        window_->AddListener(this);
+        window_->AddInputListener(this, 0);
+        listening_ = true;
+    }
+    return X_STATUS_SUCCESS;
+}
 
-    // System
-    if (GetAsyncKeyState(VK_RETURN) & 0x8000) buttons |= X_INPUT_GAMEPAD_START;
-    if (GetAsyncKeyState(VK_OEM_3)  & 0x8000) buttons |= X_INPUT_GAMEPAD_BACK;  // ` key
+void KeyboardInputDriver::Detach() {
+    if (window_ && listening_) {
+        window_->RemoveInputListener(this);
+        window_->RemoveListener(this);
+    }
+    listening_ = false;
+    window_ = nullptr;
+}
 
-    // Shoulders
-    if (GetAsyncKeyState('Q') & 0x8000) buttons |= X_INPUT_GAMEPAD_LEFT_SHOULDER;
-    if (GetAsyncKeyState('E') & 0x8000) buttons |= X_INPUT_GAMEPAD_RIGHT_SHOULDER;
+void KeyboardInputDriver::OnKeyDown(rex::ui::KeyEvent& e) {
+    SetKey(static_cast<uint16_t>(e.virtual_key()), true);
+}
 
-    // Triggers: [ = LT, ] = RT
-    if (GetAsyncKeyState(VK_OEM_4) & 0x8000) lt = 255;  // [
-    if (GetAsyncKeyState(VK_OEM_6) & 0x8000) rt = 255;  // ]
+void KeyboardInputDriver::OnKeyUp(rex::ui::KeyEvent& e) {
+    SetKey(static_cast<uint16_t>(e.virtual_key()), false);
 }
-#endif  // _WIN32
 
-using namespace rex::input;
+void KeyboardInputDriver::OnLostFocus(rex::ui::UISetupEvent& /*e*/) {
+    // Key-ups for keys released elsewhere never arrive
+    std::memset(key_down_, 0, sizeof(key_down_));
+    Publish();
+}
 
-KeyboardInputDriver::KeyboardInputDriver(rex::ui::Window* window)
-    : InputDriver(window, 0) {}
+void KeyboardInputDriver::SetKey(uint16_t key, bool down) {
+    if (key >= 256 || key_down_[key] == down) return;  // auto-repeat
+    key_down_[key] = down;
+    Publish();
+}
 
-KeyboardInputDriver::~KeyboardInputDriver() {}
+// UI thread: rebuild every slot's state from the held keys and publish
+// the slots that changed.
+void KeyboardInputDriver::Publish() {
+    for (int slot = 0; slot < 4; slot++) {
+        uint64_t input = 0;
+        for (auto& b : bindings_[slot]) {
+            if (key_down_[b.key]) input |= 1ull << b.control;
+        }
+        // Both directions of an axis held: negative wins
+        for (int axis = 0; axis < 4; axis++) {
+            uint64_t neg = 1ull << (CONTROL_STICKS + axis * 2);
+            if (input & neg) input &= ~(neg << 1);
+        }
+        uint64_t prev = state_[slot].load(std::memory_order_relaxed);
+        if ((prev & STATE_INPUT_MASK) == input) continue;
+        uint64_t packet = (prev >> 32) + 1;
+        changed_ns_[slot].store(InputLatencyNowNs(), std::memory_order_relaxed);
+        state_[slot].store((packet << 32) | input, std::memory_order_release);
+    }
+}
 
-X_STATUS KeyboardInputDriver::Setup() {
-    return X_STATUS_SUCCESS;
+bool KeyboardInputDriver::SlotEnabled(uint32_t user_index) const {
+    // Slot 0 always has the keyboard; other slots need bindings or a pad
+    if (user_index == 0) return true;
+    if (user_index >= 4) return false;
+    return !bindings_[user_index].empty() || PadPollerGet((int)user_index).connected;
 }
 
 X_RESULT KeyboardInputDriver::GetCapabilities(uint32_t user_index,
                                                uint32_t /*flags*/,
                                                X_INPUT_CAPABILITIES* out_caps) {
-    if (user_index != 0) return X_ERROR_DEVICE_NOT_CONNECTED;
+    if (!SlotEnabled(user_index)) return X_ERROR_DEVICE_NOT_CONNECTED;
     if (out_caps) {
         std::memset(out_caps, 0, sizeof(*out_caps));
         out_caps->type     = 0x01;
@@ -104,44 +215,45 @@ X_RESULT KeyboardInputDriver::GetCapabilities(uint32_t user_index,
 
 X_RESULT KeyboardInputDriver::GetState(uint32_t user_index,
                                         X_INPUT_STATE* out_state) {
-    if (user_index != 0) return X_ERROR_DEVICE_NOT_CONNECTED;
+    if (!SlotEnabled(user_index)) return X_ERROR_DEVICE_NOT_CONNECTED;
     if (out_state) {
-        uint16_t current = 0;
-        uint8_t  lt = 0, rt = 0;
-        int16_t  lx = 0, ly = 0, rx = 0, ry = 0;
-
-#ifdef _WIN32
-        PollKeyboard(current, lt, rt);
-
-        // Right stick: IJKL
-        if (GetAsyncKeyState('J') & 0x8000) lx = -32767;
-        else if (GetAsyncKeyState('L') & 0x8000) lx = 32767;
-        if (GetAsyncKeyState('K') & 0x8000) ly = -32767;
-        else if (GetAsyncKeyState('I') & 0x8000) ly = 32767;
-
-        // Merge physical Xbox controller via XInput
-        if (auto xig = GetXInputGetState()) {
-            XINPUT_STATE_S xi;
-            if (xig(0, &xi) == ERROR_SUCCESS) {
-                current |= xi.Gamepad.wButtons;
-                if (xi.Gamepad.bLeftTrigger  > lt) lt = xi.Gamepad.bLeftTrigger;
-                if (xi.Gamepad.bRightTrigger > rt) rt = xi.Gamepad.bRightTrigger;
-                auto dz = [](int16_t v, int16_t d) -> int16_t {
-                    return (v > d || v < -d) ? v : 0;
-                };
-                if (!lx) lx = dz(xi.Gamepad.sThumbLX, 7849);
-                if (!ly) ly = dz(xi.Gamepad.sThumbLY, 7849);
-                rx = dz(xi.Gamepad.sThumbRX, 8689);
-                ry = dz(xi.Gamepad.sThumbRY, 8689);
-            }
+        uint64_t s = state_[user_index].load(std::memory_order_acquire);
+        uint32_t packet  = (uint32_t)(s >> 32);
+        uint16_t current = (uint16_t)s;
+        uint8_t  lt = (s >> CONTROL_LT) & 1 ? 255 : 0;
+        uint8_t  rt = (s >> CONTROL_RT) & 1 ? 255 : 0;
+        int16_t  axes[4];
+        for (int axis = 0; axis < 4; axis++) {
+            uint32_t dir = (uint32_t)(s >> (CONTROL_STICKS + axis * 2)) & 3;
+            axes[axis] = dir == 1 ? -32767 : dir == 2 ? 32767 : 0;
+        }
+        int16_t lx = axes[0], ly = axes[1], rx = axes[2], ry = axes[3];
+
+        // Merge the physical pad polled for this slot
+        PadState pad = PadPollerGet((int)user_index);
+        if (pad.connected) {
+            packet += pad.packet;
+            current |= pad.buttons;
+            if (pad.lt > lt) lt = pad.lt;
+            if (pad.rt > rt) rt = pad.rt;
+            auto dz = [](int16_t v, int16_t d) -> int16_t {
+                return (v > d || v < -d) ? v : 0;
+            };
+            if (!lx) lx = dz(pad.lx, 7849);
+            if (!ly) ly = dz(pad.ly, 7849);
+            if (!rx) rx = dz(pad.rx, 8689);
+            if (!ry) ry = dz(pad.ry, 8689);
         }
-#endif
 
-        if (current != prev_buttons_) {
-            packet_number_++;
-            prev_buttons_ = current;
+        // First poll to return a change: stamp it with the newest source
+        if (InputLatencyActive() &&
+            last_polled_[user_index].exchange(packet, std::memory_order_relaxed) != packet) {
+            int64_t changed = changed_ns_[user_index].load(std::memory_order_relaxed);
+            if (pad.connected) changed = std::max(changed, pad.changed_ns);
+            InputLatencyPolled((int)user_index, changed);
         }
-        out_state->packet_number        = packet_number_;
+
+        out_state->packet_number        = packet;
         out_state->gamepad.buttons      = current;
         out_state->gamepad.left_trigger  = lt;
         out_state->gamepad.right_trigger = rt;
@@ -155,12 +267,12 @@ X_RESULT KeyboardInputDriver::GetState(uint32_t user_index,
 
 X_RESULT KeyboardInputDriver::SetState(uint32_t user_index,
                                         X_INPUT_VIBRATION* /*vibration*/) {
-    if (user_index != 0) return X_ERROR_DEVICE_NOT_CONNECTED;
+    if (!SlotEnabled(user_index)) return X_ERROR_DEVICE_NOT_CONNECTED;
     return X_ERROR_SUCCESS;
 }
 
 X_RESULT KeyboardInputDriver::GetKeystroke(uint32_t user_index, uint32_t /*flags*/,
                                             X_INPUT_KEYSTROKE* /*out_keystroke*/) {
-    if (user_index != 0) return X_ERROR_DEVICE_NOT_CONNECTED;
+    if (!SlotEnabled(user_index)) return X_ERROR_DEVICE_NOT_CONNECTED;
     return X_ERROR_EMPTY;
 }
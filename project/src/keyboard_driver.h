@@ -1,11 +1,16 @@
 // vig8 -- Keyboard-to-gamepad input driver
-// Maps keyboard keys to Xbox 360 controller inputs for slot 0.
+// Maps keyboard keys to Xbox 360 controller inputs.
 // Registered via InsertDriverFront so it is queried before the SDL driver.
-// Physical Xbox controller is merged via dynamically-loaded XInput.
+// The physical pad of each slot is merged in from the background poller.
 //
-// Key mapping:
+// Key state is tracked from the window's key events (UI thread). After
+// each change the state of every keyboard slot is rebuilt and published as
+// one packed 64-bit word, so GetState is a single atomic load with no
+// per-key syscalls on the game thread. Losing focus releases every key.
+//
+// Default mapping (slot 1 when settings give it no bindings):
 //   WASD / Arrow keys  = D-pad (movement / menu navigation)
-//   IJKL               = Right stick (turret)
+//   IJKL               = Left stick
 //   Enter              = Start (pause)
 //   Space / Z          = A (confirm / fire)
 //   Escape / Backspace = B (back / cancel)
@@ -14,14 +19,27 @@
 //   Q / E              = LB / RB (shoulder buttons)
 //   [ / ]              = LT / RT (analog triggers)
 //   `                  = Back
+//
+// [keyboard] keys_1..keys_4 in the settings file replace the mapping for a
+// slot, one "CONTROL=Key" string per binding, e.g.
+//   keys_2 = ["UP=Up", "DOWN=Down", "LEFT=Left", "RIGHT=Right", "A=RCtrl"]
+// Controls are the input script's names (A B X Y START BACK UP DOWN LEFT
+// RIGHT LB RB LS RS LT RT) plus stick directions LX- LX+ LY- LY+ RX- RX+
+// RY- RY+. Keys: A-Z, 0-9, Num0-Num9, F1-F12, Up Down Left Right Space
+// Enter Escape Backspace Tab Shift LShift RShift Ctrl LCtrl RCtrl Alt and
+// ` [ ] ; ' , . / \ - =. Slots 2-4 are connected only when bound or when
+// the poller has a pad there.
 
 #pragma once
 
+#include "settings.h"
+
 #include <rex/input/input_driver.h>
 #include <rex/ui/window_listener.h>
 
 #include <atomic>
 #include <cstdint>
+#include <vector>
 
 using rex::X_STATUS;
 using rex::X_RESULT;
@@ -31,12 +49,16 @@ using rex::input::X_INPUT_VIBRATION;
 using rex::input::X_INPUT_KEYSTROKE;
 
 class KeyboardInputDriver final : public rex::input::InputDriver,
+                                  public rex::ui::WindowListener,
                                   public rex::ui::WindowInputListener {
 public:
-    explicit KeyboardInputDriver(rex::ui::Window* window);
+    KeyboardInputDriver(rex::ui::Window* window, const Vig8Settings& settings);
     ~KeyboardInputDriver() override;
 
+    // Starts listening to the window's key events.
     X_STATUS Setup() override;
+    // Stop listening. Call before the window is destroyed.
+    void Detach();
 
     X_RESULT GetCapabilities(uint32_t user_index, uint32_t flags,
                              X_INPUT_CAPABILITIES* out_caps) override;
@@ -46,10 +68,26 @@ public:
     X_RESULT GetKeystroke(uint32_t user_index, uint32_t flags,
                           X_INPUT_KEYSTROKE* out_keystroke) override;
 
-    void OnKeyDown(rex::ui::KeyEvent& e) override {}
-    void OnKeyUp(rex::ui::KeyEvent& e) override {}
+    void OnKeyDown(rex::ui::KeyEvent& e) override;
+    void OnKeyUp(rex::ui::KeyEvent& e) override;
+    void OnLostFocus(rex::ui::UISetupEvent& e) override;
 
 private:
-    uint32_t packet_number_ = 0;
-    uint16_t prev_buttons_  = 0;
+    // `control` is the bit it sets in a packed slot state (see .cpp).
+    struct Binding {
+        uint16_t key;      // rex::ui::VirtualKey (Win32 VK numbering)
+        uint8_t  control;
+    };
+
+    bool SlotEnabled(uint32_t user_index) const;
+    void SetKey(uint16_t key, bool down);
+    void Publish();
+
+    rex::ui::Window*      window_;
+    bool                  listening_ = false;
+    std::vector<Binding>  bindings_[4];
+    bool                  key_down_[256] = {};   // UI thread only
+    std::atomic<uint64_t> state_[4] = {};        // packed, published
+    std::atomic<int64_t>  changed_ns_[4] = {};   // when state_ last changed
+    std::atomic<uint32_t> last_polled_[4] = {};  // packet last returned
 };
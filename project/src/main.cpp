@@ -6,7 +6,12 @@
 #include "settings.h"
 #include "menu.h"
 #include "net.h"
+#include "net_telemetry.h"
+#include "input_latency.h"
 #include "keyboard_driver.h"
+#include "pad_poller.h"
+#include "startup_graph.h"
+#include "vtable_check.h"
 
 #include <rex/cvar.h>
 #include <rex/filesystem.h>
@@ -30,6 +35,7 @@
 #include <imgui.h>
 
 #include <atomic>
+#include <cstdio>
 #include <filesystem>
 #include <thread>
 
@@ -282,6 +288,7 @@ static void ApplyConsoleVisibility(bool show) {
 class DebugOverlayDialog : public rex::ui::ImGuiDialog {
 public:
     bool visible = true;
+    bool show_net = false;  // per-peer network table
 
     DebugOverlayDialog(rex::ui::ImGuiDrawer* imgui_drawer)
         : ImGuiDialog(imgui_drawer) {}
@@ -304,11 +311,68 @@ protected:
         ImGui::SetNextWindowPos(ImVec2(10, 10), ImGuiCond_FirstUseEver);
         ImGui::SetNextWindowSize(ImVec2(220, 60), ImGuiCond_FirstUseEver);
         ImGui::SetNextWindowBgAlpha(0.5f);
-        if (ImGui::Begin("Debug##overlay", nullptr, ImGuiWindowFlags_NoCollapse)) {
+        if (ImGui::Begin("Debug##overlay", nullptr,
+                         ImGuiWindowFlags_NoCollapse |
+                         (show_net || InputLatencyActive() ? ImGuiWindowFlags_AlwaysAutoResize : 0))) {
             ImGui::Text("%.1f FPS (%.2f ms)", io.Framerate, 1000.0f / io.Framerate);
+            if (InputLatencyActive()) DrawLatency();
+            if (show_net) DrawNetStats();
         }
         ImGui::End();
     }
+
+private:
+    // Input change -> first game poll -> present, per percentile.
+    void DrawLatency() {
+        InputLatencyStats s = InputLatencyRead();
+        if (!s.events) {
+            ImGui::TextDisabled("Input latency: no input yet");
+            return;
+        }
+        ImGui::Text("Input->present p50/95/99: %.1f / %.1f / %.1f ms",
+                    s.present_p50_ms, s.present_p95_ms, s.present_p99_ms);
+        ImGui::Text("Input->poll    p50/95/99: %.1f / %.1f / %.1f ms",
+                    s.poll_p50_ms, s.poll_p95_ms, s.poll_p99_ms);
+    }
+
+    // Snapshot taken by the frame hook; one row per peer.
+    void DrawNetStats() {
+        auto peers = NetTelemetrySnapshot();
+        if (peers.empty()) {
+            ImGui::TextDisabled("No network peers");
+            return;
+        }
+        if (!ImGui::BeginTable("net##overlay", 7, ImGuiTableFlags_SizingFixedFit)) return;
+        for (const char* h : {"Peer", "RTT", "Jitter", "Loss", "In kbps", "Out kbps", "Last rx"}) {
+            ImGui::TableSetupColumn(h);
+        }
+        ImGui::TableHeadersRow();
+        for (auto& p : peers) {
+            char ip_str[16];
+            const uint8_t* b = (const uint8_t*)&p.ip;
+            snprintf(ip_str, sizeof(ip_str), "%u.%u.%u.%u", b[0], b[1], b[2], b[3]);
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(ip_str);
+            ImGui::TableNextColumn();
+            if (p.rtt_samples) ImGui::Text("%.1f ms", p.rtt_us / 1000.0f);
+            else ImGui::TextDisabled("-");
+            ImGui::TableNextColumn();
+            if (p.rtt_samples) ImGui::Text("%.1f ms", p.jitter_us / 1000.0f);
+            else ImGui::TextDisabled("-");
+            ImGui::TableNextColumn();
+            if (p.loss_pct >= 0) ImGui::Text("%.1f%%", p.loss_pct);
+            else ImGui::TextDisabled("-");
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", p.rx_kbps);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", p.tx_kbps);
+            ImGui::TableNextColumn();
+            if (p.since_rx_ms >= 0) ImGui::Text("%lld ms", (long long)p.since_rx_ms);
+            else ImGui::TextDisabled("never");
+        }
+        ImGui::EndTable();
+    }
 };
 
 class Vig8App : public rex::ui::WindowedApp,
@@ -371,80 +435,141 @@ public:
         REXLOG_INFO("vig8 starting");
         REXLOG_INFO("  Game directory: {}", game_dir.string());
 
-        // Create and initialize runtime
-        runtime_ = std::make_unique<rex::Runtime>(game_dir);
-        runtime_->set_app_context(&app_context());
-
-        auto status = runtime_->Setup(
-            static_cast<uint32_t>(PPC_CODE_BASE),
-            static_cast<uint32_t>(PPC_CODE_SIZE),
-            static_cast<uint32_t>(PPC_IMAGE_BASE),
-            static_cast<uint32_t>(PPC_IMAGE_SIZE),
-            PPCFuncMappings);
-        if (XFAILED(status)) {
-            REXLOG_ERROR("Runtime setup failed: {:08X}", status);
-            return false;
-        }
-
-        // Load XEX image
-        status = runtime_->LoadXexImage("game:\\default.xex");
-        if (XFAILED(status)) {
-            REXLOG_ERROR("Failed to load XEX: {:08X}", status);
-            return false;
+        // Startup phases as a task graph. The runtime (memory, kernel, GPU
+        // device) comes first; then the XEX image loads and networking
+        // starts on workers while this thread builds the window, drawers
+        // and menus. A background thread reads the assets into the page
+        // cache meanwhile, in either mode, without holding up startup.
+        // [debug] parallel_startup = false runs the same tasks serially.
+        StartupGraph startup;
+        auto t_runtime = startup.Add("runtime", [&]() {
+            runtime_ = std::make_unique<rex::Runtime>(game_dir);
+            runtime_->set_app_context(&app_context());
+            auto status = runtime_->Setup(
+                static_cast<uint32_t>(PPC_CODE_BASE),
+                static_cast<uint32_t>(PPC_CODE_SIZE),
+                static_cast<uint32_t>(PPC_IMAGE_BASE),
+                static_cast<uint32_t>(PPC_IMAGE_SIZE),
+                PPCFuncMappings);
+            if (XFAILED(status)) {
+                REXLOG_ERROR("Runtime setup failed: {:08X}", status);
+                return false;
+            }
+            return true;
+        }, {}, true);
+
+        auto t_xex = startup.Add("xex", [&]() {
+            auto status = runtime_->LoadXexImage("game:\\default.xex");
+            if (XFAILED(status)) {
+                REXLOG_ERROR("Failed to load XEX: {:08X}", status);
+                return false;
+            }
+            return true;
+        }, {t_runtime});
+
+        // [debug] vtable_check: vtable targets with no recompiled function,
+        // listed before the title runs rather than hit mid-game.
+        if (settings_.vtable_check) {
+            startup.Add("vtables", [&]() {
+                std::string report;
+                auto result = VtableCheck(runtime_->kernel_state()->memory()->virtual_membase(), report);
+                if (result.missing) {
+                    REXLOG_WARN("{}", report);
+                } else {
+                    REXLOG_INFO("{}", report);
+                }
+                return true;
+            }, {t_xex});
         }
 
-        // Create window
-        window_ = rex::ui::Window::Create(app_context(), "Vigilante 8 Arcade", 1280, 720);
-        if (!window_) {
-            REXLOG_ERROR("Failed to create window");
-            return false;
-        }
+        auto t_window = startup.Add("window", [&]() {
+            window_ = rex::ui::Window::Create(app_context(), "Vigilante 8 Arcade", 1280, 720);
+            if (!window_) {
+                REXLOG_ERROR("Failed to create window");
+                return false;
+            }
 
-        window_->AddListener(this);
-        window_->AddInputListener(this, 0);
-        window_->Open();
+            window_->AddListener(this);
+            window_->AddInputListener(this, 0);
+            window_->Open();
+            return true;
+        }, {}, true);
 
-        // Setup graphics presenter and ImGui
-        auto* graphics_system = runtime_->graphics_system();
-        if (graphics_system && graphics_system->presenter()) {
+        // Graphics presenter, ImGui and menus
+        auto t_ui = startup.Add("ui", [&]() {
+            auto* graphics_system = runtime_->graphics_system();
+            if (!graphics_system || !graphics_system->presenter()) return true;
             auto* presenter = graphics_system->presenter();
             auto* provider = graphics_system->provider();
-            if (provider) {
-                immediate_drawer_ = provider->CreateImmediateDrawer();
-                if (immediate_drawer_) {
-                    immediate_drawer_->SetPresenter(presenter);
-                    imgui_drawer_ = std::make_unique<rex::ui::ImGuiDrawer>(window_.get(), 64);
-                    imgui_drawer_->SetPresenterAndImmediateDrawer(presenter, immediate_drawer_.get());
-
-                    // Debug FPS overlay (visibility controlled by settings)
-                    debug_overlay_ = std::unique_ptr<DebugOverlayDialog>(
-                        new DebugOverlayDialog(imgui_drawer_.get()));
-                    debug_overlay_->visible = settings_.show_fps;
-
-                    // Menu system with config dialogs
-                    menu_system_ = std::make_unique<MenuSystem>(
-                        imgui_drawer_.get(), window_.get(), &app_context(),
-                        runtime_.get(),
-                        &settings_, settings_path_,
-                        [this]() { ApplySettings(); });
-                    auto menu = menu_system_->BuildMenuBar();
-                    window_->SetMainMenu(std::move(menu));
-                    window_->CompleteMainMenuItemsUpdate();
-
-                    runtime_->set_display_window(window_.get());
-                    runtime_->set_imgui_drawer(imgui_drawer_.get());
-
-                    // set_display_window triggers SetupInputDrivers, so
-                    // input_system() is valid from this point on.
-                    if (runtime_->kernel_state()->input_system()) {
-                        auto kbd = std::make_unique<KeyboardInputDriver>(window_.get());
-                        kbd->Setup();
-                        runtime_->kernel_state()->input_system()->InsertDriverFront(std::move(kbd));
-                    }
+            if (!provider) return true;
+            immediate_drawer_ = provider->CreateImmediateDrawer();
+            if (!immediate_drawer_) return true;
+            immediate_drawer_->SetPresenter(presenter);
+            imgui_drawer_ = std::make_unique<rex::ui::ImGuiDrawer>(window_.get(), 64);
+            imgui_drawer_->SetPresenterAndImmediateDrawer(presenter, immediate_drawer_.get());
+
+            // Debug FPS overlay (visibility controlled by settings)
+            debug_overlay_ = std::unique_ptr<DebugOverlayDialog>(
+                new DebugOverlayDialog(imgui_drawer_.get()));
+            debug_overlay_->visible = settings_.show_fps || settings_.show_net_stats ||
+                                      settings_.input_latency;
+            debug_overlay_->show_net = settings_.show_net_stats;
+
+            // Menu system with config dialogs
+            menu_system_ = std::make_unique<MenuSystem>(
+                imgui_drawer_.get(), window_.get(), &app_context(),
+                runtime_.get(),
+                &settings_, settings_path_,
+                [this]() { ApplySettings(); });
+            auto menu = menu_system_->BuildMenuBar();
+            window_->SetMainMenu(std::move(menu));
+            window_->CompleteMainMenuItemsUpdate();
+            return true;
+        }, {t_runtime, t_window}, true);
+
+        startup.Add("display", [&]() {
+            auto* graphics_system = runtime_->graphics_system();
+            if (!graphics_system || !graphics_system->presenter()) return true;
+            if (imgui_drawer_) {
+                runtime_->set_display_window(window_.get());
+                runtime_->set_imgui_drawer(imgui_drawer_.get());
+
+                // set_display_window triggers SetupInputDrivers, so
+                // input_system() is valid from this point on.
+                if (runtime_->kernel_state()->input_system()) {
+                    PadPollerStart(settings_.pad_backend, settings_.pad_poll_hz);
+                    auto kbd = std::make_unique<KeyboardInputDriver>(window_.get(), settings_);
+                    kbd->Setup();
+                    keyboard_driver_ = kbd.get();
+                    runtime_->kernel_state()->input_system()->InsertDriverFront(std::move(kbd));
                 }
             }
-            window_->SetPresenter(presenter);
-        }
+            window_->SetPresenter(graphics_system->presenter());
+            return true;
+        }, {t_ui, t_xex}, true);
+
+        // Initialize LAN networking and optional relay (after runtime so
+        // kernel_state is available). The relay connect can block.
+        startup.Add("net", [&]() {
+            NetSetTestOptions(MakeNetTestOptions(settings_));
+            NetInit(settings_.lan_port,
+                    settings_.relay_enabled,
+                    settings_.relay_host.c_str(),
+                    settings_.relay_port,
+                    settings_.relay_protocol.c_str());
+            return true;
+        }, {t_runtime});
+
+        startup.AddBackground("assets", [dir = game_dir.string()]() {
+            uint64_t bytes = StartupWarmFiles(dir, 1ull << 30);
+            REXLOG_INFO("Warmed {} MB of assets", bytes >> 20);
+        });
+
+        bool started = startup.Run(settings_.parallel_startup);
+        std::string report = startup.Report();
+        REXLOG_INFO("{}", report);
+        fprintf(stderr, "%s", report.c_str());
+        if (!started) return false;
 
         // Apply fullscreen after presenter is fully wired up
         if (settings_.fullscreen) {
@@ -454,11 +579,9 @@ public:
             });
         }
 
-        // Initialize LAN networking and optional relay (after runtime so kernel_state is available)
-        NetInit(settings_.lan_port,
-                settings_.relay_enabled,
-                settings_.relay_host.c_str(),
-                settings_.relay_port);
+        if (settings_.input_latency || !settings_.latency_csv.empty()) {
+            InputLatencyStart(settings_.latency_csv);
+        }
 
         // Launch module in background
         app_context().CallInUIThreadDeferred([this]() {
@@ -531,9 +654,13 @@ public:
             module_thread_.join();
         }
         if (window_) {
+            // The input system (and the keyboard driver) outlive the window
+            if (keyboard_driver_) keyboard_driver_->Detach();
             window_->RemoveInputListener(this);
             window_->RemoveListener(this);
         }
+        PadPollerStop();
+        InputLatencyStop();
         // Shut down LAN networking before runtime is destroyed
         NetShutdown();
 
@@ -562,7 +689,9 @@ private:
     void ApplySettings() {
         // Debug overlay visibility
         if (debug_overlay_) {
-            debug_overlay_->visible = settings_.show_fps;
+            debug_overlay_->visible = settings_.show_fps || settings_.show_net_stats ||
+                                      settings_.input_latency;
+            debug_overlay_->show_net = settings_.show_net_stats;
         }
 
         // Debug console visibility
@@ -597,6 +726,7 @@ private:
     std::unique_ptr<rex::ui::ImGuiDrawer> imgui_drawer_;
     std::unique_ptr<DebugOverlayDialog> debug_overlay_;
     std::unique_ptr<MenuSystem> menu_system_;
+    KeyboardInputDriver* keyboard_driver_ = nullptr;  // owned by the input system
     Vig8Settings settings_;
     std::filesystem::path settings_path_;
 };
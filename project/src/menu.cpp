@@ -181,6 +181,7 @@ public:
         : ImGuiDialog(drawer), settings_(settings),
           settings_path_(settings_path), on_done_(std::move(on_done)) {
         show_fps_ = settings->show_fps;
+        show_net_stats_ = settings->show_net_stats;
         show_console_ = settings->show_console;
         invulnerable_ = settings->invulnerable;
         unlock_all_cars_ = settings->unlock_all_cars;
@@ -189,11 +190,12 @@ public:
 protected:
     void OnDraw(ImGuiIO& io) override {
         (void)io;
-        ImGui::SetNextWindowSize(ImVec2(370, 240), ImGuiCond_FirstUseEver);
+        ImGui::SetNextWindowSize(ImVec2(370, 260), ImGuiCond_FirstUseEver);
         if (ImGui::Begin("Debug Options##vig8", nullptr,
                          ImGuiWindowFlags_NoCollapse |
                          ImGuiWindowFlags_NoResize)) {
             ImGui::Checkbox("Show FPS overlay", &show_fps_);
+            ImGui::Checkbox("Show network stats overlay", &show_net_stats_);
             ImGui::Checkbox("Show debug console", &show_console_);
             ImGui::Separator();
             ImGui::Checkbox("Player invulnerable", &invulnerable_);
@@ -209,6 +211,7 @@ protected:
             RightAlignedButtons();
             if (ImGui::Button("OK", ImVec2(80, 0))) {
                 settings_->show_fps = show_fps_;
+                settings_->show_net_stats = show_net_stats_;
                 settings_->show_console = show_console_;
                 settings_->invulnerable = invulnerable_;
                 settings_->unlock_all_cars = unlock_all_cars_;
@@ -230,6 +233,7 @@ private:
     std::filesystem::path settings_path_;
     std::function<void()> on_done_;
     bool show_fps_ = true;
+    bool show_net_stats_ = false;
     bool show_console_ = false;
     bool invulnerable_ = false;
     bool unlock_all_cars_ = false;
@@ -9,24 +9,38 @@
 //       -> Our overrides here (via /force:multiple)
 //         -> Real native sockets (already working in SDK)
 //         -> Background discovery thread (for QoS beacons)
+//         -> Receive reactor thread (completes overlapped WSARecvFrom)
 
 #include "net.h"
+#include "net_capture.h"
+#include "net_punch.h"
+#include "net_scheduler.h"
+#include "net_telemetry.h"
+#include "net_tunnel.h"
+#include "relay_client.h"
+#include "session_cache.h"
+#include "peer_table.h"
+#include "present_hook.h"
 #include "vig8_config.h"
-#include "xlive.h"
 
 #include <rex/runtime/guest/context.h>
 #include <rex/runtime/guest/memory.h>
 #include <rex/kernel/kernel_state.h>
+#include <rex/kernel/xevent.h>
 #include <rex/kernel/xsocket.h>
 #include <rex/logging.h>
 
 #include <algorithm>
+#include <array>
 #include <atomic>
+#include <cerrno>
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
+#include <deque>
+#include <filesystem>
 #include <mutex>
-#include <shared_mutex>
+#include <random>
 #include <thread>
 #include <unordered_map>
 #include <vector>
@@ -37,8 +51,10 @@
 #pragma comment(lib, "ws2_32.lib")
 #else
 #include <arpa/inet.h>
+#include <fcntl.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <sys/select.h>
 #include <unistd.h>
@@ -58,14 +74,30 @@ static XNADDR_LAN g_local_xnaddr;        // Our XNADDR with real LAN IP
 static uint32_t    g_local_ip_net = 0;    // Our IP in network byte order
 static int         g_lan_port = 3074;     // Discovery port (configurable)
 
-// Peer table: maps IP (network order) -> peer info
-struct PeerEntry {
-    XNADDR_LAN xnaddr;
-    uint8_t     xnkid[8];
-    bool        connected;
-};
-static std::vector<PeerEntry> g_peers;
-static std::shared_mutex      g_peers_mutex;
+// Peer table: maps IP (network order) -> peer info. Lock-free lookups;
+// unconnected peers silent for PEER_IDLE_EXPIRY_MS are dropped by the
+// discovery thread.
+static PeerTable g_peers;
+static constexpr int64_t PEER_IDLE_EXPIRY_MS  = 30000;
+static constexpr int64_t PEER_EXPIRY_SCAN_MS  = 1000;
+
+// Hosts beacon fast while someone is searching (a DISC_PROBE, or a QoS
+// probe, heard within BEACON_FAST_HOLD_MS) and slowly otherwise. v1 peers
+// beacon every BEACON_INTERVAL_V1_MS.
+static constexpr int64_t BEACON_INTERVAL_V1_MS   = 500;
+static constexpr int64_t BEACON_INTERVAL_FAST_MS = 250;
+static constexpr int64_t BEACON_INTERVAL_IDLE_MS = 1000;
+static constexpr int64_t BEACON_FAST_HOLD_MS     = 10000;
+static std::atomic<int64_t> g_last_probe_heard_ms{-1};
+
+// Joinable sessions (relay list + beaconing LAN hosts) that XGI searches
+// answer from. A search that finds the relay part older than
+// SESSION_RELAY_STALE_MS answers from it anyway and refreshes it behind
+// the answer.
+static SessionCache g_sessions;
+static constexpr int64_t LAN_SESSION_EXPIRY_MS   = 5000;   // 5 missed idle beacons
+static constexpr int64_t SESSION_RELAY_STALE_MS  = 2000;
+static constexpr int     SESSION_CACHE_MAX       = 4096;
 
 // QoS listener state
 struct QosListenerState {
@@ -81,18 +113,6 @@ static std::mutex       g_qos_mutex;
 // thread can write to guest memory for deferred QoS completion.
 static uint8_t* g_base = nullptr;
 
-// Deferred QoS completion: when XNetQosLookup finds sessions it writes
-// cxnqosPending = N (pending) and schedules a completion here.  The
-// discovery thread sets cxnqosPending = 0 after a short delay, giving the
-// game time to finish initialising the session struct (specifically r31+8,
-// the completion-callback object) before we trigger the callback path.
-struct PendingQosCompletion {
-    uint32_t qos_addr;  // guest address of XNQOS struct
-    std::chrono::steady_clock::time_point ready_at;
-};
-static std::vector<PendingQosCompletion> g_pending_qos;
-static std::mutex                        g_pending_qos_mutex;
-
 // Discovery thread
 static SOCKET             g_disc_socket = (SOCKET)INVALID_SOCKET;
 static std::thread        g_disc_thread;
@@ -102,33 +122,316 @@ static std::atomic<bool>  g_disc_running{false};
 // so the crash handler can report exactly where the thread was.
 std::atomic<int> g_disc_step{0};
 
-// Pending overlapped completions — for XGI SEARCH we delay the completion
-// so the game has time to store the callback object at overlapped+8 before
-// sub_8218A068 tries to dereference it.
-struct PendingOverlappedCompletion {
-    uint32_t overlapped_ptr;
-    uint32_t result;
-    std::chrono::steady_clock::time_point fire_at;
-};
-static std::vector<PendingOverlappedCompletion> g_pending_ov;
-static std::mutex                               g_pending_ov_mutex;
-
-// Pending async recv operations
+// Pending async recv operations, keyed by guest WSAOVERLAPPED address.
+// Completed by the reactor thread as soon as the socket becomes readable;
+// the guest only ever observes the result through overlapped memory.
 struct PendingRecv {
     uint32_t socket_handle;   // guest XSocket handle
+    SOCKET   native;          // host socket (resolved on the guest thread)
     uint32_t buf_guest;       // guest buffer pointer (WSABUF.buf)
     uint32_t buf_len;         // buffer length
     uint32_t bytes_ptr;       // guest ptr for bytes received
     uint32_t flags_ptr;       // guest ptr for flags
     uint32_t from_ptr;        // guest ptr for sockaddr_in
     uint32_t fromlen_ptr;     // guest ptr for fromlen
+    uint32_t event_handle;    // WSAOVERLAPPED.hEvent (0 = none)
+    uint64_t seq;             // registration order (FIFO per socket)
 };
 static std::unordered_map<uint32_t, PendingRecv> g_pending_recvs;
 static std::mutex g_pending_mutex;
+static uint64_t   g_pending_seq = 0;
+
+// Receive reactor: one thread polls every socket that has a pending
+// overlapped receive and completes it straight into guest memory.
+static std::thread        g_reactor_thread;
+static std::atomic<bool>  g_reactor_running{false};
+static SOCKET             g_reactor_wake = (SOCKET)INVALID_SOCKET;
+static struct sockaddr_in g_reactor_wake_addr = {};
+
+// Kernel state captured on a guest thread (kernel_state() is not usable from
+// raw std::threads) so the reactor can signal WSAOVERLAPPED.hEvent.
+static rex::kernel::KernelState* g_kernel_state = nullptr;
 
 // System-link port (game-set via XNetSetSystemLinkPort)
 static uint16_t g_system_link_port = 0;
 
+// ============================================================================
+// Traffic statistics and impairment (loopback test harness)
+// ============================================================================
+//
+// Every datagram we send goes through NetSendTo, which applies the
+// configured NetImpairment (loss, latency/jitter, reordering, egress
+// bandwidth cap) and counts per-peer traffic. With impairment off it is a
+// plain sendto. Delayed packets are sent from the timer thread.
+//
+// Per-peer counters live in net_telemetry; these helpers feed them. A peer
+// gets counters when it enters g_peers and loses them when it leaves.
+
+static NetClock::time_point g_net_start;
+static std::atomic<int64_t> g_session_created_ms{-1};
+static std::atomic<int64_t> g_first_search_hit_ms{-1};
+
+static int64_t NetUptimeMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        NetClock::now() - g_net_start).count();
+}
+
+static int64_t SteadyNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void NoteRecv(uint32_t ip_net, int bytes) {
+    NetTelemetryRx(ip_net, (uint32_t)bytes, SteadyNowNs());
+}
+
+static void NotePeerDiscovered(uint32_t ip_net) {
+    NetTelemetryDiscovered(ip_net, NetUptimeMs());
+}
+
+static void NotePeerConnected(uint32_t ip_net) {
+    NetTelemetryConnected(ip_net, NetUptimeMs());
+}
+
+// Record a first-occurrence time, once.
+static void NoteFirst(std::atomic<int64_t>& when_ms) {
+    int64_t unset = -1;
+    when_ms.compare_exchange_strong(unset, NetUptimeMs(), std::memory_order_relaxed);
+}
+
+static NetTestOptions g_test_opts;
+static uint32_t       g_bind_ip_net = INADDR_ANY;   // set from bind_address
+static std::vector<struct sockaddr_in> g_disc_peers; // parsed discovery_peers
+
+struct ImpairState {
+    std::mutex           mutex;
+    bool                 enabled = false;
+    std::mt19937         rng;
+    NetClock::time_point link_free;  // when the capped egress link drains
+};
+static ImpairState g_impair;
+
+// Longest egress queue the bandwidth cap will hold before tail-dropping.
+static constexpr auto IMPAIR_MAX_BACKLOG = std::chrono::milliseconds(1000);
+
+void NetSetTestOptions(const NetTestOptions& options) {
+    g_test_opts = options;
+    const NetImpairment& im = options.impair;
+    std::lock_guard lock(g_impair.mutex);
+    g_impair.enabled = im.latency_ms > 0 || im.jitter_ms > 0 || im.loss_pct > 0 ||
+                       im.reorder_pct > 0 || im.bandwidth_kbps > 0;
+    g_impair.rng.seed(im.seed);
+    g_impair.link_free = NetClock::time_point{};
+}
+
+static uint16_t SocketLocalPort(SOCKET sock) {
+    struct sockaddr_in a = {};
+    socklen_t len = sizeof(a);
+    getsockname(sock, (struct sockaddr*)&a, &len);
+    return a.sin_port;
+}
+
+// Wrap a game datagram for a peer reached over a punched path.
+static int WrapDirect(SOCKET sock, const struct sockaddr_in& dest,
+                      const uint8_t* data, int len, uint8_t* out) {
+    uint16_t src_port = SocketLocalPort(sock);
+    out[0] = DISC_MAGIC;
+    out[1] = DISC_DIRECT;
+    std::memcpy(out + 2, &dest.sin_port, 2);
+    std::memcpy(out + 4, &src_port, 2);
+    std::memcpy(out + 6, &g_local_ip_net, 4);
+    std::memcpy(out + DISC_DIRECT_HEADER_LEN, data, (size_t)len);
+    return DISC_DIRECT_HEADER_LEN + len;
+}
+
+// `record` is false for tunnel packets: the guest datagrams inside them
+// were captured when queued. `to` is the address the guest used; a peer
+// with a punched path (net_punch.h) is sent to from the discovery socket
+// instead.
+static int NetSendTo(SOCKET sock, const uint8_t* data, int len,
+                     const struct sockaddr_in& to, bool record = true) {
+    struct sockaddr_in dest = to;
+    uint32_t peer = to.sin_addr.s_addr;
+    if (record && NetCaptureActive()) {
+        bool disc = sock == g_disc_socket;
+        NetCaptureRecord(NetCapDir::Out, disc ? NetCapKind::Discovery : NetCapKind::Game,
+                         g_local_ip_net,
+                         disc ? htons((uint16_t)g_lan_port) : SocketLocalPort(sock),
+                         peer, dest.sin_port, data, (size_t)len);
+    }
+    // While replaying the peers exist only in the capture; nothing goes out.
+    if (NetReplayActive()) return len;
+
+    static thread_local uint8_t wrapped[DISC_DIRECT_HEADER_LEN + 65536];
+    int guest_len = len;
+    if (sock != g_disc_socket && len <= 65536 && PunchRoute(peer, &dest)) {
+        len = WrapDirect(sock, to, data, len, wrapped);
+        data = wrapped;
+        sock = g_disc_socket;
+    }
+
+    bool impaired;
+    {
+        std::lock_guard lock(g_impair.mutex);
+        impaired = g_impair.enabled;
+    }
+    if (!impaired) {
+        int n = sendto(sock, (const char*)data, len, 0,
+                       (const struct sockaddr*)&dest, sizeof(dest));
+        if (n >= 0) NetTelemetryTx(peer, (uint32_t)n);
+        return n >= 0 ? guest_len : n;
+    }
+
+    const NetImpairment& im = g_test_opts.impair;
+    auto now = NetClock::now();
+    bool drop = false, reorder = false;
+    NetClock::time_point send_at;
+    {
+        std::lock_guard lock(g_impair.mutex);
+        std::uniform_real_distribution<double> pct(0.0, 100.0);
+        drop = im.loss_pct > 0 && pct(g_impair.rng) < im.loss_pct;
+
+        // Egress serialization: the packet leaves once the link is free
+        auto departs = now;
+        if (!drop && im.bandwidth_kbps > 0) {
+            auto tx_time = std::chrono::microseconds((int64_t)len * 8 * 1000 / im.bandwidth_kbps);
+            departs = std::max(now, g_impair.link_free) + tx_time;
+            if (departs - now > IMPAIR_MAX_BACKLOG) {
+                drop = true;  // queue full
+            } else {
+                g_impair.link_free = departs;
+            }
+        }
+
+        int delay_ms = im.latency_ms;
+        if (im.jitter_ms > 0) {
+            std::uniform_int_distribution<int> jitter(-im.jitter_ms, im.jitter_ms);
+            delay_ms = std::max(0, delay_ms + jitter(g_impair.rng));
+        }
+        if (im.reorder_pct > 0 && pct(g_impair.rng) < im.reorder_pct) {
+            // Hold back past anything sent in the next few milliseconds
+            reorder = true;
+            delay_ms += std::max(10, im.jitter_ms * 2);
+        }
+        send_at = departs + std::chrono::milliseconds(delay_ms);
+    }
+
+    if (drop) {
+        NetTelemetryDropped(peer);
+    } else {
+        NetTelemetryTx(peer, (uint32_t)len);
+        if (reorder) NetTelemetryReordered(peer);
+    }
+    if (drop) return guest_len;  // lost on the wire — the sender can't tell
+
+    if (send_at <= now) {
+        sendto(sock, (const char*)data, len, 0,
+               (const struct sockaddr*)&dest, sizeof(dest));
+    } else {
+        std::vector<uint8_t> copy(data, data + len);
+        NetTimerRunAt(send_at, [sock, dest, copy = std::move(copy)]() {
+            sendto(sock, (const char*)copy.data(), (int)copy.size(), 0,
+                   (const struct sockaddr*)&dest, sizeof(dest));
+        });
+    }
+    return guest_len;
+}
+
+// Parse "ip" or "ip:port" (port defaults to the discovery port).
+static bool ParseHostPort(const std::string& spec, int default_port, struct sockaddr_in* out) {
+    std::string host = spec;
+    int port = default_port;
+    size_t colon = spec.rfind(':');
+    if (colon != std::string::npos) {
+        host = spec.substr(0, colon);
+        port = std::atoi(spec.c_str() + colon + 1);
+    }
+    *out = {};
+    out->sin_family = AF_INET;
+    out->sin_port = htons((uint16_t)port);
+    return port > 0 && port < 65536 &&
+           inet_pton(AF_INET, host.c_str(), &out->sin_addr) == 1;
+}
+
+// Write the stats file atomically (temp + rename) so the harness never
+// reads a torn file.
+static void WriteNetStats() {
+    if (!g_test_opts.metrics_path.empty()) {
+        char self[INET_ADDRSTRLEN] = {};
+        struct in_addr a;
+        a.s_addr = g_local_ip_net;
+        inet_ntop(AF_INET, &a, self, sizeof(self));
+        NetTelemetryWritePrometheus(g_test_opts.metrics_path, self, PresentFrameNumber(),
+                                    NetUptimeMs(), SteadyNowNs());
+    }
+    if (g_test_opts.stats_path.empty()) return;
+    std::string tmp = g_test_opts.stats_path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "w");
+    if (!f) return;
+
+    char self[INET_ADDRSTRLEN] = {};
+    struct in_addr a;
+    a.s_addr = g_local_ip_net;
+    inet_ntop(AF_INET, &a, self, sizeof(self));
+
+    fprintf(f, "{\n  \"instance\": \"%s\",\n  \"uptime_ms\": %lld,\n", self,
+            (long long)NetUptimeMs());
+    fprintf(f, "  \"session_created_ms\": %lld,\n  \"first_search_hit_ms\": %lld,\n",
+            (long long)g_session_created_ms.load(), (long long)g_first_search_hit_ms.load());
+    fprintf(f, "  \"peers\": [");
+    bool first = true;
+    for (auto& t : NetTelemetryRead(SteadyNowNs())) {
+        char ip_str[INET_ADDRSTRLEN] = {};
+        a.s_addr = t.ip;
+        inet_ntop(AF_INET, &a, ip_str, sizeof(ip_str));
+        fprintf(f, "%s\n    {\"ip\": \"%s\", \"discovered_ms\": %lld, \"connected_ms\": %lld, "
+                   "\"tx_packets\": %llu, \"tx_bytes\": %llu, \"rx_packets\": %llu, "
+                   "\"rx_bytes\": %llu, \"dropped\": %llu, \"reordered\": %llu, "
+                   "\"rtt_us\": %u, \"jitter_us\": %u, \"loss_pct\": %.1f}",
+                first ? "" : ",", ip_str, (long long)t.discovered_ms, (long long)t.connected_ms,
+                (unsigned long long)t.tx_packets, (unsigned long long)t.tx_bytes,
+                (unsigned long long)t.rx_packets, (unsigned long long)t.rx_bytes,
+                (unsigned long long)t.dropped, (unsigned long long)t.reordered,
+                t.rtt_us, t.jitter_us, t.loss_pct);
+        first = false;
+    }
+    fprintf(f, "\n  ]");
+    TunnelStats ts = TunnelGetStats();
+    if (ts.packets || ts.rx_packets) {
+        fprintf(f, ",\n  \"tunnel\": {\"datagrams\": %llu, \"packets\": %llu, "
+                   "\"compressed\": %llu, \"raw_bytes\": %llu, \"wire_bytes\": %llu, "
+                   "\"hold_avg_us\": %llu, \"hold_max_us\": %llu, \"rx_packets\": %llu, "
+                   "\"rx_datagrams\": %llu, \"rx_errors\": %llu}",
+                (unsigned long long)ts.datagrams, (unsigned long long)ts.packets,
+                (unsigned long long)ts.compressed, (unsigned long long)ts.raw_bytes,
+                (unsigned long long)ts.wire_bytes,
+                (unsigned long long)(ts.datagrams ? ts.hold_us_total / ts.datagrams : 0),
+                (unsigned long long)ts.hold_us_max, (unsigned long long)ts.rx_packets,
+                (unsigned long long)ts.rx_datagrams, (unsigned long long)ts.rx_errors);
+    }
+    auto paths = PunchGetPaths();
+    if (!paths.empty()) {
+        fprintf(f, ",\n  \"direct_paths\": [");
+        for (size_t i = 0; i < paths.size(); i++) {
+            char ip_str[INET_ADDRSTRLEN] = {}, ep_str[INET_ADDRSTRLEN] = {};
+            a.s_addr = paths[i].ina;
+            inet_ntop(AF_INET, &a, ip_str, sizeof(ip_str));
+            inet_ntop(AF_INET, &paths[i].endpoint.sin_addr, ep_str, sizeof(ep_str));
+            fprintf(f, "%s\n    {\"ip\": \"%s\", \"state\": \"%s\", \"endpoint\": \"%s:%u\", "
+                       "\"rtt_us\": %lld, \"attempts\": %d}",
+                    i ? "," : "", ip_str, paths[i].state, ep_str,
+                    ntohs(paths[i].endpoint.sin_port), (long long)paths[i].rtt_us,
+                    paths[i].attempts);
+        }
+        fprintf(f, "\n  ]");
+    }
+    fprintf(f, "\n}\n");
+    fclose(f);
+
+    std::error_code ec;
+    std::filesystem::rename(tmp, g_test_opts.stats_path, ec);
+}
+
 // ============================================================================
 // XGI session intercept — overrides __imp__XMsgStartIORequest to handle
 // session create/search/delete via xlive relay.
@@ -140,6 +443,8 @@ static uint16_t g_system_link_port = 0;
 // to the AppManager as normal.
 //
 // Message IDs (determined from vig8_recomp.9.cpp PPC disassembly):
+//   0x000B0007  XGIUserSetContextEx   — observed, then forwarded
+//   0x000B0008  XGIUserSetPropertyEx  — observed, then forwarded
 //   0x000B0010  XGISessionCreateImpl  (28 bytes) — host creates a session
 //   0x000B001C  XGISessionSearch      (36 bytes) — search for sessions
 //   0x000B0011  XGISessionDelete      (16 bytes) — delete/end session
@@ -151,11 +456,16 @@ static constexpr uint32_t VIG8_TITLE_ID = 0x584109A8;
 
 // Currently hosted session XNKID
 static uint8_t  g_session_xnkid[8] = {};
+static uint8_t  g_session_public_slots  = 0;   // from XGISessionCreate
+static uint8_t  g_session_private_slots = 0;
 static bool     g_session_active   = false;
+static SessionTerms g_session_terms;            // advertised in v3 beacons
 static std::mutex g_session_mutex;
 
 // Forward declaration (defined below in peer-table section)
 static void AddOrUpdatePeer(const XNADDR_LAN& addr, const uint8_t* xnkid);
+static int64_t PeerClockMs();
+static void SendProbe(SOCKET sock, const uint8_t* target_kid);
 
 // Big-endian read/write helpers for guest memory
 static inline uint32_t GuestReadU32(uint8_t* base, uint32_t addr) {
@@ -169,6 +479,58 @@ static inline void GuestWriteU32(uint8_t* base, uint32_t addr, uint32_t val) {
                 | ((val & 0x0000FF00u) << 8)  | ((val & 0x000000FFu) << 24);
     std::memcpy(base + addr, &be, 4);
 }
+static inline uint16_t GuestReadU16(uint8_t* base, uint32_t addr) {
+    return (uint16_t)((base[addr] << 8) | base[addr + 1]);
+}
+static inline void GuestWriteU16(uint8_t* base, uint32_t addr, uint16_t val) {
+    uint8_t be[2] = {(uint8_t)(val >> 8), (uint8_t)(val & 0xFF)};
+    std::memcpy(base + addr, be, 2);
+}
+
+// ---- XGIUserSetContextEx / XGIUserSetPropertyEx (0x000B0007 / 0x000B0008) ----
+// Buffer layout (XgiApp):
+//   [0x00] user_index
+//   [0x10] context_id / property_id
+//   [0x14] context_value / value_size (4 or 8)
+//   [0x18] — / value_ptr (big-endian integer)
+// The SDK's XgiApp still handles both; the values are only noted here so
+// a hosted session's beacon can advertise them. Only the integer sizes are
+// kept; the last value set for an id wins whichever local user set it.
+static void NoteUserTerm(uint8_t* base, uint32_t message, uint32_t buf, uint32_t len) {
+    if (!buf || len < 0x18) return;
+    uint32_t id = GuestReadU32(base, buf + 0x10);
+    std::lock_guard<std::mutex> lk(g_session_mutex);
+    if (message == 0x000B0007) {
+        uint32_t value = GuestReadU32(base, buf + 0x14);
+        auto& ctxs = g_session_terms.contexts;
+        auto it = std::find_if(ctxs.begin(), ctxs.end(), [&](const auto& c) { return c.first == id; });
+        if (it != ctxs.end()) {
+            it->second = value;
+        } else if (ctxs.size() < (size_t)DISC_BEACON_MAX_TERMS) {
+            ctxs.emplace_back(id, value);
+        }
+        REXLOG_INFO("[XGI] USER CONTEXT 0x{:08X}={}", id, value);
+        return;
+    }
+    if (len < 0x1C) return;
+    uint32_t size = GuestReadU32(base, buf + 0x14);
+    uint32_t value_ptr = GuestReadU32(base, buf + 0x18);
+    if (!value_ptr || (size != 4 && size != 8)) return;
+    SessionTerms::Property prop{id, 1, (int32_t)GuestReadU32(base, value_ptr)};
+    if (size == 8) {
+        prop.type = 2;
+        prop.value = (int64_t)(((uint64_t)GuestReadU32(base, value_ptr) << 32) |
+                               GuestReadU32(base, value_ptr + 4));
+    }
+    auto& props = g_session_terms.properties;
+    auto it = std::find_if(props.begin(), props.end(), [&](const auto& p) { return p.id == id; });
+    if (it != props.end()) {
+        *it = prop;
+    } else if (props.size() < (size_t)DISC_BEACON_MAX_TERMS) {
+        props.push_back(prop);
+    }
+    REXLOG_INFO("[XGI] USER PROPERTY 0x{:08X} size={} value={}", id, size, (long long)prop.value);
+}
 
 // ---- XGISessionCreateImpl (0x000B0010, 28 bytes) ----
 // Buffer layout (from XgiApp.cpp + vig8_recomp.9.cpp disasm):
@@ -187,7 +549,8 @@ static rex::X_HRESULT HandleXgiCreate(uint8_t* base, uint32_t buf, uint32_t len)
         return 0x80004005;
     }
     uint32_t session_info_ptr = GuestReadU32(base, buf + 0x14);
-    uint32_t num_public = GuestReadU32(base, buf + 0x08);
+    uint32_t num_public  = GuestReadU32(base, buf + 0x08);
+    uint32_t num_private = GuestReadU32(base, buf + 0x0C);
     REXLOG_INFO("[XGI] CREATE session_info_ptr=0x{:08X} pub_slots={}", session_info_ptr, num_public);
     fprintf(stderr, "[XGI] CREATE session_info_ptr=0x%08X pub_slots=%u\n", session_info_ptr, num_public);
     fflush(stderr);
@@ -203,18 +566,27 @@ static rex::X_HRESULT HandleXgiCreate(uint8_t* base, uint32_t buf, uint32_t len)
     {
         std::lock_guard<std::mutex> lk(g_session_mutex);
         std::memcpy(g_session_xnkid, xnkid, 8);
+        g_session_public_slots  = (uint8_t)std::min<uint32_t>(num_public, 0xFF);
+        g_session_private_slots = (uint8_t)std::min<uint32_t>(num_private, 0xFF);
         g_session_active = true;
     }
+    NoteFirst(g_session_created_ms);
 
     // Write XSESSION_INFO = XNKID(8) + XNADDR(36)
     if (session_info_ptr) {
         std::memcpy(base + session_info_ptr,      xnkid,           8);
         std::memcpy(base + session_info_ptr + 8,  &g_local_xnaddr, sizeof(XNADDR_LAN));
+        NetCaptureRecord(NetCapDir::In, NetCapKind::XgiCreate, 0, 0, 0, 0,
+                         base + session_info_ptr, 8 + sizeof(XNADDR_LAN));
     }
 
-    if (xlive::IsConnected()) {
-        xlive::RegisterSession(xnkid, nullptr, 0, (uint8_t)num_public);
-        fprintf(stderr, "[XGI] CREATE: registered session with relay\n");
+    if (RelayIsConnected()) {
+        std::array<uint8_t, 8> kid;
+        std::memcpy(kid.data(), xnkid, 8);
+        RelayPost([kid, num_public]() {
+            RelayRegisterSession(kid.data(), (uint8_t)num_public);
+        });
+        fprintf(stderr, "[XGI] CREATE: registering session with relay\n");
     } else {
         fprintf(stderr, "[XGI] CREATE: relay not connected, session is LAN-only\n");
     }
@@ -251,41 +623,57 @@ static rex::X_HRESULT HandleXgiCreate(uint8_t* base, uint32_t buf, uint32_t len)
 //   [46]    cFilledPublicSlots
 //   [47]    cFilledPrivateSlots
 //   [48..63] dwNumProperties, dwNumContexts, pProperties, pContexts (all 0)
-static rex::X_HRESULT HandleXgiSearch(uint8_t* base, uint32_t buf, uint32_t len) {
-    if (!buf || len < 0x20) {
-        REXLOG_WARN("[XGI] SEARCH: buffer too small (len={})", len);
-        return 0x80004005;
-    }
-    uint32_t max_results  = GuestReadU32(base, buf + 0x08);
-    uint32_t buf_size     = GuestReadU32(base, buf + 0x18);
-    uint32_t output_ptr   = GuestReadU32(base, buf + 0x1C);
-
-    REXLOG_INFO("[XGI] SEARCH max={} buf_size={} output=0x{:08X}",
-                max_results, buf_size, output_ptr);
-    fprintf(stderr, "[XGI] SEARCH max=%u buf_size=%u output=0x%08X relay=%s\n",
-            max_results, buf_size, output_ptr,
-            xlive::IsConnected() ? "connected" : "NOT CONNECTED");
-    fflush(stderr);
-
-    // Log all buffer dwords for debugging
-    for (int i = 0; i < 9; i++) {
-        REXLOG_INFO("[XGI] SEARCH buf[{}]=0x{:08X}", i*4, GuestReadU32(base, buf + i*4));
-    }
+//
+// XUSER_PROPERTY is 24 bytes: dwPropertyId, then XUSER_DATA (type at +8,
+// value at +16 for the integer types). XUSER_CONTEXT is 8: id, value.
+//
+// Results come from g_sessions (relay list + LAN hosts) with no round-trip,
+// filtered and ranked there (SessionCache::Query) and capped by what the
+// output buffer holds rather than a fixed count.
+// Only the first search after connecting, before any relay list has been
+// cached, waits on the relay: that request runs on the relay worker
+// (relay_client.h), the guest gets IO_PENDING, and the results are written
+// into the output buffer when the overlapped completes. Later searches
+// answer from the cache and, if it has gone stale, queue a refresh for the
+// searches after them.
+struct XgiSearchRequest {
+    uint32_t                     output_ptr;
+    int                          cap;          // max entries to write
+    SessionQuery                 query;
+    uint32_t                     overlapped;   // 0 = synchronous caller
+    NetClock::time_point         deadline;     // give up on the relay
+    std::shared_ptr<RelaySearch> relay;        // null = relay not connected
+};
 
-    if (!output_ptr || max_results == 0) {
-        return 0;
+static constexpr uint32_t XGI_SEARCH_ENTRY_STRIDE = 1326;  // bytes per XSESSION_SEARCHRESULT
+static constexpr auto     XGI_SEARCH_TIMEOUT      = std::chrono::milliseconds(3000);
+static constexpr auto     XGI_SEARCH_POLL         = std::chrono::milliseconds(10);
+static constexpr uint32_t XGI_SEARCH_MAX_TERMS    = 64;    // properties/contexts read
+static constexpr int      XGI_SEARCH_LOG_RESULTS  = 4;     // results logged per search
+
+// Write the search output (count + entries) from the session cache, after
+// folding in the relay's answer if this search had to wait for one.
+// Returns the number of entries written.
+static int WriteXgiSearchResults(uint8_t* base, const XgiSearchRequest& req) {
+    constexpr uint32_t ENTRY_STRIDE = XGI_SEARCH_ENTRY_STRIDE;
+    uint32_t output_ptr = req.output_ptr;
+    int cap = req.cap;
+
+    if (req.relay) {
+        if (!req.relay->done.load(std::memory_order_acquire)) {
+            REXLOG_WARN("[XGI] SEARCH: relay did not answer within {} ms",
+                        (long long)XGI_SEARCH_TIMEOUT.count());
+        } else if (req.relay->ok) {
+            g_sessions.ApplySnapshot(req.relay->sessions.data(),
+                                     (int)req.relay->sessions.size(), PeerClockMs());
+        }
     }
+    std::vector<CachedSession> sessions = g_sessions.Query(req.query, NetTelemetryRttUs);
+    int count = (int)sessions.size();
 
-    xlive::Session sessions[8];
-    int cap = (int)std::min(max_results, 8u);
-    int count = xlive::IsConnected() ? xlive::SearchSessions(sessions, cap) : 0;
-    if (count < 0) count = 0;
-
-    constexpr uint32_t ENTRY_STRIDE = 1326; // bytes per XSESSION_SEARCHRESULT
-
+    std::memset(base + output_ptr + 8, 0, (size_t)count * ENTRY_STRIDE);
     for (int i = 0; i < count; i++) {
         uint32_t entry = output_ptr + 8 + (uint32_t)i * ENTRY_STRIDE;
-        std::memset(base + entry, 0, ENTRY_STRIDE);
 
         // XSESSION_INFO: XNKID(8) + XNADDR(36)
         std::memcpy(base + entry,      sessions[i].xnkid,       8);
@@ -301,16 +689,153 @@ static rex::X_HRESULT HandleXgiSearch(uint8_t* base, uint32_t buf, uint32_t len)
         std::memcpy(&host_addr, sessions[i].host_xnaddr, sizeof(XNADDR_LAN));
         AddOrUpdatePeer(host_addr, sessions[i].xnkid);
 
-        REXLOG_INFO("[XGI] SEARCH result[{}]: xnkid={:02X}{:02X}.. ip={:08X}",
-                    i, sessions[i].xnkid[0], sessions[i].xnkid[1], ntohl(host_addr.ina));
+        if (i < XGI_SEARCH_LOG_RESULTS) {
+            REXLOG_INFO("[XGI] SEARCH result[{}]: xnkid={:02X}{:02X}.. ip={:08X} open={}",
+                        i, sessions[i].xnkid[0], sessions[i].xnkid[1],
+                        ntohl(host_addr.ina), open);
+        }
     }
 
     // Write result count at output_ptr[0] (big-endian)
     GuestWriteU32(base, output_ptr, (uint32_t)count);
+
+    // Replaying: the recorded results stand in for the relay's answer.
+    NetCapPacket rec;
+    if (NetReplayActive() && NetReplayTake(NetCapKind::XgiSearch, 0, &rec) &&
+        rec.data.size() >= 8) {
+        size_t len = std::min<size_t>(rec.data.size(), 8 + (size_t)cap * ENTRY_STRIDE);
+        std::memcpy(base + output_ptr, rec.data.data(), len);
+        count = (int)std::min<uint32_t>(GuestReadU32(base, output_ptr),
+                                        (uint32_t)((len - 8) / ENTRY_STRIDE));
+        GuestWriteU32(base, output_ptr, (uint32_t)count);
+        for (int i = 0; i < count; i++) {
+            uint32_t entry = output_ptr + 8 + (uint32_t)i * ENTRY_STRIDE;
+            XNADDR_LAN host_addr;
+            std::memcpy(&host_addr, base + entry + 8, sizeof(XNADDR_LAN));
+            AddOrUpdatePeer(host_addr, base + entry);
+        }
+    }
+    NetCaptureRecord(NetCapDir::In, NetCapKind::XgiSearch, 0, 0, 0, 0,
+                     base + output_ptr, 8 + (size_t)count * ENTRY_STRIDE);
+
+    if (count > 0) NoteFirst(g_first_search_hit_ms);
     REXLOG_INFO("[XGI] SEARCH found {} sessions", count);
     fprintf(stderr, "[XGI] SEARCH found %d sessions\n", count);
     fflush(stderr);
-    return 0;
+    return count;
+}
+
+// Guest task: the relay has answered or timed out (or there was nothing to
+// wait for); fill the output buffer and complete the overlapped.
+static void FinishXgiSearch(uint8_t* base, const XgiSearchRequest& req) {
+    if (req.output_ptr) WriteXgiSearchResults(base, req);
+    REXLOG_INFO("[XGI] SEARCH: completing overlapped 0x{:08X}", req.overlapped);
+    // Use CompleteOverlappedImmediate — NOT Deferred — because the SEARCH
+    // overlapped was never registered with DispatchMessageAsync, so Deferred
+    // crashes trying to look it up in internal state.  Immediate fires the
+    // guest callback (sub_8218A068) directly on this thread.
+    rex::kernel::kernel_state()->CompleteOverlappedImmediate(req.overlapped, 0);
+}
+
+// Returns X_ERROR_IO_PENDING once the search is queued (overlapped
+// callers), otherwise completes synchronously.
+static rex::X_HRESULT HandleXgiSearch(uint8_t* base, uint32_t buf, uint32_t len,
+                                      uint32_t overlapped) {
+    if (!buf || len < 0x20) {
+        REXLOG_WARN("[XGI] SEARCH: buffer too small (len={})", len);
+        if (!overlapped) return 0x80004005;
+        NetPostToGuest(NetClock::now() + std::chrono::milliseconds(150), [overlapped]() {
+            rex::kernel::kernel_state()->CompleteOverlappedImmediate(overlapped, 0x80004005);
+        });
+        return 0x00000103; // X_ERROR_IO_PENDING
+    }
+    uint32_t max_results  = GuestReadU32(base, buf + 0x08);
+    uint32_t buf_size     = GuestReadU32(base, buf + 0x18);
+    uint32_t output_ptr   = GuestReadU32(base, buf + 0x1C);
+
+    REXLOG_INFO("[XGI] SEARCH max={} buf_size={} output=0x{:08X}",
+                max_results, buf_size, output_ptr);
+    fprintf(stderr, "[XGI] SEARCH max=%u buf_size=%u output=0x%08X relay=%s\n",
+            max_results, buf_size, output_ptr,
+            RelayIsConnected() ? "connected" : "NOT CONNECTED");
+    fflush(stderr);
+
+    auto req = std::make_shared<XgiSearchRequest>();
+    SessionQuery& q = req->query;
+    uint32_t filter_id = GuestReadU32(base, buf + 0x04);
+    uint32_t num_props = std::min<uint32_t>(GuestReadU16(base, buf + 0x0C), XGI_SEARCH_MAX_TERMS);
+    uint32_t num_ctxs  = std::min<uint32_t>(GuestReadU16(base, buf + 0x0E), XGI_SEARCH_MAX_TERMS);
+    uint32_t props_ptr = GuestReadU32(base, buf + 0x10);
+    uint32_t ctxs_ptr  = GuestReadU32(base, buf + 0x14);
+    for (uint32_t i = 0; props_ptr && i < num_props; i++) {
+        uint32_t p = props_ptr + i * 24;
+        SessionTerms::Property prop{GuestReadU32(base, p), base[p + 8], 0};
+        if (prop.type == 1) {         // XUSER_DATA_TYPE_INT32
+            prop.value = (int32_t)GuestReadU32(base, p + 16);
+        } else if (prop.type == 2) {  // XUSER_DATA_TYPE_INT64
+            prop.value = (int64_t)(((uint64_t)GuestReadU32(base, p + 16) << 32) |
+                                   GuestReadU32(base, p + 20));
+        }
+        q.terms.properties.push_back(prop);
+    }
+    for (uint32_t i = 0; ctxs_ptr && i < num_ctxs; i++) {
+        q.terms.contexts.emplace_back(GuestReadU32(base, ctxs_ptr + i * 8),
+                                GuestReadU32(base, ctxs_ptr + i * 8 + 4));
+    }
+    REXLOG_INFO("[XGI] SEARCH filter=0x{:08X} properties={} contexts={}",
+                filter_id, q.terms.properties.size(), q.terms.contexts.size());
+    for (auto& [id, value] : q.terms.contexts) {
+        REXLOG_INFO("[XGI] SEARCH   context 0x{:08X}={}", id, value);
+    }
+    for (auto& prop : q.terms.properties) {
+        REXLOG_INFO("[XGI] SEARCH   property 0x{:08X} type={} value={}",
+                    prop.id, prop.type, (long long)prop.value);
+    }
+
+    // As many entries as both the game and its output buffer allow.
+    uint32_t fits = buf_size > 8 ? (buf_size - 8) / XGI_SEARCH_ENTRY_STRIDE : 0;
+    req->output_ptr = output_ptr;
+    req->cap        = (int)std::min<uint32_t>({max_results, fits, (uint32_t)SESSION_CACHE_MAX});
+    q.max           = (size_t)req->cap;
+    req->overlapped = overlapped;
+    req->deadline   = NetClock::now() + XGI_SEARCH_TIMEOUT;
+    bool want_results = output_ptr && req->cap != 0;
+    // LAN hosts answer at once with a fresh beacon (slots, QoS data, and an
+    // RTT sample through the echoed timestamp) and beacon fast for a while.
+    if (want_results && g_disc_socket != (SOCKET)INVALID_SOCKET) {
+        static const uint8_t any_kid[8] = {};
+        SendProbe(g_disc_socket, any_kid);
+    }
+    if (want_results && RelayIsConnected() && !g_sessions.RelaySynced()) {
+        req->relay = RelaySearchAsync(SESSION_CACHE_MAX);
+    } else if (want_results && RelayIsConnected() &&
+               g_sessions.RelayStale(PeerClockMs(), SESSION_RELAY_STALE_MS)) {
+        RelayRefreshSessions(SESSION_CACHE_MAX, [](const std::vector<xlive::Session>& list) {
+            auto st = g_sessions.ApplySnapshot(list.data(), (int)list.size(), PeerClockMs());
+            if (st.added || st.removed) {
+                REXLOG_INFO("[NET] Relay sessions: +{} -{} ~{}", st.added, st.removed, st.changed);
+            }
+        });
+    }
+
+    if (!overlapped) {
+        // Synchronous caller: nothing to hand back to, so wait here.
+        while (req->relay && !req->relay->done.load(std::memory_order_acquire) &&
+               NetClock::now() < req->deadline) {
+            std::this_thread::sleep_for(XGI_SEARCH_POLL);
+        }
+        if (want_results) WriteXgiSearchResults(base, *req);
+        return 0;
+    }
+
+    if (!want_results) req->output_ptr = 0;
+    // Never complete sooner than 150 ms: the game's main thread stores the
+    // callback object at overlapped+8 only after XMsgStartIORequest
+    // returns, and sub_8218A068 dereferences it as a vtable on completion.
+    RelayFinishSearchOnGuest(req->relay, NetClock::now() + std::chrono::milliseconds(150),
+                             req->deadline, [base, req]() { FinishXgiSearch(base, *req); });
+    REXLOG_INFO("[XGI] SEARCH: overlapped 0x{:08X} pending", overlapped);
+    return 0x00000103; // X_ERROR_IO_PENDING
 }
 
 // ---- XGISessionDelete (0x000B0011) ----
@@ -343,37 +868,11 @@ extern "C" PPC_FUNC(__imp__XMsgStartIORequest) {
     uint32_t buffer_ptr     = ctx.r6.u32;
     uint32_t buffer_length  = ctx.r7.u32;
 
-    // Drain any deferred SEARCH completions that are ready.
-    // MUST be done on a guest thread (this function) where kernel_state() is
-    // valid.  The discovery thread is a raw std::thread where kernel_state()
-    // returns null, so we cannot call CompleteOverlappedDeferred from there.
-    {
-        std::vector<PendingOverlappedCompletion> to_fire;
-        {
-            auto now = std::chrono::steady_clock::now();
-            std::lock_guard<std::mutex> lk(g_pending_ov_mutex);
-            for (auto it = g_pending_ov.begin(); it != g_pending_ov.end(); ) {
-                if (now >= it->fire_at) {
-                    to_fire.push_back(*it);
-                    it = g_pending_ov.erase(it);
-                } else {
-                    ++it;
-                }
-            }
-        }
-        for (auto& pending : to_fire) {
-            REXLOG_INFO("[XGI] SEARCH: completing overlapped 0x{:08X} result=0x{:08X} (immediate, 150ms delayed)",
-                        pending.overlapped_ptr, pending.result);
-            // Use CompleteOverlappedImmediate — NOT Deferred — because the SEARCH
-            // overlapped was never registered with DispatchMessageAsync, so Deferred
-            // crashes trying to look it up in internal state.  Immediate fires the
-            // guest callback (sub_8218A068) directly on this thread.  The 150ms delay
-            // above ensures overlapped+8 (context/callback object) is initialised
-            // before we arrive here, so sub_8218A068 can safely dereference it.
-            rex::kernel::kernel_state()->CompleteOverlappedImmediate(
-                pending.overlapped_ptr, pending.result);
-        }
-    }
+    // Run any deferred SEARCH completions that are due. They must run on a
+    // guest thread where kernel_state() is valid — the timer thread is a raw
+    // std::thread where kernel_state() returns null. The present hook drains
+    // too, so a search completes even if the game stops sending messages.
+    NetDrainGuest();
 
     REXLOG_INFO("[XMsg] app={} msg=0x{:08X} buf=0x{:08X} len={}",
                 app_id, message, buffer_ptr, buffer_length);
@@ -386,33 +885,17 @@ extern "C" PPC_FUNC(__imp__XMsgStartIORequest) {
             result = HandleXgiCreate(base, buffer_ptr, buffer_length);
             break;
         case 0x000B001C:
-            result = HandleXgiSearch(base, buffer_ptr, buffer_length);
-            // Delay the overlapped completion by 150 ms so the game's main
-            // thread has time to store the callback object at overlapped+8
-            // before sub_8218A068 tries to invoke it.  Without the delay the
-            // kernel dispatch fires the completion almost immediately and the
-            // callback pointer (overlapped+8) is still 0x44 (uninitialised),
-            // causing a crash when sub_8218A068 dereferences it as a vtable.
-            if (overlapped_ptr) {
-                {
-                    std::lock_guard<std::mutex> lk(g_pending_ov_mutex);
-                    g_pending_ov.push_back({
-                        overlapped_ptr,
-                        (uint32_t)result,
-                        std::chrono::steady_clock::now() +
-                            std::chrono::milliseconds(150)
-                    });
-                }
-                REXLOG_INFO("[XGI] SEARCH: deferred overlapped 0x{:08X} by 150ms",
-                            overlapped_ptr);
-                ctx.r3.u64 = 0x00000103; // X_ERROR_IO_PENDING
-            } else {
-                ctx.r3.u64 = (uint64_t)(uint32_t)result;
-            }
+            // Completes its own overlapped once the relay answers
+            ctx.r3.u64 = (uint64_t)(uint32_t)HandleXgiSearch(
+                base, buffer_ptr, buffer_length, overlapped_ptr);
             return; // Skip the common CompleteOverlappedDeferred below
         case 0x000B0011:
             result = HandleXgiDelete(base, buffer_ptr, buffer_length);
             break;
+        case 0x000B0007:
+        case 0x000B0008:
+            NoteUserTerm(base, message, buffer_ptr, buffer_length);
+            [[fallthrough]];
         default:
             // Forward to existing SDK XgiApp handler
             result = rex::kernel::kernel_state()->app_manager()->DispatchMessageAsync(
@@ -541,68 +1024,167 @@ static void BuildLocalXnAddr(uint32_t ip_net) {
 // Peer table helpers
 // ============================================================================
 
-static PeerEntry* FindPeerByIP(uint32_t ip_net) {
-    for (auto& p : g_peers) {
-        if (p.xnaddr.ina == ip_net) return &p;
-    }
-    return nullptr;
+static int64_t PeerClockMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
 static void AddOrUpdatePeer(const XNADDR_LAN& addr, const uint8_t* xnkid) {
-    std::unique_lock lock(g_peers_mutex);
-    auto* existing = FindPeerByIP(addr.ina);
-    if (existing) {
-        existing->xnaddr = addr;
-        if (xnkid) std::memcpy(existing->xnkid, xnkid, 8);
-    } else {
-        PeerEntry entry = {};
-        entry.xnaddr = addr;
-        if (xnkid) std::memcpy(entry.xnkid, xnkid, 8);
-        entry.connected = false;
-        g_peers.push_back(entry);
+    if (!g_peers.Upsert(addr, xnkid, PeerClockMs())) {
+        REXLOG_WARN("[NET] Peer table full, dropping beacon");
+        return;
     }
+    NotePeerDiscovered(addr.ina);
 }
 
 // ============================================================================
 // Discovery protocol
 // ============================================================================
 
-static void SendBeacon(SOCKET sock, const struct sockaddr_in& dest) {
+static inline void PutBE16(uint8_t* p, uint16_t v) { p[0] = (uint8_t)(v >> 8); p[1] = (uint8_t)v; }
+static inline void PutBE32(uint8_t* p, uint32_t v) { PutBE16(p, (uint16_t)(v >> 16)); PutBE16(p + 2, (uint16_t)v); }
+static inline void PutBE64(uint8_t* p, uint64_t v) { PutBE32(p, (uint32_t)(v >> 32)); PutBE32(p + 4, (uint32_t)v); }
+static inline uint16_t GetBE16(const uint8_t* p) { return (uint16_t)((p[0] << 8) | p[1]); }
+static inline uint32_t GetBE32(const uint8_t* p) { return ((uint32_t)GetBE16(p) << 16) | GetBE16(p + 2); }
+static inline uint64_t GetBE64(const uint8_t* p) { return ((uint64_t)GetBE32(p) << 32) | GetBE32(p + 4); }
+
+// Send our beacon (v2, layout in net.h) if we are hosting. `interval_ms`
+// is the time since the previous periodic beacon; `echo_ns` the timestamp
+// of the probe being answered, or 0.
+static void SendBeacon(SOCKET sock, const struct sockaddr_in& dest,
+                       uint16_t interval_ms, uint64_t echo_ns) {
+    // Slot counts: the host plus every peer the game connected to fill
+    // public slots first.
+    uint8_t pub, priv;
+    SessionTerms terms;
+    {
+        std::lock_guard lk(g_session_mutex);
+        pub  = g_session_public_slots;
+        priv = g_session_private_slots;
+        terms = g_session_terms;
+    }
+    size_t filled = 1 + g_peers.ConnectedCount();
+    uint8_t filled_pub  = (uint8_t)std::min<size_t>(filled, pub);
+    uint8_t filled_priv = (uint8_t)std::min<size_t>(filled - filled_pub, priv);
+
     std::lock_guard lock(g_qos_mutex);
     if (!g_qos_listener.active) return;
 
-    uint8_t buf[DISC_HEADER_LEN + 2 + DISC_MAX_QOS];
+    uint8_t buf[DISC_HEADER_LEN + 2 + DISC_MAX_QOS + DISC_BEACON_TRAILER_LEN +
+                DISC_BEACON_TERMS_MAX_LEN];
     buf[0] = DISC_MAGIC;
     buf[1] = DISC_BEACON;
     std::memcpy(buf + 2, g_qos_listener.xnkid, 8);
     std::memcpy(buf + 10, &g_local_xnaddr, 36);
-    // data_len in big-endian
     uint16_t dlen = g_qos_listener.data_len;
-    buf[46] = (uint8_t)(dlen >> 8);
-    buf[47] = (uint8_t)(dlen & 0xFF);
+    PutBE16(buf + 46, dlen);
     if (dlen > 0) {
         std::memcpy(buf + 48, g_qos_listener.data, dlen);
     }
 
-    int total = 48 + (int)dlen;
-    sendto(sock, (const char*)buf, total, 0,
-           (const struct sockaddr*)&dest, sizeof(dest));
+    uint8_t* t = buf + 48 + dlen;
+    std::memset(t, 0, DISC_BEACON_TRAILER_LEN);
+    t[0] = DISC_BEACON_V3;
+    t[1] = (uint8_t)(pub - filled_pub);
+    t[2] = (uint8_t)(priv - filled_priv);
+    t[3] = filled_pub;
+    t[4] = filled_priv;
+    PutBE16(t + 6, interval_ms);
+    PutBE64(t + 8, (uint64_t)SteadyNowNs());
+    PutBE64(t + 16, echo_ns);
+
+    // NoteUserTerm keeps at most DISC_BEACON_MAX_TERMS of each
+    uint8_t* p = t + DISC_BEACON_TRAILER_LEN;
+    *p++ = (uint8_t)terms.contexts.size();
+    *p++ = (uint8_t)terms.properties.size();
+    for (auto& [id, value] : terms.contexts) {
+        PutBE32(p, id);
+        PutBE32(p + 4, value);
+        p += 8;
+    }
+    for (auto& prop : terms.properties) {
+        PutBE32(p, prop.id);
+        p[4] = prop.type;
+        PutBE64(p + 5, (uint64_t)prop.value);
+        p += 13;
+    }
+
+    NetSendTo(sock, buf, (int)(p - buf), dest);
 }
 
+// Ask every host on the LAN (and the configured discovery peers) for a
+// beacon now. Hosts answer directly, echoing our timestamp, and beacon
+// fast for a while since someone is searching.
 static void SendProbe(SOCKET sock, const uint8_t* target_kid) {
-    uint8_t buf[DISC_HEADER_LEN];
+    uint8_t buf[DISC_PROBE_V2_LEN] = {};
     buf[0] = DISC_MAGIC;
     buf[1] = DISC_PROBE;
     std::memcpy(buf + 2, target_kid, 8);
     std::memcpy(buf + 10, &g_local_xnaddr, 36);
+    buf[46] = DISC_BEACON_V2;
+    PutBE64(buf + 48, (uint64_t)SteadyNowNs());
 
     struct sockaddr_in bcast = {};
     bcast.sin_family = AF_INET;
     bcast.sin_port = htons((uint16_t)g_lan_port);
     bcast.sin_addr.s_addr = INADDR_BROADCAST;
 
-    sendto(sock, (const char*)buf, DISC_HEADER_LEN, 0,
-           (const struct sockaddr*)&bcast, sizeof(bcast));
+    NetSendTo(sock, buf, DISC_PROBE_V2_LEN, bcast);
+    for (auto& peer : g_disc_peers) {
+        NetSendTo(sock, buf, DISC_PROBE_V2_LEN, peer);
+    }
+}
+
+// A received beacon. v1 senders leave `version` 0 and the v2 fields zero.
+struct BeaconInfo {
+    const uint8_t* xnkid;
+    const uint8_t* data;
+    uint16_t       data_len;
+    uint8_t        version;
+    uint8_t        open_public, open_private, filled_public, filled_private;
+    uint16_t       interval_ms;
+    uint64_t       sent_ns;
+    uint64_t       echo_ns;
+    bool           has_terms;   // v3
+    SessionTerms   terms;
+};
+
+static bool ParseBeacon(const uint8_t* buf, int n, BeaconInfo* b) {
+    if (n < DISC_HEADER_LEN + 2) return false;
+    *b = {};
+    b->xnkid = buf + 2;
+    b->data = buf + 48;
+    b->data_len = std::min<uint16_t>(GetBE16(buf + 46), (uint16_t)DISC_MAX_QOS);
+    if (n < 48 + (int)b->data_len) {
+        b->data_len = 0;
+        return true;
+    }
+    const uint8_t* t = buf + 48 + b->data_len;
+    if (n - (48 + (int)b->data_len) < DISC_BEACON_TRAILER_LEN || t[0] < DISC_BEACON_V2) return true;
+    b->version        = t[0];
+    b->open_public    = t[1];
+    b->open_private   = t[2];
+    b->filled_public  = t[3];
+    b->filled_private = t[4];
+    b->interval_ms    = GetBE16(t + 6);
+    b->sent_ns        = GetBE64(t + 8);
+    b->echo_ns        = GetBE64(t + 16);
+
+    const uint8_t* p = t + DISC_BEACON_TRAILER_LEN;
+    const uint8_t* end = buf + n;
+    if (b->version < DISC_BEACON_V3 || end - p < 2) return true;
+    int num_ctxs = std::min<int>(p[0], DISC_BEACON_MAX_TERMS);
+    int num_props = std::min<int>(p[1], DISC_BEACON_MAX_TERMS);
+    p += 2;
+    if (end - p < num_ctxs * 8 + num_props * 13) return true;
+    for (int i = 0; i < num_ctxs; i++, p += 8) {
+        b->terms.contexts.emplace_back(GetBE32(p), GetBE32(p + 4));
+    }
+    for (int i = 0; i < num_props; i++, p += 13) {
+        b->terms.properties.push_back({GetBE32(p), p[4], (int64_t)GetBE64(p + 5)});
+    }
+    b->has_terms = true;
+    return true;
 }
 
 // Beacon response data returned by CollectBeaconResponses
@@ -642,135 +1224,1088 @@ static std::vector<BeaconResponse> CollectBeaconResponses(
         if (n < DISC_HEADER_LEN + 2) continue;
         if (buf[0] != DISC_MAGIC || buf[1] != DISC_BEACON) continue;
 
-        // Skip our own beacons
-        XNADDR_LAN* addr = (XNADDR_LAN*)(buf + 10);
-        if (addr->ina == g_local_ip_net) continue;
+        // Skip our own beacons
+        XNADDR_LAN* addr = (XNADDR_LAN*)(buf + 10);
+        if (addr->ina == g_local_ip_net) continue;
+
+        BeaconResponse resp = {};
+        std::memcpy(resp.xnkid, buf + 2, 8);
+        std::memcpy(&resp.host_addr, buf + 10, 36);
+        resp.qos_data_len = ((uint16_t)buf[46] << 8) | buf[47];
+        if (resp.qos_data_len > DISC_MAX_QOS)
+            resp.qos_data_len = DISC_MAX_QOS;
+        if (resp.qos_data_len > 0 && n >= 48 + (int)resp.qos_data_len) {
+            std::memcpy(resp.qos_data, buf + 48, resp.qos_data_len);
+        }
+
+        // Add peer
+        AddOrUpdatePeer(resp.host_addr, resp.xnkid);
+        responses.push_back(resp);
+    }
+    return responses;
+}
+
+// ============================================================================
+// QoS probing
+// ============================================================================
+//
+// XNetQosLookup sends `cProbes` packet pairs to each target's discovery
+// port. A host with an active QoS listener answers:
+//   - the first packet of a pair with a small reply (RTT sample, plus the
+//     listener's data blob);
+//   - the second with a back-to-back pair of padded replies, carrying the
+//     gap it measured between the two probe packets.
+// The probe pair spacing at the host gives upstream bandwidth, the reply
+// pair spacing here gives downstream. Arrival times are taken after
+// recvfrom, so the bandwidth figures are approximate. Results are written
+// into the XNQOS and cached per peer IP. A target that beaconed recently
+// and whose RTT is already known is answered from its beacon instead,
+// without sending anything.
+
+static constexpr int      QOS_DEFAULT_PROBES  = 4;
+static constexpr int      QOS_MAX_PROBES      = 8;
+static constexpr int      QOS_MAX_TARGETS     = 64;
+static constexpr auto     QOS_PAIR_INTERVAL   = std::chrono::milliseconds(10);
+// Never complete sooner than this: the game initialises the completion
+// callback object (session_struct+8) after XNetQosLookup returns.
+static constexpr auto     QOS_COMPLETE_MIN    = std::chrono::milliseconds(300);
+// XNetQosLookup has no timeout argument; complete by this long after the
+// call with whatever replies arrived.
+static constexpr auto     QOS_PROBE_BUDGET    = std::chrono::milliseconds(750);
+static_assert(QOS_PROBE_BUDGET >= QOS_COMPLETE_MIN);
+static constexpr auto     QOS_RECHECK         = std::chrono::milliseconds(50);
+static constexpr auto     QOS_CACHE_TTL       = std::chrono::seconds(10);
+static constexpr uint32_t QOS_MAX_BPS         = 1000000000;  // 1 Gbps
+
+struct QosResult {
+    bool     contacted;
+    uint16_t probes_xmit;
+    uint16_t probes_recv;
+    uint16_t rtt_min_ms;
+    uint16_t rtt_med_ms;
+    uint32_t up_bps;
+    uint32_t dn_bps;
+    uint16_t data_len;
+    uint8_t  data[DISC_MAX_QOS];
+};
+
+struct QosTarget {
+    uint32_t              ip_net;
+    uint8_t               xnkid[8];
+    bool                  cached;        // answered from g_qos_cache, not probed
+    QosResult             cached_result;
+    std::vector<uint32_t> rtt_us;
+    std::vector<uint32_t> up_gap_us;
+    std::vector<uint32_t> dn_gap_us;
+    int64_t               dn_first_ns[QOS_MAX_PROBES];  // reply-pair first arrival
+    int                   pairs_sent;
+    int                   pairs_answered;  // PAIR_SECOND replies seen
+    bool                  from_beacon;     // cached_result built from a beacon
+    uint16_t              data_len;
+    bool                  data_received;
+    uint8_t               data[DISC_MAX_QOS];
+};
+
+struct QosLookup {
+    uint32_t               qos_addr;    // guest XNQOS
+    uint32_t               data_addr;   // guest blob area, DISC_MAX_QOS per target
+    int                    probes;
+    NetClock::time_point   deadline;    // complete by now even if replies are missing
+    std::vector<QosTarget> targets;
+};
+
+struct QosCacheEntry {
+    QosResult            result;
+    NetClock::time_point measured_at;
+};
+
+static std::unordered_map<uint16_t, QosLookup>     g_qos_lookups;  // by lookup id
+static std::unordered_map<uint32_t, QosCacheEntry> g_qos_cache;    // by peer IP
+static std::mutex                                  g_qos_lookup_mutex;
+static uint16_t                                    g_qos_next_id = 1;
+
+// The latest beacon from each host, so a lookup can answer from it with no
+// packets of its own. Guarded by g_qos_lookup_mutex.
+struct BeaconQos {
+    uint64_t             sent_ns;     // sender's clock (v2); orders beacons
+    uint16_t             data_len;
+    uint8_t              data[DISC_MAX_QOS];
+    NetClock::time_point heard_at;
+};
+static std::unordered_map<uint32_t, BeaconQos> g_beacon_qos;   // by host IP
+static constexpr auto QOS_BEACON_TTL = std::chrono::seconds(3);
+
+static void NoteBeaconQos(uint32_t ip, const BeaconInfo& b) {
+    std::lock_guard lock(g_qos_lookup_mutex);
+    BeaconQos& q = g_beacon_qos[ip];
+    // A probe reply and a broadcast can cross; keep the newer
+    if (b.sent_ns && q.sent_ns > b.sent_ns) return;
+    q.sent_ns = b.sent_ns;
+    q.data_len = b.data_len;
+    std::memcpy(q.data, b.data, b.data_len);
+    q.heard_at = NetClock::now();
+}
+
+// Answer a lookup target from `ip`'s latest beacon. Needs a fresh beacon
+// and an RTT already measured to the host (the echo in a beacon answering
+// our search probe, an earlier lookup, or a direct path). Bandwidth isn't
+// measured this way and is reported as 0 (unknown). Caller holds
+// g_qos_lookup_mutex.
+static bool BeaconQosResult(uint32_t ip, NetClock::time_point now, QosResult* r) {
+    auto it = g_beacon_qos.find(ip);
+    if (it == g_beacon_qos.end() || now - it->second.heard_at >= QOS_BEACON_TTL) return false;
+    uint32_t rtt_us = NetTelemetryRttUs(ip);
+    if (!rtt_us) return false;
+    *r = {};
+    r->contacted = true;
+    r->probes_xmit = r->probes_recv = 1;   // the probe/beacon exchange
+    r->rtt_min_ms = r->rtt_med_ms = (uint16_t)std::min<uint32_t>((rtt_us + 999) / 1000, 0xFFFF);
+    r->data_len = it->second.data_len;
+    std::memcpy(r->data, it->second.data, r->data_len);
+    return true;
+}
+
+// Drop cached results and beacon blobs too old to answer a lookup.
+// Discovery thread, with the peer expiry scan.
+static void PruneQosState(NetClock::time_point now) {
+    std::lock_guard lock(g_qos_lookup_mutex);
+    std::erase_if(g_qos_cache, [&](const auto& e) { return now - e.second.measured_at >= QOS_CACHE_TTL; });
+    std::erase_if(g_beacon_qos, [&](const auto& e) { return now - e.second.heard_at >= QOS_BEACON_TTL; });
+}
+
+// token = lookup id (16) | target index (8) | pair index (8)
+static inline uint32_t QosToken(uint16_t id, int target, int pair) {
+    return ((uint32_t)id << 16) | ((uint32_t)target << 8) | (uint32_t)pair;
+}
+
+static void SendQosPacket(const struct sockaddr_in& dest, uint8_t type, const uint8_t* xnkid,
+                          uint32_t token, uint8_t flags, uint64_t timestamp, uint32_t gap_us,
+                          const uint8_t* data, uint16_t data_len, int pad_to) {
+    // Big enough for a padded pair packet or a reply carrying a full blob
+    static_assert(DISC_QOS_PAIR_LEN >= DISC_QOS_LEN, "pair packets must hold the QoS header");
+    uint8_t buf[std::max(DISC_QOS_PAIR_LEN, DISC_QOS_LEN + DISC_MAX_QOS)];
+    data_len = std::min<uint16_t>(data_len, (uint16_t)DISC_MAX_QOS);
+    int total = std::min(std::max(DISC_QOS_LEN + (int)data_len, pad_to), (int)sizeof(buf));
+    std::memset(buf, 0, total);
+    buf[0] = DISC_MAGIC;
+    buf[1] = type;
+    std::memcpy(buf + 2, xnkid, 8);
+    std::memcpy(buf + 10, &g_local_xnaddr, 36);
+    PutBE32(buf + 46, token);
+    buf[50] = flags;
+    PutBE64(buf + 52, timestamp);
+    PutBE32(buf + 60, gap_us);
+    PutBE16(buf + 64, data_len);
+    if (data_len > 0) std::memcpy(buf + DISC_QOS_LEN, data, data_len);
+    NetSendTo(g_disc_socket, buf, total, dest);
+}
+
+// ---- Responder side (discovery thread) ----
+
+static void HandleQosProbe(const uint8_t* buf, int n, const struct sockaddr_in& from,
+                           int64_t arrival_ns) {
+    if (n < DISC_QOS_LEN) return;
+    // Arrival of recent PAIR_FIRSTs, to time the pair gap. A fixed table
+    // by token: a first whose second never came is simply overwritten.
+    struct PairFirst {
+        uint32_t ip_net;
+        uint32_t token;
+        int64_t  arrival_ns;
+    };
+    static constexpr uint32_t PAIR_SLOTS = 64;
+    static PairFirst s_pair_first[PAIR_SLOTS];
+
+    uint8_t  xnkid[8];
+    uint8_t  data[DISC_MAX_QOS];
+    uint16_t data_len = 0;
+    {
+        std::lock_guard lock(g_qos_mutex);
+        if (!g_qos_listener.active) return;
+        std::memcpy(xnkid, g_qos_listener.xnkid, 8);
+        // The data blob only goes to probes aimed at our session
+        if (std::memcmp(buf + 2, g_qos_listener.xnkid, 8) == 0) {
+            data_len = g_qos_listener.data_len;
+            std::memcpy(data, g_qos_listener.data, data_len);
+        }
+    }
+
+    uint32_t token = GetBE32(buf + 46);
+    uint8_t  flags = buf[50];
+    uint64_t ts    = GetBE64(buf + 52);
+
+    struct sockaddr_in reply = {};
+    reply.sin_family = AF_INET;
+    reply.sin_port = htons((uint16_t)g_lan_port);
+    reply.sin_addr.s_addr = from.sin_addr.s_addr;
+
+    PairFirst& slot = s_pair_first[(token ^ (token >> 8) ^ (token >> 16)) % PAIR_SLOTS];
+    if (flags & DISC_QOS_PAIR_FIRST) {
+        slot = {from.sin_addr.s_addr, token, arrival_ns};
+        SendQosPacket(reply, DISC_QOS_REPLY, xnkid, token, DISC_QOS_PAIR_FIRST, ts, 0,
+                      data, data_len, 0);
+    } else if (flags & DISC_QOS_PAIR_SECOND) {
+        uint32_t gap_us = 0;
+        if (slot.arrival_ns && slot.ip_net == from.sin_addr.s_addr && slot.token == token) {
+            gap_us = (uint32_t)std::max<int64_t>(1, (arrival_ns - slot.arrival_ns) / 1000);
+            slot = {};
+        }
+        // Back-to-back padded pair so the prober can time the downstream
+        SendQosPacket(reply, DISC_QOS_REPLY, xnkid, token, DISC_QOS_PAIR_FIRST | DISC_QOS_PAIR_SECOND,
+                      ts, gap_us, nullptr, 0, DISC_QOS_PAIR_LEN);
+        SendQosPacket(reply, DISC_QOS_REPLY, xnkid, token, DISC_QOS_PAIR_SECOND,
+                      ts, gap_us, nullptr, 0, DISC_QOS_PAIR_LEN);
+    }
+}
+
+// ---- Prober side ----
+
+static void HandleQosReply(const uint8_t* buf, int n, const struct sockaddr_in& from,
+                           int64_t arrival_ns) {
+    if (n < DISC_QOS_LEN) return;
+    uint32_t token = GetBE32(buf + 46);
+    uint8_t  flags = buf[50];
+    uint64_t ts    = GetBE64(buf + 52);
+    uint32_t gap   = GetBE32(buf + 60);
+
+    std::lock_guard lock(g_qos_lookup_mutex);
+    auto it = g_qos_lookups.find((uint16_t)(token >> 16));
+    if (it == g_qos_lookups.end()) return;  // completed or released
+    QosLookup& lk = it->second;
+    int t = (token >> 8) & 0xFF, pair = token & 0xFF;
+    if (t >= (int)lk.targets.size() || pair >= lk.probes) return;
+    QosTarget& target = lk.targets[t];
+    if (target.ip_net != from.sin_addr.s_addr) return;
+
+    uint32_t rtt_us = (uint32_t)std::max<int64_t>(0, (arrival_ns - (int64_t)ts) / 1000);
+    if (flags & DISC_QOS_PAIR_FIRST) NetTelemetryRtt(target.ip_net, rtt_us);
+    if (flags == DISC_QOS_PAIR_FIRST) {
+        // Small reply to the first probe: RTT + data blob
+        target.rtt_us.push_back(rtt_us);
+        uint16_t dlen = std::min<uint16_t>(GetBE16(buf + 64), (uint16_t)DISC_MAX_QOS);
+        if (dlen > 0 && n >= DISC_QOS_LEN + dlen) {
+            std::memcpy(target.data, buf + DISC_QOS_LEN, dlen);
+            target.data_len = dlen;
+            target.data_received = true;
+        }
+    } else if (flags == (DISC_QOS_PAIR_FIRST | DISC_QOS_PAIR_SECOND)) {
+        // First of the reply pair
+        target.rtt_us.push_back(rtt_us);
+        target.dn_first_ns[pair] = arrival_ns;
+        if (gap) target.up_gap_us.push_back(gap);
+        target.pairs_answered++;
+    } else if (flags == DISC_QOS_PAIR_SECOND) {
+        if (target.dn_first_ns[pair]) {
+            int64_t dn_gap = std::max<int64_t>(1, (arrival_ns - target.dn_first_ns[pair]) / 1000);
+            target.dn_gap_us.push_back((uint32_t)dn_gap);
+            target.dn_first_ns[pair] = 0;
+        }
+    }
+}
+
+static void SendQosPairs(uint16_t id, int pair) {
+    struct Dest { struct sockaddr_in addr; uint8_t xnkid[8]; int target; };
+    std::vector<Dest> dests;
+    {
+        std::lock_guard lock(g_qos_lookup_mutex);
+        auto it = g_qos_lookups.find(id);
+        if (it == g_qos_lookups.end()) return;
+        for (int t = 0; t < (int)it->second.targets.size(); t++) {
+            QosTarget& target = it->second.targets[t];
+            if (target.cached) continue;
+            Dest d = {};
+            d.addr.sin_family = AF_INET;
+            d.addr.sin_port = htons((uint16_t)g_lan_port);
+            d.addr.sin_addr.s_addr = target.ip_net;
+            std::memcpy(d.xnkid, target.xnkid, 8);
+            d.target = t;
+            dests.push_back(d);
+            target.pairs_sent++;
+        }
+    }
+    for (auto& d : dests) {
+        // Each pair is answered with two RTT-carrying replies
+        NetTelemetryProbesSent(d.addr.sin_addr.s_addr, 2);
+        uint32_t token = QosToken(id, d.target, pair);
+        SendQosPacket(d.addr, DISC_QOS_PROBE, d.xnkid, token, DISC_QOS_PAIR_FIRST,
+                      (uint64_t)SteadyNowNs(), 0, nullptr, 0, DISC_QOS_PAIR_LEN);
+        SendQosPacket(d.addr, DISC_QOS_PROBE, d.xnkid, token, DISC_QOS_PAIR_SECOND,
+                      (uint64_t)SteadyNowNs(), 0, nullptr, 0, DISC_QOS_PAIR_LEN);
+    }
+}
+
+static uint32_t Median(std::vector<uint32_t> v) {
+    if (v.empty()) return 0;
+    std::nth_element(v.begin(), v.begin() + v.size() / 2, v.end());
+    return v[v.size() / 2];
+}
+
+static uint32_t PairGapToBps(uint32_t gap_us) {
+    if (gap_us == 0) return 0;
+    uint64_t bps = (uint64_t)DISC_QOS_PAIR_LEN * 8 * 1000000 / gap_us;
+    return (uint32_t)std::min<uint64_t>(bps, QOS_MAX_BPS);
+}
+
+static QosResult SummarizeTarget(const QosTarget& t) {
+    QosResult r = {};
+    r.probes_xmit = (uint16_t)(t.pairs_sent * 2);
+    r.probes_recv = (uint16_t)std::min<size_t>(t.rtt_us.size(), r.probes_xmit);
+    r.contacted = !t.rtt_us.empty();
+    if (r.contacted) {
+        uint32_t min_us = *std::min_element(t.rtt_us.begin(), t.rtt_us.end());
+        uint32_t med_us = Median(t.rtt_us);
+        // Round up: a sub-millisecond LAN RTT still reports 1 ms
+        r.rtt_min_ms = (uint16_t)std::min<uint32_t>((min_us + 999) / 1000, 0xFFFF);
+        r.rtt_med_ms = (uint16_t)std::min<uint32_t>((med_us + 999) / 1000, 0xFFFF);
+        r.up_bps = PairGapToBps(Median(t.up_gap_us));
+        r.dn_bps = PairGapToBps(Median(t.dn_gap_us));
+    }
+    if (t.data_received) {
+        r.data_len = t.data_len;
+        std::memcpy(r.data, t.data, t.data_len);
+    }
+    return r;
+}
+
+// Write one XNQOSINFO entry (layout documented at XNetQosLookup).
+static void WriteQosEntry(uint8_t* base, uint32_t e, uint32_t data_addr, const QosResult& r) {
+    uint8_t flags = XNET_XNQOSINFO_COMPLETE;
+    if (r.contacted) flags |= XNET_XNQOSINFO_TARGET_CONTACTED;
+    if (r.data_len)  flags |= XNET_XNQOSINFO_DATA_RECEIVED;
+    base[e + 0] = flags;
+    base[e + 1] = 0;
+    GuestWriteU16(base, e + 2, r.probes_xmit);
+    GuestWriteU16(base, e + 4, r.probes_recv);
+    GuestWriteU16(base, e + 6, r.data_len);
+    if (r.data_len) {
+        std::memcpy(base + data_addr, r.data, r.data_len);
+        GuestWriteU32(base, e + 8, data_addr);
+    } else {
+        GuestWriteU32(base, e + 8, 0);
+    }
+    GuestWriteU16(base, e + 12, r.rtt_med_ms);
+    GuestWriteU16(base, e + 14, r.rtt_min_ms);
+    GuestWriteU32(base, e + 16, r.up_bps);
+    GuestWriteU32(base, e + 20, r.dn_bps);
+}
+
+// Timer task: publish results once every target has answered every pair,
+// or at the deadline with whatever arrived.
+static void FinishQosLookup(uint16_t id) {
+    std::unique_lock lock(g_qos_lookup_mutex);
+    auto it = g_qos_lookups.find(id);
+    if (it == g_qos_lookups.end() || !g_base) return;  // released
+    QosLookup& lk = it->second;
+
+    bool all_answered = true;
+    for (auto& t : lk.targets) {
+        if (!t.cached && t.pairs_answered < lk.probes) all_answered = false;
+    }
+    if (!all_answered && NetClock::now() < lk.deadline) {
+        lock.unlock();
+        NetTimerRunAfter(QOS_RECHECK, [id]() { FinishQosLookup(id); });
+        return;
+    }
+
+    auto now = NetClock::now();
+    for (size_t i = 0; i < lk.targets.size(); i++) {
+        QosTarget& t = lk.targets[i];
+        QosResult r;
+        if (t.cached) {
+            r = t.cached_result;
+        } else {
+            // A target that never answered is reported as not contacted,
+            // with zero RTT and bandwidth; a missing pair sample leaves
+            // its bandwidth 0 (unknown)
+            r = SummarizeTarget(t);
+            if (r.contacted) g_qos_cache[t.ip_net] = {r, now};
+        }
+
+        WriteQosEntry(g_base, lk.qos_addr + 8 + (uint32_t)i * 24,
+                      lk.data_addr + (uint32_t)i * DISC_MAX_QOS, r);
+
+        struct in_addr a;
+        a.s_addr = t.ip_net;
+        char ip_str[INET_ADDRSTRLEN] = {};
+        inet_ntop(AF_INET, &a, ip_str, sizeof(ip_str));
+        fprintf(stderr, "[NET] QoS %s: %s rtt min/med=%u/%ums up=%ukbps dn=%ukbps recv=%u/%u data=%u\n",
+                ip_str, t.from_beacon ? "beacon" : t.cached ? "cached" :
+                        (t.rtt_us.empty() ? "unreachable" : "measured"),
+                r.rtt_min_ms, r.rtt_med_ms, r.up_bps / 1000, r.dn_bps / 1000,
+                r.probes_recv, r.probes_xmit, r.data_len);
+    }
+
+    // Set cxnqosPending = 0 last → game will fire completion callback
+    std::atomic_thread_fence(std::memory_order_release);
+    GuestWriteU32(g_base, lk.qos_addr + 4, 0);
+    fprintf(stderr, "[NET] QoS complete: XNQOS@0x%08X\n", lk.qos_addr);
+    fflush(stderr);
+    g_qos_lookups.erase(it);
+}
+
+// Forget any lookup still filling `qos_addr` (the game released it).
+static void CancelQosLookup(uint32_t qos_addr) {
+    std::lock_guard lock(g_qos_lookup_mutex);
+    for (auto it = g_qos_lookups.begin(); it != g_qos_lookups.end(); ++it) {
+        if (it->second.qos_addr == qos_addr) {
+            g_qos_lookups.erase(it);
+            return;
+        }
+    }
+}
+
+// ============================================================================
+// Discovery thread
+// ============================================================================
+
+static void DeliverDirect(const uint8_t* buf, int n, const struct sockaddr_in& from);
+
+// Dispatch one datagram received on the discovery port. Runs on the
+// discovery thread, or on the main guest thread for replayed packets.
+static void HandleDiscoveryPacket(const uint8_t* buf, int n, const struct sockaddr_in& from,
+                                  int64_t arrival_ns) {
+    if (n >= DISC_DIRECT_HEADER_LEN && buf[0] == DISC_MAGIC && buf[1] == DISC_DIRECT) {
+        // A replay already holds these as game datagrams
+        if (!NetReplayActive()) DeliverDirect(buf, n, from);
+        return;
+    }
+    if (n < DISC_HEADER_LEN || buf[0] != DISC_MAGIC) return;
+    const XNADDR_LAN* sender_addr = (const XNADDR_LAN*)(buf + 10);
+    BeaconInfo beacon;
+
+    // Skip our own packets
+    if (sender_addr->ina != g_local_ip_net) {
+        if (buf[1] == DISC_PROBE) {
+            // Someone is searching — answer them directly, echoing a v2
+            // prober's timestamp, and beacon fast for a while
+            struct sockaddr_in reply = {};
+            reply.sin_family = AF_INET;
+            reply.sin_port = htons((uint16_t)g_lan_port);
+            reply.sin_addr.s_addr = from.sin_addr.s_addr;
+            uint64_t echo = (n >= DISC_PROBE_V2_LEN && buf[46] >= DISC_BEACON_V2) ? GetBE64(buf + 48) : 0;
+            g_disc_step.store(31, std::memory_order_relaxed);
+            g_last_probe_heard_ms.store(PeerClockMs(), std::memory_order_relaxed);
+            SendBeacon(g_disc_socket, reply, 0, echo);
+        }
+        else if (buf[1] == DISC_BEACON && ParseBeacon(buf, n, &beacon)) {
+            // Received a beacon — add/update peer
+            g_disc_step.store(32, std::memory_order_relaxed);
+            uint32_t ip = from.sin_addr.s_addr;
+            AddOrUpdatePeer(*sender_addr, beacon.xnkid);
+            if (beacon.echo_ns) {
+                // Answers our probe: one RTT sample, no QoS round trip
+                int64_t rtt_ns = arrival_ns - (int64_t)beacon.echo_ns;
+                if (rtt_ns > 0) NetTelemetryRtt(ip, (uint32_t)std::min<int64_t>(rtt_ns / 1000, UINT32_MAX));
+            } else if (!beacon.version) {
+                NetTelemetryBeacon(ip, arrival_ns, BEACON_INTERVAL_V1_MS * 1000000);
+            } else if (beacon.interval_ms) {
+                NetTelemetryBeacon(ip, arrival_ns, (int64_t)beacon.interval_ms * 1000000);
+            }
+            NoteBeaconQos(ip, beacon);
+            static const uint8_t no_kid[8] = {};
+            if (std::memcmp(beacon.xnkid, no_kid, 8) != 0) {
+                uint8_t filled = beacon.filled_public + beacon.filled_private;
+                uint8_t slots  = filled + beacon.open_public + beacon.open_private;
+                g_sessions.NoteLanHost(beacon.xnkid, *sender_addr, PeerClockMs(),
+                                       filled, beacon.version ? slots : 0,
+                                       beacon.has_terms ? &beacon.terms : nullptr);
+            }
+        }
+        else if (buf[1] == DISC_QOS_PROBE) {
+            g_disc_step.store(33, std::memory_order_relaxed);
+            g_last_probe_heard_ms.store(PeerClockMs(), std::memory_order_relaxed);
+            HandleQosProbe(buf, n, from, arrival_ns);
+        }
+        else if (buf[1] == DISC_QOS_REPLY) {
+            g_disc_step.store(34, std::memory_order_relaxed);
+            HandleQosReply(buf, n, from, arrival_ns);
+        }
+        else if (buf[1] == DISC_PUNCH || buf[1] == DISC_PUNCH_ACK) {
+            g_disc_step.store(35, std::memory_order_relaxed);
+            PunchHandlePacket(buf, n, from);
+        }
+    }
+}
+
+static void DiscoveryThreadFunc() {
+    g_disc_step.store(1, std::memory_order_relaxed);
+    fprintf(stderr, "[DISC] step 1: thread entry\n"); fflush(stderr);
+    REXLOG_INFO("[NET] Discovery thread started on port {}", g_lan_port);
+    fprintf(stderr, "[DISC] step 1b: past REXLOG, entering loop\n"); fflush(stderr);
+
+    auto last_beacon = std::chrono::steady_clock::now() -
+                       std::chrono::seconds(10); // send first beacon immediately
+    int64_t last_expiry_ms = PeerClockMs();
+
+    int iter = 0;
+    while (g_disc_running.load(std::memory_order_relaxed)) {
+        iter++;
+        if (iter == 1 || iter % 50 == 0) {
+            fprintf(stderr, "[DISC] iter=%d step=%d\n", iter,
+                    g_disc_step.load(std::memory_order_relaxed));
+            fflush(stderr);
+        }
+
+        // Step 2: Build fd_set and call select
+        g_disc_step.store(2, std::memory_order_relaxed);
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(g_disc_socket, &fds);
+        struct timeval tv = {0, 100000}; // 100ms
+        int sel = select((int)g_disc_socket + 1, &fds, nullptr, nullptr, &tv);
+
+        // Step 3: Process received packets. Drain everything queued so QoS
+        // reply pairs are timestamped back-to-back, not a loop apart.
+        g_disc_step.store(3, std::memory_order_relaxed);
+        for (int drained = 0; sel > 0 && drained < 64; drained++) {
+            uint8_t buf[2048];
+            struct sockaddr_in from = {};
+            socklen_t fromlen = sizeof(from);
+            int n = recvfrom(g_disc_socket, (char*)buf, sizeof(buf), 0,
+                             (struct sockaddr*)&from, &fromlen);
+            int64_t arrival_ns = SteadyNowNs();
+            // Live traffic is read and dropped while replaying a capture
+            if (n > 0 && !NetReplayActive()) {
+                // Direct-path game datagrams are counted against the peer's
+                // ina when the guest receives them
+                if (n < 2 || buf[1] != DISC_DIRECT) NoteRecv(from.sin_addr.s_addr, n);
+                NetCaptureRecord(NetCapDir::In, NetCapKind::Discovery,
+                                 from.sin_addr.s_addr, from.sin_port,
+                                 g_local_ip_net, htons((uint16_t)g_lan_port), buf, (size_t)n);
+                HandleDiscoveryPacket(buf, n, from, arrival_ns);
+            }
+
+            FD_ZERO(&fds);
+            FD_SET(g_disc_socket, &fds);
+            struct timeval poll_tv = {0, 0};
+            sel = select((int)g_disc_socket + 1, &fds, nullptr, nullptr, &poll_tv);
+        }
+
+        // Step 4: Broadcast beacons periodically if hosting (QoS listener
+        // active), fast while someone has searched recently
+        g_disc_step.store(4, std::memory_order_relaxed);
+        auto now = std::chrono::steady_clock::now();
+        auto since_beacon = std::chrono::duration_cast<std::chrono::milliseconds>(
+            now - last_beacon);
+        int64_t probe_ms = g_last_probe_heard_ms.load(std::memory_order_relaxed);
+        bool searched = probe_ms >= 0 && PeerClockMs() - probe_ms < BEACON_FAST_HOLD_MS;
+        int64_t interval_ms = searched ? BEACON_INTERVAL_FAST_MS : BEACON_INTERVAL_IDLE_MS;
+        if (since_beacon.count() >= interval_ms) {
+            // The first beacon (and one after a long stall) declares no interval
+            uint16_t declared = since_beacon.count() <= BEACON_INTERVAL_IDLE_MS * 2
+                                    ? (uint16_t)since_beacon.count() : 0;
+            g_disc_step.store(41, std::memory_order_relaxed);
+            struct sockaddr_in bcast = {};
+            bcast.sin_family = AF_INET;
+            bcast.sin_port = htons((uint16_t)g_lan_port);
+            bcast.sin_addr.s_addr = INADDR_BROADCAST;
+            SendBeacon(g_disc_socket, bcast, declared, 0);
+            // Explicit targets for networks without broadcast (loopback tests)
+            for (auto& peer : g_disc_peers) {
+                SendBeacon(g_disc_socket, peer, declared, 0);
+            }
+            last_beacon = now;
+        }
+
+        // Step 5: Expire peers that stopped beaconing
+        g_disc_step.store(5, std::memory_order_relaxed);
+        int64_t now_ms = PeerClockMs();
+        if (now_ms - last_expiry_ms >= PEER_EXPIRY_SCAN_MS) {
+            size_t expired = g_peers.ExpireIdle(now_ms, PEER_IDLE_EXPIRY_MS, NetTelemetryForget);
+            g_sessions.ExpireLan(now_ms, LAN_SESSION_EXPIRY_MS);
+            PruneQosState(NetClock::now());
+            if (expired) {
+                REXLOG_INFO("[NET] Expired {} idle peer(s), {} remaining",
+                            expired, g_peers.Size());
+            }
+            last_expiry_ms = now_ms;
+            WriteNetStats();
+        }
+
+        g_disc_step.store(6, std::memory_order_relaxed);
+    }
+
+    REXLOG_INFO("[NET] Discovery thread stopped");
+}
+
+// ============================================================================
+// Receive reactor
+// ============================================================================
+//
+// Overlapped WSARecvFrom calls that find no data are parked in
+// g_pending_recvs. The reactor thread polls every socket with a parked
+// receive; when a datagram arrives it is received directly into the guest
+// buffer, the WSAOVERLAPPED is marked complete and hEvent is signalled.
+// WSAGetOverlappedResult is then a pure memory check on the guest side —
+// no syscall per poll, and completion latency no longer depends on how
+// often the game polls.
+
+#ifdef _WIN32
+typedef WSAPOLLFD NetPollFd;
+static int NetPoll(NetPollFd* fds, size_t count, int timeout_ms) {
+    return WSAPoll(fds, (ULONG)count, timeout_ms);
+}
+#else
+typedef struct pollfd NetPollFd;
+static int NetPoll(NetPollFd* fds, size_t count, int timeout_ms) {
+    return poll(fds, (nfds_t)count, timeout_ms);
+}
+#endif
+
+static constexpr uint32_t OV_STATUS_PENDING   = 0x00000103;  // STATUS_PENDING
+static constexpr uint32_t OV_STATUS_CANCELLED = 0xC0000120;  // STATUS_CANCELLED
+static constexpr uint32_t OV_STATUS_MSGSIZE   = 0x80000005;  // STATUS_BUFFER_OVERFLOW (WSAEMSGSIZE)
+
+// RecvGameDatagram: the datagram was larger than the receive buffer. Its
+// first buf_len bytes are in the buffer and the rest is lost, as Winsock
+// does when it fails a receive with WSAEMSGSIZE.
+static constexpr int RECV_MSGSIZE = -2;
+
+// Leave WSAEMSGSIZE as the thread's socket error, where a native recvfrom
+// that hit it leaves it for the guest's WSAGetLastError.
+static void SetMsgSizeError() {
+#ifdef _WIN32
+    WSASetLastError(WSAEMSGSIZE);
+#else
+    errno = EMSGSIZE;
+#endif
+}
+
+static void SetNonBlocking(SOCKET sock) {
+#ifdef _WIN32
+    u_long nonblock = 1;
+    ioctlsocket(sock, FIONBIO, &nonblock);
+#else
+    int flags_val = fcntl(sock, F_GETFL, 0);
+    fcntl(sock, F_SETFL, flags_val | O_NONBLOCK);
+#endif
+}
+
+// ---- Packet-arrival-to-game-visibility latency ----
+// The reactor stamps each completion with the time poll() reported the
+// socket readable. The sample is closed when WSAGetOverlappedResult first
+// observes the completed overlapped. Slots are direct-mapped by overlapped
+// address; a collision only drops a sample.
+struct RecvLatencySlot {
+    std::atomic<uint32_t> overlapped{0};
+    std::atomic<int64_t>  ready_ns{0};
+};
+static constexpr uint32_t RECV_LATENCY_SLOTS   = 256;
+static constexpr int      RECV_LATENCY_BUCKETS = 20;  // log2(us): 1us .. ~0.5s
+static RecvLatencySlot        g_recv_latency_slots[RECV_LATENCY_SLOTS];
+static std::atomic<uint64_t>  g_recv_latency_samples{0};
+static std::atomic<uint64_t>  g_recv_latency_total_us{0};
+static std::atomic<uint64_t>  g_recv_latency_max_us{0};
+static std::atomic<uint64_t>  g_recv_latency_hist[RECV_LATENCY_BUCKETS];
+
+static RecvLatencySlot& RecvLatencySlotFor(uint32_t overlapped) {
+    return g_recv_latency_slots[(overlapped >> 3) & (RECV_LATENCY_SLOTS - 1)];
+}
+
+static void LogRecvLatency() {
+    uint64_t n = g_recv_latency_samples.load(std::memory_order_relaxed);
+    if (n == 0) return;
+    // Percentiles are reported as the upper bound of their log2 bucket.
+    auto percentile = [n](double p) -> uint64_t {
+        uint64_t target = (uint64_t)(n * p), seen = 0;
+        for (int b = 0; b < RECV_LATENCY_BUCKETS; b++) {
+            seen += g_recv_latency_hist[b].load(std::memory_order_relaxed);
+            if (seen > target) return 1ull << (b + 1);
+        }
+        return 1ull << RECV_LATENCY_BUCKETS;
+    };
+    uint64_t avg = g_recv_latency_total_us.load(std::memory_order_relaxed) / n;
+    uint64_t max = g_recv_latency_max_us.load(std::memory_order_relaxed);
+    REXLOG_INFO("[NET] recv arrival->visible: n={} avg={}us p50<={}us p99<={}us max={}us",
+                n, avg, percentile(0.50), percentile(0.99), max);
+    fprintf(stderr, "[NET] recv arrival->visible: n=%llu avg=%lluus p50<=%lluus p99<=%lluus max=%lluus\n",
+            (unsigned long long)n, (unsigned long long)avg,
+            (unsigned long long)percentile(0.50), (unsigned long long)percentile(0.99),
+            (unsigned long long)max);
+    fflush(stderr);
+}
+
+static void RecordRecvVisible(uint32_t overlapped) {
+    auto& slot = RecvLatencySlotFor(overlapped);
+    uint32_t tagged = slot.overlapped.load(std::memory_order_acquire);
+    if (tagged != overlapped) return;
+    int64_t ready_ns = slot.ready_ns.load(std::memory_order_relaxed);
+    if (!slot.overlapped.compare_exchange_strong(tagged, 0, std::memory_order_acq_rel)) return;
+
+    uint64_t us = (uint64_t)std::max<int64_t>(0, (SteadyNowNs() - ready_ns) / 1000);
+    int bucket = 0;
+    while (bucket < RECV_LATENCY_BUCKETS - 1 && (us >> (bucket + 1)) != 0) bucket++;
+    g_recv_latency_hist[bucket].fetch_add(1, std::memory_order_relaxed);
+    g_recv_latency_total_us.fetch_add(us, std::memory_order_relaxed);
+    uint64_t prev_max = g_recv_latency_max_us.load(std::memory_order_relaxed);
+    while (us > prev_max &&
+           !g_recv_latency_max_us.compare_exchange_weak(prev_max, us, std::memory_order_relaxed)) {}
+    uint64_t n = g_recv_latency_samples.fetch_add(1, std::memory_order_relaxed) + 1;
+    if ((n & 4095) == 0) LogRecvLatency();
+}
 
-        BeaconResponse resp = {};
-        std::memcpy(resp.xnkid, buf + 2, 8);
-        std::memcpy(&resp.host_addr, buf + 10, 36);
-        resp.qos_data_len = ((uint16_t)buf[46] << 8) | buf[47];
-        if (resp.qos_data_len > DISC_MAX_QOS)
-            resp.qos_data_len = DISC_MAX_QOS;
-        if (resp.qos_data_len > 0 && n >= 48 + (int)resp.qos_data_len) {
-            std::memcpy(resp.qos_data, buf + 48, resp.qos_data_len);
+// Datagrams that no receive has taken yet, per socket: unpacked from a
+// tunnel packet, or delivered over a direct path through the discovery
+// socket. Guarded by g_pending_mutex.
+struct QueuedDatagram {
+    struct sockaddr_in   from;
+    std::vector<uint8_t> data;
+};
+static std::unordered_map<SOCKET, std::deque<QueuedDatagram>> g_queued_rx;
+// Guest sockets by bound port (network order), for direct-path delivery.
+// Guarded by g_pending_mutex.
+static std::unordered_map<uint16_t, SOCKET> g_game_ports;
+
+// Receive one guest datagram on `native` into the receive's buffer.
+// Returns its length, RECV_MSGSIZE if it didn't fit, or -1 if nothing is
+// queued. Caller holds g_pending_mutex. With the tunnel on, datagrams are
+// read into a host buffer first so tunnel packets can be split before the
+// guest sees them.
+static int RecvGameDatagram(uint8_t* base, const PendingRecv& pr, struct sockaddr_in* from) {
+    char* dst = pr.buf_guest ? (char*)(base + pr.buf_guest) : nullptr;
+    auto& queue = g_queued_rx[pr.native];
+    // A datagram from the host buffer: as much as fits, RECV_MSGSIZE if cut
+    auto deliver = [&](const uint8_t* data, size_t size) {
+        size_t n = dst ? std::min<size_t>(size, pr.buf_len) : 0;
+        if (n) std::memcpy(dst, data, n);
+        return size > n ? RECV_MSGSIZE : (int)n;
+    };
+    if (queue.empty() && !TunnelEnabled()) {
+        socklen_t from_len = sizeof(*from);
+        int n = recvfrom(pr.native, dst, dst ? (int)pr.buf_len : 0, 0,
+                         (struct sockaddr*)from, &from_len);
+#ifdef _WIN32
+        if (n < 0 && WSAGetLastError() == WSAEMSGSIZE) return RECV_MSGSIZE;
+#endif
+        return n;
+    }
+
+    while (queue.empty()) {
+        static thread_local uint8_t scratch[65536];
+        socklen_t from_len = sizeof(*from);
+        int n = recvfrom(pr.native, (char*)scratch, sizeof(scratch), 0,
+                         (struct sockaddr*)from, &from_len);
+        if (n < 0) return n;
+
+        std::vector<std::vector<uint8_t>> datagrams;
+        if (TunnelDecode(scratch, n, &datagrams)) {
+            for (auto& d : datagrams) queue.push_back({*from, std::move(d)});
+            continue;  // a malformed packet yields nothing; read the next
         }
+        // Plain datagram (broadcast, or a peer without the tunnel)
+        return deliver(scratch, (size_t)n);
+    }
 
-        // Add peer
-        AddOrUpdatePeer(resp.host_addr, resp.xnkid);
-        responses.push_back(resp);
+    QueuedDatagram d = std::move(queue.front());
+    queue.pop_front();
+    *from = d.from;
+    return deliver(d.data.data(), d.data.size());
+}
+
+// Write a received datagram's metadata into guest memory and publish the
+// completion. The payload must already be in the guest buffer. InternalLow
+// is written last so a guest that reads 0 there also sees every other field.
+// `n` RECV_MSGSIZE publishes a truncated datagram as a WSAEMSGSIZE failure.
+static void PublishRecvCompletion(uint8_t* base, uint32_t overlapped,
+                                  const PendingRecv& pr, int n,
+                                  const struct sockaddr_in& from) {
+    uint32_t status = 0;
+    if (n == RECV_MSGSIZE) {
+        n = pr.buf_guest ? (int)pr.buf_len : 0;
+        status = OV_STATUS_MSGSIZE;
+    }
+    if (pr.bytes_ptr) GuestWriteU32(base, pr.bytes_ptr, (uint32_t)n);
+    if (pr.flags_ptr) GuestWriteU32(base, pr.flags_ptr, 0);
+    if (pr.from_ptr) {
+        // sockaddr_in layout for Xbox (big-endian):
+        // +0 uint16_t sin_family, +2 uint16_t sin_port,
+        // +4 uint32_t sin_addr, +8 zero[8]
+        GuestWriteU16(base, pr.from_ptr + 0, AF_INET);
+        // Port and addr are already in network byte order
+        std::memcpy(base + pr.from_ptr + 2, &from.sin_port, 2);
+        std::memcpy(base + pr.from_ptr + 4, &from.sin_addr, 4);
+        std::memset(base + pr.from_ptr + 8, 0, 8);
+    }
+    if (pr.fromlen_ptr) GuestWriteU32(base, pr.fromlen_ptr, 16);
+    NoteRecv(from.sin_addr.s_addr, n);
+    if (NetCaptureActive() && pr.buf_guest) {
+        NetCaptureRecord(NetCapDir::In, NetCapKind::Game,
+                         from.sin_addr.s_addr, from.sin_port,
+                         g_local_ip_net, SocketLocalPort(pr.native),
+                         base + pr.buf_guest, std::min<size_t>((size_t)n, pr.buf_len));
+    }
+    if (overlapped) {
+        // WSAOVERLAPPED: +0 Internal (status), +4 InternalHigh (bytes),
+        //                +8 Offset, +12 OffsetHigh, +16 hEvent
+        GuestWriteU32(base, overlapped + 4, (uint32_t)n);
+        std::atomic_thread_fence(std::memory_order_release);
+        GuestWriteU32(base, overlapped + 0, status);
     }
-    return responses;
 }
 
-// ============================================================================
-// Discovery thread
-// ============================================================================
+static void SignalGuestEvent(uint32_t event_handle) {
+    if (!event_handle || !g_kernel_state) return;
+    auto ev = g_kernel_state->object_table()->LookupObject<rex::kernel::XEvent>(event_handle);
+    if (ev) ev->Set(0, false);
+}
 
-static void DiscoveryThreadFunc() {
-    g_disc_step.store(1, std::memory_order_relaxed);
-    fprintf(stderr, "[DISC] step 1: thread entry\n"); fflush(stderr);
-    REXLOG_INFO("[NET] Discovery thread started on port {}", g_lan_port);
-    fprintf(stderr, "[DISC] step 1b: past REXLOG, entering loop\n"); fflush(stderr);
+static void ReactorWake() {
+    if (g_reactor_wake == (SOCKET)INVALID_SOCKET) return;
+    char b = 0;
+    sendto(g_reactor_wake, &b, 1, 0,
+           (const struct sockaddr*)&g_reactor_wake_addr, sizeof(g_reactor_wake_addr));
+}
 
-    auto last_beacon = std::chrono::steady_clock::now() -
-                       std::chrono::seconds(10); // send first beacon immediately
+// Hand a DISC_DIRECT datagram to the guest socket it was sent to, as if it
+// came from the sender's ina and game port. The header's ina is only
+// believed when `from` is that peer's direct path.
+static void DeliverDirect(const uint8_t* buf, int n, const struct sockaddr_in& from) {
+    uint16_t dst_port;
+    struct sockaddr_in guest_from = {};
+    guest_from.sin_family = AF_INET;
+    std::memcpy(&dst_port, buf + 2, 2);
+    std::memcpy(&guest_from.sin_port, buf + 4, 2);
+    std::memcpy(&guest_from.sin_addr.s_addr, buf + 6, 4);
+    const uint8_t* payload = buf + DISC_DIRECT_HEADER_LEN;
+    int len = n - DISC_DIRECT_HEADER_LEN;
+    if (!PunchAcceptDirect(guest_from.sin_addr.s_addr, from)) return;
 
-    int iter = 0;
-    while (g_disc_running.load(std::memory_order_relaxed)) {
-        iter++;
-        if (iter == 1 || iter % 50 == 0) {
-            fprintf(stderr, "[DISC] iter=%d step=%d\n", iter,
-                    g_disc_step.load(std::memory_order_relaxed));
-            fflush(stderr);
+    {
+        std::lock_guard lock(g_pending_mutex);
+        auto port = g_game_ports.find(dst_port);
+        if (port == g_game_ports.end()) return;  // nothing bound there; the kernel would drop it too
+        auto& queue = g_queued_rx[port->second];
+        std::vector<std::vector<uint8_t>> datagrams;
+        if (TunnelDecode(payload, len, &datagrams)) {
+            for (auto& d : datagrams) queue.push_back({guest_from, std::move(d)});
+        } else {
+            queue.push_back({guest_from, std::vector<uint8_t>(payload, payload + len)});
         }
+    }
+    ReactorWake();
+}
 
-        // Step 2: Build fd_set and call select
-        g_disc_step.store(2, std::memory_order_relaxed);
-        fd_set fds;
-        FD_ZERO(&fds);
-        FD_SET(g_disc_socket, &fds);
-        struct timeval tv = {0, 100000}; // 100ms
-        int sel = select((int)g_disc_socket + 1, &fds, nullptr, nullptr, &tv);
+// True when the guest socket a receive was parked on has been closed: its
+// handle no longer resolves, or resolves to another host socket. The host fd
+// number may already belong to a new socket, so such a receive must never
+// be completed from it. Caller holds g_pending_mutex.
+static bool PendingRecvOrphaned(const PendingRecv& pr) {
+    if (!g_kernel_state) return false;
+    auto socket_obj = g_kernel_state->object_table()->LookupObject<rex::kernel::XSocket>(
+        pr.socket_handle);
+    return !socket_obj || (SOCKET)socket_obj->native_handle() != pr.native;
+}
 
-        // Step 3: Process received packet if any
-        g_disc_step.store(3, std::memory_order_relaxed);
-        if (sel > 0) {
-            uint8_t buf[2048];
-            struct sockaddr_in from = {};
-            int fromlen = sizeof(from);
-            int n = recvfrom(g_disc_socket, (char*)buf, sizeof(buf), 0,
-                             (struct sockaddr*)&from, &fromlen);
+// Cancel every parked receive whose guest socket has been closed, so it is
+// neither polled nor counted ahead of a new socket's receives on a reused
+// fd. Caller holds g_pending_mutex and signals the returned events after
+// releasing it.
+static void PurgeOrphanedRecvs(uint8_t* base, std::vector<uint32_t>* to_signal) {
+    for (auto it = g_pending_recvs.begin(); it != g_pending_recvs.end();) {
+        if (!PendingRecvOrphaned(it->second)) {
+            ++it;
+            continue;
+        }
+        REXLOG_DEBUG("[NET] Cancelling receive {:08X} on closed socket {:08X}",
+                     it->first, it->second.socket_handle);
+        GuestWriteU32(base, it->first + 4, 0);
+        std::atomic_thread_fence(std::memory_order_release);
+        GuestWriteU32(base, it->first + 0, OV_STATUS_CANCELLED);
+        to_signal->push_back(it->second.event_handle);
+        it = g_pending_recvs.erase(it);
+    }
+}
+
+// Complete as many parked receives on `native` as there are queued
+// datagrams, oldest registration first.
+static void ReactorServiceSocket(SOCKET native, short revents, int64_t ready_ns) {
+    std::vector<uint32_t> to_signal;
+    {
+        std::lock_guard lock(g_pending_mutex);
+        uint8_t* base = g_base;
 
-            if (n >= DISC_HEADER_LEN && buf[0] == DISC_MAGIC) {
-                XNADDR_LAN* sender_addr = (XNADDR_LAN*)(buf + 10);
-
-                // Skip our own packets
-                if (sender_addr->ina != g_local_ip_net) {
-                    if (buf[1] == DISC_PROBE) {
-                        // Someone is looking for us — respond with beacon
-                        // directly to them
-                        struct sockaddr_in reply = {};
-                        reply.sin_family = AF_INET;
-                        reply.sin_port = htons((uint16_t)g_lan_port);
-                        reply.sin_addr.s_addr = from.sin_addr.s_addr;
-                        g_disc_step.store(31, std::memory_order_relaxed);
-                        SendBeacon(g_disc_socket, reply);
-                    }
-                    else if (buf[1] == DISC_BEACON && n >= DISC_HEADER_LEN + 2) {
-                        // Received a beacon — add/update peer
-                        uint8_t* xnkid = buf + 2;
-                        g_disc_step.store(32, std::memory_order_relaxed);
-                        AddOrUpdatePeer(*sender_addr, xnkid);
-                    }
-                }
+        std::vector<std::pair<uint64_t, uint32_t>> order;  // (seq, overlapped)
+        for (auto& [ov, pr] : g_pending_recvs) {
+            if (pr.native == native) order.push_back({pr.seq, ov});
+        }
+        std::sort(order.begin(), order.end());
+
+        bool dead = (revents & (POLLERR | POLLNVAL)) && !(revents & POLLIN);
+        for (auto& [seq, ov] : order) {
+            auto it = g_pending_recvs.find(ov);
+            PendingRecv& pr = it->second;
+
+            // Closed since the poll set was built (and possibly the fd
+            // reused): fail the receive rather than read the new socket.
+            if (dead || PendingRecvOrphaned(pr)) {
+                // Socket closed or errored underneath us: fail the receive.
+                GuestWriteU32(base, ov + 4, 0);
+                std::atomic_thread_fence(std::memory_order_release);
+                GuestWriteU32(base, ov + 0, OV_STATUS_CANCELLED);
+                to_signal.push_back(pr.event_handle);
+                g_pending_recvs.erase(it);
+                continue;
             }
+
+            struct sockaddr_in from = {};
+            int n = RecvGameDatagram(base, pr, &from);
+            if (n < 0 && n != RECV_MSGSIZE) break;  // drained
+
+            auto& slot = RecvLatencySlotFor(ov);
+            slot.ready_ns.store(ready_ns, std::memory_order_relaxed);
+            slot.overlapped.store(ov, std::memory_order_release);
+
+            PublishRecvCompletion(base, ov, pr, n, from);
+            to_signal.push_back(pr.event_handle);
+            g_pending_recvs.erase(it);
         }
+    }
+    for (uint32_t ev : to_signal) SignalGuestEvent(ev);
+}
 
-        // Step 4: Fire any pending deferred QoS completions.
-        g_disc_step.store(4, std::memory_order_relaxed);
+static void ReactorThreadFunc() {
+    REXLOG_INFO("[NET] Receive reactor started");
+    std::vector<NetPollFd> fds;
+    char drain[64];
+
+    while (g_reactor_running.load(std::memory_order_acquire)) {
+        fds.clear();
+        fds.push_back({g_reactor_wake, POLLIN, 0});
+        std::vector<uint32_t> cancelled;
         {
-            auto now2 = std::chrono::steady_clock::now();
-            std::lock_guard<std::mutex> lock(g_pending_qos_mutex);
-            for (auto it = g_pending_qos.begin(); it != g_pending_qos.end(); ) {
-                if (now2 >= it->ready_at && g_base) {
-                    // Set cxnqosPending = 0 → game will fire completion callback
-                    GuestWriteU32(g_base, it->qos_addr + 4, 0);
-                    fprintf(stderr, "[NET] QoS deferred complete: XNQOS@0x%08X\n", it->qos_addr);
-                    fflush(stderr);
-                    it = g_pending_qos.erase(it);
-                } else {
-                    ++it;
-                }
+            std::lock_guard lock(g_pending_mutex);
+            PurgeOrphanedRecvs(g_base, &cancelled);
+            for (auto& [ov, pr] : g_pending_recvs) {
+                bool seen = false;
+                for (size_t i = 1; i < fds.size() && !seen; i++) seen = fds[i].fd == pr.native;
+                if (!seen) fds.push_back({pr.native, POLLIN, 0});
             }
         }
+        for (uint32_t ev : cancelled) SignalGuestEvent(ev);
 
-        // Step 5: Broadcast beacons periodically if hosting (QoS listener active)
-        g_disc_step.store(5, std::memory_order_relaxed);
-        auto now = std::chrono::steady_clock::now();
-        auto since_beacon = std::chrono::duration_cast<std::chrono::milliseconds>(
-            now - last_beacon);
-        if (since_beacon.count() >= 500) {
-            g_disc_step.store(51, std::memory_order_relaxed);
-            struct sockaddr_in bcast = {};
-            bcast.sin_family = AF_INET;
-            bcast.sin_port = htons((uint16_t)g_lan_port);
-            bcast.sin_addr.s_addr = INADDR_BROADCAST;
-            SendBeacon(g_disc_socket, bcast);
-            last_beacon = now;
+        int ready = NetPoll(fds.data(), fds.size(), 250);
+        if (ready <= 0) continue;
+        int64_t ready_ns = SteadyNowNs();
+
+        if (fds[0].revents & POLLIN) {
+            while (recv(g_reactor_wake, drain, sizeof(drain), 0) > 0) {}
+            // Direct-path datagrams are queued without the socket becoming
+            // readable; the wake is their only signal.
+            std::lock_guard lock(g_pending_mutex);
+            for (size_t i = 1; i < fds.size(); i++) {
+                auto it = g_queued_rx.find(fds[i].fd);
+                if (it != g_queued_rx.end() && !it->second.empty()) fds[i].revents |= POLLIN;
+            }
+        }
+        for (size_t i = 1; i < fds.size(); i++) {
+            if (fds[i].revents) ReactorServiceSocket(fds[i].fd, fds[i].revents, ready_ns);
         }
+    }
+    REXLOG_INFO("[NET] Receive reactor stopped");
+}
 
-        g_disc_step.store(6, std::memory_order_relaxed);
+static bool ReactorStart() {
+    // Loopback datagram socket that the reactor polls alongside the game
+    // sockets; sending a byte to it interrupts poll() when work is queued.
+    g_reactor_wake = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (g_reactor_wake == (SOCKET)INVALID_SOCKET) {
+        REXLOG_ERROR("[NET] Failed to create reactor wake socket");
+        return false;
+    }
+    g_reactor_wake_addr = {};
+    g_reactor_wake_addr.sin_family = AF_INET;
+    g_reactor_wake_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(g_reactor_wake_addr);
+    if (bind(g_reactor_wake, (struct sockaddr*)&g_reactor_wake_addr, len) < 0 ||
+        getsockname(g_reactor_wake, (struct sockaddr*)&g_reactor_wake_addr, &len) < 0) {
+        REXLOG_ERROR("[NET] Failed to bind reactor wake socket");
+        closesocket(g_reactor_wake);
+        g_reactor_wake = (SOCKET)INVALID_SOCKET;
+        return false;
     }
+    SetNonBlocking(g_reactor_wake);
 
-    REXLOG_INFO("[NET] Discovery thread stopped");
+    g_reactor_running.store(true, std::memory_order_release);
+    g_reactor_thread = std::thread(ReactorThreadFunc);
+    return true;
+}
+
+static void ReactorStop() {
+    g_reactor_running.store(false, std::memory_order_release);
+    ReactorWake();
+    if (g_reactor_thread.joinable()) {
+        g_reactor_thread.join();
+    }
+    if (g_reactor_wake != (SOCKET)INVALID_SOCKET) {
+        closesocket(g_reactor_wake);
+        g_reactor_wake = (SOCKET)INVALID_SOCKET;
+    }
+    LogRecvLatency();
+}
+
+// ============================================================================
+// Replay delivery
+// ============================================================================
+//
+// While replaying, no socket is read: guest receives are satisfied from the
+// capture (net_capture.h) as the frame counter reaches each packet's
+// recorded frame. Receives that find nothing due are parked as usual and
+// completed from the present hook (NetOnPresent) instead of the reactor.
+
+// Take the next recorded datagram for this socket's port as if recvfrom had
+// returned it. The game binds its system-link sockets to fixed ports, so
+// the port identifies the socket across runs. Returns -1 if none is due.
+static int ReplayRecvInto(uint8_t* base, const PendingRecv& pr, struct sockaddr_in* from) {
+    NetCapPacket p;
+    if (!NetReplayTake(NetCapKind::Game, SocketLocalPort(pr.native), &p)) return -1;
+    int n = (int)std::min<size_t>(p.data.size(), pr.buf_len);
+    if (pr.buf_guest && n > 0) std::memcpy(base + pr.buf_guest, p.data.data(), (size_t)n);
+    *from = {};
+    from->sin_family = AF_INET;
+    from->sin_port = p.src_port;
+    from->sin_addr.s_addr = p.src_ip;
+    return n;
+}
+
+// Deliver everything due by the current frame. Main guest thread only.
+static void ReplayDeliver(uint8_t* base) {
+    std::vector<uint32_t> to_signal;
+    {
+        std::lock_guard lock(g_pending_mutex);
+        std::vector<std::pair<uint64_t, uint32_t>> order;  // (seq, overlapped)
+        for (auto& [ov, pr] : g_pending_recvs) order.push_back({pr.seq, ov});
+        std::sort(order.begin(), order.end());
+
+        for (auto& [seq, ov] : order) {
+            auto it = g_pending_recvs.find(ov);
+            struct sockaddr_in from;
+            int n = ReplayRecvInto(base, it->second, &from);
+            if (n < 0) continue;
+            PublishRecvCompletion(base, ov, it->second, n, from);
+            to_signal.push_back(it->second.event_handle);
+            g_pending_recvs.erase(it);
+        }
+    }
+    for (uint32_t ev : to_signal) SignalGuestEvent(ev);
+
+    NetCapPacket p;
+    while (NetReplayTake(NetCapKind::Discovery, 0, &p)) {
+        struct sockaddr_in from = {};
+        from.sin_family = AF_INET;
+        from.sin_port = p.src_port;
+        from.sin_addr.s_addr = p.src_ip;
+        NoteRecv(p.src_ip, (int)p.data.size());
+        HandleDiscoveryPacket(p.data.data(), (int)p.data.size(), from, SteadyNowNs());
+    }
 }
 
 // ============================================================================
 // Init / Shutdown
 // ============================================================================
 
-void NetInit(int lan_port, bool relay_enabled, const char* relay_host, int relay_port) {
+static void NetOnPresent(uint8_t* base);
+
+void NetInit(int lan_port, bool relay_enabled, const char* relay_host, int relay_port,
+             const char* relay_protocol) {
     g_lan_port = lan_port;
 
 #ifdef _WIN32
@@ -778,10 +2313,57 @@ void NetInit(int lan_port, bool relay_enabled, const char* relay_host, int relay
     WSAStartup(MAKEWORD(2, 2), &wsa);
 #endif
 
-    // Detect LAN IP
-    g_local_ip_net = GetLocalLanIP();
+    g_net_start = NetClock::now();
+    PresentSubscribe(PresentStage::Before, NetOnPresent);
+
+    if (!g_test_opts.replay_path.empty()) {
+        NetReplayOpen(g_test_opts.replay_path);
+    }
+
+    // Detect LAN IP, unless pinned to an address (one of several local
+    // instances on 127.0.0.x)
+    g_bind_ip_net = INADDR_ANY;
+    if (!g_test_opts.bind_address.empty()) {
+        struct in_addr a;
+        if (inet_pton(AF_INET, g_test_opts.bind_address.c_str(), &a) == 1) {
+            g_bind_ip_net = a.s_addr;
+        } else {
+            REXLOG_ERROR("[NET] Invalid bind_address '{}'", g_test_opts.bind_address);
+        }
+    }
+    g_local_ip_net = g_bind_ip_net != INADDR_ANY ? g_bind_ip_net : GetLocalLanIP();
+    // A replay takes on the recorded instance's address so replayed peers
+    // see the XNADDR they were talking to.
+    if (NetReplayActive() && NetReplayLocalIp() != 0) {
+        g_local_ip_net = NetReplayLocalIp();
+    }
     BuildLocalXnAddr(g_local_ip_net);
 
+    if (!g_test_opts.capture_path.empty()) {
+        NetCaptureOpen(g_test_opts.capture_path, g_local_ip_net);
+    }
+
+    g_disc_peers.clear();
+    for (auto& spec : g_test_opts.discovery_peers) {
+        struct sockaddr_in peer;
+        if (ParseHostPort(spec, g_lan_port, &peer)) {
+            g_disc_peers.push_back(peer);
+        } else {
+            REXLOG_ERROR("[NET] Invalid discovery peer '{}'", spec);
+        }
+    }
+
+    // Start the timer and receive reactor first — guest sockets don't
+    // depend on the discovery socket below. A replay completes receives
+    // from the present hook, so live sockets are never polled.
+    NetTimerStart();
+    if (!NetReplayActive()) ReactorStart();
+    if (g_test_opts.tunnel && !NetReplayActive()) {
+        TunnelStart([](SOCKET sock, const struct sockaddr_in& dest, const uint8_t* pkt, int len) {
+            NetSendTo(sock, pkt, len, dest, false);
+        });
+    }
+
     {
         char ip_str[INET_ADDRSTRLEN] = {};
         struct in_addr a;
@@ -808,7 +2390,7 @@ void NetInit(int lan_port, bool relay_enabled, const char* relay_host, int relay
     struct sockaddr_in bind_addr = {};
     bind_addr.sin_family = AF_INET;
     bind_addr.sin_port = htons((uint16_t)g_lan_port);
-    bind_addr.sin_addr.s_addr = INADDR_ANY;
+    bind_addr.sin_addr.s_addr = g_bind_ip_net;
 
     if (bind(g_disc_socket, (struct sockaddr*)&bind_addr, sizeof(bind_addr)) < 0) {
         REXLOG_ERROR("[NET] Failed to bind discovery socket to port {}", g_lan_port);
@@ -817,17 +2399,56 @@ void NetInit(int lan_port, bool relay_enabled, const char* relay_host, int relay
         return;
     }
 
+    // Learn the discovery socket's public endpoint before anything else
+    // reads it, so the XNADDR the relay publishes lets peers behind other
+    // NATs punch through to us (net_punch.h)
+    if (!g_test_opts.stun_server.empty() && !NetReplayActive()) {
+        struct sockaddr_in stun, mapped;
+        if (!ParseHostPort(g_test_opts.stun_server, 3478, &stun)) {
+            REXLOG_ERROR("[NET] Invalid stun_server '{}'", g_test_opts.stun_server);
+        } else if (StunQuery(g_disc_socket, stun, &mapped, 500)) {
+            g_local_xnaddr.inaOnline = mapped.sin_addr.s_addr;
+            g_local_xnaddr.wPortOnline = mapped.sin_port;
+            PunchMakeKey(&g_local_xnaddr);
+            char ip_str[INET_ADDRSTRLEN] = {};
+            inet_ntop(AF_INET, &mapped.sin_addr, ip_str, sizeof(ip_str));
+            REXLOG_INFO("[NET] Public endpoint {}:{}", ip_str, ntohs(mapped.sin_port));
+        } else {
+            REXLOG_WARN("[NET] No STUN answer from {}; direct paths only to "
+                        "reachable peers", g_test_opts.stun_server);
+        }
+    }
+    if (!NetReplayActive()) {
+        PunchStart([](const struct sockaddr_in& to, const uint8_t* pkt, int n) {
+                       NetSendTo(g_disc_socket, pkt, n, to);
+                   },
+                   g_local_xnaddr, g_lan_port);
+    }
+
     // Start discovery thread
     g_disc_running.store(true, std::memory_order_release);
     g_disc_thread = std::thread(DiscoveryThreadFunc);
 
-    // Connect to relay server if enabled
-    if (relay_enabled && relay_host && *relay_host) {
+    // Connect to relay server if enabled. Calls after the connect go
+    // through the relay worker.
+    RelayProtocol protocol = RelayProtocol::Xlive;
+    if (!relay_protocol) relay_protocol = "xlive";
+    if (relay_enabled && NetReplayActive()) {
+        fprintf(stderr, "[NET] Relay skipped while replaying a capture\n");
+        fflush(stderr);
+    } else if (relay_enabled && !RelayProtocolFromName(relay_protocol, &protocol)) {
+        REXLOG_ERROR("[NET] Unknown relay_protocol '{}', relay not used", relay_protocol);
+        fprintf(stderr, "[NET] FAILED: unknown relay_protocol '%s' (xlive or relay_server)\n",
+                relay_protocol);
+        fflush(stderr);
+    } else if (relay_enabled && relay_host && *relay_host) {
         const uint8_t* xnaddr_bytes = reinterpret_cast<const uint8_t*>(&g_local_xnaddr);
-        if (xlive::Connect(relay_host, (uint16_t)relay_port,
-                           VIG8_TITLE_ID, xnaddr_bytes, "Player")) {
-            REXLOG_INFO("[NET] Connected to relay {}:{}", relay_host, relay_port);
-            fprintf(stderr, "[NET] Connected to relay %s:%d\n", relay_host, relay_port);
+        RelayClientStart(g_test_opts.impair.relay_delay_ms);
+        if (RelayConnect(protocol, relay_host, (uint16_t)relay_port,
+                         VIG8_TITLE_ID, xnaddr_bytes, "Player")) {
+            REXLOG_INFO("[NET] Connected to relay {}:{} ({})", relay_host, relay_port, relay_protocol);
+            fprintf(stderr, "[NET] Connected to relay %s:%d (%s)\n",
+                    relay_host, relay_port, relay_protocol);
         } else {
             REXLOG_ERROR("[NET] Failed to connect to relay {}:{}", relay_host, relay_port);
             fprintf(stderr, "[NET] FAILED to connect to relay %s:%d\n", relay_host, relay_port);
@@ -842,10 +2463,9 @@ void NetInit(int lan_port, bool relay_enabled, const char* relay_host, int relay
 }
 
 void NetShutdown() {
-    // Disconnect from relay
-    if (xlive::IsConnected()) {
-        xlive::Disconnect();
-    }
+    // Disconnect from relay once the worker is idle
+    RelayClientStop();
+    RelayDisconnect();
 
     // Stop discovery thread
     g_disc_running.store(false, std::memory_order_release);
@@ -853,6 +2473,15 @@ void NetShutdown() {
         g_disc_thread.join();
     }
 
+    // Send what the tunnel still holds, then stop receive reactor and timer
+    TunnelStop();
+    PunchStop();
+    ReactorStop();
+    NetTimerStop();
+    WriteNetStats();
+    NetCaptureClose();
+    NetReplayClose();
+
     // Close discovery socket
     if (g_disc_socket != (SOCKET)INVALID_SOCKET) {
         closesocket(g_disc_socket);
@@ -860,17 +2489,23 @@ void NetShutdown() {
     }
 
     // Clear state
-    {
-        std::unique_lock lock(g_peers_mutex);
-        g_peers.clear();
-    }
+    g_peers.Clear();
+    g_sessions.Clear();
+    NetTelemetryReset();
+    g_last_probe_heard_ms.store(-1, std::memory_order_relaxed);
     {
         std::lock_guard lock(g_qos_mutex);
         g_qos_listener.active = false;
     }
+    {
+        std::lock_guard<std::mutex> lk(g_session_mutex);
+        g_session_terms = {};
+    }
     {
         std::lock_guard lock(g_pending_mutex);
         g_pending_recvs.clear();
+        g_queued_rx.clear();
+        g_game_ports.clear();
     }
 
 #ifdef _WIN32
@@ -917,8 +2552,10 @@ extern "C" PPC_FUNC(__imp__NetDll_XNetXnAddrToInAddr) {
         std::memcpy(xnkid, base + xnkid_ptr, 8);
     }
 
-    // Add to peer table
+    // Add to peer table; a peer behind another NAT gets a direct path
+    // punched to it, which sends to `ina` then use transparently
     AddOrUpdatePeer(addr, xnkid);
+    PunchBegin(addr);
 
     // Write the IP to guest memory (raw 4 bytes, network byte order — no swap)
     std::memcpy(base + inaddr_ptr, &addr.ina, 4);
@@ -941,15 +2578,13 @@ extern "C" PPC_FUNC(__imp__NetDll_XNetInAddrToXnAddr) {
     uint32_t ip_net;
     std::memcpy(&ip_net, base + inaddr_ptr, 4);
 
-    std::shared_lock lock(g_peers_mutex);
-    auto* peer = FindPeerByIP(ip_net);
-
-    if (peer) {
+    PeerInfo peer;
+    if (g_peers.Find(ip_net, &peer)) {
         if (xnaddr_out) {
-            std::memcpy(base + xnaddr_out, &peer->xnaddr, sizeof(XNADDR_LAN));
+            std::memcpy(base + xnaddr_out, &peer.xnaddr, sizeof(XNADDR_LAN));
         }
         if (xnkid_out) {
-            std::memcpy(base + xnkid_out, peer->xnkid, 8);
+            std::memcpy(base + xnkid_out, peer.xnkid, 8);
         }
         ctx.r3.u64 = 0;
     } else {
@@ -983,18 +2618,12 @@ extern "C" PPC_FUNC(__imp__NetDll_XNetConnect) {
         uint32_t ip_net;
         std::memcpy(&ip_net, base + inaddr_ptr, 4);
 
-        std::unique_lock lock(g_peers_mutex);
-        auto* peer = FindPeerByIP(ip_net);
-        if (peer) {
-            peer->connected = true;
-        } else {
-            // Create peer entry for this IP
-            PeerEntry entry = {};
-            entry.xnaddr.ina = ip_net;
-            entry.xnaddr.inaOnline = ip_net;
-            entry.connected = true;
-            g_peers.push_back(entry);
-        }
+        // Creates the peer entry if this IP hasn't beaconed
+        if (g_peers.MarkConnected(ip_net, PeerClockMs())) NotePeerConnected(ip_net);
+
+        // Retries punching if an earlier attempt to this peer failed
+        PeerInfo peer;
+        if (g_peers.Find(ip_net, &peer)) PunchBegin(peer.xnaddr);
     }
 
     ctx.r3.u64 = 0;
@@ -1008,9 +2637,8 @@ extern "C" PPC_FUNC(__imp__NetDll_XNetGetConnectStatus) {
         uint32_t ip_net;
         std::memcpy(&ip_net, base + inaddr_ptr, 4);
 
-        std::shared_lock lock(g_peers_mutex);
-        auto* peer = FindPeerByIP(ip_net);
-        if (peer && peer->connected) {
+        PeerInfo peer;
+        if (g_peers.Find(ip_net, &peer) && peer.connected) {
             ctx.r3.u64 = XNET_CONNECT_STATUS_CONNECTED;
             return;
         }
@@ -1027,13 +2655,9 @@ extern "C" PPC_FUNC(__imp__NetDll_XNetUnregisterInAddr) {
         uint32_t ip_net;
         std::memcpy(&ip_net, base + inaddr_ptr, 4);
 
-        std::unique_lock lock(g_peers_mutex);
-        for (auto it = g_peers.begin(); it != g_peers.end(); ++it) {
-            if (it->xnaddr.ina == ip_net) {
-                g_peers.erase(it);
-                break;
-            }
-        }
+        g_peers.Remove(ip_net);
+        NetTelemetryForget(ip_net);
+        PunchForget(ip_net);
     }
 
     ctx.r3.u64 = 0;
@@ -1094,24 +2718,30 @@ extern "C" PPC_FUNC(__imp__NetDll_XNetQosListen) {
 // XNetQosLookup (internal: __imp__NetDll_XNetQosLookup)
 //
 // Called via wrapper sub_821B3FD0 which prepends r3=1 and reshuffles args.
-// At call time:
+// At call time (XNetQosLookup's own arguments shifted by one register):
 //   r3=1 (module), r4=cxna, r5=apxna, r6=apxnkid, r7=apxnkey
-//   r8=cina, r9=aina, r10=adwBitsPerSec
-//   sp+84=cProbes, sp+92=dwTimeout, sp+100=?, sp+108=pXoverlapped
+//   r8=cina, r9=aina, r10=adwServiceId
+//   sp+84=cProbes, sp+92=dwBitsPerSec, sp+100=dwFlags, sp+108=hEvent
 //   sp+116=ppxnqos  ← game stores r27=r31+104 here (address of XNQOS* field)
 //
 // The game expects us to write an XNQOS* into *(ppxnqos). On the next
 // iteration the game checks *(ppxnqos) != 0 && cxnqosPending == 0
-// and then calls the completion callback.  We skip the UDP probe entirely
-// and return fake-but-valid QoS data immediately.
+// and then calls the completion callback. We return with every entry
+// pending, probe the targets over the discovery socket (see "QoS probing")
+// and publish the measurements from the timer thread.
 extern "C" PPC_FUNC(__imp__NetDll_XNetQosLookup) {
     g_base = base;  // store for use by the deferred-completion thread
 
     uint32_t cxna    = ctx.r4.u32;
+    uint32_t apxna   = ctx.r5.u32;
+    uint32_t apxnkid = ctx.r6.u32;
+    uint32_t cprobes = PPC_LOAD_U32(ctx.r1.u32 + 84);
+    // sp+92 = dwBitsPerSec, sp+100 = dwFlags, sp+108 = hEvent (unused)
     // sp+116 = ppxnqos (address of the XNQOS* field in the session struct)
     uint32_t ppxnqos = PPC_LOAD_U32(ctx.r1.u32 + 116);
 
-    fprintf(stderr, "[NET] XNetQosLookup: cxna=%u ppxnqos=0x%08X\n", cxna, ppxnqos);
+    fprintf(stderr, "[NET] XNetQosLookup: cxna=%u probes=%u ppxnqos=0x%08X\n",
+            cxna, cprobes, ppxnqos);
     fflush(stderr);
     REXLOG_INFO("[NET] XNetQosLookup: cxna={}, ppxnqos=0x{:08X}", cxna, ppxnqos);
 
@@ -1120,12 +2750,14 @@ extern "C" PPC_FUNC(__imp__NetDll_XNetQosLookup) {
         ctx.r3.u64 = 0;
         return;
     }
+    if (cxna > QOS_MAX_TARGETS) cxna = QOS_MAX_TARGETS;
 
     auto* mem = rex::kernel::kernel_state()->memory();
 
     // Free any previous XNQOS allocation at this slot.
     uint32_t prev = PPC_LOAD_U32(ppxnqos);
     if (prev) {
+        CancelQosLookup(prev);
         mem->SystemHeapFree(prev);
         PPC_STORE_U32(ppxnqos, 0);
     }
@@ -1145,7 +2777,10 @@ extern "C" PPC_FUNC(__imp__NetDll_XNetQosLookup) {
     //     +14 uint16_t wRttMinimum
     //     +16 uint32_t dwUpBitsPerSec
     //     +20 uint32_t dwDnBitsPerSec
-    uint32_t alloc_size = 8 + cxna * 24;
+    // followed by DISC_MAX_QOS bytes per entry for the pbData blobs, so a
+    // single XNetQosRelease frees everything.
+    uint32_t data_offset = 8 + cxna * 24;
+    uint32_t alloc_size = data_offset + cxna * DISC_MAX_QOS;
     uint32_t qos_addr = mem->SystemHeapAlloc(alloc_size, 0x10);
     if (!qos_addr) {
         REXLOG_ERROR("[NET] XNetQosLookup: alloc failed ({} bytes)", alloc_size);
@@ -1155,41 +2790,67 @@ extern "C" PPC_FUNC(__imp__NetDll_XNetQosLookup) {
     std::memset(base + qos_addr, 0, alloc_size);
 
     // Header: cxnqos = cxna, cxnqosPending = cxna (NOT 0 yet).
-    // The discovery thread will set cxnqosPending = 0 after a short delay,
-    // giving the game time to fully initialise the session struct (including
-    // the completion-callback object at session_struct+8) before we trigger
-    // the callback path through sub_8218A068.
+    // FinishQosLookup sets cxnqosPending = 0 no sooner than
+    // QOS_COMPLETE_MIN, giving the game time to fully initialise the
+    // session struct (including the completion-callback object at
+    // session_struct+8) before we trigger the callback path through
+    // sub_8218A068.
     PPC_STORE_U32(qos_addr + 0, cxna);   // cxnqos
     PPC_STORE_U32(qos_addr + 4, cxna);   // cxnqosPending = cxna (pending)
 
-    // Fill each entry with good fake stats.
-    // bFlags: XNET_XNQOSINFO_COMPLETE(0x01) | XNET_XNQOSINFO_TARGET_CONTACTED(0x02)
-    for (uint32_t i = 0; i < cxna; i++) {
-        uint32_t e = qos_addr + 8 + i * 24;
-        PPC_STORE_U8 (e +  0, 0x03);      // bFlags
-        PPC_STORE_U8 (e +  1, 0);         // bReserved
-        PPC_STORE_U16(e +  2, 4);         // cProbesXmit
-        PPC_STORE_U16(e +  4, 4);         // cProbesRecv
-        PPC_STORE_U16(e +  6, 0);         // cbData (no QoS blob)
-        PPC_STORE_U32(e +  8, 0);         // pbData = NULL
-        PPC_STORE_U16(e + 12, 30);        // wRttMedian  (30 ms)
-        PPC_STORE_U16(e + 14, 20);        // wRttMinimum (20 ms)
-        PPC_STORE_U32(e + 16, 10000000);  // dwUpBitsPerSec (10 Mbps)
-        PPC_STORE_U32(e + 20, 10000000);  // dwDnBitsPerSec (10 Mbps)
+    QosLookup lk;
+    lk.qos_addr = qos_addr;
+    lk.data_addr = qos_addr + data_offset;
+    lk.probes = cprobes ? (int)std::min<uint32_t>(cprobes, QOS_MAX_PROBES) : QOS_DEFAULT_PROBES;
+    auto now = NetClock::now();
+    lk.deadline = now + QOS_PROBE_BUDGET;
+
+    int to_probe = 0;
+    lk.targets.resize(cxna);
+    {
+        std::lock_guard lock(g_qos_lookup_mutex);
+        for (uint32_t i = 0; i < cxna; i++) {
+            QosTarget& t = lk.targets[i];
+            t = {};
+            uint32_t xna_ptr = apxna ? PPC_LOAD_U32(apxna + i * 4) : 0;
+            uint32_t kid_ptr = apxnkid ? PPC_LOAD_U32(apxnkid + i * 4) : 0;
+            if (xna_ptr) std::memcpy(&t.ip_net, base + xna_ptr, 4);  // XNADDR.ina
+            if (kid_ptr) std::memcpy(t.xnkid, base + kid_ptr, 8);
+
+            auto cached = g_qos_cache.find(t.ip_net);
+            if (cached != g_qos_cache.end() && now - cached->second.measured_at < QOS_CACHE_TTL) {
+                t.cached = true;
+                t.cached_result = cached->second.result;
+            } else if (t.ip_net == 0) {
+                t.cached = true;  // nothing to probe; reports as unreachable
+            } else if (BeaconQosResult(t.ip_net, now, &t.cached_result)) {
+                t.cached = t.from_beacon = true;
+            } else {
+                to_probe++;
+            }
+        }
+    }
+
+    int probes = lk.probes;
+    uint16_t id;
+    {
+        std::lock_guard lock(g_qos_lookup_mutex);
+        do { id = g_qos_next_id++; } while (id == 0 || g_qos_lookups.count(id));
+        g_qos_lookups.emplace(id, std::move(lk));
     }
 
     // Write XNQOS pointer into *ppxnqos (= session_struct+104).
     PPC_STORE_U32(ppxnqos, qos_addr);
 
-    // Schedule deferred completion: set cxnqosPending = 0 after 300 ms.
-    {
-        std::lock_guard<std::mutex> lock(g_pending_qos_mutex);
-        g_pending_qos.push_back({qos_addr,
-            std::chrono::steady_clock::now() + std::chrono::milliseconds(300)});
+    if (to_probe > 0) {
+        for (int pair = 0; pair < probes; pair++) {
+            NetTimerRunAfter(QOS_PAIR_INTERVAL * pair, [id, pair]() { SendQosPairs(id, pair); });
+        }
     }
+    NetTimerRunAfter(QOS_COMPLETE_MIN, [id]() { FinishQosLookup(id); });
 
-    fprintf(stderr, "[NET] XNetQosLookup: XNQOS@0x%08X pending (cxna=%u), completing in 300ms\n",
-            qos_addr, cxna);
+    fprintf(stderr, "[NET] XNetQosLookup: XNQOS@0x%08X pending (cxna=%u, probing %d x %d pairs)\n",
+            qos_addr, cxna, to_probe, probes);
     fflush(stderr);
     REXLOG_INFO("[NET] XNetQosLookup: XNQOS@0x{:08X} pending -> *ppxnqos(0x{:08X})", qos_addr, ppxnqos);
 
@@ -1201,6 +2862,7 @@ extern "C" PPC_FUNC(__imp__NetDll_XNetQosRelease) {
     uint32_t qos_ptr = ctx.r4.u32;
 
     if (qos_ptr) {
+        CancelQosLookup(qos_ptr);
         auto* mem = rex::kernel::kernel_state()->memory();
         mem->SystemHeapFree(qos_ptr);
     }
@@ -1245,182 +2907,243 @@ extern "C" PPC_FUNC(__imp__NetDll_WSARecvFrom) {
         return;
     }
 
+    // The reactor runs on a raw std::thread where kernel_state() is null,
+    // so it uses the pointers captured here.
+    g_base = base;
+    g_kernel_state = ks;
+
     SOCKET native = (SOCKET)socket_obj->native_handle();
+    SetNonBlocking(native);
+
+    PendingRecv pr = {};
+    pr.socket_handle = socket_handle;
+    pr.native = native;
+    pr.buf_guest = buf_guest;
+    pr.buf_len = buf_len;
+    pr.bytes_ptr = bytes_ptr;
+    pr.flags_ptr = flags_ptr;
+    pr.from_ptr = from_ptr;
+    pr.fromlen_ptr = fromlen_ptr;
+    pr.event_handle = overlapped ? PPC_LOAD_U32(overlapped + 16) : 0;
+
+    // Try non-blocking receive straight into the guest buffer. Hold the
+    // pending lock so a datagram can't be taken here ahead of an older
+    // receive the reactor is about to complete on the same socket.
+    std::unique_lock lock(g_pending_mutex);
+    std::vector<uint32_t> cancelled;
+    PurgeOrphanedRecvs(base, &cancelled);
+    bool older_pending = false;
+    for (auto& [ov, other] : g_pending_recvs) {
+        if (other.native == native) { older_pending = true; break; }
+    }
 
-    // Try non-blocking receive
+    int n = -1;
     struct sockaddr_in from_addr = {};
-    int from_len = sizeof(from_addr);
-    uint8_t temp_buf[65536];
-    uint32_t recv_len = (buf_len < sizeof(temp_buf)) ? buf_len : sizeof(temp_buf);
-
-    // Set non-blocking for this attempt
-#ifdef _WIN32
-    u_long nonblock = 1;
-    ioctlsocket(native, FIONBIO, &nonblock);
-#else
-    int flags_val = fcntl(native, F_GETFL, 0);
-    fcntl(native, F_SETFL, flags_val | O_NONBLOCK);
-#endif
-
-    int n = recvfrom(native, (char*)temp_buf, recv_len, 0,
-                     (struct sockaddr*)&from_addr, &from_len);
+    if (!older_pending && NetReplayActive()) {
+        n = ReplayRecvInto(base, pr, &from_addr);
+    } else if (!older_pending) {
+        n = RecvGameDatagram(base, pr, &from_addr);
+    }
 
-    if (n > 0) {
-        // Data received — copy to guest buffer
-        if (buf_guest && (uint32_t)n <= buf_len) {
-            std::memcpy(base + buf_guest, temp_buf, n);
-        }
-        if (bytes_ptr) {
-            PPC_STORE_U32(bytes_ptr, (uint32_t)n);
-        }
-        if (flags_ptr) {
-            PPC_STORE_U32(flags_ptr, 0);
-        }
-        // Write source address to guest
-        if (from_ptr) {
-            // sockaddr_in layout for Xbox (big-endian):
-            // +0 uint16_t sin_family, +2 uint16_t sin_port,
-            // +4 uint32_t sin_addr, +8 zero[8]
-            PPC_STORE_U16(from_ptr + 0, AF_INET);
-            // Port and addr are already in network byte order
-            std::memcpy(base + from_ptr + 2, &from_addr.sin_port, 2);
-            std::memcpy(base + from_ptr + 4, &from_addr.sin_addr, 4);
-            std::memset(base + from_ptr + 8, 0, 8);
-        }
-        if (fromlen_ptr) {
-            PPC_STORE_U32(fromlen_ptr, 16);
-        }
-        // Mark overlapped as complete if present
-        if (overlapped) {
-            // XOVERLAPPED: +0 InternalLow, +4 InternalHigh, +8 Offset, +12 OffsetHigh,
-            //              +16 hEvent, +20 extended
-            PPC_STORE_U32(overlapped + 0, 0); // status = complete
-            PPC_STORE_U32(overlapped + 4, (uint32_t)n); // bytes transferred
+    if (n >= 0 || n == RECV_MSGSIZE) {
+        lock.unlock();
+        for (uint32_t ev : cancelled) SignalGuestEvent(ev);
+        PublishRecvCompletion(base, overlapped, pr, n, from_addr);
+        SignalGuestEvent(pr.event_handle);
+        if (n == RECV_MSGSIZE) {
+            SetMsgSizeError();
+            ctx.r3.u64 = (uint32_t)-1; // SOCKET_ERROR, WSAEMSGSIZE
+            return;
         }
         ctx.r3.u64 = 0; // success
-    } else {
-        // No data yet — store as pending operation
-        if (overlapped) {
-            std::lock_guard lock(g_pending_mutex);
-            PendingRecv pr;
-            pr.socket_handle = socket_handle;
-            pr.buf_guest = buf_guest;
-            pr.buf_len = buf_len;
-            pr.bytes_ptr = bytes_ptr;
-            pr.flags_ptr = flags_ptr;
-            pr.from_ptr = from_ptr;
-            pr.fromlen_ptr = fromlen_ptr;
-            g_pending_recvs[overlapped] = pr;
-
-            // Mark overlapped as pending
-            PPC_STORE_U32(overlapped + 0, 0x00000103); // STATUS_PENDING
-        }
+        return;
+    }
 
-        // Return -1 with WSA_IO_PENDING
-        ctx.r3.u64 = (uint32_t)-1;
-        // The game should check WSAGetLastError which will return IO_PENDING
+    // No data yet — park it for the reactor
+    if (overlapped) {
+        // Mark overlapped as pending before the reactor can see it
+        PPC_STORE_U32(overlapped + 0, OV_STATUS_PENDING);
+        pr.seq = g_pending_seq++;
+        g_pending_recvs[overlapped] = pr;
+        lock.unlock();
+        ReactorWake();
+    } else {
+        lock.unlock();
     }
+    for (uint32_t ev : cancelled) SignalGuestEvent(ev);
+
+    // Return -1 with WSA_IO_PENDING
+    ctx.r3.u64 = (uint32_t)-1;
+    // The game should check WSAGetLastError which will return IO_PENDING
 }
 
 // WSAGetOverlappedResult(r4=socket, r5=overlapped, r6=bytes_ptr,
 //                        r7=wait, r8=flags_ptr)
+//
+// Completion is published into the WSAOVERLAPPED by the reactor, so this
+// is a pure guest-memory check — no lock, no syscall.
 extern "C" PPC_FUNC(__imp__NetDll_WSAGetOverlappedResult) {
-    uint32_t socket_handle = ctx.r4.u32;
     uint32_t overlapped    = ctx.r5.u32;
     uint32_t bytes_ptr     = ctx.r6.u32;
-    // r7=wait (ignored — we poll)
+    // r7=wait (ignored — the game polls; hEvent is signalled on completion)
     uint32_t flags_ptr     = ctx.r8.u32;
 
-    (void)socket_handle;
-
-    std::lock_guard lock(g_pending_mutex);
-    auto it = g_pending_recvs.find(overlapped);
-    if (it == g_pending_recvs.end()) {
-        // Check if the overlapped was already completed (InternalLow == 0)
-        if (overlapped) {
-            uint32_t status = PPC_LOAD_U32(overlapped + 0);
-            if (status == 0) {
-                // Already complete
-                uint32_t transferred = PPC_LOAD_U32(overlapped + 4);
-                if (bytes_ptr) PPC_STORE_U32(bytes_ptr, transferred);
-                if (flags_ptr) PPC_STORE_U32(flags_ptr, 0);
-                ctx.r3.u64 = 1; // TRUE
-                return;
-            }
-        }
-        // No pending operation found
+    if (!overlapped) {
         ctx.r3.u64 = 0; // FALSE
         return;
     }
 
-    auto& pr = it->second;
+    uint32_t status = PPC_LOAD_U32(overlapped + 0);
+    if (status == OV_STATUS_MSGSIZE) {
+        // Completed with a truncated datagram: report its bytes and fail
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (bytes_ptr) PPC_STORE_U32(bytes_ptr, PPC_LOAD_U32(overlapped + 4));
+        if (flags_ptr) PPC_STORE_U32(flags_ptr, 0);
+        RecordRecvVisible(overlapped);
+        SetMsgSizeError();
+        ctx.r3.u64 = 0; // FALSE, WSAEMSGSIZE
+        return;
+    }
+    if (status != 0) {
+        // Still pending (0x103) or failed
+        ctx.r3.u64 = 0; // FALSE = incomplete
+        return;
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint32_t transferred = PPC_LOAD_U32(overlapped + 4);
+    if (bytes_ptr) PPC_STORE_U32(bytes_ptr, transferred);
+    if (flags_ptr) PPC_STORE_U32(flags_ptr, 0);
+    RecordRecvVisible(overlapped);
+    ctx.r3.u64 = 1; // TRUE = success
+}
+
+// ============================================================================
+// Send / bind overrides
+// ============================================================================
+//
+// WSASendTo goes through NetSendTo so game traffic is counted per peer and
+// can be impaired for testing. With the tunnel on, unicast datagrams are
+// queued and leave batched and compressed at the end of the frame. bind substitutes the configured
+// bind_address for INADDR_ANY so several instances can share one machine.
+
+// Read a guest sockaddr_in (big-endian family; port/addr already in
+// network byte order).
+static bool ReadGuestSockaddr(uint8_t* base, uint32_t addr, uint32_t len,
+                              struct sockaddr_in* out) {
+    if (!addr || len < 8) return false;
+    *out = {};
+    out->sin_family = AF_INET;
+    uint16_t family = (uint16_t)((base[addr] << 8) | base[addr + 1]);
+    std::memcpy(&out->sin_port, base + addr + 2, 2);
+    std::memcpy(&out->sin_addr, base + addr + 4, 4);
+    return family == AF_INET;
+}
+
+// WSASendTo(r4=socket, r5=bufs, r6=buf_count, r7=bytes_sent_ptr,
+//           r8=flags, r9=to, r10=tolen, stack+84=overlapped)
+extern "C" PPC_FUNC(__imp__NetDll_WSASendTo) {
+    uint32_t socket_handle = ctx.r4.u32;
+    uint32_t bufs_ptr      = ctx.r5.u32;
+    uint32_t buf_count     = ctx.r6.u32;
+    uint32_t bytes_ptr     = ctx.r7.u32;
+    uint32_t to_ptr        = ctx.r9.u32;
+    uint32_t tolen         = ctx.r10.u32;
+    uint32_t overlapped    = PPC_LOAD_U32(ctx.r1.u32 + 84);
 
-    // Try to receive data now
     auto* ks = rex::kernel::kernel_state();
     auto socket_obj = ks->object_table()->LookupObject<rex::kernel::XSocket>(
-        pr.socket_handle);
+        socket_handle);
     if (!socket_obj) {
-        g_pending_recvs.erase(it);
-        ctx.r3.u64 = 0;
+        ctx.r3.u64 = (uint32_t)-1; // SOCKET_ERROR
         return;
     }
-
+    g_kernel_state = ks;
     SOCKET native = (SOCKET)socket_obj->native_handle();
 
-    struct sockaddr_in from_addr = {};
-    int from_len = sizeof(from_addr);
-    uint8_t temp_buf[65536];
-    uint32_t recv_len = (pr.buf_len < sizeof(temp_buf)) ? pr.buf_len
-                                                        : sizeof(temp_buf);
-
-#ifdef _WIN32
-    u_long nonblock = 1;
-    ioctlsocket(native, FIONBIO, &nonblock);
-#else
-    int flags_val = fcntl(native, F_GETFL, 0);
-    fcntl(native, F_SETFL, flags_val | O_NONBLOCK);
-#endif
-
-    int n = recvfrom(native, (char*)temp_buf, recv_len, 0,
-                     (struct sockaddr*)&from_addr, &from_len);
+    // Gather WSABUFs (+0 len, +4 buf_ptr) into one datagram
+    uint8_t data[65536];
+    int total = 0;
+    for (uint32_t i = 0; i < buf_count && bufs_ptr; i++) {
+        uint32_t len = PPC_LOAD_U32(bufs_ptr + i * 8 + 0);
+        uint32_t ptr = PPC_LOAD_U32(bufs_ptr + i * 8 + 4);
+        if (!ptr || total + (int)len > (int)sizeof(data)) break;
+        std::memcpy(data + total, base + ptr, len);
+        total += (int)len;
+    }
 
-    if (n > 0) {
-        // Copy to guest buffers
-        if (pr.buf_guest && (uint32_t)n <= pr.buf_len) {
-            std::memcpy(base + pr.buf_guest, temp_buf, n);
-        }
-        if (pr.bytes_ptr) {
-            PPC_STORE_U32(pr.bytes_ptr, (uint32_t)n);
-        }
-        if (pr.flags_ptr) {
-            PPC_STORE_U32(pr.flags_ptr, 0);
-        }
-        if (pr.from_ptr) {
-            PPC_STORE_U16(pr.from_ptr + 0, AF_INET);
-            std::memcpy(base + pr.from_ptr + 2, &from_addr.sin_port, 2);
-            std::memcpy(base + pr.from_ptr + 4, &from_addr.sin_addr, 4);
-            std::memset(base + pr.from_ptr + 8, 0, 8);
+    int n;
+    struct sockaddr_in dest;
+    if (ReadGuestSockaddr(base, to_ptr, tolen, &dest)) {
+        if (dest.sin_addr.s_addr != INADDR_BROADCAST &&
+            TunnelEnqueue(native, dest, data, total)) {
+            // Sent with the frame's other datagrams at the end of the frame
+            if (NetCaptureActive()) {
+                NetCaptureRecord(NetCapDir::Out, NetCapKind::Game, g_local_ip_net,
+                                 SocketLocalPort(native), dest.sin_addr.s_addr,
+                                 dest.sin_port, data, (size_t)total);
+            }
+            n = total;
+        } else {
+            n = NetSendTo(native, data, total, dest);
         }
-        if (pr.fromlen_ptr) {
-            PPC_STORE_U32(pr.fromlen_ptr, 16);
+        // Broadcasts don't cross 127.0.0.x; fan them out to the known peers.
+        if (dest.sin_addr.s_addr == INADDR_BROADCAST) {
+            for (auto& peer : g_disc_peers) {
+                struct sockaddr_in copy = peer;
+                copy.sin_port = dest.sin_port;
+                NetSendTo(native, data, total, copy);
+            }
         }
+    } else {
+        // Connected socket
+        n = send(native, (const char*)data, total, 0);
+    }
 
-        // Mark overlapped complete
-        if (overlapped) {
-            PPC_STORE_U32(overlapped + 0, 0); // complete
-            PPC_STORE_U32(overlapped + 4, (uint32_t)n);
-        }
+    if (n < 0) {
+        ctx.r3.u64 = (uint32_t)-1; // SOCKET_ERROR
+        return;
+    }
+    if (bytes_ptr) PPC_STORE_U32(bytes_ptr, (uint32_t)n);
+    if (overlapped) {
+        PPC_STORE_U32(overlapped + 4, (uint32_t)n);
+        PPC_STORE_U32(overlapped + 0, 0);
+        SignalGuestEvent(PPC_LOAD_U32(overlapped + 16));
+    }
+    ctx.r3.u64 = 0;
+}
 
-        // Write to output params
-        if (bytes_ptr) PPC_STORE_U32(bytes_ptr, (uint32_t)n);
-        if (flags_ptr) PPC_STORE_U32(flags_ptr, 0);
+// bind(r4=socket, r5=name, r6=namelen)
+extern "C" PPC_FUNC(__imp__NetDll_bind) {
+    uint32_t socket_handle = ctx.r4.u32;
+    uint32_t name_ptr      = ctx.r5.u32;
+    uint32_t name_len      = ctx.r6.u32;
+
+    auto socket_obj = rex::kernel::kernel_state()->object_table()
+        ->LookupObject<rex::kernel::XSocket>(socket_handle);
+    struct sockaddr_in addr;
+    if (!socket_obj || !ReadGuestSockaddr(base, name_ptr, name_len, &addr)) {
+        ctx.r3.u64 = (uint32_t)-1; // SOCKET_ERROR
+        return;
+    }
+    if (addr.sin_addr.s_addr == INADDR_ANY) {
+        addr.sin_addr.s_addr = g_bind_ip_net;
+    }
 
-        g_pending_recvs.erase(it);
-        ctx.r3.u64 = 1; // TRUE = success
+    SOCKET native = (SOCKET)socket_obj->native_handle();
+    int ret = bind(native, (const struct sockaddr*)&addr, sizeof(addr));
+    if (ret < 0) {
+        REXLOG_WARN("[NET] bind to port {} failed", ntohs(addr.sin_port));
     } else {
-        // Still no data
-        ctx.r3.u64 = 0; // FALSE = incomplete
+        // Where direct-path datagrams for this port are delivered
+        // The fd may be a closed socket's number reused: drop whatever was
+        // queued for, or routed to, the old one.
+        std::lock_guard lock(g_pending_mutex);
+        std::erase_if(g_game_ports, [&](const auto& e) { return e.second == native; });
+        g_queued_rx.erase(native);
+        g_game_ports[SocketLocalPort(native)] = native;
     }
+    ctx.r3.u64 = (uint64_t)(uint32_t)ret;
 }
 
 // ============================================================================
@@ -1457,3 +3180,23 @@ extern "C" PPC_FUNC(sub_8218A068) {
     }
     __imp__sub_8218A068(ctx, base);
 }
+
+// ============================================================================
+// Per-frame work
+// ============================================================================
+//
+// Subscribed to the present hook (present_hook.h) ahead of every present:
+// sends the frame's tunnel batches, samples peer telemetry for the
+// overlay, runs due guest-thread net completions, and during a replay
+// delivers the recorded traffic due by the new frame.
+
+static void NetOnPresent(uint8_t* base) {
+    TunnelFlush();
+    NetTelemetrySample(SteadyNowNs());
+    NetDrainGuest();
+    if (NetReplayActive()) {
+        g_base = base;
+        g_kernel_state = rex::kernel::kernel_state();
+        ReplayDeliver(base);
+    }
+}
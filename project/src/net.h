@@ -5,19 +5,50 @@
 #pragma once
 
 #include <cstdint>
+#include <string>
+#include <vector>
 
 // Initialize LAN networking: detect local IP, start discovery thread.
-// Optionally connects to an xlive relay server for internet session discovery.
+// Optionally connects to a relay server for internet session discovery,
+// speaking `relay_protocol` ("xlive" or "relay_server", relay_link.h).
 // Call after runtime initialization.
 void NetInit(int lan_port,
              bool relay_enabled = false,
              const char* relay_host = "localhost",
-             int relay_port = 36000);
+             int relay_port = 36000,
+             const char* relay_protocol = "xlive");
 
 // Stop discovery thread, disconnect from relay, and clean up sockets.
 // Call before runtime shutdown.
 void NetShutdown();
 
+// Test impairment applied to every datagram we send (game traffic through
+// WSASendTo plus discovery/QoS). All zero = pass-through.
+struct NetImpairment {
+    int    latency_ms     = 0;
+    int    jitter_ms      = 0;    // uniform +/- around latency_ms
+    double loss_pct       = 0.0;
+    double reorder_pct    = 0.0;  // held back long enough to be overtaken
+    int    bandwidth_kbps = 0;    // egress cap, 0 = unlimited
+    uint32_t seed         = 1;
+    int    relay_delay_ms = 0;    // added before every relay call (slow-relay stand-in)
+};
+
+// Options for running several instances on one machine (loopback
+// system-link testing). Call before NetInit.
+struct NetTestOptions {
+    std::string              bind_address;     // local IP for all sockets, "" = auto
+    std::vector<std::string> discovery_peers;  // "ip[:port]" unicast beacon/probe targets
+    bool                     tunnel = false;   // batch + compress game datagrams (net_tunnel.h)
+    std::string              stun_server;      // "ip[:port]" to learn our public endpoint, "" = off
+    NetImpairment            impair;
+    std::string              stats_path;       // rewritten every second, "" = off
+    std::string              metrics_path;     // Prometheus text, rewritten every second
+    std::string              capture_path;     // pcapng of all guest traffic, "" = off
+    std::string              replay_path;      // feed a capture back in place of sockets
+};
+void NetSetTestOptions(const NetTestOptions& options);
+
 // ============================================================================
 // XNADDR layout (36 bytes, matches Xbox 360 structure)
 // ============================================================================
@@ -27,7 +58,8 @@ struct XNADDR_LAN {
     uint32_t inaOnline;     // +4   IPv4 address (network byte order)
     uint16_t wPortOnline;   // +8   port (network byte order)
     uint8_t  abEnet[6];    // +10  MAC address
-    uint8_t  abOnline[20]; // +16  online address (zeroed for LAN)
+    uint8_t  abOnline[20]; // +16  online address (zeroed for LAN; the first 8
+                           //      bytes carry the punch key, net_punch.h)
 };
 static_assert(sizeof(XNADDR_LAN) == 36, "XNADDR_LAN must be 36 bytes");
 #pragma pack(pop)
@@ -38,9 +70,71 @@ static_assert(sizeof(XNADDR_LAN) == 36, "XNADDR_LAN must be 36 bytes");
 constexpr uint8_t  DISC_MAGIC      = 0xD8;
 constexpr uint8_t  DISC_BEACON     = 0x01;
 constexpr uint8_t  DISC_PROBE      = 0x02;
+constexpr uint8_t  DISC_QOS_PROBE  = 0x03;
+constexpr uint8_t  DISC_QOS_REPLY  = 0x04;
+constexpr uint8_t  DISC_PUNCH      = 0x05;  // direct-path probe (net_punch.h)
+constexpr uint8_t  DISC_PUNCH_ACK  = 0x06;
+constexpr uint8_t  DISC_DIRECT     = 0x07;  // game datagram over a direct path
 constexpr int      DISC_HEADER_LEN = 46;  // magic(1) + type(1) + xnkid(8) + xnaddr(36)
 constexpr int      DISC_MAX_QOS    = 512; // max QoS data blob size
 
+// Beacon (after the common header):
+//   [46] data_len   uint16 BE  (QoS listener data blob)
+//   [48] data
+// v2 appends a trailer after the blob. v1 receivers read only up to the
+// end of the blob, so they accept v2 beacons unchanged.
+//   +0  version     uint8      (DISC_BEACON_V2; later versions extend)
+//   +1  open_public, open_private, filled_public, filled_private  uint8
+//   +5  reserved
+//   +6  interval_ms uint16 BE  (since the sender's previous periodic
+//                               beacon; 0 = first, or a probe reply)
+//   +8  sent        uint64 BE  (sender's clock, ns)
+//   +16 echo        uint64 BE  (the probe's timestamp this answers, else 0)
+// v3 appends the host's matchmaking terms (session_cache.h) after that, up
+// to DISC_BEACON_MAX_TERMS of each; v2 receivers stop at the trailer.
+//   +24 num_contexts, num_properties  uint8
+//   +26 contexts    id uint32 BE, value uint32 BE
+//       properties  id uint32 BE, type uint8 (XUSER_DATA_TYPE_INT32/INT64),
+//                   value uint64 BE
+// Probe: the common header (xnkid = the session sought, or zero), then in
+// v2 [46] version, [47] reserved, [48] timestamp uint64 BE (prober's
+// clock, ns; echoed in the beacon that answers).
+constexpr uint8_t  DISC_BEACON_V2            = 2;
+constexpr uint8_t  DISC_BEACON_V3            = 3;
+constexpr int      DISC_BEACON_TRAILER_LEN   = 24;
+constexpr int      DISC_BEACON_MAX_TERMS     = 16;
+constexpr int      DISC_BEACON_TERMS_MAX_LEN = 2 + DISC_BEACON_MAX_TERMS * (8 + 13);
+constexpr int      DISC_PROBE_V2_LEN         = 56;
+
+// QoS probe/reply (after the common header):
+//   [46] token      uint32 BE  (prober's lookup/target/pair id, echoed)
+//   [50] flags      uint8      (DISC_QOS_PAIR_*)
+//   [51] reserved
+//   [52] timestamp  uint64 BE  (prober's clock, echoed)
+//   [60] gap_us     uint32 BE  (reply to PAIR_SECOND: arrival gap at responder)
+//   [64] data_len   uint16 BE  (reply only: listener's QoS data blob)
+//   [66] data
+// Pair packets are padded to DISC_QOS_PAIR_LEN so their spacing on the
+// wire reflects link bandwidth.
+constexpr int      DISC_QOS_LEN         = 66;
+constexpr int      DISC_QOS_PAIR_LEN    = 1024;
+constexpr uint8_t  DISC_QOS_PAIR_FIRST  = 0x01;
+constexpr uint8_t  DISC_QOS_PAIR_SECOND = 0x02;
+
+// Punch probe/ack (after the common header):
+//   [46] nonce      uint32 BE  (prober's microsecond clock, echoed)
+//   [50] target     uint32     (ina the probe is meant for, network order)
+//   [54] key        8 bytes    (the receiver's punch key, from its XNADDR)
+constexpr int      DISC_PUNCH_LEN       = 62;
+
+// Direct-path game datagram (no common header):
+//   [0]  magic, DISC_DIRECT
+//   [2]  dst_port   uint16     (receiver's game socket, network order)
+//   [4]  src_port   uint16     (sender's game socket, network order)
+//   [6]  sender     uint32     (sender's ina, network order)
+//   [10] datagram
+constexpr int      DISC_DIRECT_HEADER_LEN = 10;
+
 // ============================================================================
 // XNet status constants
 // ============================================================================
@@ -51,3 +145,8 @@ constexpr uint32_t XNET_CONNECT_STATUS_CONNECTED   = 4;
 constexpr uint32_t XNET_ETHERNET_LINK_ACTIVE       = 0x01;
 constexpr uint32_t XNET_ETHERNET_LINK_100MBPS      = 0x04;
 constexpr uint32_t XNET_ETHERNET_LINK_FULL_DUPLEX  = 0x08;
+
+// XNQOSINFO.bFlags
+constexpr uint8_t  XNET_XNQOSINFO_COMPLETE         = 0x01;
+constexpr uint8_t  XNET_XNQOSINFO_TARGET_CONTACTED = 0x02;
+constexpr uint8_t  XNET_XNQOSINFO_DATA_RECEIVED    = 0x08;
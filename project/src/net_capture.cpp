@@ -0,0 +1,414 @@
+// vig8 - Network capture and replay
+// See net_capture.h for the file layout.
+
+#include "net_capture.h"
+#include "present_hook.h"
+
+#include <rex/logging.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+
+// ============================================================================
+// pcapng constants
+// ============================================================================
+
+static constexpr uint32_t PCAPNG_SHB        = 0x0A0D0D0A;
+static constexpr uint32_t PCAPNG_IDB        = 0x00000001;
+static constexpr uint32_t PCAPNG_EPB        = 0x00000006;
+static constexpr uint32_t PCAPNG_BYTE_ORDER = 0x1A2B3C4D;
+
+static constexpr uint16_t LINKTYPE_IPV4  = 228;
+static constexpr uint16_t LINKTYPE_USER0 = 147;
+
+static constexpr uint16_t OPT_ENDOFOPT   = 0;
+static constexpr uint16_t OPT_COMMENT    = 1;
+static constexpr uint16_t SHB_USERAPPL   = 4;
+static constexpr uint16_t IF_NAME        = 2;
+static constexpr uint16_t IF_IPV4ADDR    = 4;
+static constexpr uint16_t IF_TSRESOL     = 9;
+static constexpr uint16_t EPB_FLAGS      = 2;
+
+static constexpr uint32_t EPB_FLAG_INBOUND  = 1;
+static constexpr uint32_t EPB_FLAG_OUTBOUND = 2;
+
+static constexpr uint32_t IF_DATAGRAM = 0;
+static constexpr uint32_t IF_XGI      = 1;
+
+static constexpr size_t IPV4_HEADER_LEN = 20;
+static constexpr size_t UDP_HEADER_LEN  = 8;
+
+// Flush the capture every this many frames so a crash loses little.
+static constexpr uint64_t CAPTURE_FLUSH_FRAMES = 60;
+
+static const char* KindName(NetCapKind kind) {
+    switch (kind) {
+    case NetCapKind::Game:      return "game";
+    case NetCapKind::Discovery: return "disc";
+    case NetCapKind::XgiCreate: return "xgi-create";
+    case NetCapKind::XgiSearch: return "xgi-search";
+    }
+    return "?";
+}
+
+static bool KindFromName(const char* name, NetCapKind* out) {
+    for (int k = 0; k <= (int)NetCapKind::XgiSearch; k++) {
+        if (std::strcmp(name, KindName((NetCapKind)k)) == 0) {
+            *out = (NetCapKind)k;
+            return true;
+        }
+    }
+    return false;
+}
+
+static size_t Pad4(size_t n) { return (n + 3) & ~(size_t)3; }
+
+// ============================================================================
+// Capture
+// ============================================================================
+
+static std::atomic<bool> g_cap_active{false};
+static std::mutex        g_cap_mutex;
+static FILE*             g_cap_file = nullptr;
+static uint64_t          g_cap_packets = 0;
+
+// Append a block: type, total length, body, padding, total length.
+static void WriteBlock(uint32_t type, const std::vector<uint8_t>& body) {
+    uint32_t total = (uint32_t)(12 + Pad4(body.size()));
+    static const uint8_t zero[4] = {};
+    fwrite(&type, 4, 1, g_cap_file);
+    fwrite(&total, 4, 1, g_cap_file);
+    fwrite(body.data(), 1, body.size(), g_cap_file);
+    fwrite(zero, 1, Pad4(body.size()) - body.size(), g_cap_file);
+    fwrite(&total, 4, 1, g_cap_file);
+}
+
+static void Put16(std::vector<uint8_t>& b, uint16_t v) {
+    b.insert(b.end(), (uint8_t*)&v, (uint8_t*)&v + 2);
+}
+static void Put32(std::vector<uint8_t>& b, uint32_t v) {
+    b.insert(b.end(), (uint8_t*)&v, (uint8_t*)&v + 4);
+}
+static void PutOption(std::vector<uint8_t>& b, uint16_t code, const void* data, size_t len) {
+    Put16(b, code);
+    Put16(b, (uint16_t)len);
+    const uint8_t* p = (const uint8_t*)data;
+    b.insert(b.end(), p, p + len);
+    b.resize(Pad4(b.size()), 0);
+}
+static void EndOptions(std::vector<uint8_t>& b) {
+    Put16(b, OPT_ENDOFOPT);
+    Put16(b, 0);
+}
+
+static void WriteInterface(uint16_t linktype, const char* name, uint32_t local_ip) {
+    std::vector<uint8_t> b;
+    Put16(b, linktype);
+    Put16(b, 0);       // reserved
+    Put32(b, 65535);   // snaplen
+    PutOption(b, IF_NAME, name, std::strlen(name));
+    if (local_ip) {
+        uint8_t addr_mask[8];
+        std::memcpy(addr_mask, &local_ip, 4);
+        std::memset(addr_mask + 4, 0xFF, 4);
+        PutOption(b, IF_IPV4ADDR, addr_mask, 8);
+    }
+    uint8_t tsresol = 6;  // microseconds
+    PutOption(b, IF_TSRESOL, &tsresol, 1);
+    EndOptions(b);
+    WriteBlock(PCAPNG_IDB, b);
+}
+
+// Present subscriber: flush the capture every CAPTURE_FLUSH_FRAMES frames
+static void CaptureOnPresent(uint8_t* /*base*/) {
+    if (NetCaptureActive() && PresentFrameNumber() % CAPTURE_FLUSH_FRAMES == 0) {
+        std::lock_guard lock(g_cap_mutex);
+        if (g_cap_file) fflush(g_cap_file);
+    }
+}
+
+bool NetCaptureOpen(const std::string& path, uint32_t local_ip) {
+    std::lock_guard lock(g_cap_mutex);
+    if (g_cap_file) return true;
+    g_cap_file = fopen(path.c_str(), "wb");
+    if (!g_cap_file) {
+        REXLOG_ERROR("[NET] Cannot open capture file {}", path);
+        return false;
+    }
+    setvbuf(g_cap_file, nullptr, _IOFBF, 1 << 20);
+
+    std::vector<uint8_t> shb;
+    Put32(shb, PCAPNG_BYTE_ORDER);
+    Put16(shb, 1);  // major
+    Put16(shb, 0);  // minor
+    Put32(shb, 0xFFFFFFFF);  // section length unknown (-1)
+    Put32(shb, 0xFFFFFFFF);
+    const char* app = "vig8";
+    PutOption(shb, SHB_USERAPPL, app, std::strlen(app));
+    EndOptions(shb);
+    WriteBlock(PCAPNG_SHB, shb);
+
+    WriteInterface(LINKTYPE_IPV4, "vig8-net", local_ip);
+    WriteInterface(LINKTYPE_USER0, "vig8-xgi", 0);
+
+    g_cap_packets = 0;
+    g_cap_active.store(true, std::memory_order_release);
+    PresentSubscribe(PresentStage::Before, CaptureOnPresent);
+    REXLOG_INFO("[NET] Capturing to {}", path);
+    return true;
+}
+
+void NetCaptureClose() {
+    std::lock_guard lock(g_cap_mutex);
+    g_cap_active.store(false, std::memory_order_release);
+    if (!g_cap_file) return;
+    fclose(g_cap_file);
+    g_cap_file = nullptr;
+    REXLOG_INFO("[NET] Capture closed ({} packets)", g_cap_packets);
+}
+
+bool NetCaptureActive() {
+    return g_cap_active.load(std::memory_order_relaxed);
+}
+
+void NetCaptureRecord(NetCapDir dir, NetCapKind kind,
+                      uint32_t src_ip, uint16_t src_port,
+                      uint32_t dst_ip, uint16_t dst_port,
+                      const uint8_t* data, size_t len) {
+    if (!NetCaptureActive()) return;
+    if (len > 65535 - IPV4_HEADER_LEN - UDP_HEADER_LEN) return;
+
+    uint64_t frame = PresentFrameNumber();
+    uint64_t ts_us = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    bool is_xgi = kind == NetCapKind::XgiCreate || kind == NetCapKind::XgiSearch;
+
+    // Packet bytes: raw XGI payload, or IPv4 + UDP + payload. The IP
+    // checksum is left 0; Wireshark flags it but decodes normally.
+    std::vector<uint8_t> pkt;
+    if (is_xgi) {
+        pkt.assign(data, data + len);
+    } else {
+        size_t total = IPV4_HEADER_LEN + UDP_HEADER_LEN + len;
+        pkt.resize(total);
+        uint8_t* ip = pkt.data();
+        ip[0] = 0x45;
+        ip[2] = (uint8_t)(total >> 8);
+        ip[3] = (uint8_t)total;
+        ip[8] = 64;   // TTL
+        ip[9] = 17;   // UDP
+        std::memcpy(ip + 12, &src_ip, 4);
+        std::memcpy(ip + 16, &dst_ip, 4);
+        uint8_t* udp = ip + IPV4_HEADER_LEN;
+        size_t udp_len = UDP_HEADER_LEN + len;
+        std::memcpy(udp + 0, &src_port, 2);
+        std::memcpy(udp + 2, &dst_port, 2);
+        udp[4] = (uint8_t)(udp_len >> 8);
+        udp[5] = (uint8_t)udp_len;
+        if (len) std::memcpy(udp + UDP_HEADER_LEN, data, len);
+    }
+
+    std::vector<uint8_t> b;
+    b.reserve(32 + Pad4(pkt.size()) + 64);
+    Put32(b, is_xgi ? IF_XGI : IF_DATAGRAM);
+    Put32(b, (uint32_t)(ts_us >> 32));
+    Put32(b, (uint32_t)ts_us);
+    Put32(b, (uint32_t)pkt.size());
+    Put32(b, (uint32_t)pkt.size());
+    b.insert(b.end(), pkt.begin(), pkt.end());
+    b.resize(Pad4(b.size()), 0);
+
+    char comment[64];
+    int clen = snprintf(comment, sizeof(comment), "frame=%llu dir=%s kind=%s",
+                        (unsigned long long)frame, dir == NetCapDir::In ? "in" : "out",
+                        KindName(kind));
+    PutOption(b, OPT_COMMENT, comment, (size_t)clen);
+    uint32_t flags = dir == NetCapDir::In ? EPB_FLAG_INBOUND : EPB_FLAG_OUTBOUND;
+    PutOption(b, EPB_FLAGS, &flags, 4);
+    EndOptions(b);
+
+    std::lock_guard lock(g_cap_mutex);
+    if (!g_cap_file) return;
+    WriteBlock(PCAPNG_EPB, b);
+    g_cap_packets++;
+}
+
+
+// ============================================================================
+// Replay
+// ============================================================================
+
+static std::atomic<bool>        g_replay_active{false};
+static std::mutex               g_replay_mutex;
+static std::deque<NetCapPacket> g_replay_queues[(int)NetCapKind::XgiSearch + 1];
+static uint32_t                 g_replay_local_ip = 0;
+static uint64_t                 g_replay_frame0 = 0;   // frame the replay started at
+
+static uint16_t Get16(const uint8_t* p) { uint16_t v; std::memcpy(&v, p, 2); return v; }
+static uint32_t Get32(const uint8_t* p) { uint32_t v; std::memcpy(&v, p, 4); return v; }
+
+// Walk an option list; calls fn(code, data, len) for each option.
+template <typename Fn>
+static void ForEachOption(const uint8_t* p, const uint8_t* end, Fn fn) {
+    while (p + 4 <= end) {
+        uint16_t code = Get16(p);
+        uint16_t len  = Get16(p + 2);
+        if (code == OPT_ENDOFOPT || p + 4 + len > end) break;
+        fn(code, p + 4, len);
+        p += 4 + Pad4(len);
+    }
+}
+
+// Decode an EPB into a replay packet. Returns false for anything we can't
+// attribute (foreign interfaces, non-UDP, missing vig8 comment).
+static bool DecodeEpb(const uint8_t* body, size_t len,
+                      const std::vector<uint16_t>& linktypes, NetCapPacket* out) {
+    if (len < 20) return false;
+    uint32_t if_id  = Get32(body);
+    uint32_t caplen = Get32(body + 12);
+    if (if_id >= linktypes.size() || 20 + Pad4(caplen) > len) return false;
+    const uint8_t* pkt = body + 20;
+
+    bool have_comment = false;
+    ForEachOption(pkt + Pad4(caplen), body + len,
+                  [&](uint16_t code, const uint8_t* data, uint16_t olen) {
+        if (code != OPT_COMMENT || have_comment) return;
+        char comment[64] = {};
+        std::memcpy(comment, data, std::min<size_t>(olen, sizeof(comment) - 1));
+        unsigned long long frame;
+        char dir[8], kind[16];
+        if (sscanf(comment, "frame=%llu dir=%7s kind=%15s", &frame, dir, kind) == 3 &&
+            KindFromName(kind, &out->kind)) {
+            out->frame = frame;
+            out->dir = std::strcmp(dir, "in") == 0 ? NetCapDir::In : NetCapDir::Out;
+            have_comment = true;
+        }
+    });
+    if (!have_comment) return false;
+
+    out->src_ip = out->dst_ip = 0;
+    out->src_port = out->dst_port = 0;
+    if (linktypes[if_id] == LINKTYPE_USER0) {
+        out->data.assign(pkt, pkt + caplen);
+        return true;
+    }
+    if (linktypes[if_id] != LINKTYPE_IPV4 || caplen < IPV4_HEADER_LEN) return false;
+
+    size_t ihl = (size_t)(pkt[0] & 0x0F) * 4;
+    if ((pkt[0] >> 4) != 4 || pkt[9] != 17 || caplen < ihl + UDP_HEADER_LEN) return false;
+    std::memcpy(&out->src_ip, pkt + 12, 4);
+    std::memcpy(&out->dst_ip, pkt + 16, 4);
+    std::memcpy(&out->src_port, pkt + ihl + 0, 2);
+    std::memcpy(&out->dst_port, pkt + ihl + 2, 2);
+    out->data.assign(pkt + ihl + UDP_HEADER_LEN, pkt + caplen);
+    return true;
+}
+
+bool NetReplayOpen(const std::string& path) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) {
+        REXLOG_ERROR("[NET] Cannot open replay file {}", path);
+        return false;
+    }
+
+    std::lock_guard lock(g_replay_mutex);
+    for (auto& q : g_replay_queues) q.clear();
+    g_replay_local_ip = 0;
+
+    std::vector<uint16_t> linktypes;
+    std::vector<uint8_t> body;
+    size_t loaded = 0, skipped = 0;
+    bool ok = true;
+    for (;;) {
+        uint32_t hdr[2];
+        if (fread(hdr, 4, 2, f) != 2) break;
+        if (hdr[1] < 12 || hdr[1] > (64u << 20)) { ok = false; break; }
+        body.resize(hdr[1] - 8);
+        if (fread(body.data(), 1, body.size(), f) != body.size()) { ok = false; break; }
+        body.resize(body.size() - 4);  // trailing length
+
+        if (hdr[0] == PCAPNG_SHB) {
+            if (body.size() < 4 || Get32(body.data()) != PCAPNG_BYTE_ORDER) {
+                REXLOG_ERROR("[NET] {}: not a pcapng file in host byte order", path);
+                ok = false;
+                break;
+            }
+            linktypes.clear();  // interface ids restart per section
+        } else if (hdr[0] == PCAPNG_IDB && body.size() >= 8) {
+            linktypes.push_back(Get16(body.data()));
+            if (linktypes.size() == 1) {
+                ForEachOption(body.data() + 8, body.data() + body.size(),
+                              [](uint16_t code, const uint8_t* data, uint16_t olen) {
+                    if (code == IF_IPV4ADDR && olen >= 4) std::memcpy(&g_replay_local_ip, data, 4);
+                });
+            }
+        } else if (hdr[0] == PCAPNG_EPB) {
+            NetCapPacket p;
+            if (DecodeEpb(body.data(), body.size(), linktypes, &p) && p.dir == NetCapDir::In) {
+                g_replay_queues[(int)p.kind].push_back(std::move(p));
+                loaded++;
+            } else {
+                skipped++;
+            }
+        }
+    }
+    fclose(f);
+
+    if (!ok) {
+        REXLOG_ERROR("[NET] {}: truncated or malformed capture", path);
+        for (auto& q : g_replay_queues) q.clear();
+        return false;
+    }
+    g_replay_frame0 = PresentFrameNumber();
+    g_replay_active.store(true, std::memory_order_release);
+    REXLOG_INFO("[NET] Replaying {} inbound packets from {} ({} outbound/other skipped)",
+                loaded, path, skipped);
+    return true;
+}
+
+void NetReplayClose() {
+    std::lock_guard lock(g_replay_mutex);
+    g_replay_active.store(false, std::memory_order_release);
+    size_t left = 0;
+    for (auto& q : g_replay_queues) {
+        left += q.size();
+        q.clear();
+    }
+    if (left) REXLOG_INFO("[NET] Replay stopped with {} packets undelivered", left);
+}
+
+bool NetReplayActive() {
+    return g_replay_active.load(std::memory_order_relaxed);
+}
+
+uint32_t NetReplayLocalIp() {
+    std::lock_guard lock(g_replay_mutex);
+    return g_replay_local_ip;
+}
+
+bool NetReplayTake(NetCapKind kind, uint16_t dst_port, NetCapPacket* out) {
+    if (!NetReplayActive()) return false;
+    uint64_t frame = PresentFrameNumber() - g_replay_frame0;
+    std::lock_guard lock(g_replay_mutex);
+    auto& q = g_replay_queues[(int)kind];
+    // Queues are in capture order, which is frame order.
+    for (auto it = q.begin(); it != q.end() && it->frame <= frame; ++it) {
+        if (dst_port && it->dst_port != dst_port) continue;
+        *out = std::move(*it);
+        q.erase(it);
+        return true;
+    }
+    return false;
+}
+
+size_t NetReplayRemaining() {
+    std::lock_guard lock(g_replay_mutex);
+    size_t n = 0;
+    for (auto& q : g_replay_queues) n += q.size();
+    return n;
+}
@@ -0,0 +1,75 @@
+// vig8 - Network capture and replay
+//
+// Capture writes every datagram that crosses the guest boundary to a
+// pcapng file: game traffic (WSASendTo / WSARecvFrom), discovery and QoS
+// packets, and the XGI create/search results handed to the game. Each
+// packet is stamped with the guest frame number (PresentFrameNumber).
+//
+//   Interface 0  LINKTYPE_IPV4   datagrams, with synthesized IPv4/UDP headers
+//   Interface 1  LINKTYPE_USER0  XGI results (raw guest bytes)
+//
+// Every packet carries an opt_comment "frame=<n> dir=<in|out> kind=<k>"
+// and the standard epb_flags direction bits, so Wireshark can filter on
+// either. Direction is relative to this instance: "in" is delivered to
+// the game, "out" left it.
+//
+// Replay loads a capture and hands its inbound packets back to the net
+// layer once the guest reaches the frame they were recorded at. Outbound
+// traffic is swallowed while replaying, so one headless instance can rerun
+// a captured session with no peers on the network.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class NetCapDir : uint8_t { In = 0, Out = 1 };
+
+enum class NetCapKind : uint8_t {
+    Game      = 0,  // guest sockets
+    Discovery = 1,  // beacons, probes, QoS on the discovery port
+    XgiCreate = 2,  // XSESSION_INFO written by XGISessionCreate
+    XgiSearch = 3,  // search output buffer (count + results)
+};
+
+struct NetCapPacket {
+    uint64_t             frame;
+    NetCapDir            dir;
+    NetCapKind           kind;
+    uint32_t             src_ip;    // network byte order
+    uint16_t             src_port;  // network byte order
+    uint32_t             dst_ip;
+    uint16_t             dst_port;
+    std::vector<uint8_t> data;
+};
+
+// ---- Capture ----
+
+// `local_ip` (network order) is stored in the interface description so a
+// replay can take on the same identity.
+bool NetCaptureOpen(const std::string& path, uint32_t local_ip);
+void NetCaptureClose();
+bool NetCaptureActive();  // one relaxed load; check before building a record
+
+void NetCaptureRecord(NetCapDir dir, NetCapKind kind,
+                      uint32_t src_ip, uint16_t src_port,
+                      uint32_t dst_ip, uint16_t dst_port,
+                      const uint8_t* data, size_t len);
+
+// ---- Replay ----
+
+bool NetReplayOpen(const std::string& path);
+void NetReplayClose();
+bool NetReplayActive();
+
+// Local IP of the recorded instance, 0 if the capture didn't say.
+uint32_t NetReplayLocalIp();
+
+// Take the oldest inbound packet of `kind` recorded at or before the
+// current frame. For Game packets `dst_port` (network order) selects the
+// receiving socket; 0 matches any.
+bool NetReplayTake(NetCapKind kind, uint16_t dst_port, NetCapPacket* out);
+
+size_t NetReplayRemaining();
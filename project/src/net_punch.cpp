@@ -0,0 +1,396 @@
+// vig8 - Direct peer paths through NAT (UDP hole punching)
+// See net_punch.h.
+
+#include "net_punch.h"
+#include "net_scheduler.h"
+#include "net_telemetry.h"
+
+#include <rex/logging.h>
+
+#ifdef _WIN32
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+static int64_t NowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        NetClock::now().time_since_epoch()).count();
+}
+
+static std::string FormatEndpoint(const struct sockaddr_in& a) {
+    char ip[INET_ADDRSTRLEN] = {};
+    inet_ntop(AF_INET, &a.sin_addr, ip, sizeof(ip));
+    return std::string(ip) + ":" + std::to_string(ntohs(a.sin_port));
+}
+
+static std::string FormatIp(uint32_t ip_net) {
+    struct sockaddr_in a = {};
+    a.sin_addr.s_addr = ip_net;
+    char ip[INET_ADDRSTRLEN] = {};
+    inet_ntop(AF_INET, &a.sin_addr, ip, sizeof(ip));
+    return ip;
+}
+
+static void PutBE32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24); p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);  p[3] = (uint8_t)v;
+}
+
+static uint32_t GetBE32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// ============================================================================
+// STUN
+// ============================================================================
+
+static constexpr uint32_t STUN_MAGIC_COOKIE     = 0x2112A442;
+static constexpr uint16_t STUN_BINDING_REQUEST  = 0x0001;
+static constexpr uint16_t STUN_BINDING_RESPONSE = 0x0101;
+static constexpr uint16_t STUN_ATTR_MAPPED      = 0x0001;
+static constexpr uint16_t STUN_ATTR_XOR_MAPPED  = 0x0020;
+
+// Pull the mapped address out of a Binding success response for `txid`.
+static bool ParseStunResponse(const uint8_t* p, int n, const uint8_t* txid,
+                              struct sockaddr_in* mapped) {
+    if (n < 20 || ((p[0] << 8) | p[1]) != STUN_BINDING_RESPONSE ||
+        GetBE32(p + 4) != STUN_MAGIC_COOKIE || std::memcmp(p + 8, txid, 12) != 0) {
+        return false;
+    }
+    int end = std::min(n, 20 + ((p[2] << 8) | p[3]));
+    bool found = false;
+    for (int off = 20; off + 4 <= end;) {
+        int type = (p[off] << 8) | p[off + 1];
+        int len = (p[off + 2] << 8) | p[off + 3];
+        const uint8_t* v = p + off + 4;
+        if (off + 4 + len > end) break;
+        // IPv4 only: reserved, family 0x01, port, address
+        if ((type == STUN_ATTR_XOR_MAPPED || type == STUN_ATTR_MAPPED) && len >= 8 && v[1] == 0x01) {
+            uint16_t port = (uint16_t)((v[2] << 8) | v[3]);
+            uint32_t addr = GetBE32(v + 4);
+            if (type == STUN_ATTR_XOR_MAPPED) {
+                port ^= (uint16_t)(STUN_MAGIC_COOKIE >> 16);
+                addr ^= STUN_MAGIC_COOKIE;
+            }
+            *mapped = {};
+            mapped->sin_family = AF_INET;
+            mapped->sin_port = htons(port);
+            mapped->sin_addr.s_addr = htonl(addr);
+            found = true;
+            if (type == STUN_ATTR_XOR_MAPPED) break;  // preferred: NATs can't rewrite it
+        }
+        off += 4 + ((len + 3) & ~3);
+    }
+    return found;
+}
+
+bool StunQuery(SOCKET sock, const struct sockaddr_in& server,
+               struct sockaddr_in* mapped, int timeout_ms) {
+    uint8_t req[20] = {};
+    req[0] = (uint8_t)(STUN_BINDING_REQUEST >> 8);
+    req[1] = (uint8_t)STUN_BINDING_REQUEST;
+    PutBE32(req + 4, STUN_MAGIC_COOKIE);
+    std::random_device rd;
+    for (int i = 0; i < 3; i++) PutBE32(req + 8 + i * 4, rd());
+
+    for (int attempt = 0; attempt < 3; attempt++) {
+        sendto(sock, (const char*)req, sizeof(req), 0,
+               (const struct sockaddr*)&server, sizeof(server));
+        auto deadline = NetClock::now() + std::chrono::milliseconds(timeout_ms);
+        for (;;) {
+            auto left = std::chrono::duration_cast<std::chrono::microseconds>(
+                deadline - NetClock::now()).count();
+            if (left <= 0) break;
+            fd_set fds;
+            FD_ZERO(&fds);
+            FD_SET(sock, &fds);
+            struct timeval tv = {(long)(left / 1000000), (long)(left % 1000000)};
+            if (select((int)sock + 1, &fds, nullptr, nullptr, &tv) <= 0) break;
+
+            uint8_t buf[548];
+            struct sockaddr_in from = {};
+            socklen_t from_len = sizeof(from);
+            int n = recvfrom(sock, (char*)buf, sizeof(buf), 0,
+                             (struct sockaddr*)&from, &from_len);
+            if (n > 0 && ParseStunResponse(buf, n, req + 8, mapped)) return true;
+            // Anything else that arrived this early (a LAN beacon) is dropped
+        }
+    }
+    return false;
+}
+
+// ============================================================================
+// Paths
+// ============================================================================
+
+enum class PathState { Punching, Direct, Failed };
+
+struct PunchPeer {
+    XNADDR_LAN           xnaddr;
+    PathState            state = PathState::Punching;
+    struct sockaddr_in   route = {};       // valid in Direct
+    NetClock::time_point attempt_end;      // Punching: give up at
+    NetClock::time_point last_rx;          // Direct: last probe, ack or data
+    NetClock::time_point last_probe;
+    int64_t              srtt_us = -1;
+    int                  attempts = 1;
+};
+
+struct PunchState {
+    std::mutex                              mutex;
+    std::unordered_map<uint32_t, PunchPeer> peers;   // by ina
+    PunchSendFn                             send;
+    XNADDR_LAN                              self = {};
+    uint16_t                                lan_port_net = 0;
+    uint64_t                                timer = 0;
+};
+static PunchState g_punch;
+static std::atomic<bool> g_punch_running{false};
+
+struct PendingProbe {
+    struct sockaddr_in to;
+    uint8_t            pkt[DISC_PUNCH_LEN];
+};
+
+static constexpr int PUNCH_KEY_LEN = 8;   // leading bytes of abOnline
+
+static bool SameKey(const uint8_t* key, const XNADDR_LAN& a) {
+    return std::memcmp(key, a.abOnline, PUNCH_KEY_LEN) == 0;
+}
+
+// `to` is the receiver as introduced; its key goes in the probe.
+static void BuildProbe(uint8_t type, uint32_t nonce, const XNADDR_LAN& to, uint8_t* pkt) {
+    std::memset(pkt, 0, DISC_PUNCH_LEN);
+    pkt[0] = DISC_MAGIC;
+    pkt[1] = type;
+    std::memcpy(pkt + 10, &g_punch.self, sizeof(XNADDR_LAN));
+    PutBE32(pkt + 46, nonce);
+    std::memcpy(pkt + 50, &to.ina, 4);
+    std::memcpy(pkt + 54, to.abOnline, PUNCH_KEY_LEN);
+}
+
+static struct sockaddr_in MakeEndpoint(uint32_t ip_net, uint16_t port_net) {
+    struct sockaddr_in a = {};
+    a.sin_family = AF_INET;
+    a.sin_addr.s_addr = ip_net;
+    a.sin_port = port_net;
+    return a;
+}
+
+// Queue probes to every candidate (Punching) or to the path (Direct).
+// Caller holds g_punch.mutex.
+static void QueueProbes(PunchPeer& p, NetClock::time_point now,
+                        std::vector<PendingProbe>* out) {
+    uint32_t nonce = (uint32_t)NowUs();
+    auto add = [&](const struct sockaddr_in& to) {
+        PendingProbe pp;
+        pp.to = to;
+        BuildProbe(DISC_PUNCH, nonce, p.xnaddr, pp.pkt);
+        out->push_back(pp);
+    };
+    if (p.state == PathState::Direct) {
+        add(p.route);
+    } else {
+        add(MakeEndpoint(p.xnaddr.inaOnline, p.xnaddr.wPortOnline));
+        add(MakeEndpoint(p.xnaddr.ina, g_punch.lan_port_net));
+    }
+    p.last_probe = now;
+}
+
+static void SendProbes(const std::vector<PendingProbe>& probes) {
+    for (auto& pp : probes) g_punch.send(pp.to, pp.pkt, DISC_PUNCH_LEN);
+}
+
+static void PunchTick() {
+    if (!g_punch_running.load(std::memory_order_acquire)) return;
+    auto now = NetClock::now();
+    std::vector<PendingProbe> probes;
+    {
+        std::lock_guard lock(g_punch.mutex);
+        for (auto& [ina, p] : g_punch.peers) {
+            if (p.state == PathState::Direct && now - p.last_rx > PUNCH_PATH_TIMEOUT) {
+                REXLOG_WARN("[NET] Direct path to {} via {} lost, back to {}", FormatIp(ina),
+                            FormatEndpoint(p.route), FormatIp(ina));
+                if (p.attempts >= PUNCH_MAX_ATTEMPTS) {
+                    p.state = PathState::Failed;
+                    continue;
+                }
+                p.state = PathState::Punching;
+                p.attempts++;
+                p.attempt_end = now + PUNCH_ATTEMPT_TIME;
+            }
+            if (p.state == PathState::Punching && now >= p.attempt_end) {
+                REXLOG_WARN("[NET] No direct path to {} after {} attempt(s); "
+                            "sending to its XNADDR address", FormatIp(ina), p.attempts);
+                p.state = PathState::Failed;
+            }
+            if (p.state == PathState::Punching ||
+                (p.state == PathState::Direct && now - p.last_probe >= PUNCH_KEEPALIVE)) {
+                QueueProbes(p, now, &probes);
+            }
+        }
+        g_punch.timer = NetTimerRunAfter(PUNCH_INTERVAL, PunchTick);
+    }
+    SendProbes(probes);
+}
+
+void PunchMakeKey(XNADDR_LAN* self) {
+    std::random_device rd;
+    for (int i = 0; i < PUNCH_KEY_LEN; i += 4) {
+        uint32_t r = rd();
+        std::memcpy(self->abOnline + i, &r, 4);
+    }
+}
+
+void PunchStart(PunchSendFn send, const XNADDR_LAN& self, int lan_port) {
+    std::lock_guard lock(g_punch.mutex);
+    g_punch.send = std::move(send);
+    g_punch.self = self;
+    g_punch.lan_port_net = htons((uint16_t)lan_port);
+    g_punch_running.store(true, std::memory_order_release);
+    g_punch.timer = NetTimerRunAfter(PUNCH_INTERVAL, PunchTick);
+}
+
+void PunchStop() {
+    g_punch_running.store(false, std::memory_order_release);
+    std::lock_guard lock(g_punch.mutex);
+    NetTimerCancel(g_punch.timer);
+    g_punch.peers.clear();
+}
+
+void PunchBegin(const XNADDR_LAN& peer) {
+    if (!g_punch_running.load(std::memory_order_acquire)) return;
+    // Only peers that published a public endpoint other than their LAN
+    // address, and aren't behind our NAT, need a punched path.
+    if (peer.inaOnline == 0 || peer.inaOnline == peer.ina || peer.wPortOnline == 0) return;
+
+    std::vector<PendingProbe> probes;
+    {
+        std::lock_guard lock(g_punch.mutex);
+        if (peer.ina == g_punch.self.ina || peer.inaOnline == g_punch.self.inaOnline) return;
+        auto now = NetClock::now();
+        auto [it, added] = g_punch.peers.try_emplace(peer.ina);
+        PunchPeer& p = it->second;
+        bool changed = !added && (p.xnaddr.inaOnline != peer.inaOnline ||
+                                  p.xnaddr.wPortOnline != peer.wPortOnline ||
+                                  !SameKey(peer.abOnline, p.xnaddr));
+        p.xnaddr = peer;
+        if (!added && !changed && p.state != PathState::Failed) return;
+        if (!added) p.attempts = 1;  // an explicit reconnect gets a fresh budget
+        p.state = PathState::Punching;
+        p.attempt_end = now + PUNCH_ATTEMPT_TIME;
+        QueueProbes(p, now, &probes);
+        REXLOG_INFO("[NET] Punching to {} (public {}, lan {})", FormatIp(peer.ina),
+                    FormatEndpoint(MakeEndpoint(peer.inaOnline, peer.wPortOnline)),
+                    FormatEndpoint(MakeEndpoint(peer.ina, g_punch.lan_port_net)));
+    }
+    SendProbes(probes);
+}
+
+void PunchForget(uint32_t ina) {
+    std::lock_guard lock(g_punch.mutex);
+    g_punch.peers.erase(ina);
+}
+
+// Caller holds g_punch.mutex.
+static void SetDirect(uint32_t ina, PunchPeer& p, const struct sockaddr_in& from,
+                      NetClock::time_point now, const char* how) {
+    if (p.state != PathState::Direct) {
+        p.state = PathState::Direct;
+        p.route = from;
+        p.last_probe = now;
+        REXLOG_INFO("[NET] Direct path to {} via {} ({})", FormatIp(ina), FormatEndpoint(from), how);
+    }
+    p.last_rx = now;
+}
+
+// `from` is one of the endpoints `p` was introduced with. Caller holds
+// g_punch.mutex.
+static bool IsCandidate(const PunchPeer& p, const struct sockaddr_in& from) {
+    return (from.sin_addr.s_addr == p.xnaddr.inaOnline && from.sin_port == p.xnaddr.wPortOnline) ||
+           (from.sin_addr.s_addr == p.xnaddr.ina && from.sin_port == g_punch.lan_port_net);
+}
+
+void PunchHandlePacket(const uint8_t* buf, int n, const struct sockaddr_in& from) {
+    if (n < DISC_PUNCH_LEN || !g_punch_running.load(std::memory_order_acquire)) return;
+    uint32_t sender_ina;
+    std::memcpy(&sender_ina, buf + 10, 4);
+    uint32_t nonce = GetBE32(buf + 46);
+    uint32_t target;
+    std::memcpy(&target, buf + 50, 4);
+    const uint8_t* key = buf + 54;
+
+    auto now = NetClock::now();
+    uint8_t ack[DISC_PUNCH_LEN];
+    {
+        std::lock_guard lock(g_punch.mutex);
+        // Only a peer we were introduced to, reaching us from one of the
+        // endpoints it was introduced with, with the key we published
+        if (target != g_punch.self.ina || !SameKey(key, g_punch.self)) return;
+        auto it = g_punch.peers.find(sender_ina);
+        if (it == g_punch.peers.end() || !IsCandidate(it->second, from)) return;
+        PunchPeer& p = it->second;
+
+        if (buf[1] == DISC_PUNCH) {
+            // The peer reached us, so replies to `from` get through its NAT
+            BuildProbe(DISC_PUNCH_ACK, nonce, p.xnaddr, ack);
+            SetDirect(sender_ina, p, from, now, "peer-initiated");
+        } else {
+            int64_t rtt_us = (int64_t)(uint32_t)((uint32_t)NowUs() - nonce);
+            p.srtt_us = p.srtt_us < 0 ? rtt_us : p.srtt_us + (rtt_us - p.srtt_us) / 8;
+            NetTelemetryRtt(sender_ina, (uint32_t)rtt_us);
+            if (p.state != PathState::Direct) {
+                REXLOG_INFO("[NET] Punch to {} answered from {} in {} us", FormatIp(sender_ina),
+                            FormatEndpoint(from), rtt_us);
+            }
+            SetDirect(sender_ina, p, from, now, "punched");
+            return;
+        }
+    }
+    g_punch.send(from, ack, DISC_PUNCH_LEN);
+}
+
+bool PunchAcceptDirect(uint32_t ina, const struct sockaddr_in& from) {
+    std::lock_guard lock(g_punch.mutex);
+    auto it = g_punch.peers.find(ina);
+    // The peer may have settled on its other candidate for us, so either
+    // of its introduced endpoints will do
+    if (it == g_punch.peers.end() || it->second.state != PathState::Direct ||
+        !IsCandidate(it->second, from)) {
+        return false;
+    }
+    it->second.last_rx = NetClock::now();
+    return true;
+}
+
+bool PunchRoute(uint32_t ina, struct sockaddr_in* wire) {
+    if (!g_punch_running.load(std::memory_order_relaxed)) return false;
+    std::lock_guard lock(g_punch.mutex);
+    auto it = g_punch.peers.find(ina);
+    if (it == g_punch.peers.end() || it->second.state != PathState::Direct) return false;
+    *wire = it->second.route;
+    return true;
+}
+
+std::vector<PunchPathInfo> PunchGetPaths() {
+    std::vector<PunchPathInfo> out;
+    std::lock_guard lock(g_punch.mutex);
+    for (auto& [ina, p] : g_punch.peers) {
+        const char* state = p.state == PathState::Direct   ? "direct"
+                          : p.state == PathState::Punching ? "punching"
+                                                           : "failed";
+        out.push_back({ina, p.route, state, p.srtt_us, p.attempts});
+    }
+    return out;
+}
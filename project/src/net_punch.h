@@ -0,0 +1,101 @@
+// vig8 - Direct peer paths through NAT (UDP hole punching)
+//
+// A relay-listed host is usually behind a NAT, so the LAN address in its
+// XNADDR (`ina`, the address the guest sends to) can't be reached from
+// outside. With [network] stun_server set, NetInit asks that server (any
+// RFC 5389 STUN server; it need not be the relay, and tools/nat_sim.py
+// runs its own) which endpoint it sees for the discovery socket, and
+// publishes it as inaOnline/wPortOnline in the XNADDR registered with the
+// relay.
+//
+// Once the guest resolves a peer's XNADDR (XNetXnAddrToInAddr,
+// XNetConnect) whose public endpoint is not ours, both of its candidates,
+// public and LAN, are probed from the discovery socket every
+// PUNCH_INTERVAL. Both peers do this once each has the other's XNADDR, so
+// each NAT has seen outbound traffic by the time the other side's probes
+// arrive. The first candidate to answer becomes the peer's direct path:
+// game datagrams the guest addresses to `ina` are wrapped in DISC_DIRECT
+// and sent there from the discovery port, and the receiver hands them to
+// the guest socket bound to the destination port with `ina` as the
+// source. The guest never sees the real endpoint.
+//
+// Nothing on the wire is authenticated, so a path is only taken to a
+// peer the guest was introduced to (PunchBegin, with the XNADDR the
+// relay listed or the peer beaconed) and only from one of that XNADDR's
+// candidates, never from what a probe claims about its sender. Each side
+// also publishes a random punch key in its XNADDR (PunchMakeKey), and a
+// probe or ack counts only if it carries the receiver's key, i.e. the
+// sender got the receiver's XNADDR from the introduction. A probe from a
+// peer we haven't resolved is dropped: a joiner's path comes up once the
+// host's guest resolves the joiner in turn and both sides probe. Direct
+// datagrams are delivered only when the ina in their header has a direct
+// path and they arrive from one of its candidates (PunchAcceptDirect).
+//
+// A direct path is kept open with a probe every PUNCH_KEEPALIVE. If
+// nothing arrives on it for PUNCH_PATH_TIMEOUT, sends go back to `ina`
+// and punching starts over, up to PUNCH_MAX_ATTEMPTS times.
+
+#pragma once
+
+#include "net.h"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <netinet/in.h>
+using SOCKET = int;
+#endif
+
+static constexpr auto PUNCH_INTERVAL      = std::chrono::milliseconds(100);
+static constexpr auto PUNCH_ATTEMPT_TIME  = std::chrono::seconds(5);
+static constexpr auto PUNCH_KEEPALIVE     = std::chrono::seconds(1);
+static constexpr auto PUNCH_PATH_TIMEOUT  = std::chrono::seconds(5);
+static constexpr int  PUNCH_MAX_ATTEMPTS  = 3;
+
+// Ask a STUN server (RFC 5389 Binding) which address `sock` appears from.
+// Blocks for up to `timeout_ms` per try, three tries. Call before anything
+// else reads `sock`.
+bool StunQuery(SOCKET sock, const struct sockaddr_in& server,
+               struct sockaddr_in* mapped, int timeout_ms);
+
+// Give `self` a fresh random punch key. Call before `self` is published.
+void PunchMakeKey(XNADDR_LAN* self);
+
+using PunchSendFn = std::function<void(const struct sockaddr_in&, const uint8_t*, int)>;
+
+// Start/stop. `send` puts a probe on the wire from the discovery socket;
+// `self` is our XNADDR as published (probes carry it). Peers' LAN
+// candidates are assumed to use the same `lan_port` as we do.
+void PunchStart(PunchSendFn send, const XNADDR_LAN& self, int lan_port);
+void PunchStop();
+
+// Start punching toward `peer` if it sits behind a different NAT. No-op
+// if a path to it is already up or being punched, unless `peer`'s
+// candidates or key changed since it was introduced.
+void PunchBegin(const XNADDR_LAN& peer);
+// Drop any path to `ina` (XNetUnregisterInAddr).
+void PunchForget(uint32_t ina);
+
+// Handle a DISC_PUNCH / DISC_PUNCH_ACK received on the discovery socket.
+void PunchHandlePacket(const uint8_t* buf, int n, const struct sockaddr_in& from);
+// A DISC_DIRECT datagram claiming to be from `ina` arrived from `from`.
+// True, and the path is kept alive, if `ina` has a direct path and `from`
+// is one of its introduced endpoints.
+bool PunchAcceptDirect(uint32_t ina, const struct sockaddr_in& from);
+
+// The endpoint to send `ina`'s traffic to, if a direct path is up.
+bool PunchRoute(uint32_t ina, struct sockaddr_in* wire);
+
+struct PunchPathInfo {
+    uint32_t           ina;
+    struct sockaddr_in endpoint;   // valid when state == "direct"
+    const char*        state;      // "punching", "direct", "failed"
+    int64_t            rtt_us;     // smoothed probe RTT, -1 = none yet
+    int                attempts;
+};
+std::vector<PunchPathInfo> PunchGetPaths();
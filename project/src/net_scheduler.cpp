@@ -0,0 +1,195 @@
+// vig8 - Deadline scheduler for networking completions
+// See net_scheduler.h for the threading model.
+
+#include "net_scheduler.h"
+
+#include <rex/logging.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// ============================================================================
+// Timer heap
+// ============================================================================
+
+struct TimerEntry {
+    NetClock::time_point deadline;
+    uint64_t             id;
+    // std::push_heap builds a max-heap; invert so the earliest is on top.
+    bool operator<(const TimerEntry& o) const {
+        return deadline != o.deadline ? deadline > o.deadline : id > o.id;
+    }
+};
+
+static std::vector<TimerEntry>               g_timer_heap;
+static std::unordered_map<uint64_t, NetTask> g_timer_tasks;  // cancelled = erased
+static std::mutex                            g_timer_mutex;
+static std::condition_variable               g_timer_cv;
+static std::thread                           g_timer_thread;
+static bool                                  g_timer_running = false;
+static uint64_t                              g_timer_next_id = 1;
+
+static void TimerThreadFunc() {
+    std::unique_lock lock(g_timer_mutex);
+    while (g_timer_running) {
+        if (g_timer_heap.empty()) {
+            g_timer_cv.wait(lock);
+            continue;
+        }
+        auto deadline = g_timer_heap.front().deadline;
+        if (NetClock::now() < deadline) {
+            // Woken early by a new earlier deadline, Stop() or spuriously.
+            g_timer_cv.wait_until(lock, deadline);
+            continue;
+        }
+
+        std::pop_heap(g_timer_heap.begin(), g_timer_heap.end());
+        uint64_t id = g_timer_heap.back().id;
+        g_timer_heap.pop_back();
+
+        auto it = g_timer_tasks.find(id);
+        if (it == g_timer_tasks.end()) continue;  // cancelled
+        NetTask fn = std::move(it->second);
+        g_timer_tasks.erase(it);
+
+        lock.unlock();
+        fn();
+        lock.lock();
+    }
+}
+
+void NetTimerStart() {
+    std::lock_guard lock(g_timer_mutex);
+    if (g_timer_running) return;
+    g_timer_running = true;
+    g_timer_thread = std::thread(TimerThreadFunc);
+}
+
+void NetTimerStop() {
+    {
+        std::lock_guard lock(g_timer_mutex);
+        if (!g_timer_running) return;
+        g_timer_running = false;
+    }
+    g_timer_cv.notify_all();
+    if (g_timer_thread.joinable()) {
+        g_timer_thread.join();
+    }
+    std::lock_guard lock(g_timer_mutex);
+    if (!g_timer_tasks.empty()) {
+        REXLOG_INFO("[NET] Timer stopped with {} task(s) unfired", g_timer_tasks.size());
+    }
+    g_timer_heap.clear();
+    g_timer_tasks.clear();
+}
+
+uint64_t NetTimerRunAt(NetClock::time_point deadline, NetTask fn) {
+    uint64_t id;
+    bool earliest;
+    {
+        std::lock_guard lock(g_timer_mutex);
+        id = g_timer_next_id++;
+        g_timer_tasks.emplace(id, std::move(fn));
+        g_timer_heap.push_back({deadline, id});
+        std::push_heap(g_timer_heap.begin(), g_timer_heap.end());
+        earliest = g_timer_heap.front().id == id;
+    }
+    // Only a new earliest deadline changes how long the thread should sleep.
+    if (earliest) g_timer_cv.notify_one();
+    return id;
+}
+
+bool NetTimerCancel(uint64_t id) {
+    std::lock_guard lock(g_timer_mutex);
+    // The heap entry is left in place and skipped when it surfaces.
+    return g_timer_tasks.erase(id) != 0;
+}
+
+// ============================================================================
+// Guest-thread queues
+// ============================================================================
+
+// A guest task that is due but hasn't been drained by its owner for this
+// long may be run by any other guest thread.
+static constexpr auto GUEST_STEAL_AFTER = std::chrono::milliseconds(250);
+
+struct GuestReady {
+    NetTask              fn;
+    NetClock::time_point ready_at;
+};
+
+struct GuestQueue {
+    std::mutex              mutex;
+    std::vector<GuestReady> ready;
+};
+
+static std::vector<std::shared_ptr<GuestQueue>> g_guest_queues;
+static std::mutex                               g_guest_queues_mutex;
+// Total ready tasks across all queues — the NetDrainGuest fast path.
+static std::atomic<int>                         g_guest_ready_total{0};
+
+static thread_local std::shared_ptr<GuestQueue> t_guest_queue;
+
+static GuestQueue& OwnGuestQueue() {
+    if (!t_guest_queue) {
+        t_guest_queue = std::make_shared<GuestQueue>();
+        std::lock_guard lock(g_guest_queues_mutex);
+        g_guest_queues.push_back(t_guest_queue);
+    }
+    return *t_guest_queue;
+}
+
+void NetPostToGuest(NetClock::time_point deadline, NetTask fn) {
+    std::shared_ptr<GuestQueue> q = t_guest_queue;
+    if (!q) {
+        OwnGuestQueue();
+        q = t_guest_queue;
+    }
+    NetTimerRunAt(deadline, [q, fn = std::move(fn)]() mutable {
+        std::lock_guard lock(q->mutex);
+        q->ready.push_back({std::move(fn), NetClock::now()});
+        g_guest_ready_total.fetch_add(1, std::memory_order_release);
+    });
+}
+
+// Move tasks from `q` into `out`; only those older than `older_than` if set.
+static void TakeReady(GuestQueue& q, std::vector<NetTask>& out,
+                      NetClock::time_point older_than = NetClock::time_point::max()) {
+    std::lock_guard lock(q.mutex);
+    auto keep = q.ready.begin();
+    for (auto it = q.ready.begin(); it != q.ready.end(); ++it) {
+        if (it->ready_at <= older_than) {
+            out.push_back(std::move(it->fn));
+        } else {
+            *keep++ = std::move(*it);
+        }
+    }
+    q.ready.erase(keep, q.ready.end());
+}
+
+void NetDrainGuest() {
+    if (g_guest_ready_total.load(std::memory_order_relaxed) == 0) return;
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    std::vector<NetTask> run;
+    TakeReady(OwnGuestQueue(), run);
+
+    if (g_guest_ready_total.load(std::memory_order_relaxed) > (int)run.size()) {
+        // Other threads have due work — take anything they've left too long.
+        auto cutoff = NetClock::now() - GUEST_STEAL_AFTER;
+        std::lock_guard lock(g_guest_queues_mutex);
+        for (auto& q : g_guest_queues) {
+            if (q != t_guest_queue) TakeReady(*q, run, cutoff);
+        }
+    }
+
+    if (run.empty()) return;
+    g_guest_ready_total.fetch_sub((int)run.size(), std::memory_order_relaxed);
+    for (auto& fn : run) fn();
+}
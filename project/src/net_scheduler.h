@@ -0,0 +1,42 @@
+// vig8 - Deadline scheduler for networking completions
+//
+// One timer thread owns a min-heap of deadlines (steady_clock) and sleeps
+// until the earliest one. Tasks either run on the timer thread itself or,
+// when they must run on a guest thread (anything that calls into
+// kernel_state(), e.g. CompleteOverlappedImmediate), are handed to the
+// posting guest thread's queue and run at its next NetDrainGuest().
+//
+// NetDrainGuest() is a single relaxed atomic load when nothing is ready, so
+// it can sit on hot guest import paths.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+using NetClock = std::chrono::steady_clock;
+using NetTask  = std::function<void()>;
+
+// Start/stop the timer thread. Stop drops anything not yet fired.
+void NetTimerStart();
+void NetTimerStop();
+
+// Run `fn` on the timer thread at `deadline`. Returns an id for
+// NetTimerCancel. Never runs inline, even if the deadline has passed.
+uint64_t NetTimerRunAt(NetClock::time_point deadline, NetTask fn);
+inline uint64_t NetTimerRunAfter(NetClock::duration delay, NetTask fn) {
+    return NetTimerRunAt(NetClock::now() + delay, std::move(fn));
+}
+
+// Cancel a timer task. Returns false if it already fired or was unknown.
+bool NetTimerCancel(uint64_t id);
+
+// Run `fn` on the calling guest thread at its first NetDrainGuest() after
+// `deadline`. If that thread doesn't drain within a short grace period
+// any guest thread that drains will run it instead, so a completion is
+// never stranded on a thread that stopped calling in.
+void NetPostToGuest(NetClock::time_point deadline, NetTask fn);
+
+// Run guest tasks that are due. Call from guest threads only.
+void NetDrainGuest();
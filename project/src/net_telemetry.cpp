@@ -0,0 +1,383 @@
+// vig8 - Per-peer network telemetry
+// See net_telemetry.h.
+
+#include "net_telemetry.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#endif
+
+// ============================================================================
+// Counter table
+// ============================================================================
+
+static constexpr uint32_t kSlotsLog2 = 8;
+static constexpr uint32_t kSlots = 1u << kSlotsLog2;   // peers tracked
+static constexpr uint32_t kMask = kSlots - 1;
+
+struct PeerSlot {
+    std::atomic<uint32_t> ip{0};  // 0 = free
+    std::atomic<uint64_t> tx_packets{0}, tx_bytes{0};
+    std::atomic<uint64_t> rx_packets{0}, rx_bytes{0};
+    std::atomic<uint64_t> dropped{0}, reordered{0};
+    std::atomic<int64_t>  discovered_ms{-1}, connected_ms{-1};
+    std::atomic<int64_t>  last_rx_ns{0};
+
+    // Written by the discovery thread only; atomics so sampling can read.
+    std::atomic<uint32_t> srtt_us{0}, rttvar_us{0};
+    std::atomic<uint64_t> rtt_samples{0};
+    std::atomic<uint64_t> replies_expected{0}, replies_seen{0};
+    std::atomic<uint64_t> beacons_seen{0}, beacons_missed{0};
+    std::atomic<int64_t>  last_beacon_ns{0};
+};
+
+static PeerSlot g_slots[kSlots];
+
+// A freed slot. 255.255.255.255 is never a peer.
+static constexpr uint32_t kTombstone = 0xFFFFFFFFu;
+
+// Serializes claiming and freeing slots; counter updates stay lock-free.
+static std::mutex g_claim_mutex;
+
+static uint32_t Home(uint32_t ip) {
+    return (ip * 0x9E3779B1u) >> (32 - kSlotsLog2);
+}
+
+// Lookup only: never claims a slot.
+static PeerSlot* FindSlot(uint32_t ip) {
+    if (ip == 0 || ip == kTombstone) return nullptr;
+    uint32_t i = Home(ip);
+    for (uint32_t n = 0; n < kSlots; n++, i = (i + 1) & kMask) {
+        uint32_t k = g_slots[i].ip.load(std::memory_order_acquire);
+        if (k == ip) return &g_slots[i];
+        if (k == 0) return nullptr;
+    }
+    return nullptr;
+}
+
+static void ClearCounters(PeerSlot& s) {
+    s.tx_packets = 0; s.tx_bytes = 0;
+    s.rx_packets = 0; s.rx_bytes = 0;
+    s.dropped = 0; s.reordered = 0;
+    s.discovered_ms = -1; s.connected_ms = -1;
+    s.last_rx_ns = 0;
+    s.srtt_us = 0; s.rttvar_us = 0; s.rtt_samples = 0;
+    s.replies_expected = 0; s.replies_seen = 0;
+    s.beacons_seen = 0; s.beacons_missed = 0;
+    s.last_beacon_ns = 0;
+}
+
+// Find or claim the slot for a peer, reusing the first freed slot on its
+// probe chain. Counters start from zero. An update racing with the free
+// of the slot's previous peer can still land in it; that's one packet.
+static PeerSlot* ClaimSlot(uint32_t ip) {
+    if (ip == 0 || ip == kTombstone) return nullptr;
+    std::lock_guard lock(g_claim_mutex);
+    PeerSlot* reuse = nullptr;
+    uint32_t i = Home(ip);
+    for (uint32_t n = 0; n < kSlots; n++, i = (i + 1) & kMask) {
+        uint32_t k = g_slots[i].ip.load(std::memory_order_relaxed);
+        if (k == ip) return &g_slots[i];
+        if (k == kTombstone && !reuse) reuse = &g_slots[i];
+        if (k == 0) {
+            if (!reuse) reuse = &g_slots[i];
+            break;
+        }
+    }
+    if (!reuse) return nullptr;  // table full — stop counting new peers
+    ClearCounters(*reuse);
+    reuse->ip.store(ip, std::memory_order_release);
+    return reuse;
+}
+
+static void Add(std::atomic<uint64_t>& c, uint64_t v) {
+    c.fetch_add(v, std::memory_order_relaxed);
+}
+
+// Set `v` only if still unset (-1).
+static void SetOnce(std::atomic<int64_t>& c, int64_t v) {
+    int64_t unset = -1;
+    c.compare_exchange_strong(unset, v, std::memory_order_relaxed);
+}
+
+void NetTelemetryTx(uint32_t ip, uint32_t bytes) {
+    if (PeerSlot* s = FindSlot(ip)) {
+        Add(s->tx_packets, 1);
+        Add(s->tx_bytes, bytes);
+    }
+}
+
+void NetTelemetryRx(uint32_t ip, uint32_t bytes, int64_t now_ns) {
+    if (PeerSlot* s = FindSlot(ip)) {
+        Add(s->rx_packets, 1);
+        Add(s->rx_bytes, bytes);
+        s->last_rx_ns.store(now_ns, std::memory_order_relaxed);
+    }
+}
+
+void NetTelemetryDropped(uint32_t ip) {
+    if (PeerSlot* s = FindSlot(ip)) Add(s->dropped, 1);
+}
+
+void NetTelemetryReordered(uint32_t ip) {
+    if (PeerSlot* s = FindSlot(ip)) Add(s->reordered, 1);
+}
+
+void NetTelemetryDiscovered(uint32_t ip, int64_t uptime_ms) {
+    if (PeerSlot* s = ClaimSlot(ip)) SetOnce(s->discovered_ms, uptime_ms);
+}
+
+void NetTelemetryConnected(uint32_t ip, int64_t uptime_ms) {
+    if (PeerSlot* s = ClaimSlot(ip)) SetOnce(s->connected_ms, uptime_ms);
+}
+
+void NetTelemetryForget(uint32_t ip) {
+    if (ip == 0 || ip == kTombstone) return;
+    std::lock_guard lock(g_claim_mutex);
+    uint32_t i = Home(ip);
+    for (uint32_t n = 0; n < kSlots; n++, i = (i + 1) & kMask) {
+        uint32_t k = g_slots[i].ip.load(std::memory_order_relaxed);
+        if (k == 0) return;
+        if (k != ip) continue;
+        g_slots[i].ip.store(kTombstone, std::memory_order_release);
+        // Tombstones that end a probe chain are dead weight: free them
+        while (g_slots[i].ip.load(std::memory_order_relaxed) == kTombstone &&
+               g_slots[(i + 1) & kMask].ip.load(std::memory_order_relaxed) == 0) {
+            g_slots[i].ip.store(0, std::memory_order_release);
+            i = (i - 1) & kMask;
+        }
+        return;
+    }
+}
+
+void NetTelemetryProbesSent(uint32_t ip, uint32_t replies) {
+    if (PeerSlot* s = FindSlot(ip)) Add(s->replies_expected, replies);
+}
+
+void NetTelemetryRtt(uint32_t ip, uint32_t rtt_us) {
+    PeerSlot* s = FindSlot(ip);
+    if (!s) return;
+    // RFC 6298 smoothing: SRTT gain 1/8, RTTVAR gain 1/4
+    uint32_t srtt = s->srtt_us.load(std::memory_order_relaxed);
+    uint32_t var  = s->rttvar_us.load(std::memory_order_relaxed);
+    if (s->rtt_samples.load(std::memory_order_relaxed) == 0) {
+        srtt = rtt_us;
+        var  = rtt_us / 2;
+    } else {
+        uint32_t dev = srtt > rtt_us ? srtt - rtt_us : rtt_us - srtt;
+        var  = (uint32_t)(((uint64_t)var * 3 + dev) / 4);
+        srtt = (uint32_t)(((uint64_t)srtt * 7 + rtt_us) / 8);
+    }
+    s->srtt_us.store(srtt, std::memory_order_relaxed);
+    s->rttvar_us.store(var, std::memory_order_relaxed);
+    Add(s->rtt_samples, 1);
+    Add(s->replies_seen, 1);
+}
+
+uint32_t NetTelemetryRttUs(uint32_t ip) {
+    const PeerSlot* s = FindSlot(ip);
+    return s ? s->srtt_us.load(std::memory_order_relaxed) : 0;
+}
+
+void NetTelemetryBeacon(uint32_t ip, int64_t now_ns, int64_t interval_ns) {
+    PeerSlot* s = FindSlot(ip);
+    if (!s || interval_ns <= 0) return;
+    int64_t last = s->last_beacon_ns.exchange(now_ns, std::memory_order_relaxed);
+    Add(s->beacons_seen, 1);
+    if (last == 0) return;
+    // Anything beyond 1.5 intervals means beacons went missing. A gap of
+    // ten or more is a host that stopped hosting and started again.
+    int64_t gap = now_ns - last;
+    if (gap > interval_ns * 3 / 2 && gap < interval_ns * 10) {
+        Add(s->beacons_missed, (uint64_t)((gap + interval_ns / 2) / interval_ns - 1));
+    }
+}
+
+// ============================================================================
+// Sampling
+// ============================================================================
+
+// Sampler-private previous byte counts, for rates, and the peer they were
+// taken for (a freed slot may since hold another). Indexed like g_slots.
+static uint32_t   g_prev_ip[kSlots];
+static uint64_t   g_prev_tx_bytes[kSlots];
+static uint64_t   g_prev_rx_bytes[kSlots];
+static int64_t    g_prev_sample_ns = 0;
+
+static std::mutex                 g_snapshot_mutex;
+static std::vector<NetPeerSample> g_snapshot;
+
+// Read one slot's counters. Rates are left at zero.
+static NetPeerSample ReadSlot(PeerSlot& s, uint32_t ip, int64_t now_ns) {
+    NetPeerSample p = {};
+    p.ip            = ip;
+    p.discovered_ms = s.discovered_ms.load(std::memory_order_relaxed);
+    p.connected_ms  = s.connected_ms.load(std::memory_order_relaxed);
+    p.tx_packets    = s.tx_packets.load(std::memory_order_relaxed);
+    p.tx_bytes      = s.tx_bytes.load(std::memory_order_relaxed);
+    p.rx_packets    = s.rx_packets.load(std::memory_order_relaxed);
+    p.rx_bytes      = s.rx_bytes.load(std::memory_order_relaxed);
+    p.dropped       = s.dropped.load(std::memory_order_relaxed);
+    p.reordered     = s.reordered.load(std::memory_order_relaxed);
+    p.rtt_samples   = s.rtt_samples.load(std::memory_order_relaxed);
+    p.rtt_us        = p.rtt_samples ? s.srtt_us.load(std::memory_order_relaxed) : 0;
+    p.jitter_us     = p.rtt_samples ? s.rttvar_us.load(std::memory_order_relaxed) : 0;
+
+    uint64_t expected = s.replies_expected.load(std::memory_order_relaxed);
+    uint64_t seen     = s.replies_seen.load(std::memory_order_relaxed);
+    uint64_t b_seen   = s.beacons_seen.load(std::memory_order_relaxed);
+    uint64_t b_missed = s.beacons_missed.load(std::memory_order_relaxed);
+    // Replies for the latest probes may still be in flight, and a late
+    // reply can arrive after its probe was already counted lost.
+    uint64_t lost  = (expected > seen ? expected - seen : 0) + b_missed;
+    uint64_t total = std::max(expected, seen) + b_seen + b_missed;
+    p.loss_pct = total ? 100.0 * (double)lost / (double)total : -1.0;
+
+    int64_t last_rx = s.last_rx_ns.load(std::memory_order_relaxed);
+    p.since_rx_ms = last_rx ? std::max<int64_t>(0, (now_ns - last_rx) / 1000000) : -1;
+    return p;
+}
+
+std::vector<NetPeerSample> NetTelemetryRead(int64_t now_ns) {
+    std::vector<NetPeerSample> out;
+    for (auto& s : g_slots) {
+        uint32_t ip = s.ip.load(std::memory_order_acquire);
+        if (ip != 0 && ip != kTombstone) out.push_back(ReadSlot(s, ip, now_ns));
+    }
+    return out;
+}
+
+void NetTelemetrySample(int64_t now_ns) {
+    std::vector<NetPeerSample> out;
+    double dt_s = g_prev_sample_ns ? (double)(now_ns - g_prev_sample_ns) / 1e9 : 0.0;
+    g_prev_sample_ns = now_ns;
+
+    for (uint32_t i = 0; i < kSlots; i++) {
+        uint32_t ip = g_slots[i].ip.load(std::memory_order_acquire);
+        if (ip == 0 || ip == kTombstone) continue;
+        NetPeerSample p = ReadSlot(g_slots[i], ip, now_ns);
+        if (g_prev_ip[i] != ip) {
+            g_prev_ip[i] = ip;
+            g_prev_tx_bytes[i] = g_prev_rx_bytes[i] = 0;
+        }
+        if (dt_s > 0) {
+            p.tx_kbps = (double)(p.tx_bytes - g_prev_tx_bytes[i]) * 8 / 1000 / dt_s;
+            p.rx_kbps = (double)(p.rx_bytes - g_prev_rx_bytes[i]) * 8 / 1000 / dt_s;
+        }
+        g_prev_tx_bytes[i] = p.tx_bytes;
+        g_prev_rx_bytes[i] = p.rx_bytes;
+        out.push_back(p);
+    }
+
+    std::lock_guard lock(g_snapshot_mutex);
+    g_snapshot.swap(out);
+}
+
+std::vector<NetPeerSample> NetTelemetrySnapshot() {
+    std::lock_guard lock(g_snapshot_mutex);
+    return g_snapshot;
+}
+
+// ============================================================================
+// Prometheus export
+// ============================================================================
+
+bool NetTelemetryWritePrometheus(const std::string& path, const std::string& instance,
+                                 uint64_t frame, int64_t uptime_ms, int64_t now_ns) {
+    std::vector<NetPeerSample> peers = NetTelemetryRead(now_ns);
+    std::string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "w");
+    if (!f) return false;
+
+    fprintf(f, "# HELP vig8_net_uptime_seconds Time since networking started.\n");
+    fprintf(f, "# TYPE vig8_net_uptime_seconds gauge\n");
+    fprintf(f, "vig8_net_uptime_seconds{instance=\"%s\"} %.3f\n", instance.c_str(),
+            (double)uptime_ms / 1000.0);
+    fprintf(f, "# HELP vig8_frames_total Guest frames presented.\n");
+    fprintf(f, "# TYPE vig8_frames_total counter\n");
+    fprintf(f, "vig8_frames_total{instance=\"%s\"} %llu\n", instance.c_str(),
+            (unsigned long long)frame);
+
+    std::vector<std::string> labels;
+    for (auto& p : peers) {
+        char ip_str[INET_ADDRSTRLEN] = {};
+        struct in_addr a;
+        a.s_addr = p.ip;
+        inet_ntop(AF_INET, &a, ip_str, sizeof(ip_str));
+        labels.push_back("{instance=\"" + instance + "\",peer=\"" + ip_str + "\"}");
+    }
+
+    // One metric family at a time, as the format requires.
+    auto family = [&](const char* name, const char* type, const char* help, auto value) {
+        fprintf(f, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+        for (size_t i = 0; i < peers.size(); i++) {
+            double v;
+            if (!value(peers[i], &v)) continue;
+            fprintf(f, "%s%s %.6g\n", name, labels[i].c_str(), v);
+        }
+    };
+    family("vig8_net_peer_tx_packets_total", "counter", "Datagrams sent to the peer.",
+           [](const NetPeerSample& p, double* v) { *v = (double)p.tx_packets; return true; });
+    family("vig8_net_peer_tx_bytes_total", "counter", "Bytes sent to the peer.",
+           [](const NetPeerSample& p, double* v) { *v = (double)p.tx_bytes; return true; });
+    family("vig8_net_peer_rx_packets_total", "counter", "Datagrams received from the peer.",
+           [](const NetPeerSample& p, double* v) { *v = (double)p.rx_packets; return true; });
+    family("vig8_net_peer_rx_bytes_total", "counter", "Bytes received from the peer.",
+           [](const NetPeerSample& p, double* v) { *v = (double)p.rx_bytes; return true; });
+    family("vig8_net_peer_dropped_total", "counter", "Datagrams dropped by test impairment.",
+           [](const NetPeerSample& p, double* v) { *v = (double)p.dropped; return true; });
+    family("vig8_net_peer_rtt_seconds", "gauge", "Smoothed round-trip time from QoS probes.",
+           [](const NetPeerSample& p, double* v) {
+               *v = p.rtt_us / 1e6;
+               return p.rtt_samples > 0;
+           });
+    family("vig8_net_peer_jitter_seconds", "gauge", "Smoothed round-trip time deviation.",
+           [](const NetPeerSample& p, double* v) {
+               *v = p.jitter_us / 1e6;
+               return p.rtt_samples > 0;
+           });
+    family("vig8_net_peer_loss_ratio", "gauge", "Inferred loss (QoS probes, beacon gaps).",
+           [](const NetPeerSample& p, double* v) {
+               *v = p.loss_pct / 100.0;
+               return p.loss_pct >= 0;
+           });
+    family("vig8_net_peer_last_rx_age_seconds", "gauge", "Time since the last datagram.",
+           [](const NetPeerSample& p, double* v) {
+               *v = p.since_rx_ms / 1000.0;
+               return p.since_rx_ms >= 0;
+           });
+    family("vig8_net_peer_connected", "gauge", "1 once the game has connected to the peer.",
+           [](const NetPeerSample& p, double* v) { *v = p.connected_ms >= 0; return true; });
+    fclose(f);
+
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    return !ec;
+}
+
+void NetTelemetryReset() {
+    {
+        std::lock_guard lock(g_claim_mutex);
+        for (auto& s : g_slots) {
+            s.ip.store(0, std::memory_order_relaxed);
+            ClearCounters(s);
+        }
+    }
+    std::memset(g_prev_ip, 0, sizeof(g_prev_ip));
+    std::memset(g_prev_tx_bytes, 0, sizeof(g_prev_tx_bytes));
+    std::memset(g_prev_rx_bytes, 0, sizeof(g_prev_rx_bytes));
+    g_prev_sample_ns = 0;
+    std::lock_guard lock(g_snapshot_mutex);
+    g_snapshot.clear();
+}
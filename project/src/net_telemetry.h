@@ -0,0 +1,86 @@
+// vig8 - Per-peer network telemetry
+//
+// Counters live in a fixed open-addressing table keyed by peer IPv4. The
+// hot paths (every send/receive) do one lock-free probe and relaxed atomic
+// adds. Only peers get a slot: it is claimed when a peer enters the peer
+// table (NetTelemetryDiscovered / NetTelemetryConnected) and freed when it
+// leaves (NetTelemetryForget). Traffic with anything else — broadcast, the
+// relay, one-off senders — isn't counted, so the table can't fill up with
+// strangers over a long session.
+//
+// Once per frame NetTelemetrySample() turns the raw counters into a
+// snapshot with derived figures (rates, loss, time since last packet) for
+// the debug overlay. The stats and metrics files read the counters directly.
+//
+// RTT and jitter come from QoS probe replies (smoothed like TCP's SRTT and
+// RTTVAR). Game datagrams carry no sequence numbers we can see, so loss is
+// inferred where it is observable: unanswered QoS probes, and gaps in a
+// host's fixed-rate discovery beacons.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct NetPeerSample {
+    uint32_t ip;                 // network byte order
+    int64_t  discovered_ms;      // ms since NetInit, -1 = never
+    int64_t  connected_ms;       // ms since NetInit, -1 = never
+    uint64_t tx_packets, tx_bytes;
+    uint64_t rx_packets, rx_bytes;
+    uint64_t dropped;            // impairment loss / bandwidth queue overflow
+    uint64_t reordered;
+    uint32_t rtt_us;             // smoothed RTT, 0 = no sample yet
+    uint32_t jitter_us;          // smoothed RTT deviation
+    uint64_t rtt_samples;
+    double   loss_pct;           // -1 = nothing observable yet
+    int64_t  since_rx_ms;        // -1 = never heard from
+    double   tx_kbps, rx_kbps;   // since the previous sample
+};
+
+// ---- Hot-path updates (any thread) ----
+
+void NetTelemetryTx(uint32_t ip, uint32_t bytes);
+void NetTelemetryRx(uint32_t ip, uint32_t bytes, int64_t now_ns);
+void NetTelemetryDropped(uint32_t ip);
+void NetTelemetryReordered(uint32_t ip);
+
+// ---- Peer lifetime ----
+
+// The peer entered the peer table (heard from / connected to). Claims its
+// slot if it has none.
+void NetTelemetryDiscovered(uint32_t ip, int64_t uptime_ms);
+void NetTelemetryConnected(uint32_t ip, int64_t uptime_ms);
+// The peer left the peer table: free its slot and counters.
+void NetTelemetryForget(uint32_t ip);
+
+// ---- Quality inputs (discovery thread) ----
+
+// `replies` QoS replies are expected for probes just sent to `ip`.
+void NetTelemetryProbesSent(uint32_t ip, uint32_t replies);
+void NetTelemetryRtt(uint32_t ip, uint32_t rtt_us);
+// A beacon from a host that beacons every `interval_ns`.
+void NetTelemetryBeacon(uint32_t ip, int64_t now_ns, int64_t interval_ns);
+
+// Smoothed RTT to `ip`, 0 if never measured. Lock-free; never claims a slot.
+uint32_t NetTelemetryRttUs(uint32_t ip);
+
+// ---- Sampling ----
+
+// Build and publish a snapshot. Call once per frame from one thread.
+void NetTelemetrySample(int64_t now_ns);
+
+// The latest published snapshot (empty before the first sample).
+std::vector<NetPeerSample> NetTelemetrySnapshot();
+
+// Read the counters now, without rates. For exporters that must not depend
+// on frames being presented.
+std::vector<NetPeerSample> NetTelemetryRead(int64_t now_ns);
+
+// Write the current counters in Prometheus text exposition format
+// (temp file + rename). `instance` becomes a label on every series.
+bool NetTelemetryWritePrometheus(const std::string& path, const std::string& instance,
+                                 uint64_t frame, int64_t uptime_ms, int64_t now_ns);
+
+void NetTelemetryReset();
@@ -0,0 +1,336 @@
+// vig8 - Compressed game-traffic tunnel
+// See net_tunnel.h.
+
+#include "net_tunnel.h"
+
+#include <rex/logging.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+// ============================================================================
+// LZ4 block format
+// ============================================================================
+//
+// Sequences of [token][literal length...][literals][offset LE16][match
+// length...]; the last sequence is literals only. Game state packets are
+// short, so this is a single-pass greedy matcher with a small hash table
+// and no acceleration skipping.
+
+static constexpr int LZ4_MIN_MATCH   = 4;
+static constexpr int LZ4_LAST_LITS   = 5;   // last 5 bytes are always literals
+static constexpr int LZ4_MFLIMIT     = 12;  // no match may start in the last 12 bytes
+static constexpr int LZ4_HASH_LOG    = 12;
+static constexpr int LZ4_MAX_OFFSET  = 65535;
+
+static inline uint32_t Read32(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+static inline uint32_t Lz4Hash(uint32_t v) {
+    return (v * 2654435761u) >> (32 - LZ4_HASH_LOG);
+}
+
+// Append a 4-bit-overflow length (the 15 in the token) as 255-runs.
+static inline bool PutLength(uint8_t*& op, const uint8_t* oend, int len) {
+    for (; len >= 255; len -= 255) {
+        if (op >= oend) return false;
+        *op++ = 255;
+    }
+    if (op >= oend) return false;
+    *op++ = (uint8_t)len;
+    return true;
+}
+
+static bool EmitSequence(uint8_t*& op, const uint8_t* oend, const uint8_t* lit, int lit_len,
+                         int offset, int match_len) {
+    if (op >= oend) return false;
+    uint8_t* token = op++;
+    *token = (uint8_t)(std::min(lit_len, 15) << 4);
+    if (lit_len >= 15 && !PutLength(op, oend, lit_len - 15)) return false;
+    if (oend - op < lit_len) return false;
+    if (lit_len) std::memcpy(op, lit, (size_t)lit_len);
+    op += lit_len;
+    if (match_len == 0) return true;  // final literals-only sequence
+
+    if (oend - op < 2) return false;
+    *op++ = (uint8_t)offset;
+    *op++ = (uint8_t)(offset >> 8);
+    int ml = match_len - LZ4_MIN_MATCH;
+    *token |= (uint8_t)std::min(ml, 15);
+    if (ml >= 15 && !PutLength(op, oend, ml - 15)) return false;
+    return true;
+}
+
+int Lz4CompressBlock(const uint8_t* src, int src_len, uint8_t* dst, int dst_cap) {
+    uint8_t* op = dst;
+    const uint8_t* oend = dst + dst_cap;
+    const uint8_t* anchor = src;
+
+    if (src_len >= LZ4_MFLIMIT + 1) {
+        int32_t table[1 << LZ4_HASH_LOG];
+        std::fill(std::begin(table), std::end(table), -1);
+        const uint8_t* ip = src;
+        const uint8_t* match_limit = src + src_len - LZ4_LAST_LITS;
+        const uint8_t* start_limit = src + src_len - LZ4_MFLIMIT;
+
+        while (ip < start_limit) {
+            uint32_t seq = Read32(ip);
+            uint32_t h = Lz4Hash(seq);
+            int32_t cand = table[h];
+            table[h] = (int32_t)(ip - src);
+            if (cand < 0 || (ip - src) - cand > LZ4_MAX_OFFSET || Read32(src + cand) != seq) {
+                ip++;
+                continue;
+            }
+            const uint8_t* ref = src + cand;
+            // Extend backwards over literals, then forwards
+            while (ip > anchor && ref > src && ip[-1] == ref[-1]) { ip--; ref--; }
+            const uint8_t* mp = ip + LZ4_MIN_MATCH;
+            const uint8_t* rp = ref + LZ4_MIN_MATCH;
+            while (mp < match_limit && *mp == *rp) { mp++; rp++; }
+
+            if (!EmitSequence(op, oend, anchor, (int)(ip - anchor), (int)(ip - ref),
+                              (int)(mp - ip))) {
+                return 0;
+            }
+            ip = mp;
+            anchor = ip;
+            if (ip < start_limit) table[Lz4Hash(Read32(ip - 2))] = (int32_t)(ip - 2 - src);
+        }
+    }
+    if (!EmitSequence(op, oend, anchor, (int)(src + src_len - anchor), 0, 0)) return 0;
+    return (int)(op - dst);
+}
+
+bool Lz4DecompressBlock(const uint8_t* src, int src_len, uint8_t* dst, int dst_len) {
+    const uint8_t* ip = src;
+    const uint8_t* iend = src + src_len;
+    uint8_t* op = dst;
+    uint8_t* oend = dst + dst_len;
+
+    auto get_length = [&](int len) -> int {
+        if (len != 15) return len;
+        uint8_t b;
+        do {
+            if (ip >= iend) return -1;
+            b = *ip++;
+            len += b;
+        } while (b == 255 && len < (1 << 24));
+        return len;
+    };
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+        int lit = get_length(token >> 4);
+        if (lit < 0 || iend - ip < lit || oend - op < lit) return false;
+        if (lit) std::memcpy(op, ip, (size_t)lit);
+        ip += lit;
+        op += lit;
+        if (ip == iend) break;  // last sequence has no match
+
+        if (iend - ip < 2) return false;
+        int offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op - dst) return false;
+        int ml = get_length(token & 15);
+        if (ml < 0) return false;
+        ml += LZ4_MIN_MATCH;
+        if (oend - op < ml) return false;
+        // Byte copy: matches may overlap their own output
+        const uint8_t* ref = op - offset;
+        for (int i = 0; i < ml; i++) op[i] = ref[i];
+        op += ml;
+    }
+    return op == oend;
+}
+
+// ============================================================================
+// Batching
+// ============================================================================
+
+static constexpr uint8_t TUNNEL_MAGIC[3] = {'V', '8', 'T'};
+static constexpr int     TUNNEL_HEADER = 6;
+static constexpr uint8_t TUNNEL_FLAG_LZ4 = 0x01;
+
+struct TunnelBatch {
+    SOCKET               sock;
+    struct sockaddr_in   dest;
+    std::vector<uint8_t> body;
+    std::vector<int64_t> enqueued_ns;  // per datagram, for hold time
+};
+
+using BatchKey = std::tuple<SOCKET, uint32_t, uint16_t>;  // socket, ip, port
+
+static std::mutex                        g_tunnel_mutex;
+static bool                              g_tunnel_enabled = false;
+static TunnelSendFn                      g_tunnel_send;
+static std::map<BatchKey, TunnelBatch>   g_batches;
+static bool                              g_flush_timer_armed = false;
+static TunnelStats                       g_stats = {};
+
+static int64_t TunnelNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        NetClock::now().time_since_epoch()).count();
+}
+
+// Caller holds g_tunnel_mutex. Sends under the lock so batches to one
+// destination leave in order even with a frame flush and a timer flush
+// racing.
+static void SendBatch(TunnelBatch& b, int64_t now_ns) {
+    if (b.enqueued_ns.empty()) return;
+    int raw = (int)b.body.size();
+    std::vector<uint8_t> pkt((size_t)TUNNEL_HEADER + raw + raw / 255 + 16);
+    std::memcpy(pkt.data(), TUNNEL_MAGIC, 3);
+    pkt[4] = (uint8_t)(raw >> 8);
+    pkt[5] = (uint8_t)raw;
+
+    // Keep the compressed form only if it is smaller
+    int clen = Lz4CompressBlock(b.body.data(), raw, pkt.data() + TUNNEL_HEADER,
+                                (int)pkt.size() - TUNNEL_HEADER);
+    if (clen > 0 && clen < raw) {
+        pkt[3] = TUNNEL_FLAG_LZ4;
+        pkt.resize((size_t)TUNNEL_HEADER + clen);
+        g_stats.compressed++;
+    } else {
+        pkt[3] = 0;
+        std::memcpy(pkt.data() + TUNNEL_HEADER, b.body.data(), (size_t)raw);
+        pkt.resize((size_t)TUNNEL_HEADER + raw);
+    }
+    g_tunnel_send(b.sock, b.dest, pkt.data(), (int)pkt.size());
+
+    g_stats.packets++;
+    g_stats.wire_bytes += pkt.size();
+    for (int64_t t : b.enqueued_ns) {
+        uint64_t hold_us = (uint64_t)std::max<int64_t>(0, (now_ns - t) / 1000);
+        g_stats.hold_us_total += hold_us;
+        g_stats.hold_us_max = std::max(g_stats.hold_us_max, hold_us);
+    }
+    b.body.clear();
+    b.enqueued_ns.clear();
+}
+
+static void FlushLocked() {
+    int64_t now_ns = TunnelNowNs();
+    for (auto& [key, b] : g_batches) SendBatch(b, now_ns);
+}
+
+void TunnelStart(TunnelSendFn send) {
+    std::lock_guard lock(g_tunnel_mutex);
+    g_tunnel_send = std::move(send);
+    g_tunnel_enabled = true;
+    g_stats = {};
+    REXLOG_INFO("[NET] Game traffic tunnel enabled (LZ4, per-frame batching)");
+}
+
+void TunnelStop() {
+    std::lock_guard lock(g_tunnel_mutex);
+    if (!g_tunnel_enabled) return;
+    FlushLocked();
+    g_batches.clear();
+    g_tunnel_enabled = false;
+    if (g_stats.datagrams) {
+        REXLOG_INFO("[NET] Tunnel: {} datagrams in {} packets, {} -> {} bytes, "
+                    "avg hold {} us, max {} us",
+                    g_stats.datagrams, g_stats.packets, g_stats.raw_bytes, g_stats.wire_bytes,
+                    g_stats.hold_us_total / g_stats.datagrams, g_stats.hold_us_max);
+    }
+}
+
+bool TunnelEnabled() {
+    std::lock_guard lock(g_tunnel_mutex);
+    return g_tunnel_enabled;
+}
+
+bool TunnelEnqueue(SOCKET sock, const struct sockaddr_in& dest,
+                   const uint8_t* data, int len) {
+    if (len > TUNNEL_MAX_DATAGRAM) return false;
+    bool arm_timer = false;
+    {
+        std::lock_guard lock(g_tunnel_mutex);
+        if (!g_tunnel_enabled) return false;
+        BatchKey key{sock, dest.sin_addr.s_addr, dest.sin_port};
+        auto [it, inserted] = g_batches.try_emplace(key);
+        TunnelBatch& b = it->second;
+        if (inserted) {
+            b.sock = sock;
+            b.dest = dest;
+        }
+        if (!b.body.empty() && (int)b.body.size() + 2 + len > TUNNEL_MAX_BODY) {
+            SendBatch(b, TunnelNowNs());
+        }
+        b.body.push_back((uint8_t)(len >> 8));
+        b.body.push_back((uint8_t)len);
+        b.body.insert(b.body.end(), data, data + len);
+        b.enqueued_ns.push_back(TunnelNowNs());
+        g_stats.datagrams++;
+        g_stats.raw_bytes += (uint64_t)len;
+
+        if (!g_flush_timer_armed) {
+            g_flush_timer_armed = true;
+            arm_timer = true;
+        }
+    }
+    // Backstop for when no frame ends soon (loading screens, a stalled
+    // render thread): nothing waits longer than TUNNEL_MAX_HOLD.
+    if (arm_timer) {
+        NetTimerRunAfter(TUNNEL_MAX_HOLD, []() {
+            std::lock_guard lock(g_tunnel_mutex);
+            g_flush_timer_armed = false;
+            if (g_tunnel_enabled) FlushLocked();
+        });
+    }
+    return true;
+}
+
+void TunnelFlush() {
+    std::lock_guard lock(g_tunnel_mutex);
+    if (g_tunnel_enabled) FlushLocked();
+}
+
+bool TunnelDecode(const uint8_t* pkt, int n, std::vector<std::vector<uint8_t>>* out) {
+    if (n < TUNNEL_HEADER || std::memcmp(pkt, TUNNEL_MAGIC, 3) != 0) return false;
+
+    int raw = (pkt[4] << 8) | pkt[5];
+    std::vector<uint8_t> body;
+    const uint8_t* bp = pkt + TUNNEL_HEADER;
+    bool ok = true;
+    if (pkt[3] & TUNNEL_FLAG_LZ4) {
+        body.resize((size_t)raw);
+        ok = Lz4DecompressBlock(bp, n - TUNNEL_HEADER, body.data(), raw);
+        bp = body.data();
+    } else {
+        ok = n - TUNNEL_HEADER == raw;
+    }
+
+    size_t first = out->size();
+    for (int pos = 0; ok && pos < raw; ) {
+        if (raw - pos < 2) { ok = false; break; }
+        int len = (bp[pos] << 8) | bp[pos + 1];
+        pos += 2;
+        if (raw - pos < len) { ok = false; break; }
+        out->emplace_back(bp + pos, bp + pos + len);
+        pos += len;
+    }
+
+    std::lock_guard lock(g_tunnel_mutex);
+    if (!ok) {
+        out->resize(first);
+        g_stats.rx_errors++;
+    } else {
+        g_stats.rx_packets++;
+        g_stats.rx_datagrams += out->size() - first;
+    }
+    return true;
+}
+
+TunnelStats TunnelGetStats() {
+    std::lock_guard lock(g_tunnel_mutex);
+    return g_stats;
+}
@@ -0,0 +1,84 @@
+// vig8 - Compressed game-traffic tunnel
+//
+// With tunneling on, unicast game datagrams are not sent as they are
+// written. They are queued per (socket, destination) and sent once per
+// frame as one tunnel packet:
+//
+//   +0  'V' '8' 'T'
+//   +3  flags      bit 0: body is LZ4-compressed
+//   +4  u16 BE     body size before compression
+//   +6  body       [u16 BE length][datagram bytes] per datagram
+//
+// The receiver splits the body back into the original datagrams, so the
+// guest sees the same datagram boundaries it sent. A batch is also sent
+// early if it would grow past TUNNEL_MAX_BODY, or TUNNEL_MAX_HOLD after
+// its first datagram if no frame ends in the meantime.
+//
+// Both ends must have tunneling enabled; it is not negotiated. There is no
+// escape for the magic either: with tunneling on, any plain datagram from a
+// peer that happens to start with "V8T" is taken for a tunnel packet and,
+// failing to decode, dropped as malformed (counted in rx_errors).
+
+#pragma once
+
+#include "net_scheduler.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <netinet/in.h>
+using SOCKET = int;
+#endif
+
+// Datagrams larger than this bypass the tunnel.
+static constexpr int TUNNEL_MAX_DATAGRAM = 60000;
+// Uncompressed body size at which a batch is sent without waiting.
+static constexpr int TUNNEL_MAX_BODY = 1200;
+// Longest a datagram waits for the frame to end.
+static constexpr auto TUNNEL_MAX_HOLD = std::chrono::milliseconds(16);
+
+using TunnelSendFn = std::function<void(SOCKET, const struct sockaddr_in&,
+                                        const uint8_t*, int)>;
+
+// Enable tunneling; `send` puts a finished tunnel packet on the wire.
+void TunnelStart(TunnelSendFn send);
+// Flush what is queued and disable.
+void TunnelStop();
+bool TunnelEnabled();
+
+// Queue one guest datagram. Returns false if it must be sent directly
+// (tunnel off, or too large).
+bool TunnelEnqueue(SOCKET sock, const struct sockaddr_in& dest,
+                   const uint8_t* data, int len);
+
+// Send every queued batch. Called at the end of each frame.
+void TunnelFlush();
+
+// True if `pkt` is a tunnel packet. Its datagrams are appended to `out`;
+// a malformed packet yields none.
+bool TunnelDecode(const uint8_t* pkt, int n, std::vector<std::vector<uint8_t>>* out);
+
+struct TunnelStats {
+    uint64_t datagrams;       // guest datagrams sent through the tunnel
+    uint64_t packets;         // tunnel packets sent
+    uint64_t compressed;      // of which the body was compressed
+    uint64_t raw_bytes;       // guest payload bytes
+    uint64_t wire_bytes;      // tunnel packet bytes (UDP payload)
+    uint64_t hold_us_total;   // summed queueing delay over all datagrams
+    uint64_t hold_us_max;
+    uint64_t rx_packets;      // tunnel packets received
+    uint64_t rx_datagrams;    // datagrams unpacked from them
+    uint64_t rx_errors;       // malformed tunnel packets dropped
+};
+TunnelStats TunnelGetStats();
+
+// ---- LZ4 block format ----
+// Compress `src` into `dst`; returns the compressed size, or 0 if it
+// does not fit in `dst_cap`.
+int Lz4CompressBlock(const uint8_t* src, int src_len, uint8_t* dst, int dst_cap);
+// Decompress into exactly `dst_len` bytes; returns false on malformed input.
+bool Lz4DecompressBlock(const uint8_t* src, int src_len, uint8_t* dst, int dst_len);
@@ -0,0 +1,406 @@
+// vig8 - Background controller poller
+
+#include "pad_poller.h"
+
+#include <rex/input/input.h>
+#include <rex/logging.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+using namespace rex::input;
+using PadClock = std::chrono::steady_clock;
+
+static int64_t PadNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        PadClock::now().time_since_epoch()).count();
+}
+
+// ============================================================================
+// Backends
+// ============================================================================
+
+#ifdef _WIN32
+// Loaded dynamically to avoid conflicts with the SDK's SDL controller handling.
+struct XINPUT_GAMEPAD_S {
+    WORD  wButtons;
+    BYTE  bLeftTrigger;
+    BYTE  bRightTrigger;
+    SHORT sThumbLX;
+    SHORT sThumbLY;
+    SHORT sThumbRX;
+    SHORT sThumbRY;
+};
+struct XINPUT_STATE_S {
+    DWORD          dwPacketNumber;
+    XINPUT_GAMEPAD_S Gamepad;
+};
+typedef DWORD (WINAPI *XInputGetState_t)(DWORD, XINPUT_STATE_S*);
+
+class XInputBackend final : public PadBackend {
+public:
+    static std::unique_ptr<PadBackend> Create() {
+        HMODULE h = LoadLibraryA("xinput1_4.dll");
+        if (!h) h = LoadLibraryA("xinput1_3.dll");
+        if (!h) h = LoadLibraryA("xinput9_1_0.dll");
+        auto fn = h ? (XInputGetState_t)GetProcAddress(h, "XInputGetState") : nullptr;
+        if (!fn) return nullptr;
+        return std::unique_ptr<PadBackend>(new XInputBackend(fn));
+    }
+
+    const char* Name() const override { return "xinput"; }
+
+    bool Poll(int slot, PadInput* out) override {
+        XINPUT_STATE_S xi;
+        if (get_state_((DWORD)slot, &xi) != ERROR_SUCCESS) return false;
+        out->buttons = xi.Gamepad.wButtons;
+        out->lt = xi.Gamepad.bLeftTrigger;
+        out->rt = xi.Gamepad.bRightTrigger;
+        out->lx = xi.Gamepad.sThumbLX;
+        out->ly = xi.Gamepad.sThumbLY;
+        out->rx = xi.Gamepad.sThumbRX;
+        out->ry = xi.Gamepad.sThumbRY;
+        return true;
+    }
+
+private:
+    explicit XInputBackend(XInputGetState_t fn) : get_state_(fn) {}
+    XInputGetState_t get_state_;
+};
+#else
+static int16_t EvdevStick(const PadAxisRange& r, int32_t v, bool invert) {
+    if (r.max <= r.min) return 0;
+    double t = (double)(v - r.min) / (r.max - r.min) * 2.0 - 1.0;   // -1..1
+    if (invert) t = -t;
+    return (int16_t)std::clamp(t * 32767.0, -32768.0, 32767.0);
+}
+
+static uint8_t EvdevTrigger(const PadAxisRange& r, int32_t v) {
+    if (r.max <= r.min) return v ? 255 : 0;
+    return (uint8_t)std::clamp((v - r.min) * 255 / (r.max - r.min), 0, 255);
+}
+
+void PadEvdevApply(PadInput* out, const PadAxisRange* range, const input_event& ev) {
+    PadInput& in = *out;
+    if (ev.type == EV_KEY) {
+        static const struct { uint16_t code; uint16_t bit; } kButtons[] = {
+            {BTN_A, X_INPUT_GAMEPAD_A},           {BTN_B, X_INPUT_GAMEPAD_B},
+            {BTN_X, X_INPUT_GAMEPAD_X},           {BTN_Y, X_INPUT_GAMEPAD_Y},
+            {BTN_TL, X_INPUT_GAMEPAD_LEFT_SHOULDER}, {BTN_TR, X_INPUT_GAMEPAD_RIGHT_SHOULDER},
+            {BTN_SELECT, X_INPUT_GAMEPAD_BACK},   {BTN_START, X_INPUT_GAMEPAD_START},
+            {BTN_THUMBL, X_INPUT_GAMEPAD_LEFT_THUMB}, {BTN_THUMBR, X_INPUT_GAMEPAD_RIGHT_THUMB},
+            {BTN_DPAD_UP, X_INPUT_GAMEPAD_DPAD_UP},   {BTN_DPAD_DOWN, X_INPUT_GAMEPAD_DPAD_DOWN},
+            {BTN_DPAD_LEFT, X_INPUT_GAMEPAD_DPAD_LEFT}, {BTN_DPAD_RIGHT, X_INPUT_GAMEPAD_DPAD_RIGHT},
+        };
+        for (auto& b : kButtons) {
+            if (ev.code != b.code) continue;
+            in.buttons = ev.value ? (in.buttons | b.bit) : (in.buttons & ~b.bit);
+        }
+    } else if (ev.type == EV_ABS && ev.code < ABS_CNT) {
+        const PadAxisRange& r = range[ev.code];
+        switch (ev.code) {
+        case ABS_X:  in.lx = EvdevStick(r, ev.value, false); break;
+        case ABS_Y:  in.ly = EvdevStick(r, ev.value, true);  break;   // evdev: down is positive
+        case ABS_RX: in.rx = EvdevStick(r, ev.value, false); break;
+        case ABS_RY: in.ry = EvdevStick(r, ev.value, true);  break;
+        case ABS_Z:  in.lt = EvdevTrigger(r, ev.value); break;
+        case ABS_RZ: in.rt = EvdevTrigger(r, ev.value); break;
+        case ABS_HAT0X:
+            in.buttons &= ~(X_INPUT_GAMEPAD_DPAD_LEFT | X_INPUT_GAMEPAD_DPAD_RIGHT);
+            if (ev.value < 0) in.buttons |= X_INPUT_GAMEPAD_DPAD_LEFT;
+            if (ev.value > 0) in.buttons |= X_INPUT_GAMEPAD_DPAD_RIGHT;
+            break;
+        case ABS_HAT0Y:
+            in.buttons &= ~(X_INPUT_GAMEPAD_DPAD_UP | X_INPUT_GAMEPAD_DPAD_DOWN);
+            if (ev.value < 0) in.buttons |= X_INPUT_GAMEPAD_DPAD_UP;
+            if (ev.value > 0) in.buttons |= X_INPUT_GAMEPAD_DPAD_DOWN;
+            break;
+        }
+    }
+}
+
+// Gamepads under /dev/input/event*, handed to free slots in device order
+// as they appear. Events are read non-blocking at each poll.
+class EvdevBackend final : public PadBackend {
+public:
+    ~EvdevBackend() override {
+        for (auto& d : devs_) Close(d);
+    }
+
+    const char* Name() const override { return "evdev"; }
+
+    bool Poll(int slot, PadInput* out) override {
+        Device& d = devs_[slot];
+        if (d.fd < 0) {
+            Scan();
+            if (d.fd < 0) return false;
+        }
+        input_event ev[64];
+        for (;;) {
+            ssize_t n = read(d.fd, ev, sizeof(ev));
+            if (n < 0) {
+                if (errno == EAGAIN || errno == EINTR) break;
+                REXLOG_INFO("[pad] slot {}: {} disconnected", slot, d.path);
+                Close(d);
+                return false;
+            }
+            for (ssize_t i = 0; i < n / (ssize_t)sizeof(input_event); i++) {
+                PadEvdevApply(&d.input, d.range, ev[i]);
+            }
+            if (n < (ssize_t)sizeof(ev)) break;
+        }
+        *out = d.input;
+        return true;
+    }
+
+private:
+    struct Device {
+        int          fd = -1;
+        std::string  path;
+        PadInput     input = {};
+        PadAxisRange range[ABS_CNT];
+    };
+
+    static bool TestBit(const uint8_t* bits, int bit) {
+        return (bits[bit / 8] >> (bit % 8)) & 1;
+    }
+
+    static void Close(Device& d) {
+        if (d.fd >= 0) close(d.fd);
+        d.fd = -1;
+        d.path.clear();
+        d.input = {};
+    }
+
+    // Open gamepads not yet assigned, into free slots. Rate-limited: the
+    // poller calls it for each empty slot.
+    void Scan() {
+        int64_t now = PadNowNs();
+        if (now - last_scan_ns_ < 100000000) return;
+        last_scan_ns_ = now;
+        for (int i = 0; i < 32; i++) {
+            auto free_slot = std::find_if(devs_.begin(), devs_.end(),
+                                          [](const Device& d) { return d.fd < 0; });
+            if (free_slot == devs_.end()) return;
+            std::string path = "/dev/input/event" + std::to_string(i);
+            if (std::any_of(devs_.begin(), devs_.end(),
+                            [&](const Device& d) { return d.path == path; })) continue;
+            int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+            if (fd < 0) continue;
+            uint8_t keys[KEY_MAX / 8 + 1] = {};
+            if (ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keys)), keys) < 0 ||
+                !TestBit(keys, BTN_GAMEPAD)) {
+                close(fd);
+                continue;
+            }
+            Device& d = *free_slot;
+            d.fd = fd;
+            d.path = path;
+            d.input = {};
+            for (int code : {ABS_X, ABS_Y, ABS_RX, ABS_RY, ABS_Z, ABS_RZ}) {
+                input_absinfo info = {};
+                if (ioctl(fd, EVIOCGABS(code), &info) == 0) d.range[code] = {info.minimum, info.maximum};
+            }
+            char name[128] = {};
+            ioctl(fd, EVIOCGNAME(sizeof(name) - 1), name);
+            REXLOG_INFO("[pad] slot {}: {} ({})", (int)(free_slot - devs_.begin()), path, name);
+        }
+    }
+
+    std::array<Device, PAD_SLOTS> devs_;
+    int64_t                       last_scan_ns_ = INT64_MIN / 2;
+};
+#endif  // _WIN32
+
+// Slot 0 only: A pulses for 100 ms every 500 ms, the left stick turns a
+// full circle every 2 s. Deterministic from the poller's start.
+class SyntheticBackend final : public PadBackend {
+public:
+    const char* Name() const override { return "synthetic"; }
+
+    bool Poll(int slot, PadInput* out) override {
+        if (slot != 0) return false;
+        int64_t t_ms = (PadNowNs() - start_ns_) / 1000000;
+        double angle = 2.0 * 3.14159265358979 * (double)(t_ms % 2000) / 2000.0;
+        *out = {};
+        if (t_ms % 500 < 100) out->buttons = X_INPUT_GAMEPAD_A;
+        out->lx = (int16_t)(std::cos(angle) * 32767.0);
+        out->ly = (int16_t)(std::sin(angle) * 32767.0);
+        return true;
+    }
+
+private:
+    int64_t start_ns_ = PadNowNs();
+};
+
+// ============================================================================
+// Poller
+// ============================================================================
+
+// Per-slot seqlock: the poller is the only writer. Readers retry while a
+// write is in progress or if one raced their read.
+struct PadSlot {
+    static constexpr int kWords = (sizeof(PadState) + 7) / 8;
+    std::atomic<uint32_t> seq{0};
+    std::atomic<uint64_t> words[kWords] = {};
+};
+
+static PadSlot                     g_slots[PAD_SLOTS];
+static std::unique_ptr<PadBackend> g_backend;
+static std::thread                 g_poll_thread;
+static std::atomic<bool>           g_poll_running{false};
+
+static void Publish(PadSlot& s, const PadState& st) {
+    uint64_t words[PadSlot::kWords] = {};
+    std::memcpy(words, &st, sizeof(st));
+    s.seq.store(s.seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (int w = 0; w < PadSlot::kWords; w++) s.words[w].store(words[w], std::memory_order_relaxed);
+    s.seq.store(s.seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+PadState PadPollerGet(int slot) {
+    PadState st = {};
+    if (slot < 0 || slot >= PAD_SLOTS) return st;
+    PadSlot& s = g_slots[slot];
+    uint64_t words[PadSlot::kWords];
+    for (;;) {
+        uint32_t before = s.seq.load(std::memory_order_acquire);
+        if (before & 1) continue;
+        for (int w = 0; w < PadSlot::kWords; w++) words[w] = s.words[w].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.seq.load(std::memory_order_relaxed) == before) break;
+    }
+    std::memcpy(&st, words, sizeof(st));
+    return st;
+}
+
+#ifdef _WIN32
+// Sleep() granularity is the system timer tick (often 15.6 ms); a
+// high-resolution waitable timer keeps 1 kHz polling honest.
+static void PadSleepUntil(PadClock::time_point t) {
+    static thread_local HANDLE timer = CreateWaitableTimerExW(
+        nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    auto remaining = t - PadClock::now();
+    if (remaining <= PadClock::duration::zero()) return;
+    if (!timer) {
+        std::this_thread::sleep_until(t);
+        return;
+    }
+    LARGE_INTEGER due;
+    due.QuadPart = -(LONGLONG)(std::chrono::duration_cast<std::chrono::nanoseconds>(remaining).count() / 100);
+    SetWaitableTimer(timer, &due, 0, nullptr, nullptr, FALSE);
+    WaitForSingleObject(timer, INFINITE);
+}
+#else
+static void PadSleepUntil(PadClock::time_point t) {
+    std::this_thread::sleep_until(t);
+}
+#endif
+
+static void PollThreadFunc(PadClock::duration period) {
+    struct SlotPoll {
+        PadState           state = {};
+        PadClock::time_point next;
+        PadClock::duration backoff = PadClock::duration::zero();
+    };
+    SlotPoll slots[PAD_SLOTS];
+    auto tick = PadClock::now();
+    for (auto& s : slots) s.next = tick;
+
+    while (g_poll_running.load(std::memory_order_relaxed)) {
+        auto now = PadClock::now();
+        for (int i = 0; i < PAD_SLOTS; i++) {
+            SlotPoll& s = slots[i];
+            if (now < s.next) continue;
+            PadInput in = {};
+            bool connected = g_backend->Poll(i, &in);
+            PadInput prev = {s.state.buttons, s.state.lt, s.state.rt,
+                             s.state.lx, s.state.ly, s.state.rx, s.state.ry};
+            if (connected != s.state.connected || !(in == prev)) {
+                s.state.connected = connected;
+                s.state.packet++;
+                s.state.buttons = in.buttons;
+                s.state.lt = in.lt;
+                s.state.rt = in.rt;
+                s.state.lx = in.lx;
+                s.state.ly = in.ly;
+                s.state.rx = in.rx;
+                s.state.ry = in.ry;
+                s.state.changed_ns = PadNowNs();
+                Publish(g_slots[i], s.state);
+            }
+            if (connected) {
+                s.backoff = PadClock::duration::zero();
+                s.next = now;
+            } else {
+                s.backoff = s.backoff == PadClock::duration::zero()
+                                ? period
+                                : std::min<PadClock::duration>(s.backoff * 2, PAD_BACKOFF_MAX);
+                s.next = now + s.backoff;
+            }
+        }
+        // Fixed cadence; after a stall, skip the missed ticks
+        tick += period;
+        if (tick < now) tick = now + period;
+        PadSleepUntil(tick);
+    }
+}
+
+bool PadPollerStart(const std::string& backend, int poll_hz) {
+    PadPollerStop();
+    std::string name = backend.empty() ? "auto" : backend;
+    if (name == "none") return true;
+#ifdef _WIN32
+    if (name == "auto" || name == "xinput") g_backend = XInputBackend::Create();
+#else
+    if (name == "auto" || name == "evdev") g_backend = std::make_unique<EvdevBackend>();
+#endif
+    if (name == "synthetic") g_backend = std::make_unique<SyntheticBackend>();
+    if (!g_backend) {
+        REXLOG_WARN("[pad] controller backend \"{}\" is not available", name);
+        return false;
+    }
+
+    PadPollerStartWith(std::move(g_backend), poll_hz);
+    return true;
+}
+
+void PadPollerStartWith(std::unique_ptr<PadBackend> backend, int poll_hz) {
+    PadPollerStop();
+    g_backend = std::move(backend);
+    poll_hz = std::clamp(poll_hz, 1, PAD_MAX_POLL_HZ);
+    auto period = std::chrono::duration_cast<PadClock::duration>(std::chrono::seconds(1)) / poll_hz;
+    for (auto& s : g_slots) Publish(s, PadState{});
+    g_poll_running.store(true, std::memory_order_relaxed);
+    g_poll_thread = std::thread(PollThreadFunc, period);
+    REXLOG_INFO("[pad] polling {} at {} Hz", g_backend->Name(), poll_hz);
+}
+
+void PadPollerStop() {
+    if (g_poll_thread.joinable()) {
+        g_poll_running.store(false, std::memory_order_relaxed);
+        g_poll_thread.join();
+    }
+    g_backend.reset();
+    for (auto& s : g_slots) Publish(s, PadState{});
+}
+
+const char* PadPollerBackend() {
+    return g_backend ? g_backend->Name() : "none";
+}
@@ -0,0 +1,73 @@
+// vig8 - Background controller poller
+//
+// One thread samples the physical controllers of all four user slots at
+// [controls] pad_poll_hz (up to 1 kHz) and publishes each slot's state
+// under a seqlock, so the input driver's GetState reads memory instead of
+// doing HID I/O on the game thread. Backends:
+//   - xinput    (Windows) XInputGetState per slot
+//   - evdev     (Linux) gamepads under /dev/input/event*, in device order
+//   - synthetic a scripted pad on slot 0 for headless tests: A pulses
+//               every 500 ms and the left stick turns a circle every 2 s
+// A disconnected slot (or, for evdev, the device scan) is retried with
+// exponential backoff from one poll period up to PAD_BACKOFF_MAX, since
+// querying an empty XInput slot can take milliseconds.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+static constexpr int  PAD_SLOTS        = 4;
+static constexpr int  PAD_MAX_POLL_HZ  = 1000;
+static constexpr auto PAD_BACKOFF_MAX  = std::chrono::seconds(2);
+
+struct PadState {
+    bool     connected;
+    uint32_t packet;        // bumped whenever the input changes
+    uint16_t buttons;       // X_INPUT_GAMEPAD_*
+    uint8_t  lt, rt;
+    int16_t  lx, ly, rx, ry;
+    int64_t  changed_ns;    // steady clock when the poller saw the change
+};
+
+// The input part of a PadState, as a backend reports it.
+struct PadInput {
+    uint16_t buttons;
+    uint8_t  lt, rt;
+    int16_t  lx, ly, rx, ry;
+
+    bool operator==(const PadInput&) const = default;
+};
+
+class PadBackend {
+public:
+    virtual ~PadBackend() = default;
+    virtual const char* Name() const = 0;
+    // Sample `slot`. False when no pad is there; the slot then backs off.
+    virtual bool Poll(int slot, PadInput* out) = 0;
+};
+
+// `backend` is "auto" (xinput on Windows, evdev on Linux), one of the
+// names above, or "none". Returns false if it isn't available here.
+bool PadPollerStart(const std::string& backend, int poll_hz);
+// Poll with a backend of the caller's (tools/test_pad_poller.cpp).
+void PadPollerStartWith(std::unique_ptr<PadBackend> backend, int poll_hz);
+void PadPollerStop();
+
+// Latest state of `slot`. Lock-free; never blocks the poller.
+PadState PadPollerGet(int slot);
+
+// Name of the running backend, "none" when stopped.
+const char* PadPollerBackend();
+
+#ifndef _WIN32
+// The evdev backend's mapping of one event onto `in`. `range` holds the
+// device's [min, max] for each ABS_* code (ABS_CNT entries); Y axes are
+// flipped to XInput's up-is-positive and triggers scaled to 0..255.
+struct PadAxisRange {
+    int32_t min = 0, max = 0;
+};
+void PadEvdevApply(PadInput* in, const PadAxisRange* range, const struct input_event& ev);
+#endif
@@ -0,0 +1,289 @@
+// vig8 - Peer table
+// Open-addressing hash table of LAN peers keyed by IPv4 address.
+//
+// Lookups happen on every XNet address translation from guest threads, so
+// reads never take a lock: they are validated against a seqlock and retried
+// if a writer ran concurrently. Writers (discovery thread, XNetConnect,
+// XNetUnregisterInAddr) are serialized by a mutex. Every slot field is an
+// atomic so the optimistic reads are well-defined.
+//
+// Peers carry a last-seen timestamp refreshed by beacons; unconnected peers
+// that go quiet are dropped by ExpireIdle() from the discovery timer.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+
+#include "net.h"
+
+struct PeerInfo {
+    XNADDR_LAN xnaddr;
+    uint8_t    xnkid[8];
+    bool       connected;
+};
+
+class PeerTable {
+public:
+    static constexpr uint32_t kCapacityLog2 = 12;
+    static constexpr uint32_t kCapacity = 1u << kCapacityLog2;   // 4096 slots
+    static constexpr uint32_t kMaxPeers = kCapacity / 4 * 3;     // 75% load
+
+    PeerTable() {
+        for (auto& k : keys_) k.store(kEmpty, std::memory_order_relaxed);
+    }
+    PeerTable(const PeerTable&) = delete;
+    PeerTable& operator=(const PeerTable&) = delete;
+
+    // Copy the peer for `ip_net` into `out`. Lock-free; safe from any thread.
+    bool Find(uint32_t ip_net, PeerInfo* out) const {
+        if (ip_net == kEmpty) return false;
+        for (;;) {
+            uint32_t s1 = seq_.load(std::memory_order_acquire);
+            if (s1 & 1) continue;  // writer in progress
+
+            bool found = false;
+            uint64_t words[kWords];
+            uint32_t i = Home(ip_net);
+            for (uint32_t n = 0; n < kCapacity; n++, i = (i + 1) & kMask) {
+                uint32_t k = keys_[i].load(std::memory_order_relaxed);
+                if (k == kEmpty) break;
+                if (k == ip_net) {
+                    for (int w = 0; w < kWords; w++)
+                        words[w] = slots_[i].words[w].load(std::memory_order_relaxed);
+                    found = true;
+                    break;
+                }
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq_.load(std::memory_order_relaxed) != s1) continue;
+
+            if (found && out) Unpack(words, out);
+            return found;
+        }
+    }
+
+    // Insert or refresh a peer heard from on the network. The connected
+    // flag of an existing peer is preserved.
+    bool Upsert(const XNADDR_LAN& addr, const uint8_t* xnkid, int64_t now_ms) {
+        std::lock_guard lock(write_mutex_);
+        uint32_t i;
+        PeerInfo info = {};
+        if (FindSlot(addr.ina, &i)) {
+            uint64_t words[kWords];
+            LoadWords(i, words);
+            Unpack(words, &info);
+        } else if (!ClaimSlot(addr.ina, &i)) {
+            return false;
+        }
+        info.xnaddr = addr;
+        if (xnkid) std::memcpy(info.xnkid, xnkid, 8);
+        Store(i, info);
+        slots_[i].last_seen_ms.store(now_ms, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Mark a peer connected (XNetConnect), creating it if unknown.
+    bool MarkConnected(uint32_t ip_net, int64_t now_ms) {
+        if (ip_net == kEmpty) return false;
+        std::lock_guard lock(write_mutex_);
+        uint32_t i;
+        PeerInfo info = {};
+        if (FindSlot(ip_net, &i)) {
+            uint64_t words[kWords];
+            LoadWords(i, words);
+            Unpack(words, &info);
+        } else if (ClaimSlot(ip_net, &i)) {
+            info.xnaddr.ina = ip_net;
+            info.xnaddr.inaOnline = ip_net;
+        } else {
+            return false;
+        }
+        info.connected = true;
+        Store(i, info);
+        slots_[i].last_seen_ms.store(now_ms, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool Remove(uint32_t ip_net) {
+        std::lock_guard lock(write_mutex_);
+        uint32_t i;
+        if (!FindSlot(ip_net, &i)) return false;
+        BeginWrite();
+        EraseSlot(i);
+        EndWrite();
+        return true;
+    }
+
+    // Drop unconnected peers not heard from for `max_idle_ms`. Connected
+    // peers stay until the game unregisters them. `on_expire`, if set, is
+    // called with each dropped address (under the write lock, so keep it
+    // short). Returns the number removed.
+    size_t ExpireIdle(int64_t now_ms, int64_t max_idle_ms,
+                      void (*on_expire)(uint32_t ip_net) = nullptr) {
+        std::lock_guard lock(write_mutex_);
+        size_t removed = 0;
+        bool writing = false;
+        for (uint32_t i = 0; i < kCapacity; ) {
+            uint32_t k = keys_[i].load(std::memory_order_relaxed);
+            if (k == kEmpty) { i++; continue; }
+            int64_t seen = slots_[i].last_seen_ms.load(std::memory_order_relaxed);
+            uint64_t words[kWords];
+            LoadWords(i, words);
+            PeerInfo info;
+            Unpack(words, &info);
+            if (info.connected || now_ms - seen < max_idle_ms) { i++; continue; }
+
+            if (!writing) { BeginWrite(); writing = true; }
+            EraseSlot(i);  // may shift a later entry into i; re-examine it
+            removed++;
+            if (on_expire) on_expire(k);
+        }
+        if (writing) EndWrite();
+        return removed;
+    }
+
+    void Clear() {
+        std::lock_guard lock(write_mutex_);
+        BeginWrite();
+        for (auto& k : keys_) k.store(kEmpty, std::memory_order_relaxed);
+        count_ = 0;
+        EndWrite();
+    }
+
+    size_t Size() const {
+        std::lock_guard lock(write_mutex_);
+        return count_;
+    }
+
+    // Peers marked connected. A full scan; call at beacon rate, not per packet.
+    size_t ConnectedCount() const {
+        std::lock_guard lock(write_mutex_);
+        size_t n = 0;
+        for (uint32_t i = 0; i < kCapacity; i++) {
+            if (keys_[i].load(std::memory_order_relaxed) == kEmpty) continue;
+            uint64_t words[kWords];
+            LoadWords(i, words);
+            PeerInfo info;
+            Unpack(words, &info);
+            if (info.connected) n++;
+        }
+        return n;
+    }
+
+private:
+    // 0.0.0.0 is never a peer address, so it marks an empty slot.
+    static constexpr uint32_t kEmpty = 0;
+    static constexpr uint32_t kMask  = kCapacity - 1;
+    static constexpr int      kWords = (sizeof(PeerInfo) + 7) / 8;
+
+    struct Slot {
+        std::atomic<uint64_t> words[kWords];
+        std::atomic<int64_t>  last_seen_ms;
+    };
+
+    static uint32_t Home(uint32_t ip_net) {
+        // Fibonacci hashing; the low octets of LAN addresses vary the most
+        // and end up in the high bits of the product.
+        return (ip_net * 0x9E3779B1u) >> (32 - kCapacityLog2);
+    }
+
+    static void Pack(const PeerInfo& info, uint64_t* words) {
+        std::memset(words, 0, kWords * 8);
+        std::memcpy(words, &info, sizeof(PeerInfo));
+    }
+    static void Unpack(const uint64_t* words, PeerInfo* info) {
+        std::memcpy(info, words, sizeof(PeerInfo));
+    }
+
+    void LoadWords(uint32_t i, uint64_t* words) const {
+        for (int w = 0; w < kWords; w++)
+            words[w] = slots_[i].words[w].load(std::memory_order_relaxed);
+    }
+
+    // --- Writer-side helpers; caller holds write_mutex_ ---
+
+    void BeginWrite() {
+        seq_.store(seq_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+    void EndWrite() {
+        seq_.store(seq_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    bool FindSlot(uint32_t ip_net, uint32_t* slot) const {
+        uint32_t i = Home(ip_net);
+        for (uint32_t n = 0; n < kCapacity; n++, i = (i + 1) & kMask) {
+            uint32_t k = keys_[i].load(std::memory_order_relaxed);
+            if (k == kEmpty) return false;
+            if (k == ip_net) { *slot = i; return true; }
+        }
+        return false;
+    }
+
+    // Reserve the first empty slot on ip_net's probe path. The key is
+    // published by the following Store().
+    bool ClaimSlot(uint32_t ip_net, uint32_t* slot) {
+        if (count_ >= kMaxPeers) return false;
+        uint32_t i = Home(ip_net);
+        while (keys_[i].load(std::memory_order_relaxed) != kEmpty) i = (i + 1) & kMask;
+        pending_key_ = ip_net;
+        *slot = i;
+        count_++;
+        return true;
+    }
+
+    // Write a slot's payload. Readers are only made to retry when
+    // something they can observe actually changes — beacon refreshes of an
+    // unchanged peer don't touch the sequence.
+    void Store(uint32_t i, const PeerInfo& info) {
+        uint64_t words[kWords], old[kWords];
+        Pack(info, words);
+        LoadWords(i, old);
+        bool new_key = keys_[i].load(std::memory_order_relaxed) == kEmpty;
+        if (!new_key && std::memcmp(words, old, sizeof(words)) == 0) return;
+
+        BeginWrite();
+        for (int w = 0; w < kWords; w++)
+            slots_[i].words[w].store(words[w], std::memory_order_relaxed);
+        if (new_key) keys_[i].store(pending_key_, std::memory_order_relaxed);
+        EndWrite();
+    }
+
+    // Backward-shift deletion: keeps probe chains intact without
+    // tombstones. Caller has opened a write section.
+    void EraseSlot(uint32_t i) {
+        uint32_t j = i;
+        for (;;) {
+            j = (j + 1) & kMask;
+            uint32_t k = keys_[j].load(std::memory_order_relaxed);
+            if (k == kEmpty) break;
+            uint32_t home = Home(k);
+            // Entry at j may move to i only if i lies on its probe path,
+            // i.e. cyclically within [home, j).
+            bool movable = (i <= j) ? (home <= i || home > j)
+                                    : (home <= i && home > j);
+            if (!movable) continue;
+            for (int w = 0; w < kWords; w++)
+                slots_[i].words[w].store(slots_[j].words[w].load(std::memory_order_relaxed),
+                                         std::memory_order_relaxed);
+            slots_[i].last_seen_ms.store(slots_[j].last_seen_ms.load(std::memory_order_relaxed),
+                                         std::memory_order_relaxed);
+            keys_[i].store(k, std::memory_order_relaxed);
+            i = j;
+        }
+        keys_[i].store(kEmpty, std::memory_order_relaxed);
+        count_--;
+    }
+
+    std::atomic<uint32_t> keys_[kCapacity];
+    Slot                  slots_[kCapacity];
+    std::atomic<uint32_t> seq_{0};
+    mutable std::mutex    write_mutex_;
+    uint32_t              count_ = 0;
+    uint32_t              pending_key_ = kEmpty;
+};
@@ -0,0 +1,46 @@
+// vig8 - Present hook
+// See present_hook.h.
+
+#include "present_hook.h"
+#include "vig8_config.h"
+
+#include <rex/runtime/guest/context.h>
+#include <rex/runtime/guest/memory.h>
+
+#include <atomic>
+
+using namespace rex::runtime::guest;
+
+static std::atomic<PresentFn> g_subscribers[2][PRESENT_MAX_SUBSCRIBERS];
+static std::atomic<uint64_t>  g_frame{0};
+
+bool PresentSubscribe(PresentStage stage, PresentFn fn) {
+    auto& slots = g_subscribers[(int)stage];
+    for (auto& slot : slots) {
+        PresentFn cur = slot.load(std::memory_order_acquire);
+        if (cur == fn) return true;
+        if (!cur && slot.compare_exchange_strong(cur, fn, std::memory_order_acq_rel)) return true;
+        if (cur == fn) return true;   // lost the slot to the same function
+    }
+    return false;
+}
+
+uint64_t PresentFrameNumber() {
+    return g_frame.load(std::memory_order_relaxed);
+}
+
+static void RunSubscribers(PresentStage stage, uint8_t* base) {
+    for (auto& slot : g_subscribers[(int)stage]) {
+        PresentFn fn = slot.load(std::memory_order_acquire);
+        if (!fn) break;   // slots fill in order
+        fn(base);
+    }
+}
+
+extern "C" void __imp__sub_82131E80(PPCContext& ctx, uint8_t* base);
+extern "C" PPC_FUNC(sub_82131E80) {
+    g_frame.fetch_add(1, std::memory_order_relaxed);
+    RunSubscribers(PresentStage::Before, base);
+    __imp__sub_82131E80(ctx, base);
+    RunSubscribers(PresentStage::After, base);
+}
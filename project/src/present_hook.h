@@ -0,0 +1,32 @@
+// vig8 - Present hook
+//
+// sub_82131E80 presents the frame (VdSwap) once per main-loop iteration.
+// This module owns that override and numbers the frames; everything else
+// that works per frame subscribes to it:
+//   Before  the frame is built but not yet presented (the net layer's
+//           completions, tunnel batches, telemetry and replay delivery;
+//           the capture's periodic flush)
+//   After   the frame has been handed to VdSwap (input latency closes
+//           the events polled while building it)
+// Subscribers run on the guest thread that presents, in subscription
+// order. Subscribing is lock-free and may happen while the game runs;
+// there is no unsubscribe, so a subscriber checks its own on/off state.
+
+#pragma once
+
+#include <cstdint>
+
+enum class PresentStage : uint8_t { Before, After };
+
+using PresentFn = void (*)(uint8_t* base);
+
+static constexpr int PRESENT_MAX_SUBSCRIBERS = 8;   // per stage
+
+// Run `fn` at `stage` of every present from now on. Subscribing a function
+// twice is a no-op. False if the stage already has
+// PRESENT_MAX_SUBSCRIBERS.
+bool PresentSubscribe(PresentStage stage, PresentFn fn);
+
+// The frame being built: 0 before the first present, then advanced as
+// each present begins (before the Before subscribers run).
+uint64_t PresentFrameNumber();
@@ -0,0 +1,161 @@
+// vig8 - Relay client worker
+// See relay_client.h.
+
+#include "relay_client.h"
+
+#include <rex/logging.h>
+
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+static std::thread             g_relay_thread;
+static std::mutex              g_relay_mutex;
+static std::condition_variable g_relay_cv;
+static std::deque<NetTask>     g_relay_queue;
+static bool                    g_relay_running = false;
+static int                     g_relay_delay_ms = 0;
+static std::atomic<bool>       g_refresh_in_flight{false};
+
+static constexpr auto RELAY_SEARCH_POLL = std::chrono::milliseconds(10);
+
+static void RelayThreadFunc() {
+    std::unique_lock lock(g_relay_mutex);
+    while (g_relay_running) {
+        if (g_relay_queue.empty()) {
+            g_relay_cv.wait(lock);
+            continue;
+        }
+        NetTask fn = std::move(g_relay_queue.front());
+        g_relay_queue.pop_front();
+        int delay_ms = g_relay_delay_ms;
+
+        lock.unlock();
+        if (delay_ms > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+        }
+        fn();
+        lock.lock();
+    }
+}
+
+void RelayClientStart(int injected_delay_ms) {
+    std::lock_guard lock(g_relay_mutex);
+    if (g_relay_running) return;
+    g_relay_running = true;
+    g_relay_delay_ms = injected_delay_ms;
+    if (injected_delay_ms > 0) {
+        REXLOG_INFO("[NET] Relay calls delayed by {} ms (test)", injected_delay_ms);
+    }
+    g_relay_thread = std::thread(RelayThreadFunc);
+}
+
+void RelayClientStop() {
+    {
+        std::lock_guard lock(g_relay_mutex);
+        if (!g_relay_running) return;
+        g_relay_running = false;
+    }
+    g_relay_cv.notify_all();
+    if (g_relay_thread.joinable()) {
+        g_relay_thread.join();
+    }
+    // Whatever is left never reached the relay. Dropping the tasks releases
+    // their RelaySearch handles; pollers see done with ok = false.
+    std::deque<NetTask> left;
+    {
+        std::lock_guard lock(g_relay_mutex);
+        left.swap(g_relay_queue);
+    }
+    if (!left.empty()) {
+        REXLOG_INFO("[NET] Relay worker stopped with {} call(s) unsent", left.size());
+    }
+}
+
+void RelayPost(NetTask fn) {
+    {
+        std::lock_guard lock(g_relay_mutex);
+        g_relay_queue.push_back(std::move(fn));
+    }
+    g_relay_cv.notify_one();
+}
+
+// Marks the search finished (ok = false) if the task is destroyed without
+// having run, so pollers never wait on a search that can't complete.
+struct RelaySearchTask {
+    std::shared_ptr<RelaySearch> search;
+    int                          max_results;
+
+    void Run() {
+        std::vector<xlive::Session> sessions((size_t)max_results);
+        int count = RelayIsConnected()
+                        ? RelaySearchSessions(sessions.data(), max_results)
+                        : -1;
+        search->ok = count >= 0;
+        sessions.resize(count > 0 ? (size_t)count : 0);
+        search->sessions = std::move(sessions);
+        search->done.store(true, std::memory_order_release);
+    }
+    ~RelaySearchTask() {
+        if (search && !search->done.load(std::memory_order_relaxed)) {
+            search->done.store(true, std::memory_order_release);
+        }
+    }
+};
+
+std::shared_ptr<RelaySearch> RelaySearchAsync(int max_results) {
+    auto search = std::make_shared<RelaySearch>();
+    auto task = std::make_shared<RelaySearchTask>();
+    task->search = search;
+    task->max_results = max_results;
+    RelayPost([task]() { task->Run(); });
+    return search;
+}
+
+// Guest task: finish now if the search settled, otherwise look again shortly.
+static void PollSearchOnGuest(std::shared_ptr<RelaySearch> search,
+                              NetClock::time_point deadline, NetTask finish) {
+    bool waiting = search && !search->done.load(std::memory_order_acquire);
+    if (waiting && NetClock::now() < deadline) {
+        NetPostToGuest(NetClock::now() + RELAY_SEARCH_POLL,
+                       [search, deadline, finish]() { PollSearchOnGuest(search, deadline, finish); });
+        return;
+    }
+    finish();
+}
+
+void RelayFinishSearchOnGuest(std::shared_ptr<RelaySearch> search,
+                              NetClock::time_point not_before,
+                              NetClock::time_point deadline, NetTask finish) {
+    NetPostToGuest(not_before, [search, deadline, finish]() {
+        PollSearchOnGuest(search, deadline, finish);
+    });
+}
+
+// Clears the in-flight flag when the refresh is done, or dropped unrun
+// by RelayClientStop.
+struct RelayRefreshTask {
+    int                                                     max_results;
+    std::function<void(const std::vector<xlive::Session>&)> on_list;
+
+    void Run() {
+        if (!RelayIsConnected()) return;
+        std::vector<xlive::Session> sessions((size_t)max_results);
+        int count = RelaySearchSessions(sessions.data(), max_results);
+        if (count >= 0) {
+            sessions.resize((size_t)count);
+            on_list(sessions);
+        }
+    }
+    ~RelayRefreshTask() { g_refresh_in_flight.store(false, std::memory_order_release); }
+};
+
+bool RelayRefreshSessions(int max_results,
+                          std::function<void(const std::vector<xlive::Session>&)> on_list) {
+    if (g_refresh_in_flight.exchange(true, std::memory_order_acq_rel)) return false;
+    auto task = std::make_shared<RelayRefreshTask>();
+    task->max_results = max_results;
+    task->on_list = std::move(on_list);
+    RelayPost([task]() { task->Run(); });
+    return true;
+}
@@ -0,0 +1,52 @@
+// vig8 - Relay client worker
+//
+// Every relay call (relay_link.h) is a blocking round-trip to the relay
+// server. They are issued from one worker thread so a slow relay never
+// stalls a guest thread; callers get a handle they can poll (searches) or
+// fire and forget (registration).
+
+#pragma once
+
+#include "net_scheduler.h"
+#include "relay_link.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Start/stop the worker. `injected_delay_ms` is added before every relay
+// call to stand in for a slow relay when testing. Stop runs nothing
+// further; searches still queued finish with ok = false.
+void RelayClientStart(int injected_delay_ms = 0);
+void RelayClientStop();
+
+// Run `fn` on the worker thread, after anything queued before it.
+void RelayPost(NetTask fn);
+
+struct RelaySearch {
+    std::atomic<bool>           done{false};
+    bool                        ok = false;   // valid once done
+    std::vector<xlive::Session> sessions;     // valid once done
+};
+
+// Queue a session search for at most `max_results` sessions.
+std::shared_ptr<RelaySearch> RelaySearchAsync(int max_results);
+
+// Run `finish` on the calling guest thread (NetPostToGuest) once `search`
+// is done or `deadline` has passed, whichever comes first, but no sooner
+// than `not_before`. A null `search` has nothing to wait for. `finish`
+// checks `search->done` itself to tell an answer from a timeout.
+void RelayFinishSearchOnGuest(std::shared_ptr<RelaySearch> search,
+                              NetClock::time_point not_before,
+                              NetClock::time_point deadline, NetTask finish);
+
+// The relay has no push channel (see session_cache.h), so the session
+// list is refreshed on demand: a search that finds the cached list stale
+// calls this, which queues one full-list fetch on the worker and hands the
+// list to `on_list` there. Returns false without queueing anything while
+// an earlier refresh is still queued or running, so a burst of searches
+// costs the relay one fetch.
+bool RelayRefreshSessions(int max_results,
+                          std::function<void(const std::vector<xlive::Session>&)> on_list);
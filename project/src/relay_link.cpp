@@ -0,0 +1,249 @@
+// vig8 - Relay link
+// See relay_link.h.
+
+#include "relay_link.h"
+#include "relay_protocol.h"
+
+#include <rex/logging.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#define MSG_NOSIGNAL 0
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#define INVALID_SOCKET (~0ULL)
+#define closesocket close
+typedef int SOCKET;
+#endif
+
+// A relay_server that stops answering is treated like a dropped connection
+static constexpr int RELAY_SERVER_TIMEOUT_MS = 5000;
+
+static RelayProtocol     g_link_protocol = RelayProtocol::Xlive;
+static std::atomic<bool> g_link_connected{false};
+
+// relay_server connection; the mutex serializes request/reply pairs
+static std::mutex g_link_mutex;
+static SOCKET     g_link_sock = (SOCKET)INVALID_SOCKET;
+static uint8_t    g_link_xnaddr[36];
+
+bool RelayProtocolFromName(const std::string& name, RelayProtocol* out) {
+    if (name == "xlive") {
+        *out = RelayProtocol::Xlive;
+    } else if (name == "relay_server") {
+        *out = RelayProtocol::RelayServer;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// relay_server framing (relay_protocol.h), blocking, under g_link_mutex
+// ============================================================================
+
+static bool LinkWriteAll(const uint8_t* p, size_t n) {
+    while (n) {
+        int w = (int)send(g_link_sock, (const char*)p, (int)n, MSG_NOSIGNAL);
+        if (w <= 0) return false;
+        p += w;
+        n -= (size_t)w;
+    }
+    return true;
+}
+
+static bool LinkReadAll(uint8_t* p, size_t n) {
+    while (n) {
+        int r = (int)recv(g_link_sock, (char*)p, (int)n, 0);
+        if (r <= 0) return false;
+        p += r;
+        n -= (size_t)r;
+    }
+    return true;
+}
+
+// Send one request and read its reply, which must be `reply_type`.
+static bool LinkRequest(uint8_t type, const uint8_t* payload, size_t len,
+                        uint8_t reply_type, std::vector<uint8_t>* reply) {
+    if (g_link_sock == (SOCKET)INVALID_SOCKET) return false;
+    std::vector<uint8_t> frame(3 + len);
+    relay::PutU16(frame.data(), (uint16_t)(len + 1));
+    frame[2] = type;
+    if (len) std::memcpy(frame.data() + 3, payload, len);
+    uint8_t hdr[3];
+    if (LinkWriteAll(frame.data(), frame.size()) && LinkReadAll(hdr, 3)) {
+        size_t reply_len = relay::GetU16(hdr);
+        if (reply_len && hdr[2] == reply_type) {
+            reply->resize(reply_len - 1);
+            if (LinkReadAll(reply->data(), reply->size())) return true;
+        }
+    }
+    // Out of step with the server (or gone): the connection is useless now
+    REXLOG_ERROR("[NET] relay_server request 0x{:02X} failed, disconnecting", type);
+    closesocket(g_link_sock);
+    g_link_sock = (SOCKET)INVALID_SOCKET;
+    g_link_connected.store(false, std::memory_order_release);
+    return false;
+}
+
+static SOCKET LinkOpen(const char* host, uint16_t port) {
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    char port_str[8];
+    snprintf(port_str, sizeof(port_str), "%u", port);
+    if (getaddrinfo(host, port_str, &hints, &result) != 0 || !result) {
+        REXLOG_ERROR("[NET] getaddrinfo failed for '{}'", host);
+        return (SOCKET)INVALID_SOCKET;
+    }
+    SOCKET s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s != (SOCKET)INVALID_SOCKET &&
+        connect(s, result->ai_addr, (int)result->ai_addrlen) != 0) {
+        closesocket(s);
+        s = (SOCKET)INVALID_SOCKET;
+    }
+    freeaddrinfo(result);
+    if (s == (SOCKET)INVALID_SOCKET) return s;
+
+    int one = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+#ifdef _WIN32
+    DWORD timeout = RELAY_SERVER_TIMEOUT_MS;
+#else
+    timeval timeout = {RELAY_SERVER_TIMEOUT_MS / 1000, (RELAY_SERVER_TIMEOUT_MS % 1000) * 1000};
+#endif
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+    setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
+    return s;
+}
+
+static bool LinkConnect(const char* host, uint16_t port, const uint8_t* xnaddr) {
+    std::lock_guard lock(g_link_mutex);
+    g_link_sock = LinkOpen(host, port);
+    if (g_link_sock == (SOCKET)INVALID_SOCKET) return false;
+    std::memcpy(g_link_xnaddr, xnaddr, sizeof(g_link_xnaddr));
+
+    uint8_t hello[4];
+    relay::PutU32(hello, relay::PROTOCOL_VERSION);
+    std::vector<uint8_t> welcome;
+    if (!LinkRequest(relay::MSG_HELLO, hello, sizeof(hello), relay::MSG_WELCOME, &welcome)) {
+        return false;
+    }
+    if (welcome.size() < 8) {
+        closesocket(g_link_sock);
+        g_link_sock = (SOCKET)INVALID_SOCKET;
+        return false;
+    }
+    REXLOG_INFO("[NET] relay_server client id {}", relay::GetU32(welcome.data()));
+    g_link_connected.store(true, std::memory_order_release);
+    return true;
+}
+
+static bool LinkRegister(const uint8_t* xnkid, uint8_t num_public) {
+    relay::SessionRecord rec = {};
+    std::memcpy(rec.xnkid, xnkid, sizeof(rec.xnkid));
+    std::memcpy(rec.host_xnaddr, g_link_xnaddr, sizeof(rec.host_xnaddr));
+    rec.current_players = 1;   // the host
+    rec.max_players = num_public;
+
+    std::lock_guard lock(g_link_mutex);
+    std::vector<uint8_t> ack;
+    if (!LinkRequest(relay::MSG_REGISTER, (const uint8_t*)&rec, sizeof(rec),
+                     relay::MSG_ACK, &ack)) {
+        return false;
+    }
+    if (ack.empty() || ack[0] != relay::ACK_OK) {
+        REXLOG_ERROR("[NET] relay_server refused session registration (status {})",
+                     ack.empty() ? -1 : (int)ack[0]);
+        return false;
+    }
+    return true;
+}
+
+static int LinkSearch(xlive::Session* out, int max_results) {
+    uint8_t req[2];
+    relay::PutU16(req, (uint16_t)std::min(max_results, 0xFFFF));
+
+    std::lock_guard lock(g_link_mutex);
+    std::vector<uint8_t> results;
+    if (!LinkRequest(relay::MSG_SEARCH, req, sizeof(req), relay::MSG_RESULTS, &results) ||
+        results.size() < 2) {
+        return -1;
+    }
+    int count = std::min<int>(relay::GetU16(results.data()), max_results);
+    count = std::min<int>(count, (int)((results.size() - 2) / sizeof(relay::SessionRecord)));
+    for (int i = 0; i < count; i++) {
+        relay::SessionRecord rec;
+        std::memcpy(&rec, results.data() + 2 + (size_t)i * sizeof(rec), sizeof(rec));
+        std::memcpy(out[i].xnkid, rec.xnkid, sizeof(out[i].xnkid));
+        std::memcpy(out[i].host_xnaddr, rec.host_xnaddr, sizeof(out[i].host_xnaddr));
+        out[i].current_players = rec.current_players;
+        out[i].max_players = rec.max_players;
+    }
+    return count;
+}
+
+static void LinkDisconnect() {
+    std::lock_guard lock(g_link_mutex);
+    if (g_link_sock != (SOCKET)INVALID_SOCKET) {
+        closesocket(g_link_sock);
+        g_link_sock = (SOCKET)INVALID_SOCKET;
+    }
+    g_link_connected.store(false, std::memory_order_release);
+}
+
+// ============================================================================
+// Relay calls
+// ============================================================================
+
+bool RelayConnect(RelayProtocol protocol, const char* host, uint16_t port,
+                  uint32_t title_id, const uint8_t* xnaddr, const char* name) {
+    g_link_protocol = protocol;
+    if (protocol == RelayProtocol::RelayServer) {
+        return LinkConnect(host, port, xnaddr);
+    }
+    return xlive::Connect(host, port, title_id, xnaddr, name);
+}
+
+bool RelayIsConnected() {
+    if (g_link_protocol == RelayProtocol::RelayServer) {
+        return g_link_connected.load(std::memory_order_acquire);
+    }
+    return xlive::IsConnected();
+}
+
+void RelayDisconnect() {
+    if (g_link_protocol == RelayProtocol::RelayServer) {
+        LinkDisconnect();
+    } else if (xlive::IsConnected()) {
+        xlive::Disconnect();
+    }
+}
+
+bool RelayRegisterSession(const uint8_t* xnkid, uint8_t num_public) {
+    if (g_link_protocol == RelayProtocol::RelayServer) {
+        return LinkRegister(xnkid, num_public);
+    }
+    return xlive::RegisterSession(xnkid, nullptr, 0, num_public);
+}
+
+int RelaySearchSessions(xlive::Session* out, int max_results) {
+    if (g_link_protocol == RelayProtocol::RelayServer) {
+        return LinkSearch(out, max_results);
+    }
+    return xlive::SearchSessions(out, max_results);
+}
@@ -0,0 +1,39 @@
+// vig8 - Relay link
+//
+// The calls vig8 makes to its session relay, and which relay they go to.
+// [network] relay_protocol picks the wire protocol:
+//   "xlive"         the xlive relay client (../xlive/client), the default
+//   "relay_server"  tools/relay_server.cpp (relay_protocol.h), so NetInit's
+//                   relay path can be run and load-tested in-repo
+// Either way relay_host/relay_port name the server and the rest of vig8
+// sees the same calls. Everything after RelayConnect is blocking and runs
+// on the relay worker (relay_client.h); RelayIsConnected may be asked from
+// any thread.
+
+#pragma once
+
+#include "xlive.h"
+
+#include <cstdint>
+#include <string>
+
+enum class RelayProtocol : uint8_t { Xlive, RelayServer };
+
+// "xlive" or "relay_server". False for any other name.
+bool RelayProtocolFromName(const std::string& name, RelayProtocol* out);
+
+// Connect and identify as `name` with our XNADDR (36 bytes). The
+// relay_server protocol has no title id or name and drops them.
+bool RelayConnect(RelayProtocol protocol, const char* host, uint16_t port,
+                  uint32_t title_id, const uint8_t* xnaddr, const char* name);
+bool RelayIsConnected();
+
+// Close the connection; the relay drops every session it registered.
+void RelayDisconnect();
+
+// Register (or update) the session `xnkid` (8 bytes) hosted at the XNADDR
+// given to RelayConnect.
+bool RelayRegisterSession(const uint8_t* xnkid, uint8_t num_public);
+
+// Fill `out` with up to `max_results` sessions. -1 on a failed call.
+int RelaySearchSessions(xlive::Session* out, int max_results);
@@ -0,0 +1,86 @@
+// Relay protocol of tools/relay_server.cpp, spoken by vig8 when
+// [network] relay_protocol = "relay_server" (relay_link.h) and by
+// tools/relay_loadgen.cpp.
+//
+// This is not the wire format of the xlive relay (../xlive/client), which
+// lives outside this repo and isn't visible here. It carries the same
+// operations vig8 uses through xlive:: — connect, register a session
+// (upsert), search, and unregister everything a connection registered when
+// it disconnects — and the session record mirrors xlive::Session (XNKID,
+// host XNADDR, player counts). So vig8's relay path (NetInit's connect,
+// XGISessionCreate's registration, XGISessionSearch and the session cache
+// refresh) runs unchanged against relay_server, and relay_loadgen measures
+// the server vig8 is then talking to.
+//
+// TCP, everything big-endian:
+//   frame    := u16 length (of type + payload), u8 type, payload
+//   HELLO    C->S  u32 version                 -> WELCOME u32 client_id, u32 udp_token
+//   REGISTER C->S  SessionRecord (upsert)      -> ACK u8 status
+//   UNREG    C->S  u8 xnkid[8]                 -> ACK u8 status
+//   SEARCH   C->S  u16 max_results             -> RESULTS u16 count, SessionRecord[count]
+//
+// UDP relay, same port, one datagram per message:
+//   BIND     C->S  u8 0xD0, u32 client_id, u32 udp_token   (no reply)
+//   DATA     C->S  u8 0xD1, u32 dst_client_id, payload
+//            S->C  u8 0xD1, u32 src_client_id, payload
+// A client's UDP address is whatever it last sent BIND from. DATA from an
+// unbound address, or to an unbound client, is dropped. vig8 doesn't use
+// the UDP relay; its game traffic goes to peers directly.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace relay {
+
+static constexpr uint32_t PROTOCOL_VERSION = 1;
+static constexpr uint16_t DEFAULT_PORT     = 36000;
+static constexpr int      MAX_FRAME        = 65535;
+
+enum MsgType : uint8_t {
+    MSG_HELLO    = 0x01,
+    MSG_REGISTER = 0x02,
+    MSG_UNREG    = 0x03,
+    MSG_SEARCH   = 0x04,
+    MSG_WELCOME  = 0x81,
+    MSG_ACK      = 0x82,
+    MSG_RESULTS  = 0x84,
+};
+
+enum AckStatus : uint8_t {
+    ACK_OK        = 0,
+    ACK_NOT_FOUND = 1,   // UNREG of a session this client doesn't own
+    ACK_LIMIT     = 2,   // per-client session limit reached
+    ACK_BAD       = 3,   // malformed request
+    ACK_NOT_OWNER = 4,   // REGISTER of an XNKID another client owns
+};
+
+enum UdpType : uint8_t {
+    UDP_BIND = 0xD0,
+    UDP_DATA = 0xD1,
+};
+static constexpr int UDP_HEADER = 5;   // type + u32 client id
+
+#pragma pack(push, 1)
+struct SessionRecord {
+    uint8_t xnkid[8];
+    uint8_t host_xnaddr[36];
+    uint8_t current_players;
+    uint8_t max_players;
+};
+#pragma pack(pop)
+static_assert(sizeof(SessionRecord) == 46, "SessionRecord must be 46 bytes");
+
+inline void PutU16(uint8_t* p, uint16_t v) { p[0] = (uint8_t)(v >> 8); p[1] = (uint8_t)v; }
+inline void PutU32(uint8_t* p, uint32_t v) { PutU16(p, (uint16_t)(v >> 16)); PutU16(p + 2, (uint16_t)v); }
+inline uint16_t GetU16(const uint8_t* p) { return (uint16_t)((p[0] << 8) | p[1]); }
+inline uint32_t GetU32(const uint8_t* p) { return ((uint32_t)GetU16(p) << 16) | GetU16(p + 2); }
+
+inline uint64_t XnkidKey(const uint8_t* xnkid) {
+    uint64_t k;
+    std::memcpy(&k, xnkid, 8);
+    return k;
+}
+
+}  // namespace relay
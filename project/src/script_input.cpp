@@ -0,0 +1,167 @@
+// vig8 -- Scripted gamepad input driver
+
+#include "script_input.h"
+#include "input_latency.h"
+
+#include <rex/input/input.h>
+#include <rex/logging.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+using namespace rex::input;
+
+static bool ParseButtons(const std::string& spec, uint16_t& buttons, uint8_t& lt, uint8_t& rt) {
+    buttons = 0; lt = 0; rt = 0;
+    if (spec == "-") return true;
+
+    static const struct { const char* name; uint16_t bit; } kNames[] = {
+        {"A", X_INPUT_GAMEPAD_A},         {"B", X_INPUT_GAMEPAD_B},
+        {"X", X_INPUT_GAMEPAD_X},         {"Y", X_INPUT_GAMEPAD_Y},
+        {"START", X_INPUT_GAMEPAD_START}, {"BACK", X_INPUT_GAMEPAD_BACK},
+        {"UP", X_INPUT_GAMEPAD_DPAD_UP},  {"DOWN", X_INPUT_GAMEPAD_DPAD_DOWN},
+        {"LEFT", X_INPUT_GAMEPAD_DPAD_LEFT}, {"RIGHT", X_INPUT_GAMEPAD_DPAD_RIGHT},
+        {"LB", X_INPUT_GAMEPAD_LEFT_SHOULDER}, {"RB", X_INPUT_GAMEPAD_RIGHT_SHOULDER},
+        {"LS", X_INPUT_GAMEPAD_LEFT_THUMB},    {"RS", X_INPUT_GAMEPAD_RIGHT_THUMB},
+    };
+
+    std::stringstream ss(spec);
+    std::string name;
+    while (std::getline(ss, name, '+')) {
+        if (name == "LT") { lt = 255; continue; }
+        if (name == "RT") { rt = 255; continue; }
+        bool found = false;
+        for (auto& n : kNames) {
+            if (name == n.name) { buttons |= n.bit; found = true; break; }
+        }
+        if (!found) return false;
+    }
+    return true;
+}
+
+ScriptedInputDriver::ScriptedInputDriver(std::string script_path)
+    : InputDriver(nullptr, 0), path_(std::move(script_path)) {}
+
+X_STATUS ScriptedInputDriver::Setup() {
+    if (path_ == "synthetic") {
+        // Flick the right stick every 250 ms for an hour: steady input
+        // changes that menus and races ignore, for latency benchmarks.
+        for (int64_t t = 0; t < 3600 * 1000; t += 250) {
+            Step step = {};
+            step.at_ms = t;
+            step.rx = (t / 250) % 2 ? 32767 : 0;
+            steps_.push_back(step);
+        }
+        REXLOG_INFO("[input] Synthetic script: {} steps", steps_.size());
+        return X_STATUS_SUCCESS;
+    }
+
+    std::ifstream f(path_);
+    if (!f) {
+        REXLOG_ERROR("[input] Cannot open input script {}", path_);
+        return X_STATUS_UNSUCCESSFUL;
+    }
+
+    std::string line;
+    int line_no = 0;
+    while (std::getline(f, line)) {
+        line_no++;
+        auto hash = line.find('#');
+        if (hash != std::string::npos) line.resize(hash);
+        std::istringstream ls(line);
+        Step step = {};
+        std::string buttons;
+        if (!(ls >> step.at_ms)) continue;  // blank/comment
+        int lx = 0, ly = 0, rx = 0, ry = 0;
+        if (!(ls >> buttons) || !ParseButtons(buttons, step.buttons, step.lt, step.rt)) {
+            REXLOG_ERROR("[input] {}:{}: bad buttons '{}'", path_, line_no, buttons);
+            continue;
+        }
+        ls >> lx >> ly >> rx >> ry;
+        step.lx = (int16_t)std::clamp(lx, -32767, 32767);
+        step.ly = (int16_t)std::clamp(ly, -32767, 32767);
+        step.rx = (int16_t)std::clamp(rx, -32767, 32767);
+        step.ry = (int16_t)std::clamp(ry, -32767, 32767);
+        steps_.push_back(step);
+    }
+    std::stable_sort(steps_.begin(), steps_.end(),
+                     [](const Step& a, const Step& b) { return a.at_ms < b.at_ms; });
+    REXLOG_INFO("[input] Loaded {} scripted steps from {}", steps_.size(), path_);
+    return X_STATUS_SUCCESS;
+}
+
+X_RESULT ScriptedInputDriver::GetCapabilities(uint32_t user_index,
+                                               uint32_t /*flags*/,
+                                               X_INPUT_CAPABILITIES* out_caps) {
+    if (user_index != 0) return X_ERROR_DEVICE_NOT_CONNECTED;
+    if (out_caps) {
+        std::memset(out_caps, 0, sizeof(*out_caps));
+        out_caps->type     = 0x01;
+        out_caps->sub_type = 0x01;
+        out_caps->gamepad.buttons       = 0xFFFF;
+        out_caps->gamepad.left_trigger  = 0xFF;
+        out_caps->gamepad.right_trigger = 0xFF;
+        out_caps->gamepad.thumb_lx = static_cast<int16_t>(0x7FFF);
+        out_caps->gamepad.thumb_ly = static_cast<int16_t>(0x7FFF);
+        out_caps->gamepad.thumb_rx = static_cast<int16_t>(0x7FFF);
+        out_caps->gamepad.thumb_ry = static_cast<int16_t>(0x7FFF);
+    }
+    return X_ERROR_SUCCESS;
+}
+
+X_RESULT ScriptedInputDriver::GetState(uint32_t user_index,
+                                        X_INPUT_STATE* out_state) {
+    if (user_index != 0) return X_ERROR_DEVICE_NOT_CONNECTED;
+    if (!out_state) return X_ERROR_SUCCESS;
+
+    // The script clock starts at the game's first poll, not at process
+    // start, so boot time doesn't eat into the script.
+    auto now = std::chrono::steady_clock::now();
+    if (!started_) {
+        started_ = true;
+        start_ = now;
+    }
+    int64_t t = std::chrono::duration_cast<std::chrono::milliseconds>(now - start_).count();
+
+    // Latest step at or before t; time only moves forward, so resume the
+    // scan from the previous answer
+    size_t idx = last_step_;
+    size_t i = idx == SIZE_MAX ? 0 : idx + 1;
+    for (; i < steps_.size() && steps_[i].at_ms <= t; i++) idx = i;
+
+    std::memset(out_state, 0, sizeof(*out_state));
+    if (idx != last_step_) {
+        packet_number_++;
+        last_step_ = idx;
+        // The step took effect at its scripted time, not at this poll
+        int64_t start_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            start_.time_since_epoch()).count();
+        InputLatencyPolled(0, start_ns + steps_[idx].at_ms * 1000000);
+    }
+    out_state->packet_number = packet_number_;
+    if (idx != SIZE_MAX) {
+        const Step& s = steps_[idx];
+        out_state->gamepad.buttons       = s.buttons;
+        out_state->gamepad.left_trigger  = s.lt;
+        out_state->gamepad.right_trigger = s.rt;
+        out_state->gamepad.thumb_lx      = s.lx;
+        out_state->gamepad.thumb_ly      = s.ly;
+        out_state->gamepad.thumb_rx      = s.rx;
+        out_state->gamepad.thumb_ry      = s.ry;
+    }
+    return X_ERROR_SUCCESS;
+}
+
+X_RESULT ScriptedInputDriver::SetState(uint32_t user_index,
+                                        X_INPUT_VIBRATION* /*vibration*/) {
+    if (user_index != 0) return X_ERROR_DEVICE_NOT_CONNECTED;
+    return X_ERROR_SUCCESS;
+}
+
+X_RESULT ScriptedInputDriver::GetKeystroke(uint32_t user_index, uint32_t /*flags*/,
+                                            X_INPUT_KEYSTROKE* /*out_keystroke*/) {
+    if (user_index != 0) return X_ERROR_DEVICE_NOT_CONNECTED;
+    return X_ERROR_EMPTY;
+}
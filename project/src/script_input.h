@@ -0,0 +1,63 @@
+// vig8 -- Scripted gamepad input driver
+// Plays back a timed controller script on slot 0. Used by the headless
+// test harness (vig8_test) to drive menus without a window or keyboard.
+//
+// Script format — one step per line, held until the next step:
+//   <ms since first poll>  <buttons>  [lx ly rx ry]
+//   # comment
+// <buttons> is "-" (none) or names joined with '+':
+//   A B X Y START BACK UP DOWN LEFT RIGHT LB RB LS RS LT RT
+// Sticks are -32767..32767. Example:
+//   0     -
+//   4000  START
+//   4150  -
+//   6000  DOWN
+//   6100  -
+// The path "synthetic" instead flicks the right stick every 250 ms, a
+// steady stream of input changes for latency benchmarks (input_latency.h).
+
+#pragma once
+
+#include <rex/input/input_driver.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using rex::X_STATUS;
+using rex::X_RESULT;
+using rex::input::X_INPUT_CAPABILITIES;
+using rex::input::X_INPUT_STATE;
+using rex::input::X_INPUT_VIBRATION;
+using rex::input::X_INPUT_KEYSTROKE;
+
+class ScriptedInputDriver final : public rex::input::InputDriver {
+public:
+    explicit ScriptedInputDriver(std::string script_path);
+
+    X_STATUS Setup() override;
+
+    X_RESULT GetCapabilities(uint32_t user_index, uint32_t flags,
+                             X_INPUT_CAPABILITIES* out_caps) override;
+    X_RESULT GetState(uint32_t user_index, X_INPUT_STATE* out_state) override;
+    X_RESULT SetState(uint32_t user_index,
+                      X_INPUT_VIBRATION* vibration) override;
+    X_RESULT GetKeystroke(uint32_t user_index, uint32_t flags,
+                          X_INPUT_KEYSTROKE* out_keystroke) override;
+
+private:
+    struct Step {
+        int64_t  at_ms;
+        uint16_t buttons;
+        uint8_t  lt, rt;
+        int16_t  lx, ly, rx, ry;
+    };
+
+    std::string       path_;
+    std::vector<Step> steps_;
+    bool              started_ = false;
+    std::chrono::steady_clock::time_point start_;
+    uint32_t          packet_number_ = 0;
+    size_t            last_step_ = SIZE_MAX;
+};
@@ -0,0 +1,289 @@
+// vig8 - Session list cache
+// Sessions the game can join, from two sources:
+//   - the relay: the full list (ApplySnapshot), fetched again only when a
+//     search finds the last one older than its staleness window
+//     (RelayStale), so an idle lobby costs the relay nothing. Pushed
+//     incremental updates would replace the refetch, but push is blocked on
+//     the relay protocol, which lives with the external xlive client and
+//     server and has no subscribe message
+//   - the LAN: hosts heard beaconing on the discovery port; v3 beacons
+//     also carry the host's matchmaking contexts and properties
+//
+// XGISessionSearch answers from here without a network round-trip, so
+// filtering and ranking happen here too: the relay client's search takes
+// no query. Writers are the relay worker and discovery thread; readers are
+// guest threads searching from the lobby. All access is under one mutex —
+// searches run a few times a second at most, and even a few thousand
+// sessions rank in well under a millisecond.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "net.h"
+#include "xlive.h"
+
+// Matchmaking contexts and properties, as a host set them on its user
+// (XUserSetContext / XUserSetProperty) or a search asks for them.
+struct SessionTerms {
+    struct Property {
+        uint32_t id;
+        uint8_t  type;    // XUSER_DATA_TYPE_*
+        int64_t  value;   // integer types only, else 0
+    };
+    std::vector<std::pair<uint32_t, uint32_t>> contexts;     // id, value
+    std::vector<Property>                      properties;
+
+    bool operator==(const SessionTerms& o) const {
+        if (contexts != o.contexts || properties.size() != o.properties.size()) return false;
+        for (size_t i = 0; i < properties.size(); i++) {
+            const Property& a = properties[i];
+            const Property& b = o.properties[i];
+            if (a.id != b.id || a.type != b.type || a.value != b.value) return false;
+        }
+        return true;
+    }
+};
+
+struct CachedSession {
+    enum class Source : uint8_t { Relay, Lan };
+
+    uint8_t      xnkid[8];
+    uint8_t      host_xnaddr[36];
+    uint8_t      current_players;
+    uint8_t      max_players;
+    Source       source;
+    int64_t      updated_ms;
+    bool         has_terms = false;   // host advertised its terms (LAN v3)
+    SessionTerms terms;
+};
+
+// An XGI search as the game issued it. Only hosts that advertise their
+// terms can be matched against the query's: a context they set to another
+// value excludes them, and each integer property they share with the query
+// ranks them higher. Relay records and older beacons carry no terms, and
+// a context or property the host never set doesn't count against it. The
+// title's filter (which properties it compares, and how) lives in its SPA
+// data, which isn't available, so properties only rank and never exclude.
+struct SessionQuery {
+    SessionTerms terms;
+    size_t       max = 0;
+    int          min_open_slots = 1;
+};
+
+class SessionCache {
+public:
+    struct DeltaStats {
+        size_t added = 0, changed = 0, removed = 0;
+    };
+
+    // Replace every relay session with `sessions` (the relay's full list).
+    DeltaStats ApplySnapshot(const xlive::Session* sessions, int count, int64_t now_ms) {
+        std::lock_guard lock(mutex_);
+        DeltaStats st;
+        std::unordered_map<uint64_t, bool> seen;
+        for (int i = 0; i < count; i++) {
+            Upsert(sessions[i], now_ms, st);
+            seen[Key(sessions[i].xnkid)] = true;
+        }
+        for (auto it = sessions_.begin(); it != sessions_.end(); ) {
+            if (it->second.source == CachedSession::Source::Relay && !seen.count(it->first)) {
+                it = sessions_.erase(it);
+                st.removed++;
+            } else {
+                ++it;
+            }
+        }
+        if (st.added || st.changed || st.removed) version_++;
+        relay_synced_ = true;
+        relay_synced_ms_ = now_ms;
+        return st;
+    }
+
+    // A LAN host beaconed. Relay entries for the same session are
+    // replaced: the LAN path is the better one to join through.
+    // `max_players` 0 means the beacon carried no slot counts (v1), and a
+    // null `terms` that it carried no contexts or properties (v1, v2).
+    void NoteLanHost(const uint8_t* xnkid, const XNADDR_LAN& host, int64_t now_ms,
+                     uint8_t current_players = 0, uint8_t max_players = 0,
+                     const SessionTerms* terms = nullptr) {
+        std::lock_guard lock(mutex_);
+        uint64_t key = Key(xnkid);
+        auto [it, inserted] = sessions_.try_emplace(key);
+        CachedSession& s = it->second;
+        if (inserted || s.source != CachedSession::Source::Lan ||
+            std::memcmp(s.host_xnaddr, &host, sizeof(host)) != 0) {
+            version_++;
+        }
+        if (max_players) {
+            if (s.current_players != current_players || s.max_players != max_players) version_++;
+            s.current_players = current_players;
+            s.max_players = max_players;
+        } else if (inserted || s.source != CachedSession::Source::Lan) {
+            // v1 beacons don't carry slot counts; assume a 4-player lobby
+            // with the host in it.
+            s.current_players = 1;
+            s.max_players = 4;
+        }
+        if (s.has_terms != (terms != nullptr) || (terms && !(s.terms == *terms))) version_++;
+        s.has_terms = terms != nullptr;
+        s.terms = terms ? *terms : SessionTerms{};
+        std::memcpy(s.xnkid, xnkid, 8);
+        std::memcpy(s.host_xnaddr, &host, sizeof(host));
+        s.source = CachedSession::Source::Lan;
+        s.updated_ms = now_ms;
+    }
+
+    // Drop LAN hosts that stopped beaconing. Returns the number removed.
+    size_t ExpireLan(int64_t now_ms, int64_t max_idle_ms) {
+        std::lock_guard lock(mutex_);
+        size_t removed = 0;
+        for (auto it = sessions_.begin(); it != sessions_.end(); ) {
+            if (it->second.source == CachedSession::Source::Lan &&
+                now_ms - it->second.updated_ms >= max_idle_ms) {
+                it = sessions_.erase(it);
+                removed++;
+            } else {
+                ++it;
+            }
+        }
+        if (removed) version_++;
+        return removed;
+    }
+
+    // Up to `q.max` sessions with at least `q.min_open_slots` open and no
+    // advertised context at odds with the query's, best first: LAN hosts,
+    // then most of the query's properties matched, then by RTT to the host
+    // in RTT_BAND_US bands (`rtt_us(ina)`, 0 = unmeasured, ranks last),
+    // then fullest lobby first so players fill games rather than spread out.
+    static constexpr uint32_t RTT_BAND_US = 20000;
+
+    template <typename RttFn>
+    std::vector<CachedSession> Query(const SessionQuery& q, RttFn&& rtt_us) const {
+        struct Ranked {
+            bool                 lan;
+            int                  matched;
+            uint32_t             rtt_band;
+            int                  open;
+            const CachedSession* s;
+        };
+        std::lock_guard lock(mutex_);
+        std::vector<Ranked> ranked;
+        ranked.reserve(sessions_.size());
+        for (auto& [key, s] : sessions_) {
+            int open = s.max_players > s.current_players ? s.max_players - s.current_players : 0;
+            if (open < q.min_open_slots) continue;
+            int matched = 0;
+            if (s.has_terms && !MatchTerms(q.terms, s.terms, &matched)) continue;
+            XNADDR_LAN host;
+            std::memcpy(&host, s.host_xnaddr, sizeof(host));
+            uint32_t rtt = rtt_us(host.ina);
+            ranked.push_back({s.source == CachedSession::Source::Lan, matched,
+                              rtt ? rtt / RTT_BAND_US : UINT32_MAX, open, &s});
+        }
+
+        size_t n = std::min(q.max, ranked.size());
+        std::partial_sort(ranked.begin(), ranked.begin() + (ptrdiff_t)n, ranked.end(),
+                          [](const Ranked& a, const Ranked& b) {
+            if (a.lan != b.lan) return a.lan;
+            if (a.matched != b.matched) return a.matched > b.matched;
+            if (a.rtt_band != b.rtt_band) return a.rtt_band < b.rtt_band;
+            if (a.open != b.open) return a.open < b.open;
+            return std::memcmp(a.s->xnkid, b.s->xnkid, 8) < 0;  // stable across searches
+        });
+
+        std::vector<CachedSession> out;
+        out.reserve(n);
+        for (size_t i = 0; i < n; i++) out.push_back(*ranked[i].s);
+        return out;
+    }
+
+    size_t Size() const {
+        std::lock_guard lock(mutex_);
+        return sessions_.size();
+    }
+
+    // True once a relay snapshot has been applied since the last Clear.
+    bool RelaySynced() const {
+        std::lock_guard lock(mutex_);
+        return relay_synced_;
+    }
+
+    // True when no relay snapshot has been applied, or the last one is at
+    // least `max_age_ms` old.
+    bool RelayStale(int64_t now_ms, int64_t max_age_ms) const {
+        std::lock_guard lock(mutex_);
+        return !relay_synced_ || now_ms - relay_synced_ms_ >= max_age_ms;
+    }
+
+    uint64_t Version() const {
+        std::lock_guard lock(mutex_);
+        return version_;
+    }
+
+    void Clear() {
+        std::lock_guard lock(mutex_);
+        sessions_.clear();
+        relay_synced_ = false;
+        version_++;
+    }
+
+private:
+    // False if the host set a context the query asks for to another value.
+    // Otherwise `matched` is the number of the query's integer properties
+    // the host set to the same value.
+    static bool MatchTerms(const SessionTerms& want, const SessionTerms& have, int* matched) {
+        for (auto& [id, value] : want.contexts) {
+            for (auto& [hid, hvalue] : have.contexts) {
+                if (hid == id && hvalue != value) return false;
+            }
+        }
+        *matched = 0;
+        for (const SessionTerms::Property& p : want.properties) {
+            if (p.type != 1 && p.type != 2) continue;   // XUSER_DATA_TYPE_INT32 / INT64
+            for (const SessionTerms::Property& h : have.properties) {
+                if (h.id == p.id && h.type == p.type && h.value == p.value) (*matched)++;
+            }
+        }
+        return true;
+    }
+
+    static uint64_t Key(const uint8_t* xnkid) {
+        uint64_t k;
+        std::memcpy(&k, xnkid, 8);
+        return k;
+    }
+
+    // Caller holds mutex_. A relay update never overrides a LAN entry.
+    void Upsert(const xlive::Session& in, int64_t now_ms, DeltaStats& st) {
+        auto [it, inserted] = sessions_.try_emplace(Key(in.xnkid));
+        CachedSession& s = it->second;
+        if (!inserted && s.source == CachedSession::Source::Lan) return;
+        if (inserted) {
+            st.added++;
+        } else if (s.current_players != in.current_players ||
+                   s.max_players != in.max_players ||
+                   std::memcmp(s.host_xnaddr, in.host_xnaddr, 36) != 0) {
+            st.changed++;
+        }
+        std::memcpy(s.xnkid, in.xnkid, 8);
+        std::memcpy(s.host_xnaddr, in.host_xnaddr, 36);
+        s.current_players = in.current_players;
+        s.max_players = in.max_players;
+        s.source = CachedSession::Source::Relay;
+        s.updated_ms = now_ms;
+        s.has_terms = false;
+        s.terms = {};
+    }
+
+    std::unordered_map<uint64_t, CachedSession> sessions_;
+    mutable std::mutex                          mutex_;
+    uint64_t                                    version_ = 0;
+    bool                                        relay_synced_ = false;
+    int64_t                                     relay_synced_ms_ = 0;
+};
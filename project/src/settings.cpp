@@ -3,6 +3,7 @@
 #include "settings.h"
 
 #include <toml++/toml.hpp>
+#include <algorithm>
 #include <fstream>
 
 Vig8Settings LoadSettings(const std::filesystem::path& path) {
@@ -28,18 +29,61 @@ Vig8Settings LoadSettings(const std::filesystem::path& path) {
         s.connected_2 = tbl["controls"]["connected_2"].value_or(s.connected_2);
         s.connected_3 = tbl["controls"]["connected_3"].value_or(s.connected_3);
         s.connected_4 = tbl["controls"]["connected_4"].value_or(s.connected_4);
+        s.pad_backend = tbl["controls"]["pad_backend"].value_or(s.pad_backend);
+        s.pad_poll_hz = tbl["controls"]["pad_poll_hz"].value_or(s.pad_poll_hz);
+
+        // [keyboard]
+        static const char* const kKeyNames[4] = {"keys_1", "keys_2", "keys_3", "keys_4"};
+        std::vector<std::string>* keys[4] = {&s.keys_1, &s.keys_2, &s.keys_3, &s.keys_4};
+        for (int i = 0; i < 4; i++) {
+            auto* arr = tbl["keyboard"][kKeyNames[i]].as_array();
+            if (!arr) continue;
+            for (auto& k : *arr) {
+                if (auto v = k.value<std::string>()) keys[i]->push_back(*v);
+            }
+        }
 
         // [network]
         s.lan_port      = tbl["network"]["lan_port"].value_or(s.lan_port);
         s.relay_enabled = tbl["network"]["relay_enabled"].value_or(s.relay_enabled);
         s.relay_host    = tbl["network"]["relay_host"].value_or(s.relay_host);
         s.relay_port    = tbl["network"]["relay_port"].value_or(s.relay_port);
+        s.relay_protocol = tbl["network"]["relay_protocol"].value_or(s.relay_protocol);
+        s.bind_address  = tbl["network"]["bind_address"].value_or(s.bind_address);
+        s.tunnel        = tbl["network"]["tunnel"].value_or(s.tunnel);
+        s.stun_server   = tbl["network"]["stun_server"].value_or(s.stun_server);
+        if (auto* peers = tbl["network"]["discovery_peers"].as_array()) {
+            for (auto& p : *peers) {
+                if (auto v = p.value<std::string>()) s.discovery_peers.push_back(*v);
+            }
+        }
+
+        // [impair]
+        s.impair_latency_ms     = tbl["impair"]["latency_ms"].value_or(s.impair_latency_ms);
+        s.impair_jitter_ms      = tbl["impair"]["jitter_ms"].value_or(s.impair_jitter_ms);
+        s.impair_loss_pct       = tbl["impair"]["loss_pct"].value_or(s.impair_loss_pct);
+        s.impair_reorder_pct    = tbl["impair"]["reorder_pct"].value_or(s.impair_reorder_pct);
+        s.impair_bandwidth_kbps = tbl["impair"]["bandwidth_kbps"].value_or(s.impair_bandwidth_kbps);
+        s.impair_seed           = tbl["impair"]["seed"].value_or(s.impair_seed);
+        s.impair_relay_delay_ms = tbl["impair"]["relay_delay_ms"].value_or(s.impair_relay_delay_ms);
+
+        // [test]
+        s.input_script = tbl["test"]["input_script"].value_or(s.input_script);
+        s.stats_file   = tbl["test"]["stats_file"].value_or(s.stats_file);
+        s.capture_file = tbl["test"]["capture_file"].value_or(s.capture_file);
+        s.replay_file  = tbl["test"]["replay_file"].value_or(s.replay_file);
 
         // [debug]
         s.show_fps = tbl["debug"]["show_fps"].value_or(s.show_fps);
         s.show_console = tbl["debug"]["show_console"].value_or(s.show_console);
         s.invulnerable = tbl["debug"]["invulnerable"].value_or(s.invulnerable);
         s.unlock_all_cars = tbl["debug"]["unlock_all_cars"].value_or(s.unlock_all_cars);
+        s.show_net_stats = tbl["debug"]["show_net_stats"].value_or(s.show_net_stats);
+        s.metrics_file = tbl["debug"]["metrics_file"].value_or(s.metrics_file);
+        s.input_latency = tbl["debug"]["input_latency"].value_or(s.input_latency);
+        s.latency_csv = tbl["debug"]["latency_csv"].value_or(s.latency_csv);
+        s.parallel_startup = tbl["debug"]["parallel_startup"].value_or(s.parallel_startup);
+        s.vtable_check = tbl["debug"]["vtable_check"].value_or(s.vtable_check);
     } catch (const toml::parse_error&) {
         // Parse error: return defaults
     }
@@ -69,18 +113,94 @@ void SaveSettings(const std::filesystem::path& path, const Vig8Settings& s) {
     f << "connected_2 = " << (s.connected_2 ? "true" : "false") << "\n";
     f << "connected_3 = " << (s.connected_3 ? "true" : "false") << "\n";
     f << "connected_4 = " << (s.connected_4 ? "true" : "false") << "\n";
+    f << "pad_backend = " << toml::value<std::string>(s.pad_backend) << "\n";
+    f << "pad_poll_hz = " << s.pad_poll_hz << "\n";
     f << "\n";
 
+    // [keyboard] is only written when a slot is rebound.
+    const std::vector<std::string>* keys[4] = {&s.keys_1, &s.keys_2, &s.keys_3, &s.keys_4};
+    if (std::any_of(keys, keys + 4, [](auto* k) { return !k->empty(); })) {
+        f << "[keyboard]\n";
+        for (int i = 0; i < 4; i++) {
+            if (keys[i]->empty()) continue;
+            f << "keys_" << (i + 1) << " = [";
+            for (size_t j = 0; j < keys[i]->size(); j++) {
+                f << (j ? ", " : "") << toml::value<std::string>((*keys[i])[j]);
+            }
+            f << "]\n";
+        }
+        f << "\n";
+    }
+
     f << "[network]\n";
     f << "lan_port = " << s.lan_port << "\n";
     f << "relay_enabled = " << (s.relay_enabled ? "true" : "false") << "\n";
     f << "relay_host = " << toml::value<std::string>(s.relay_host) << "\n";
     f << "relay_port = " << s.relay_port << "\n";
+    f << "relay_protocol = " << toml::value<std::string>(s.relay_protocol) << "\n";
+    f << "bind_address = " << toml::value<std::string>(s.bind_address) << "\n";
+    f << "tunnel = " << (s.tunnel ? "true" : "false") << "\n";
+    f << "stun_server = " << toml::value<std::string>(s.stun_server) << "\n";
+    f << "discovery_peers = [";
+    for (size_t i = 0; i < s.discovery_peers.size(); i++) {
+        f << (i ? ", " : "") << toml::value<std::string>(s.discovery_peers[i]);
+    }
+    f << "]\n";
     f << "\n";
 
+    // [impair] and [test] are only written when in use so normal
+    // settings files don't grow harness knobs.
+    if (s.impair_latency_ms || s.impair_jitter_ms || s.impair_loss_pct > 0 ||
+        s.impair_reorder_pct > 0 || s.impair_bandwidth_kbps || s.impair_relay_delay_ms) {
+        f << "[impair]\n";
+        f << "latency_ms = " << s.impair_latency_ms << "\n";
+        f << "jitter_ms = " << s.impair_jitter_ms << "\n";
+        f << "loss_pct = " << s.impair_loss_pct << "\n";
+        f << "reorder_pct = " << s.impair_reorder_pct << "\n";
+        f << "bandwidth_kbps = " << s.impair_bandwidth_kbps << "\n";
+        f << "seed = " << s.impair_seed << "\n";
+        f << "relay_delay_ms = " << s.impair_relay_delay_ms << "\n";
+        f << "\n";
+    }
+    if (!s.input_script.empty() || !s.stats_file.empty() ||
+        !s.capture_file.empty() || !s.replay_file.empty()) {
+        f << "[test]\n";
+        f << "input_script = " << toml::value<std::string>(s.input_script) << "\n";
+        f << "stats_file = " << toml::value<std::string>(s.stats_file) << "\n";
+        f << "capture_file = " << toml::value<std::string>(s.capture_file) << "\n";
+        f << "replay_file = " << toml::value<std::string>(s.replay_file) << "\n";
+        f << "\n";
+    }
+
     f << "[debug]\n";
     f << "show_fps = " << (s.show_fps ? "true" : "false") << "\n";
     f << "show_console = " << (s.show_console ? "true" : "false") << "\n";
     f << "invulnerable = " << (s.invulnerable ? "true" : "false") << "\n";
     f << "unlock_all_cars = " << (s.unlock_all_cars ? "true" : "false") << "\n";
+    f << "show_net_stats = " << (s.show_net_stats ? "true" : "false") << "\n";
+    f << "metrics_file = " << toml::value<std::string>(s.metrics_file) << "\n";
+    f << "input_latency = " << (s.input_latency ? "true" : "false") << "\n";
+    f << "latency_csv = " << toml::value<std::string>(s.latency_csv) << "\n";
+    f << "parallel_startup = " << (s.parallel_startup ? "true" : "false") << "\n";
+    f << "vtable_check = " << (s.vtable_check ? "true" : "false") << "\n";
+}
+
+NetTestOptions MakeNetTestOptions(const Vig8Settings& s) {
+    NetTestOptions o;
+    o.bind_address           = s.bind_address;
+    o.discovery_peers        = s.discovery_peers;
+    o.tunnel                 = s.tunnel;
+    o.stun_server            = s.stun_server;
+    o.impair.latency_ms      = s.impair_latency_ms;
+    o.impair.jitter_ms       = s.impair_jitter_ms;
+    o.impair.loss_pct        = s.impair_loss_pct;
+    o.impair.reorder_pct     = s.impair_reorder_pct;
+    o.impair.bandwidth_kbps  = s.impair_bandwidth_kbps;
+    o.impair.seed            = (uint32_t)s.impair_seed;
+    o.impair.relay_delay_ms  = s.impair_relay_delay_ms;
+    o.stats_path             = s.stats_file;
+    o.metrics_path           = s.metrics_file;
+    o.capture_path           = s.capture_file;
+    o.replay_path            = s.replay_file;
+    return o;
 }
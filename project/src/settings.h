@@ -4,8 +4,11 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <filesystem>
 
+#include "net.h"
+
 struct Vig8Settings {
     // [gfx]
     std::string render_path = "rov";  // "rov" or "rtv"
@@ -25,18 +28,55 @@ struct Vig8Settings {
     bool connected_2 = false;
     bool connected_3 = false;
     bool connected_4 = false;
+    // Physical pads (pad_poller.h): "auto", "xinput", "evdev", "synthetic"
+    // or "none", sampled pad_poll_hz times a second (max 1000)
+    std::string pad_backend = "auto";
+    int pad_poll_hz = 250;
+
+    // [keyboard] — per-slot key bindings, "CONTROL=Key" (keyboard_driver.h).
+    // Empty keys_1 keeps the built-in layout; other slots are unbound.
+    std::vector<std::string> keys_1;
+    std::vector<std::string> keys_2;
+    std::vector<std::string> keys_3;
+    std::vector<std::string> keys_4;
 
     // [network]
     int lan_port = 3074;         // UDP port for LAN discovery/QoS beacons
-    bool relay_enabled = false;  // Connect to xlive relay server
+    bool relay_enabled = false;  // Connect to a relay server
     std::string relay_host = "localhost";
     int relay_port = 36000;
+    std::string relay_protocol = "xlive";  // or "relay_server" (tools/relay_server)
+    std::string bind_address;                  // "" = auto-detect LAN IP
+    std::vector<std::string> discovery_peers;  // "ip[:port]" unicast targets
+    bool tunnel = false;  // batch + compress game traffic (all players must match)
+    std::string stun_server;  // "ip[:port]" for direct paths through NAT, "" = off
+
+    // [impair] — test-only network impairment on outgoing traffic
+    int impair_latency_ms = 0;
+    int impair_jitter_ms = 0;
+    double impair_loss_pct = 0.0;
+    double impair_reorder_pct = 0.0;
+    int impair_bandwidth_kbps = 0;  // 0 = unlimited
+    int impair_seed = 1;
+    int impair_relay_delay_ms = 0;  // delay every relay request
+
+    // [test] — headless harness (vig8_test) only
+    std::string input_script;  // scripted controller input for slot 0
+    std::string stats_file;    // periodic network stats (JSON)
+    std::string capture_file;  // pcapng capture of guest network traffic
+    std::string replay_file;   // replay a capture instead of using the network
 
     // [debug]
     bool show_fps = true;
     bool show_console = false;
     bool invulnerable = false;
     bool unlock_all_cars = false;
+    bool show_net_stats = false;  // per-peer network table in the overlay
+    std::string metrics_file;     // per-peer network metrics (Prometheus text)
+    bool input_latency = false;   // measure input-to-present latency (overlay)
+    std::string latency_csv;      // per-event latencies; also enables measuring
+    bool parallel_startup = true; // false: run startup phases serially
+    bool vtable_check = false;    // report vtable targets with no recompiled function
 };
 
 // Global debug flags (defined in stubs.cpp, set from ApplySettings)
@@ -52,3 +92,7 @@ Vig8Settings LoadSettings(const std::filesystem::path& path);
 
 // Save settings to TOML file.
 void SaveSettings(const std::filesystem::path& path, const Vig8Settings& settings);
+
+// Network test options ([network] bind/peers, [impair], [test] stats,
+// [debug] metrics) for NetSetTestOptions.
+NetTestOptions MakeNetTestOptions(const Vig8Settings& settings);
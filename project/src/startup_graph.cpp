@@ -0,0 +1,229 @@
+// vig8 - Startup task graph
+// See startup_graph.h.
+
+#include "startup_graph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+static int64_t StartupNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+StartupGraph::TaskId StartupGraph::Add(const char* name, std::function<bool()> fn,
+                                       std::initializer_list<TaskId> deps, bool ui) {
+    TaskId id = (TaskId)tasks_.size();
+    Task t;
+    t.name = name;
+    t.fn = std::move(fn);
+    t.deps = deps;
+    t.ui = ui;
+    tasks_.push_back(std::move(t));
+    for (TaskId d : deps) tasks_[d].dependents.push_back(id);
+    return id;
+}
+
+void StartupGraph::AddBackground(const char* name, std::function<void()> fn) {
+    background_.push_back({name, std::move(fn), nullptr});
+}
+
+void StartupGraph::Execute(TaskId id, int runner) {
+    Task& t = tasks_[id];
+    t.runner = runner;
+    t.start_ns = StartupNowNs();
+    bool ok = t.fn();
+    t.end_ns = StartupNowNs();
+    t.state = ok ? State::Done : State::Failed;
+}
+
+bool StartupGraph::Run(bool parallel) {
+    parallel_ = parallel;
+    run_start_ns_ = StartupNowNs();
+    for (auto& t : tasks_) {
+        t.state = State::Waiting;
+        t.pending = (int)t.deps.size();
+        t.start_ns = t.end_ns = 0;
+    }
+    for (auto& b : background_) {
+        auto timing = std::make_shared<BackgroundTiming>();
+        timing->start_ns.store(StartupNowNs(), std::memory_order_relaxed);
+        b.timing = timing;
+        std::thread([fn = b.fn, timing]() {
+            fn();
+            timing->end_ns.store(StartupNowNs(), std::memory_order_release);
+        }).detach();
+    }
+
+    if (!parallel) {
+        workers_ = 0;
+        for (TaskId id = 0; id < (TaskId)tasks_.size(); id++) {
+            Task& t = tasks_[id];
+            bool ready = std::all_of(t.deps.begin(), t.deps.end(),
+                                     [&](TaskId d) { return tasks_[d].state == State::Done; });
+            if (ready) Execute(id, 0);
+            else t.state = State::Skipped;
+        }
+    } else {
+        std::mutex              m;
+        std::condition_variable cv;
+        std::vector<TaskId>     ready_any;  // both run lowest id first, so
+        std::vector<TaskId>     ready_ui;   // registration order is priority
+        size_t                  finished = 0;
+
+        auto enqueue = [&](TaskId id) {
+            if (tasks_[id].ui) ready_ui.push_back(id);
+            else ready_any.push_back(id);
+        };
+        // Under m: record the outcome and release or skip dependents.
+        std::function<void(TaskId)> finish = [&](TaskId id) {
+            finished++;
+            bool ok = tasks_[id].state == State::Done;
+            for (TaskId d : tasks_[id].dependents) {
+                Task& dt = tasks_[d];
+                if (dt.state != State::Waiting) continue;
+                if (!ok) {
+                    dt.state = State::Skipped;
+                    finish(d);
+                } else if (--dt.pending == 0) {
+                    enqueue(d);
+                }
+            }
+        };
+
+        for (TaskId id = 0; id < (TaskId)tasks_.size(); id++) {
+            if (tasks_[id].pending == 0) enqueue(id);
+        }
+
+        unsigned hw = std::thread::hardware_concurrency();
+        workers_ = (int)std::clamp(hw > 1 ? hw - 1 : 1u, 2u, 4u);
+        std::vector<std::thread> pool;
+        for (int w = 0; w < workers_; w++) {
+            pool.emplace_back([&, w]() {
+                std::unique_lock<std::mutex> lock(m);
+                for (;;) {
+                    cv.wait(lock, [&]() { return !ready_any.empty() || finished == tasks_.size(); });
+                    if (ready_any.empty()) return;
+                    auto it = std::min_element(ready_any.begin(), ready_any.end());
+                    TaskId id = *it;
+                    ready_any.erase(it);
+                    lock.unlock();
+                    Execute(id, w + 1);
+                    lock.lock();
+                    finish(id);
+                    cv.notify_all();
+                }
+            });
+        }
+
+        std::unique_lock<std::mutex> lock(m);
+        for (;;) {
+            cv.wait(lock, [&]() { return !ready_ui.empty() || finished == tasks_.size(); });
+            if (ready_ui.empty()) break;
+            auto it = std::min_element(ready_ui.begin(), ready_ui.end());
+            TaskId id = *it;
+            ready_ui.erase(it);
+            lock.unlock();
+            Execute(id, 0);
+            lock.lock();
+            finish(id);
+            cv.notify_all();
+        }
+        lock.unlock();
+        for (auto& th : pool) th.join();
+    }
+
+    run_end_ns_ = StartupNowNs();
+    return std::all_of(tasks_.begin(), tasks_.end(),
+                       [](const Task& t) { return t.state == State::Done; });
+}
+
+std::string StartupGraph::Report() const {
+    auto ms = [](int64_t ns) { return (double)ns / 1e6; };
+    std::string out;
+    char line[256];
+
+    double work_ms = 0;
+    for (const Task& t : tasks_) work_ms += ms(t.end_ns - t.start_ns);
+    snprintf(line, sizeof(line), "startup (%s, %d workers): wall %.1f ms, work %.1f ms\n",
+             parallel_ ? "parallel" : "serial", workers_,
+             ms(run_end_ns_ - run_start_ns_), work_ms);
+    out += line;
+
+    for (const Task& t : tasks_) {
+        const char* state = t.state == State::Done ? "" :
+                            t.state == State::Failed ? "  FAILED" : "  skipped";
+        snprintf(line, sizeof(line), "  %-10s %s +%7.1f ms  %7.1f ms%s\n",
+                 t.name.c_str(), t.ui ? "ui" : "  ",
+                 t.start_ns ? ms(t.start_ns - run_start_ns_) : 0.0,
+                 ms(t.end_ns - t.start_ns), state);
+        out += line;
+    }
+
+    for (const Background& b : background_) {
+        if (!b.timing) continue;
+        int64_t start = b.timing->start_ns.load(std::memory_order_relaxed);
+        int64_t end = b.timing->end_ns.load(std::memory_order_acquire);
+        if (end) {
+            snprintf(line, sizeof(line), "  %-10s bg +%7.1f ms  %7.1f ms\n", b.name.c_str(),
+                     ms(start - run_start_ns_), ms(end - start));
+        } else {
+            snprintf(line, sizeof(line), "  %-10s bg +%7.1f ms  still running\n", b.name.c_str(),
+                     ms(start - run_start_ns_));
+        }
+        out += line;
+    }
+
+    // Walk back from the last task to finish
+    TaskId cur = -1;
+    for (TaskId id = 0; id < (TaskId)tasks_.size(); id++) {
+        if (tasks_[id].end_ns && (cur < 0 || tasks_[id].end_ns > tasks_[cur].end_ns)) cur = id;
+    }
+    std::vector<TaskId> path;
+    while (cur >= 0) {
+        path.push_back(cur);
+        const Task& t = tasks_[cur];
+        auto later = [&](TaskId a, TaskId b) { return b < 0 || tasks_[a].end_ns > tasks_[b].end_ns; };
+        TaskId next = -1;
+        for (TaskId d : t.deps) {
+            if (tasks_[d].end_ns && later(d, next)) next = d;
+        }
+        // The task that held this one's thread until it started
+        for (TaskId id = 0; id < (TaskId)tasks_.size(); id++) {
+            const Task& o = tasks_[id];
+            if (id != cur && o.end_ns && o.runner == t.runner && o.end_ns <= t.start_ns &&
+                later(id, next)) next = id;
+        }
+        cur = next;
+    }
+    out += "  critical path:";
+    for (auto it = path.rbegin(); it != path.rend(); ++it) {
+        const Task& t = tasks_[*it];
+        snprintf(line, sizeof(line), "%s %s %.1f ms", it == path.rbegin() ? "" : " ->",
+                 t.name.c_str(), ms(t.end_ns - t.start_ns));
+        out += line;
+    }
+    out += "\n";
+    return out;
+}
+
+uint64_t StartupWarmFiles(const std::string& dir, uint64_t max_bytes) {
+    std::error_code ec;
+    std::filesystem::recursive_directory_iterator it(dir, ec), end;
+    std::vector<char> buf(1 << 20);
+    uint64_t total = 0;
+    for (; !ec && it != end && total < max_bytes; it.increment(ec)) {
+        if (!it->is_regular_file(ec)) continue;
+        FILE* f = fopen(it->path().string().c_str(), "rb");
+        if (!f) continue;
+        size_t n;
+        while (total < max_bytes && (n = fread(buf.data(), 1, buf.size(), f)) > 0) total += n;
+        fclose(f);
+    }
+    return total;
+}
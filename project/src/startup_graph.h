@@ -0,0 +1,85 @@
+// vig8 - Startup task graph
+//
+// Startup phases registered as tasks with dependencies. Run() executes
+// them on a small worker pool; tasks marked `ui` run on the calling
+// thread instead (window and presenter work must stay on the UI thread).
+// Among ready tasks the earliest registered runs first. Serial mode runs
+// every task on the caller in registration order, the baseline the
+// parallel schedule is compared against.
+//
+// A task returns false to fail; tasks depending on it are skipped and
+// Run() returns false. Report() lists each task's start and duration and
+// the critical path: from the task that finished last, back at each step
+// through whichever finished last of its dependencies and the task its
+// thread ran before it.
+//
+// Background tasks (AddBackground) start on their own detached thread
+// when Run() begins, in either mode. Run() never waits for them and their
+// time is kept out of the wall, work and critical path figures; Report()
+// lists them separately.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <vector>
+
+class StartupGraph {
+public:
+    using TaskId = int;
+
+    TaskId Add(const char* name, std::function<bool()> fn,
+               std::initializer_list<TaskId> deps = {}, bool ui = false);
+
+    // `fn` may outlive the graph and the caller's frame: capture by value.
+    void AddBackground(const char* name, std::function<void()> fn);
+
+    bool Run(bool parallel);
+
+    // Multi-line timing report of the last Run().
+    std::string Report() const;
+
+private:
+    enum class State { Waiting, Done, Failed, Skipped };
+
+    struct Task {
+        std::string           name;
+        std::function<bool()> fn;
+        std::vector<TaskId>   deps;
+        std::vector<TaskId>   dependents;
+        bool                  ui = false;
+        State                 state = State::Waiting;
+        int                   pending = 0;   // unfinished deps
+        int                   runner = -1;
+        int64_t               start_ns = 0, end_ns = 0;
+    };
+
+    // Shared with the detached thread, which may finish after the graph
+    // is gone.
+    struct BackgroundTiming {
+        std::atomic<int64_t> start_ns{0}, end_ns{0};
+    };
+    struct Background {
+        std::string                       name;
+        std::function<void()>             fn;
+        std::shared_ptr<BackgroundTiming> timing;
+    };
+
+    // `runner` is 0 for the calling thread, else the worker's number.
+    void Execute(TaskId id, int runner);
+
+    std::vector<Task>       tasks_;
+    std::vector<Background> background_;
+    int64_t           run_start_ns_ = 0, run_end_ns_ = 0;
+    bool              parallel_ = false;
+    int               workers_ = 0;
+};
+
+// Read every file under `dir` once (up to `max_bytes` in total) so the
+// OS page cache holds the game's assets before the game opens them.
+// Returns the bytes read.
+uint64_t StartupWarmFiles(const std::string& dir, uint64_t max_bytes);
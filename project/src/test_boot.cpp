@@ -3,10 +3,18 @@
 
 #include "vig8_config.h"
 #include "vig8_init.h"
+#include "headless_input.h"
+#include "net.h"
+#include "input_latency.h"
+#include "script_input.h"
+#include "settings.h"
+#include "startup_graph.h"
+#include "vtable_check.h"
 
 #include <rex/runtime.h>
 #include <rex/logging.h>
 #include <rex/cvar.h>
+#include <rex/kernel/kernel_state.h>
 
 #include <cstdio>
 #include <filesystem>
@@ -150,45 +158,128 @@ int main(int argc, char** argv) {
     fprintf(stderr, "[test] Game dir: %s\n", game_dir.string().c_str());
     fflush(stderr);
 
-    // Create runtime (tool mode - no GPU)
-    fprintf(stderr, "[test] Creating Runtime...\n");
+    // Settings: explicit path (harness instances each get their own) or the
+    // same vig8_settings.toml the app uses.
+    std::filesystem::path settings_path;
+    if (argc > 2) {
+        settings_path = argv[2];
+    } else {
+        settings_path = std::filesystem::absolute(game_dir).parent_path() / "vig8_settings.toml";
+    }
+    Vig8Settings settings = LoadSettings(settings_path);
+    fprintf(stderr, "[test] Settings: %s\n", settings_path.string().c_str());
     fflush(stderr);
 
-    auto runtime = std::make_unique<rex::Runtime>(game_dir);
+    // Startup phases as a task graph, the same shape as the app's minus the
+    // window: XEX load and networking overlap once the runtime is up, and
+    // the asset warmup runs in the background in either mode. [debug]
+    // parallel_startup = false runs the tasks serially.
+    std::unique_ptr<rex::Runtime> runtime;
+    StartupGraph startup;
+    auto t_runtime = startup.Add("runtime", [&]() {
+        // Create runtime (tool mode - no GPU)
+        fprintf(stderr, "[test] Creating Runtime...\n");
+        fflush(stderr);
 
-    fprintf(stderr, "[test] Runtime created, calling Setup...\n");
-    fflush(stderr);
+        runtime = std::make_unique<rex::Runtime>(game_dir);
 
-    auto status = runtime->Setup(
-        static_cast<uint32_t>(PPC_CODE_BASE),
-        static_cast<uint32_t>(PPC_CODE_SIZE),
-        static_cast<uint32_t>(PPC_IMAGE_BASE),
-        static_cast<uint32_t>(PPC_IMAGE_SIZE),
-        PPCFuncMappings);
+        fprintf(stderr, "[test] Runtime created, calling Setup...\n");
+        fflush(stderr);
 
-    fprintf(stderr, "[test] Setup returned: 0x%08X\n", status);
-    fflush(stderr);
+        auto status = runtime->Setup(
+            static_cast<uint32_t>(PPC_CODE_BASE),
+            static_cast<uint32_t>(PPC_CODE_SIZE),
+            static_cast<uint32_t>(PPC_IMAGE_BASE),
+            static_cast<uint32_t>(PPC_IMAGE_SIZE),
+            PPCFuncMappings);
 
-    if (status != 0) {
-        fprintf(stderr, "[test] Setup FAILED\n");
-        return 1;
-    }
+        fprintf(stderr, "[test] Setup returned: 0x%08X\n", status);
+        fflush(stderr);
 
-    // Load XEX
-    fprintf(stderr, "[test] Loading XEX...\n");
-    fflush(stderr);
+        if (status != 0) {
+            fprintf(stderr, "[test] Setup FAILED\n");
+            return false;
+        }
+        return true;
+    }, {}, true);
 
-    status = runtime->LoadXexImage("game:\\default.xex");
-    fprintf(stderr, "[test] LoadXexImage returned: 0x%08X\n", status);
-    fflush(stderr);
+    auto t_xex = startup.Add("xex", [&]() {
+        // Load XEX
+        fprintf(stderr, "[test] Loading XEX...\n");
+        fflush(stderr);
 
-    if (status != 0) {
-        fprintf(stderr, "[test] LoadXexImage FAILED\n");
-        return 1;
+        auto status = runtime->LoadXexImage("game:\\default.xex");
+        fprintf(stderr, "[test] LoadXexImage returned: 0x%08X\n", status);
+        fflush(stderr);
+
+        if (status != 0) {
+            fprintf(stderr, "[test] LoadXexImage FAILED\n");
+            return false;
+        }
+
+        fprintf(stderr, "[test] Boot test PASSED - XEX loaded successfully!\n");
+        fflush(stderr);
+        return true;
+    }, {t_runtime});
+
+    if (settings.vtable_check) {
+        startup.Add("vtables", [&]() {
+            std::string report;
+            VtableCheck(runtime->kernel_state()->memory()->virtual_membase(), report);
+            fprintf(stderr, "[test] %s", report.c_str());
+            fflush(stderr);
+            return true;
+        }, {t_xex});
     }
 
-    fprintf(stderr, "[test] Boot test PASSED - XEX loaded successfully!\n");
+    // Scripted controller on slot 0. Without a display window the runtime
+    // creates no input system, so the game's input calls are answered by
+    // headless_input.cpp from the script. A latency benchmark with no script
+    // of its own gets the synthetic one, since without input it measures
+    // nothing. A script that can't be loaded stops the run rather than
+    // leave the game without input.
+    bool measure_latency = settings.input_latency || !settings.latency_csv.empty();
+    std::string input_script = settings.input_script;
+    if (input_script.empty() && measure_latency) input_script = "synthetic";
+    startup.Add("input", [&]() {
+        if (input_script.empty()) return true;
+        auto script = std::make_unique<ScriptedInputDriver>(input_script);
+        if (script->Setup() != X_STATUS_SUCCESS) {
+            fprintf(stderr, "[test] FAILED to load input_script %s\n", input_script.c_str());
+            fflush(stderr);
+            return false;
+        }
+        HeadlessInputInstall(std::move(script));
+        fprintf(stderr, "[test] Input script %s on slot 0\n", input_script.c_str());
+        fflush(stderr);
+        return true;
+    });
+
+    startup.Add("net", [&]() {
+        NetSetTestOptions(MakeNetTestOptions(settings));
+        NetInit(settings.lan_port,
+                settings.relay_enabled,
+                settings.relay_host.c_str(),
+                settings.relay_port,
+                settings.relay_protocol.c_str());
+        return true;
+    }, {t_runtime});
+
+    startup.AddBackground("assets", [dir = game_dir.string()]() {
+        uint64_t bytes = StartupWarmFiles(dir, 1ull << 30);
+        fprintf(stderr, "[test] Warmed %llu MB of assets\n", (unsigned long long)(bytes >> 20));
+    });
+
+    bool started = startup.Run(settings.parallel_startup);
+    fprintf(stderr, "[test] %s", startup.Report().c_str());
     fflush(stderr);
+    if (!started) return 1;
+
+    // Latency benchmarks: input_latency or latency_csv, driven by the
+    // input script (synthetic unless one is set)
+    if (measure_latency) {
+        InputLatencyStart(settings.latency_csv);
+    }
 
     // Launch module
     fprintf(stderr, "[test] Launching module...\n");
@@ -201,6 +292,14 @@ int main(int argc, char** argv) {
         thread->Wait(0, 0, 0, nullptr);
     }
 
+    NetShutdown();
+    uint64_t latency_events = InputLatencyRead().events;
+    InputLatencyStop();
+    if (measure_latency && latency_events == 0) {
+        fprintf(stderr, "[test] FAILED: input latency benchmark recorded no events\n");
+        return 1;
+    }
+
     fprintf(stderr, "[test] Done.\n");
     return 0;
 }
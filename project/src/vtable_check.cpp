@@ -0,0 +1,74 @@
+// vig8 - Startup vtable coverage check
+// See vtable_check.h.
+
+#include "vtable_check.h"
+#include "vtable_scan.h"
+
+#include "vig8_config.h"
+#include "vig8_init.h"
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <vector>
+
+VtableCheckResult VtableCheck(const uint8_t* base, std::string& report, size_t max_listed) {
+    auto start = std::chrono::steady_clock::now();
+    const uint32_t image_base = static_cast<uint32_t>(PPC_IMAGE_BASE);
+    const uint32_t code_begin = static_cast<uint32_t>(PPC_CODE_BASE);
+    const uint32_t code_end = static_cast<uint32_t>(PPC_CODE_BASE + PPC_CODE_SIZE);
+    const uint8_t* image = base + image_base;
+    VtableCheckResult r;
+
+    // Data sections from the mapped PE headers; without them, everything
+    // below the code, as the original Python scanner did.
+    std::vector<VtableSection> sections;
+    if (!VtableParseSections(image, static_cast<size_t>(PPC_IMAGE_SIZE), image_base, sections)) {
+        sections.clear();
+        sections.push_back({"image", image_base, code_begin - image_base, false});
+    }
+
+    std::vector<VtableSlot> slots;
+    for (const auto& s : sections) {
+        if (s.code) continue;
+        r.sections++;
+        r.pointers += VtableScan(base + s.address, s.size, s.address, code_begin, code_end, 2, slots);
+    }
+    r.slots = slots.size();
+
+    // Missing target -> slots referencing it
+    std::map<uint32_t, std::vector<uint32_t>> missing;
+    for (const auto& slot : slots) {
+        if (!PPC_LOOKUP_FUNC(const_cast<uint8_t*>(base), slot.target)) {
+            missing[slot.target].push_back(slot.address);
+        }
+    }
+    r.missing = missing.size();
+    r.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    char line[160];
+    snprintf(line, sizeof(line),
+             "vtable check: %zu sections, %zu code pointers, %zu vtable slots, "
+             "%zu targets without a function (%.2f ms, %s)\n",
+             r.sections, r.pointers, r.slots, r.missing, r.ms, VtableScanKernel());
+    report = line;
+    size_t listed = 0;
+    for (const auto& [target, refs] : missing) {
+        if (listed++ == max_listed) {
+            snprintf(line, sizeof(line), "  ... %zu more\n", missing.size() - max_listed);
+            report += line;
+            break;
+        }
+        VtableThunk thunk;
+        if (VtableIsThunk(base + target, target, thunk)) {
+            snprintf(line, sizeof(line), "  0x%08X thunk: addi r3,r3,%d; b 0x%08X",
+                     target, thunk.adjust, thunk.target);
+        } else {
+            snprintf(line, sizeof(line), "  0x%08X", target);
+        }
+        report += line;
+        snprintf(line, sizeof(line), "  (%zu refs, first 0x%08X)\n", refs.size(), refs[0]);
+        report += line;
+    }
+    return r;
+}
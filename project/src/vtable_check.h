@@ -0,0 +1,31 @@
+// vig8 - Startup vtable coverage check
+//
+// After the XEX loads, scans the image's data sections for vtables (see
+// vtable_scan.h) and looks every target up in the runtime's function
+// table, the same lookup PPC_CALL_INDIRECT_FUNC does. A target without a
+// recompiled function would otherwise only surface when the game makes
+// that virtual call; this lists all of them in a few milliseconds, before
+// the title starts. Enabled by [debug] vtable_check.
+//
+// tools/find_missing_vtable_funcs does the same offline against
+// pe_image.bin and generated/vig8_init.cpp.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct VtableCheckResult {
+    size_t sections = 0;  // data sections scanned
+    size_t pointers = 0;  // code pointers seen
+    size_t slots = 0;     // of those, in vtables
+    size_t missing = 0;   // distinct vtable targets with no function
+    double ms = 0;
+};
+
+// `base` is the guest memory base with the image mapped at PPC_IMAGE_BASE
+// and the function table populated. `report` gets a summary line and one
+// line per missing target (at most `max_listed`).
+VtableCheckResult VtableCheck(const uint8_t* base, std::string& report,
+                              size_t max_listed = 64);
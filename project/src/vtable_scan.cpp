@@ -0,0 +1,228 @@
+// vig8 - Vtable scanner
+// See vtable_scan.h.
+
+#include "vtable_scan.h"
+
+#include <bit>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define VTABLE_HAVE_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#if defined(__GNUC__) || defined(__clang__)
+#define VTABLE_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define VTABLE_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define VTABLE_TARGET_SSE41
+#define VTABLE_TARGET_AVX2
+#endif
+#endif
+
+static uint32_t LoadBE32(const uint8_t* p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static uint32_t LoadLE32(const uint8_t* p) {
+    return (uint32_t)p[3] << 24 | (uint32_t)p[2] << 16 | (uint32_t)p[1] << 8 | p[0];
+}
+
+static uint16_t LoadLE16(const uint8_t* p) {
+    return (uint16_t)(p[1] << 8 | p[0]);
+}
+
+bool VtableParseSections(const uint8_t* image, size_t size, uint32_t image_base,
+                         std::vector<VtableSection>& out) {
+    if (size < 0x40 || image[0] != 'M' || image[1] != 'Z') return false;
+    uint32_t pe = LoadLE32(image + 0x3C);
+    if ((uint64_t)pe + 24 > size || memcmp(image + pe, "PE\0\0", 4) != 0) return false;
+    uint16_t count = LoadLE16(image + pe + 6);
+    uint16_t optional_size = LoadLE16(image + pe + 20);
+    uint64_t table = (uint64_t)pe + 24 + optional_size;
+    if (table + (uint64_t)count * 40 > size) return false;
+
+    out.clear();
+    for (uint16_t i = 0; i < count; i++) {
+        const uint8_t* h = image + table + i * 40;
+        VtableSection s;
+        s.name.assign((const char*)h, strnlen((const char*)h, 8));
+        uint32_t rva = LoadLE32(h + 12);
+        uint32_t vsize = LoadLE32(h + 8);
+        if (vsize == 0) vsize = LoadLE32(h + 16);  // SizeOfRawData
+        if (rva >= size) continue;
+        if (vsize > size - rva) vsize = (uint32_t)(size - rva);
+        uint32_t flags = LoadLE32(h + 36);
+        s.address = image_base + rva;
+        s.size = vsize;
+        // IMAGE_SCN_CNT_CODE | IMAGE_SCN_MEM_EXECUTE
+        s.code = (flags & 0x20000020) != 0;
+        out.push_back(std::move(s));
+    }
+    return true;
+}
+
+enum class Kernel { Scalar, Sse41, Avx2 };
+
+// Each kernel appends the index of every word that is a code pointer:
+// (word - code_begin) <= last unsigned, and 4-byte aligned.
+
+static void ScanScalar(const uint8_t* p, size_t begin, size_t words,
+                       uint32_t code_begin, uint32_t last, std::vector<uint32_t>& hits) {
+    for (size_t i = begin; i < words; i++) {
+        uint32_t v = LoadBE32(p + i * 4);
+        if (v - code_begin <= last && (v & 3) == 0) hits.push_back((uint32_t)i);
+    }
+}
+
+#ifdef VTABLE_HAVE_X86
+VTABLE_TARGET_SSE41 static inline unsigned MaskSse41(const uint8_t* p, __m128i shuffle,
+                                                     __m128i begin, __m128i last, __m128i three) {
+    __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)p), shuffle);
+    __m128i d = _mm_sub_epi32(v, begin);
+    __m128i in = _mm_cmpeq_epi32(_mm_min_epu32(d, last), d);
+    __m128i aligned = _mm_cmpeq_epi32(_mm_and_si128(v, three), _mm_setzero_si128());
+    return (unsigned)_mm_movemask_ps(_mm_castsi128_ps(_mm_and_si128(in, aligned)));
+}
+
+VTABLE_TARGET_SSE41 static void ScanSse41(const uint8_t* p, size_t words, uint32_t code_begin,
+                                          uint32_t last, std::vector<uint32_t>& hits) {
+    const __m128i shuffle = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    const __m128i begin = _mm_set1_epi32((int)code_begin);
+    const __m128i vlast = _mm_set1_epi32((int)last);
+    const __m128i three = _mm_set1_epi32(3);
+    size_t i = 0;
+    for (; i + 16 <= words; i += 16) {
+        const uint8_t* q = p + i * 4;
+        unsigned m = MaskSse41(q, shuffle, begin, vlast, three) |
+                     MaskSse41(q + 16, shuffle, begin, vlast, three) << 4 |
+                     MaskSse41(q + 32, shuffle, begin, vlast, three) << 8 |
+                     MaskSse41(q + 48, shuffle, begin, vlast, three) << 12;
+        for (; m; m &= m - 1) hits.push_back((uint32_t)(i + std::countr_zero(m)));
+    }
+    ScanScalar(p, i, words, code_begin, last, hits);
+}
+
+VTABLE_TARGET_AVX2 static inline unsigned MaskAvx2(const uint8_t* p, __m256i shuffle,
+                                                   __m256i begin, __m256i last, __m256i three) {
+    __m256i v = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)p), shuffle);
+    __m256i d = _mm256_sub_epi32(v, begin);
+    __m256i in = _mm256_cmpeq_epi32(_mm256_min_epu32(d, last), d);
+    __m256i aligned = _mm256_cmpeq_epi32(_mm256_and_si256(v, three), _mm256_setzero_si256());
+    return (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_and_si256(in, aligned)));
+}
+
+VTABLE_TARGET_AVX2 static void ScanAvx2(const uint8_t* p, size_t words, uint32_t code_begin,
+                                        uint32_t last, std::vector<uint32_t>& hits) {
+    const __m256i shuffle = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                             3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    const __m256i begin = _mm256_set1_epi32((int)code_begin);
+    const __m256i vlast = _mm256_set1_epi32((int)last);
+    const __m256i three = _mm256_set1_epi32(3);
+    size_t i = 0;
+    for (; i + 32 <= words; i += 32) {
+        const uint8_t* q = p + i * 4;
+        uint32_t m = MaskAvx2(q, shuffle, begin, vlast, three) |
+                     MaskAvx2(q + 32, shuffle, begin, vlast, three) << 8 |
+                     MaskAvx2(q + 64, shuffle, begin, vlast, three) << 16 |
+                     MaskAvx2(q + 96, shuffle, begin, vlast, three) << 24;
+        for (; m; m &= m - 1) hits.push_back((uint32_t)(i + std::countr_zero(m)));
+    }
+    ScanScalar(p, i, words, code_begin, last, hits);
+}
+
+static Kernel DetectKernel() {
+    unsigned r[4];
+#if defined(_MSC_VER)
+    int regs[4];
+    __cpuid(regs, 1);
+    for (int i = 0; i < 4; i++) r[i] = (unsigned)regs[i];
+#else
+    if (!__get_cpuid(1, &r[0], &r[1], &r[2], &r[3])) return Kernel::Scalar;
+#endif
+    bool sse41 = (r[2] >> 19) & 1;
+    bool osxsave = (r[2] >> 27) & 1;
+    bool avx = (r[2] >> 28) & 1;
+    if (osxsave && avx) {
+        // The OS must save the YMM state (XCR0 bits 1 and 2)
+#if defined(_MSC_VER)
+        bool ymm = (_xgetbv(0) & 6) == 6;
+        __cpuidex(regs, 7, 0);
+        r[1] = (unsigned)regs[1];
+#else
+        unsigned lo, hi;
+        __asm__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        bool ymm = (lo & 6) == 6;
+        __cpuid_count(7, 0, r[0], r[1], r[2], r[3]);
+#endif
+        if (ymm && ((r[1] >> 5) & 1)) return Kernel::Avx2;
+    }
+    return sse41 ? Kernel::Sse41 : Kernel::Scalar;
+}
+#endif
+
+static Kernel ActiveKernel() {
+#ifdef VTABLE_HAVE_X86
+    static const Kernel kernel = DetectKernel();
+    return kernel;
+#else
+    return Kernel::Scalar;
+#endif
+}
+
+const char* VtableScanKernel() {
+    switch (ActiveKernel()) {
+    case Kernel::Avx2: return "avx2";
+    case Kernel::Sse41: return "sse4.1";
+    default: return "scalar";
+    }
+}
+
+size_t VtableScan(const uint8_t* data, size_t size, uint32_t address,
+                  uint32_t code_begin, uint32_t code_end, size_t min_run,
+                  std::vector<VtableSlot>& out, bool simd) {
+    if (code_end <= code_begin) return 0;
+    size_t words = size / 4;
+    uint32_t last = code_end - code_begin - 1;
+    std::vector<uint32_t> hits;
+
+    Kernel kernel = simd ? ActiveKernel() : Kernel::Scalar;
+#ifdef VTABLE_HAVE_X86
+    if (kernel == Kernel::Avx2) ScanAvx2(data, words, code_begin, last, hits);
+    else if (kernel == Kernel::Sse41) ScanSse41(data, words, code_begin, last, hits);
+    else
+#endif
+    ScanScalar(data, 0, words, code_begin, last, hits);
+
+    // Keep runs of consecutive slots
+    if (min_run == 0) min_run = 1;
+    for (size_t i = 0; i < hits.size();) {
+        size_t j = i + 1;
+        while (j < hits.size() && hits[j] == hits[j - 1] + 1) j++;
+        if (j - i >= min_run) {
+            for (size_t k = i; k < j; k++) {
+                uint32_t off = hits[k] * 4;
+                out.push_back({address + off, LoadBE32(data + off)});
+            }
+        }
+        i = j;
+    }
+    return hits.size();
+}
+
+bool VtableIsThunk(const uint8_t* code, uint32_t address, VtableThunk& thunk) {
+    uint32_t i1 = LoadBE32(code);
+    uint32_t i2 = LoadBE32(code + 4);
+    // addi r3,r3,imm (opcode 14, rD = rA = 3); b target (opcode 18, AA = LK = 0)
+    bool addi_r3 = (i1 >> 26) == 14 && ((i1 >> 21) & 0x1F) == 3 && ((i1 >> 16) & 0x1F) == 3;
+    bool branch = (i2 >> 26) == 18 && (i2 & 3) == 0;
+    if (!addi_r3 || !branch) return false;
+    thunk.adjust = (int16_t)(i1 & 0xFFFF);
+    int32_t li = (int32_t)(i2 & 0x03FFFFFC);
+    if (li >= 0x02000000) li -= 0x04000000;
+    thunk.target = address + 4 + (uint32_t)li;
+    return true;
+}
@@ -0,0 +1,57 @@
+// vig8 - Vtable scanner
+//
+// Finds vtables in the XEX image: runs of consecutive 4-byte slots in the
+// data sections that hold big-endian pointers into the recompiled code
+// range. A target with no recompiled function is a virtual call waiting
+// to fail ("Indirect call to 0x...: no recompiled function"), so these
+// are what the startup self-check (vtable_check.h) and
+// tools/find_missing_vtable_funcs look for.
+//
+// No runtime dependencies: the tool builds this file on its own.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct VtableSection {
+    std::string name;
+    uint32_t    address = 0;   // guest address
+    uint32_t    size = 0;
+    bool        code = false;  // executable; not scanned
+};
+
+// Section table of a PE image as laid out in memory (what extract_pe
+// writes and the loader maps at `image_base`). Returns false if the
+// headers are not a valid PE.
+bool VtableParseSections(const uint8_t* image, size_t size, uint32_t image_base,
+                         std::vector<VtableSection>& out);
+
+struct VtableSlot {
+    uint32_t address;  // guest address of the slot
+    uint32_t target;   // code address stored in it
+};
+
+// Scans `size` bytes at `data` (guest address `address`, 4-byte aligned)
+// for big-endian words in [code_begin, code_end) that are 4-byte aligned,
+// and appends those in runs of at least `min_run` consecutive slots to
+// `out`. Uses AVX2 or SSE4.1 when the CPU has them and `simd` is set.
+// Returns the number of code pointers seen, in runs or not.
+size_t VtableScan(const uint8_t* data, size_t size, uint32_t address,
+                  uint32_t code_begin, uint32_t code_end, size_t min_run,
+                  std::vector<VtableSlot>& out, bool simd = true);
+
+// Name of the kernel VtableScan uses with `simd` set: "avx2", "sse4.1"
+// or "scalar".
+const char* VtableScanKernel();
+
+struct VtableThunk {
+    int32_t  adjust;  // this-pointer adjustment
+    uint32_t target;  // function branched to
+};
+
+// True if the code at `code` (guest address `address`) is a C++ adjustor
+// thunk: `addi r3,r3,imm; b target`.
+bool VtableIsThunk(const uint8_t* code, uint32_t address, VtableThunk& thunk);
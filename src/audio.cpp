@@ -0,0 +1,588 @@
+#include "audio.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define AUDIO_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr uint32_t AUDIO_RING_FRAMES = 16;    // ~85 ms per client
+static constexpr uint32_t AUDIO_PREFILL = 3;         // callbacks granted at registration
+static constexpr uint32_t AUDIO_HANDLE_TAG = 0x41550000;
+static constexpr uint32_t AUDIO_STATS_FRAMES = 1875; // 10 s of output
+
+static double frame_period_us()
+{
+    return 1e6 * AUDIO_FRAME_SAMPLES / AUDIO_SAMPLE_RATE;
+}
+
+// Start of output frame n; exact in whole nanoseconds, so no drift
+static Clock::time_point frame_deadline(Clock::time_point start, uint64_t n)
+{
+    return start + std::chrono::nanoseconds(n * 1000000000ull * AUDIO_FRAME_SAMPLES / AUDIO_SAMPLE_RATE);
+}
+
+// ============================================================================
+// Frame conversion
+// ============================================================================
+
+#ifdef AUDIO_HAVE_SSE2
+// Byte-swap each 32-bit lane: swap the bytes of every 16-bit half, then
+// the halves. SSE2 only, so no CPU dispatch is needed on x86-64.
+static inline __m128 load_swapped(const uint8_t* p)
+{
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+    v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xB1), 0xB1);
+    return _mm_castsi128_ps(v);
+}
+
+// Four samples at a time: channels 0-3 are one 4x4 transpose, channels
+// 4-5 are interleaved pairwise and stored as halves.
+static void convert_sse2(const uint8_t* in, float* out)
+{
+    const uint32_t stride = AUDIO_FRAME_SAMPLES * 4;
+    for (uint32_t i = 0; i < AUDIO_FRAME_SAMPLES; i += 4)
+    {
+        const uint8_t* p = in + i * 4;
+        __m128 c0 = load_swapped(p);
+        __m128 c1 = load_swapped(p + stride);
+        __m128 c2 = load_swapped(p + stride * 2);
+        __m128 c3 = load_swapped(p + stride * 3);
+        __m128 c4 = load_swapped(p + stride * 4);
+        __m128 c5 = load_swapped(p + stride * 5);
+        _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+        __m128 lo = _mm_unpacklo_ps(c4, c5);
+        __m128 hi = _mm_unpackhi_ps(c4, c5);
+
+        float* o = out + i * AUDIO_CHANNELS;
+        _mm_storeu_ps(o, c0);
+        _mm_storel_pi((__m64*)(o + 4), lo);
+        _mm_storeu_ps(o + 6, c1);
+        _mm_storeh_pi((__m64*)(o + 10), lo);
+        _mm_storeu_ps(o + 12, c2);
+        _mm_storel_pi((__m64*)(o + 16), hi);
+        _mm_storeu_ps(o + 18, c3);
+        _mm_storeh_pi((__m64*)(o + 22), hi);
+    }
+}
+#endif
+
+static void convert_scalar(const uint8_t* in, float* out)
+{
+    for (uint32_t ch = 0; ch < AUDIO_CHANNELS; ch++)
+    {
+        const uint8_t* p = in + ch * AUDIO_FRAME_SAMPLES * 4;
+        for (uint32_t i = 0; i < AUDIO_FRAME_SAMPLES; i++, p += 4)
+        {
+            uint32_t w = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+            memcpy(&out[i * AUDIO_CHANNELS + ch], &w, 4);
+        }
+    }
+}
+
+void audio_convert_frame(const uint8_t* in, float* out, bool simd)
+{
+#ifdef AUDIO_HAVE_SSE2
+    if (simd)
+    {
+        convert_sse2(in, out);
+        return;
+    }
+#endif
+    (void)simd;
+    convert_scalar(in, out);
+}
+
+// ============================================================================
+// Sinks
+// ============================================================================
+
+struct AudioSink
+{
+    virtual ~AudioSink() = default;
+    virtual void write(const float* frame) = 0;   // AUDIO_FRAME_FLOATS interleaved
+};
+
+struct NullSink : AudioSink
+{
+    void write(const float*) override {}
+};
+
+// WAVE_FORMAT_EXTENSIBLE, 6 channels of 32-bit float (FL FR FC LFE BL BR).
+// The RIFF, fact and data sizes are patched when the file is closed.
+struct WavSink : AudioSink
+{
+    FILE*    file = nullptr;
+    uint64_t frames = 0;
+
+    static void put16(uint8_t*& p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p += 2; }
+    static void put32(uint8_t*& p, uint32_t v) { put16(p, (uint16_t)v); put16(p, (uint16_t)(v >> 16)); }
+    static void tag(uint8_t*& p, const char* t) { memcpy(p, t, 4); p += 4; }
+
+    void write_header(uint32_t data_bytes)
+    {
+        static const uint8_t ieee_float_guid[16] = {
+            0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00,
+            0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71,
+        };
+        uint8_t header[80];
+        uint8_t* p = header;
+        tag(p, "RIFF"); put32(p, 72 + data_bytes); tag(p, "WAVE");
+        tag(p, "fmt "); put32(p, 40);
+        put16(p, 0xFFFE);                                // WAVE_FORMAT_EXTENSIBLE
+        put16(p, AUDIO_CHANNELS);
+        put32(p, AUDIO_SAMPLE_RATE);
+        put32(p, AUDIO_SAMPLE_RATE * AUDIO_CHANNELS * 4);
+        put16(p, AUDIO_CHANNELS * 4);
+        put16(p, 32);
+        put16(p, 22);
+        put16(p, 32);                                    // valid bits
+        put32(p, 0x3F);                                  // channel mask
+        memcpy(p, ieee_float_guid, 16); p += 16;
+        tag(p, "fact"); put32(p, 4); put32(p, data_bytes / (AUDIO_CHANNELS * 4));
+        tag(p, "data"); put32(p, data_bytes);
+        fseek(file, 0, SEEK_SET);
+        fwrite(header, 1, sizeof(header), file);
+    }
+
+    bool open(const char* path)
+    {
+        file = fopen(path, "wb");
+        if (!file) return false;
+        write_header(0);
+        return true;
+    }
+
+    void write(const float* frame) override
+    {
+        fwrite(frame, 4, AUDIO_FRAME_FLOATS, file);
+        frames++;
+    }
+
+    ~WavSink() override
+    {
+        if (!file) return;
+        uint64_t bytes = frames * AUDIO_FRAME_BYTES;
+        write_header((uint32_t)std::min<uint64_t>(bytes, 0xFFFFFFFFull - 72));
+        fclose(file);
+    }
+};
+
+// ============================================================================
+// Statistics
+// ============================================================================
+
+// 50 us bins up to 25 ms; later samples land in the last bin but still
+// count towards the maximum
+struct Histogram
+{
+    static constexpr uint32_t BINS = 500;
+    static constexpr double BIN_US = 50.0;
+    std::atomic<uint32_t> bins[BINS] = {};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum_us{0};
+    std::atomic<uint64_t> max_us{0};
+
+    void add(double us)
+    {
+        us = std::max(us, 0.0);
+        uint32_t bin = std::min<uint32_t>((uint32_t)(us / BIN_US), BINS - 1);
+        bins[bin].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        sum_us.fetch_add((uint64_t)us, std::memory_order_relaxed);
+        uint64_t v = (uint64_t)us, m = max_us.load(std::memory_order_relaxed);
+        while (v > m && !max_us.compare_exchange_weak(m, v, std::memory_order_relaxed)) {}
+    }
+
+    double percentile(double p) const
+    {
+        uint64_t n = count.load(std::memory_order_relaxed), target = (uint64_t)std::ceil(n * p), seen = 0;
+        for (uint32_t i = 0; i < BINS; i++)
+        {
+            seen += bins[i].load(std::memory_order_relaxed);
+            if (seen >= target && seen) return (i + 1) * BIN_US;
+        }
+        return 0.0;
+    }
+
+    void print(const char* name) const
+    {
+        uint64_t n = count.load(std::memory_order_relaxed);
+        if (!n) return;
+        fprintf(stderr, "[AUDIO]   %-18s mean %6.0f us  p50 %6.0f  p99 %6.0f  max %6llu  (%llu)\n", name,
+                (double)sum_us.load(std::memory_order_relaxed) / n, percentile(0.5), percentile(0.99),
+                (unsigned long long)max_us.load(std::memory_order_relaxed), (unsigned long long)n);
+    }
+};
+
+static Histogram s_tick_lateness;     // output thread wake vs. frame deadline
+static Histogram s_callback_jitter;   // |callback interval - frame period|
+static Histogram s_callback_delay;    // frame played -> callback issued
+static std::atomic<uint64_t> s_convert_ns{0};
+static std::atomic<uint64_t> s_convert_max_ns{0};
+static std::atomic<uint64_t> s_converted{0};
+static std::atomic<uint64_t> s_played{0};
+static std::atomic<uint64_t> s_overruns{0};
+static std::atomic<uint64_t> s_underruns{0};
+static std::atomic<uint64_t> s_resyncs{0};
+
+// ============================================================================
+// Clients and the output thread
+// ============================================================================
+
+struct AudioClient
+{
+    std::atomic<bool>     active{false};
+    uint32_t              callback = 0;
+    uint32_t              callback_arg = 0;
+    std::atomic<uint32_t> owed{0};              // callbacks granted, not yet issued
+    std::atomic<int64_t>  granted_ns{0};        // when the last one was granted
+
+    // Ring: head written by the guest (main OS thread), tail by the output thread
+    alignas(64) std::atomic<uint32_t> head{0};
+    alignas(64) std::atomic<uint32_t> tail{0};
+    float frames[AUDIO_RING_FRAMES][AUDIO_FRAME_FLOATS];
+
+    // Main thread only
+    Clock::time_point last_callback;
+    bool              have_last = false;
+
+    // Last output tick that may have snapshotted this slot before it was
+    // unregistered; guarded by s_clients_lock
+    uint64_t          retired_tick = 0;
+};
+
+static AudioClient s_clients[AUDIO_MAX_CLIENTS];
+static std::mutex s_clients_lock;   // registration vs. the output tick's snapshot
+static uint64_t s_tick_seq = 0;     // ticks snapshotted; guarded by s_clients_lock
+static std::atomic<uint64_t> s_tick_done{0};  // ticks whose mix and write finished
+static std::thread s_thread;
+static std::atomic<bool> s_running{false};
+static AudioSink* s_sink = nullptr;
+static bool s_deterministic = false;
+static uint64_t s_vsyncs = 0;
+static uint32_t s_next_client = 0;  // round-robin start for audio_next_callback
+
+static int64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+// One output frame: pop a frame from every client that has one, mix, play,
+// and grant each client a callback. A client with nothing queued plays
+// silence (an underrun) and is granted a callback only if it has none
+// outstanding, so a guest that skips a submit keeps getting called.
+//
+// Only the snapshot of the clients is taken under s_clients_lock; the mix
+// and the sink write (a file write for wav:) run outside it, so the guest
+// never waits on them to register or unregister. A slot unregistered
+// meanwhile is not handed out again until this tick is done with it.
+static void output_tick()
+{
+    static float mix[AUDIO_FRAME_FLOATS];
+    static const float silence[AUDIO_FRAME_FLOATS] = {};
+    const float* out = silence;
+    int mixed = 0;
+    int64_t t = now_ns();
+
+    AudioClient* played[AUDIO_MAX_CLIENTS];
+    uint64_t tick;
+    {
+        std::lock_guard<std::mutex> lock(s_clients_lock);
+        tick = ++s_tick_seq;
+        for (uint32_t i = 0; i < AUDIO_MAX_CLIENTS; i++)
+        {
+            AudioClient& c = s_clients[i];
+            if (!c.active.load(std::memory_order_acquire)) continue;
+            if (c.tail.load(std::memory_order_relaxed) == c.head.load(std::memory_order_acquire))
+            {
+                s_underruns.fetch_add(1, std::memory_order_relaxed);
+                if (c.owed.load(std::memory_order_relaxed) == 0)
+                {
+                    c.granted_ns.store(t, std::memory_order_relaxed);
+                    c.owed.fetch_add(1, std::memory_order_release);
+                }
+                continue;
+            }
+            played[mixed++] = &c;
+        }
+    }
+
+    // The frame at each tail stays put until the tail moves: the guest
+    // only writes at head, and only this thread advances the tail
+    for (int i = 0; i < mixed; i++)
+    {
+        AudioClient& c = *played[i];
+        const float* frame = c.frames[c.tail.load(std::memory_order_relaxed) % AUDIO_RING_FRAMES];
+        if (i == 0)
+        {
+            out = frame;
+        }
+        else
+        {
+            if (i == 1) memcpy(mix, out, sizeof(mix));
+            for (uint32_t k = 0; k < AUDIO_FRAME_FLOATS; k++) mix[k] += frame[k];
+            out = mix;
+        }
+    }
+
+    s_sink->write(out);
+    for (int i = 0; i < mixed; i++)
+    {
+        AudioClient& c = *played[i];
+        c.tail.store(c.tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        if (c.owed.load(std::memory_order_relaxed) < AUDIO_RING_FRAMES)
+        {
+            c.granted_ns.store(t, std::memory_order_relaxed);
+            c.owed.fetch_add(1, std::memory_order_release);
+        }
+    }
+    s_tick_done.store(tick, std::memory_order_release);
+    if (s_played.fetch_add(1, std::memory_order_relaxed) % AUDIO_STATS_FRAMES == AUDIO_STATS_FRAMES - 1)
+        audio_print_stats();
+}
+
+static void output_thread()
+{
+#ifdef _WIN32
+    // The default timer resolution (15.6 ms) is coarser than a frame
+    HANDLE timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+                                          TIMER_ALL_ACCESS);
+#endif
+    Clock::time_point start = Clock::now();
+    uint64_t n = 1;
+    while (s_running.load(std::memory_order_acquire))
+    {
+        Clock::time_point deadline = frame_deadline(start, n);
+#ifdef _WIN32
+        int64_t wait_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - Clock::now()).count();
+        if (timer && wait_ns > 0)
+        {
+            LARGE_INTEGER due;
+            due.QuadPart = -(wait_ns / 100);
+            SetWaitableTimer(timer, &due, 0, nullptr, nullptr, FALSE);
+            WaitForSingleObject(timer, INFINITE);
+        }
+        else
+#endif
+        std::this_thread::sleep_until(deadline);
+
+        double late_us = std::chrono::duration<double, std::micro>(Clock::now() - deadline).count();
+        s_tick_lateness.add(late_us);
+        output_tick();
+        n++;
+
+        // After a long stall (debugger, suspended process) restart the
+        // clock instead of playing the missed frames back to back
+        if (late_us > 200000.0)
+        {
+            start = Clock::now();
+            n = 1;
+            s_resyncs.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+#ifdef _WIN32
+    if (timer) CloseHandle(timer);
+#endif
+}
+
+bool audio_init(const char* spec, bool deterministic)
+{
+    if (s_sink) return true;
+    if (!spec || strcmp(spec, "off") == 0)
+    {
+        printf("  Audio: off\n");
+        return true;
+    }
+    if (strcmp(spec, "null") == 0)
+    {
+        s_sink = new NullSink();
+    }
+    else if (strncmp(spec, "wav:", 4) == 0)
+    {
+        WavSink* wav = new WavSink();
+        if (!wav->open(spec + 4))
+        {
+            fprintf(stderr, "[AUDIO] Failed to open %s\n", spec + 4);
+            delete wav;
+            return false;
+        }
+        s_sink = wav;
+    }
+    else
+    {
+        fprintf(stderr, "[AUDIO] Unknown output '%s' (expected off, null or wav:<path>)\n", spec);
+        return false;
+    }
+
+    s_deterministic = deterministic;
+    if (!deterministic)
+    {
+        s_running = true;
+        s_thread = std::thread(output_thread);
+    }
+    printf("  Audio: %s, %u Hz x %u channels, %u-sample frames (%s conversion%s)\n", spec,
+           AUDIO_SAMPLE_RATE, AUDIO_CHANNELS, AUDIO_FRAME_SAMPLES,
+#ifdef AUDIO_HAVE_SSE2
+           "SSE2",
+#else
+           "scalar",
+#endif
+           deterministic ? ", clocked by VdSwap" : "");
+    return true;
+}
+
+void audio_shutdown()
+{
+    if (!s_sink) return;
+    if (s_running.exchange(false)) s_thread.join();
+    delete s_sink;
+    s_sink = nullptr;
+    audio_print_stats();
+}
+
+uint32_t audio_register_client(uint32_t callback, uint32_t callback_arg)
+{
+    std::lock_guard<std::mutex> lock(s_clients_lock);
+    for (uint32_t i = 0; i < AUDIO_MAX_CLIENTS; i++)
+    {
+        AudioClient& c = s_clients[i];
+        if (c.active.load(std::memory_order_relaxed)) continue;
+        // Unregistered while a tick in flight may still be mixing its ring
+        if (s_tick_done.load(std::memory_order_acquire) < c.retired_tick) continue;
+        c.callback = callback;
+        c.callback_arg = callback_arg;
+        c.head.store(0, std::memory_order_relaxed);
+        c.tail.store(0, std::memory_order_relaxed);
+        c.have_last = false;
+        // Without a sink nothing is ever owed
+        c.owed.store(s_sink ? AUDIO_PREFILL : 0, std::memory_order_relaxed);
+        c.granted_ns.store(now_ns(), std::memory_order_relaxed);
+        c.active.store(true, std::memory_order_release);
+        return AUDIO_HANDLE_TAG | i;
+    }
+    return 0;
+}
+
+static AudioClient* find_client(uint32_t handle)
+{
+    uint32_t i = handle & 0xFFFF;
+    if ((handle & 0xFFFF0000) != AUDIO_HANDLE_TAG || i >= AUDIO_MAX_CLIENTS) return nullptr;
+    AudioClient& c = s_clients[i];
+    return c.active.load(std::memory_order_acquire) ? &c : nullptr;
+}
+
+void audio_unregister_client(uint32_t handle)
+{
+    std::lock_guard<std::mutex> lock(s_clients_lock);
+    if (AudioClient* c = find_client(handle))
+    {
+        c->active.store(false, std::memory_order_release);
+        c->retired_tick = s_tick_seq;
+    }
+}
+
+bool audio_submit_frame(uint32_t handle, const uint8_t* frame)
+{
+    AudioClient* c = find_client(handle);
+    if (!c) return false;
+    uint32_t head = c->head.load(std::memory_order_relaxed);
+    if (head - c->tail.load(std::memory_order_acquire) == AUDIO_RING_FRAMES)
+    {
+        s_overruns.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    Clock::time_point t0 = Clock::now();
+    audio_convert_frame(frame, c->frames[head % AUDIO_RING_FRAMES]);
+    uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count();
+    s_convert_ns.fetch_add(ns, std::memory_order_relaxed);
+    s_converted.fetch_add(1, std::memory_order_relaxed);
+    if (ns > s_convert_max_ns.load(std::memory_order_relaxed))
+        s_convert_max_ns.store(ns, std::memory_order_relaxed);
+
+    c->head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+void audio_vsync()
+{
+    if (!s_deterministic || !s_sink) return;
+    s_vsyncs++;
+    uint64_t target = s_vsyncs * AUDIO_SAMPLE_RATE / (AUDIO_FRAME_SAMPLES * 60);
+    while (s_played.load(std::memory_order_relaxed) < target) output_tick();
+}
+
+uint64_t audio_frames_played()
+{
+    return s_played.load(std::memory_order_relaxed);
+}
+
+bool audio_next_callback(uint32_t& callback, uint32_t& callback_arg)
+{
+    for (uint32_t k = 0; k < AUDIO_MAX_CLIENTS; k++)
+    {
+        uint32_t i = (s_next_client + k) % AUDIO_MAX_CLIENTS;
+        AudioClient& c = s_clients[i];
+        if (!c.active.load(std::memory_order_acquire)) continue;
+        uint32_t owed = c.owed.load(std::memory_order_acquire);
+        if (owed == 0 || !c.owed.compare_exchange_strong(owed, owed - 1, std::memory_order_acq_rel))
+            continue;
+
+        Clock::time_point now = Clock::now();
+        if (c.have_last)
+        {
+            double interval_us = std::chrono::duration<double, std::micro>(now - c.last_callback).count();
+            s_callback_jitter.add(std::fabs(interval_us - frame_period_us()));
+        }
+        c.last_callback = now;
+        c.have_last = true;
+        s_callback_delay.add((now_ns() - c.granted_ns.load(std::memory_order_relaxed)) / 1000.0);
+
+        callback = c.callback;
+        callback_arg = c.callback_arg;
+        s_next_client = i + 1;
+        return true;
+    }
+    return false;
+}
+
+void audio_print_stats()
+{
+    uint64_t converted = s_converted.load(std::memory_order_relaxed);
+    fprintf(stderr, "[AUDIO] %llu frames played, %llu submitted; %llu overruns, %llu underruns, %llu resyncs\n",
+            (unsigned long long)s_played.load(std::memory_order_relaxed), (unsigned long long)converted,
+            (unsigned long long)s_overruns.load(std::memory_order_relaxed),
+            (unsigned long long)s_underruns.load(std::memory_order_relaxed),
+            (unsigned long long)s_resyncs.load(std::memory_order_relaxed));
+    if (converted)
+    {
+        fprintf(stderr, "[AUDIO]   conversion         mean %6.2f us  max %6.2f us per frame\n",
+                s_convert_ns.load(std::memory_order_relaxed) / 1000.0 / converted,
+                s_convert_max_ns.load(std::memory_order_relaxed) / 1000.0);
+    }
+    s_tick_lateness.print("tick lateness");
+    s_callback_jitter.print("callback jitter");
+    s_callback_delay.print("callback delay");
+}
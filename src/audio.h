@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+
+// XAudio render-driver output. The guest registers a client callback and
+// submits one frame per callback: 256 samples for each of 6 channels,
+// planar big-endian float. Frames are byte-swapped and interleaved (SSE2)
+// into a per-client single-producer single-consumer ring; an output thread
+// drains the rings at 48 kHz into a sink and, for every frame it plays,
+// owes the client one callback. The callbacks themselves run guest code,
+// so they are issued on the main fiber through audio_next_callback().
+
+static constexpr uint32_t AUDIO_SAMPLE_RATE   = 48000;
+static constexpr uint32_t AUDIO_CHANNELS      = 6;
+static constexpr uint32_t AUDIO_FRAME_SAMPLES = 256;
+static constexpr uint32_t AUDIO_FRAME_FLOATS  = AUDIO_FRAME_SAMPLES * AUDIO_CHANNELS;
+static constexpr uint32_t AUDIO_FRAME_BYTES   = AUDIO_FRAME_FLOATS * 4;
+static constexpr uint32_t AUDIO_MAX_CLIENTS   = 8;
+
+// Start output. `spec` is "null" (paced, discarded), "wav:<path>" (paced,
+// written as a 6-channel float WAV) or "off" (no output thread; clients
+// register but never get callbacks, as the old stubs behaved). Returns
+// false if the sink could not be opened. With `deterministic`, there is
+// no output thread either: audio_vsync() plays the frames instead, so the
+// output and the callbacks follow guest progress rather than wall time.
+bool audio_init(const char* spec, bool deterministic = false);
+
+// Stop the output thread, finish the WAV file and print the statistics.
+// Safe to call more than once.
+void audio_shutdown();
+
+// Register a guest callback (function address and its argument). Returns
+// the driver handle the guest passes back, or 0 when all slots are taken.
+uint32_t audio_register_client(uint32_t callback, uint32_t callback_arg);
+void audio_unregister_client(uint32_t handle);
+
+// Convert the guest frame at `frame` (AUDIO_FRAME_BYTES of big-endian
+// planar float) into the client's ring. A full ring drops the frame and
+// counts an overrun. Returns false for an unknown handle.
+bool audio_submit_frame(uint32_t handle, const uint8_t* frame);
+
+// Called once per VdSwap. In deterministic mode, plays the frames one
+// 60 Hz vsync is worth (25 every 8 calls); otherwise does nothing.
+void audio_vsync();
+
+// Output frames played so far. XMA decode batches follow this clock.
+uint64_t audio_frames_played();
+
+// Next callback owed to the guest, if any. Called from the main fiber
+// until it returns false; each true result is one callback to run.
+bool audio_next_callback(uint32_t& callback, uint32_t& callback_arg);
+
+// Planar big-endian float frame -> interleaved native float frame.
+// Exposed for timing; `simd` false selects the scalar path.
+void audio_convert_frame(const uint8_t* in, float* out, bool simd = true);
+
+// Print conversion cost, ring over/underruns, output-tick lateness and
+// callback jitter. Also printed every 10 s of output and at shutdown.
+void audio_print_stats();
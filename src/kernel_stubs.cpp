@@ -1,6 +1,8 @@
 #include "ppc_config.h"
 #include "ppc_context.h"
 #include "memory.h"
+#include "audio.h"
+#include "xma.h"
 
 #include <cstdio>
 #include <cstdarg>
@@ -231,6 +233,44 @@ static void thread_yield()
     }
 }
 
+// XMA decode batches (src/xma.h) and the audio render-driver callbacks
+// (src/audio.h) owed by the output thread. Callbacks are only issued on
+// the main fiber, where a wait inside one sleeps instead of switching
+// fibers mid-call; on a guest fiber they stay owed until the main fiber
+// next gets here (VdSwap at the latest). Each runs to completion with its
+// own PPCContext and PPC stack.
+static uint32_t g_audio_stack_top = 0;
+static bool g_in_audio_callback = false;
+
+static void pump_audio(PPCContext& ctx, uint8_t* base)
+{
+    xma_pump(audio_frames_played());
+    if (g_in_audio_callback || g_current_thread) return;
+    uint32_t callback, callback_arg;
+    while (audio_next_callback(callback, callback_arg))
+    {
+        typedef void (*PPCFuncPtr)(PPCContext& __restrict, uint8_t*);
+        PPCFuncPtr fn = PPC_LOOKUP_FUNC(base, callback);
+        if (!fn)
+        {
+            fprintf(stderr, "[AUDIO] No function at callback 0x%08X\n", callback);
+            continue;
+        }
+        if (!g_audio_stack_top) g_audio_stack_top = alloc_thread_stack();
+
+        PPCContext cb_ctx;
+        memset(&cb_ctx, 0, sizeof(PPCContext));
+        cb_ctx.r13 = ctx.r13;
+        cb_ctx.fpscr.csr = 0x1F80;
+        cb_ctx.r1.u32 = g_audio_stack_top - 16;
+        cb_ctx.r3.u32 = callback_arg;
+
+        g_in_audio_callback = true;
+        fn(cb_ctx, base);
+        g_in_audio_callback = false;
+    }
+}
+
 
 // ============================================================================
 // C Runtime Functions (sprintf, vsnprintf, DbgPrint)
@@ -380,6 +420,7 @@ PPC_FUNC(__imp__KeDelayExecutionThread)
 {
     // r3 = processor mode, r4 = alertable, r5 = interval (ptr to LARGE_INTEGER, 100ns units)
     STUB_LOG_ONCE("KeDelayExecutionThread");
+    pump_audio(ctx, base);
 
     // If we're running in a fiber thread, yield back to main
     if (g_current_thread)
@@ -1982,6 +2023,8 @@ PPC_FUNC(__imp__VdSwap)
         if (!pt.suspended && !pt.finished)
             thread_give_timeslice(pt, i);
     }
+    audio_vsync();
+    pump_audio(ctx, base);
 
     // Pump Win32 messages and sleep to prevent 100% CPU usage.
 #ifdef _WIN32
@@ -1989,7 +2032,11 @@ PPC_FUNC(__imp__VdSwap)
     while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
     {
         if (msg.message == WM_QUIT)
+        {
+            xma_shutdown();
+            audio_shutdown();
             ExitProcess(0);
+        }
         TranslateMessage(&msg);
         DispatchMessage(&msg);
     }
@@ -2030,19 +2077,37 @@ PPC_FUNC(__imp__VdRetrainEDRAMWorker)
 
 PPC_FUNC(__imp__XAudioRegisterRenderDriverClient)
 {
+    // r3 = callback struct ptr (u32 callback fn, u32 callback arg), r4 = driver handle* (out)
     STUB_LOG("XAudioRegisterRenderDriverClient");
+    uint32_t callback = ppc_read_u32(base, ctx.r3.u32);
+    uint32_t callback_arg = ppc_read_u32(base, ctx.r3.u32 + 4);
+    uint32_t handle = audio_register_client(callback, callback_arg);
+    if (!handle)
+    {
+        ctx.r3.u32 = 0x80004005; // E_FAIL
+        return;
+    }
+    if (ctx.r4.u32)
+        ppc_write_u32(base, ctx.r4.u32, handle);
+    fprintf(stderr, "[AUDIO] Render client 0x%08X: callback=0x%08X arg=0x%08X\n",
+            handle, callback, callback_arg);
     ctx.r3.u32 = 0;
 }
 
 PPC_FUNC(__imp__XAudioUnregisterRenderDriverClient)
 {
+    // r3 = driver handle
     STUB_LOG("XAudioUnregisterRenderDriverClient");
+    audio_unregister_client(ctx.r3.u32);
     ctx.r3.u32 = 0;
 }
 
 PPC_FUNC(__imp__XAudioSubmitRenderDriverFrame)
 {
+    // r3 = driver handle, r4 = frame (256 samples x 6 channels, planar BE float)
     STUB_LOG_ONCE("XAudioSubmitRenderDriverFrame");
+    if (ctx.r4.u32)
+        audio_submit_frame(ctx.r3.u32, base + ctx.r4.u32);
     ctx.r3.u32 = 0;
 }
 
@@ -2060,13 +2125,24 @@ PPC_FUNC(__imp__XAudioGetVoiceCategoryVolumeChangeMask)
 
 PPC_FUNC(__imp__XMACreateContext)
 {
+    // r3 = context ptr* (out)
     STUB_LOG("XMACreateContext");
+    uint32_t context = xma_create_context();
+    if (!context)
+    {
+        ctx.r3.u32 = 0xC0000017; // STATUS_NO_MEMORY
+        return;
+    }
+    if (ctx.r3.u32)
+        ppc_write_u32(base, ctx.r3.u32, context);
     ctx.r3.u32 = 0;
 }
 
 PPC_FUNC(__imp__XMAReleaseContext)
 {
+    // r3 = context ptr
     STUB_LOG("XMAReleaseContext");
+    xma_release_context(ctx.r3.u32);
 }
 
 
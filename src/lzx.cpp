@@ -0,0 +1,472 @@
+#include "lzx.h"
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// Format constants (see libmspack's lzx.h for the reference decoder)
+static const int LZX_MIN_MATCH            = 2;
+static const int LZX_NUM_CHARS            = 256;
+static const int LZX_NUM_PRIMARY_LENGTHS  = 7;
+static const int LZX_NUM_SECONDARY_LENGTHS = 249;
+static const int LZX_PRETREE_SYMBOLS      = 20;
+static const int LZX_ALIGNED_SYMBOLS      = 8;
+static const int LZX_MAX_POSITION_SLOTS   = 50;
+static const int LZX_MAINTREE_MAX         = LZX_NUM_CHARS + LZX_MAX_POSITION_SLOTS * 8;
+static const uint32_t LZX_FRAME_SIZE      = 32768;
+
+enum
+{
+    LZX_BLOCK_VERBATIM = 1,
+    LZX_BLOCK_ALIGNED = 2,
+    LZX_BLOCK_UNCOMPRESSED = 3,
+};
+
+// Bits past the end of the input read as zero; a stream that needs more
+// than a few words of that is corrupt.
+static const int LZX_MAX_OVERRUN_WORDS = 4;
+
+namespace {
+
+struct LzxTables
+{
+    uint8_t  extra_bits[LZX_MAX_POSITION_SLOTS + 1];
+    uint32_t position_base[LZX_MAX_POSITION_SLOTS + 1];
+
+    LzxTables()
+    {
+        for (int i = 0, j = 0; i <= LZX_MAX_POSITION_SLOTS; i += 2)
+        {
+            extra_bits[i] = (uint8_t)j;
+            if (i + 1 <= LZX_MAX_POSITION_SLOTS) extra_bits[i + 1] = (uint8_t)j;
+            if (i != 0 && j < 17) j++;
+        }
+        for (int i = 0, j = 0; i <= LZX_MAX_POSITION_SLOTS; i++)
+        {
+            position_base[i] = (uint32_t)j;
+            j += 1 << extra_bits[i];
+        }
+    }
+};
+
+const LzxTables& lzx_tables()
+{
+    static const LzxTables tables;
+    return tables;
+}
+
+// 16-bit little-endian words, consumed most significant bit first. The
+// 64-bit buffer holds the next bits left-aligned.
+struct BitReader
+{
+    const uint8_t* base = nullptr;
+    size_t   size = 0;
+    size_t   off = 0;       // next word to load; may run past size
+    uint64_t buf = 0;
+    int      bits = 0;
+
+    void init(const uint8_t* data, size_t data_size, size_t start)
+    {
+        base = data;
+        size = data_size;
+        off = start;
+        buf = 0;
+        bits = 0;
+    }
+
+    void refill()
+    {
+        while (bits <= 48)
+        {
+            uint64_t w = 0;
+            if (off + 1 < size) w = base[off] | (base[off + 1] << 8);
+            off += 2;
+            buf |= w << (48 - bits);
+            bits += 16;
+        }
+    }
+
+    uint32_t peek(int n)
+    {
+        if (bits < n) refill();
+        return n ? (uint32_t)(buf >> (64 - n)) : 0;
+    }
+
+    void remove(int n)
+    {
+        buf <<= n;
+        bits -= n;
+    }
+
+    uint32_t read(int n)
+    {
+        uint32_t v = peek(n);
+        remove(n);
+        return v;
+    }
+
+    // Discard the rest of the current 16-bit word
+    void align()
+    {
+        remove(bits & 15);
+    }
+
+    // Offset of the next unconsumed word (after align())
+    size_t byte_pos() const
+    {
+        return off - (size_t)bits / 8;
+    }
+
+    bool overrun() const
+    {
+        return byte_pos() > size + 2 * LZX_MAX_OVERRUN_WORDS;
+    }
+};
+
+// Canonical Huffman decode table. Codes up to HUFF_PRIMARY_BITS long
+// resolve in one lookup on the next bits; longer ones (rare) go through a
+// 2^(16 - HUFF_PRIMARY_BITS) entry subtable. Entries are
+// symbol | (code length << 16), or HUFF_SUBTABLE | subtable index.
+static const int      HUFF_PRIMARY_BITS = 11;
+static const int      HUFF_SUB_BITS = 16 - HUFF_PRIMARY_BITS;
+static const uint32_t HUFF_SUBTABLE = 0x80000000u;
+
+struct HuffTable
+{
+    uint32_t primary[1 << HUFF_PRIMARY_BITS];
+    std::vector<uint32_t> sub;
+    bool empty = true;
+
+    bool build(const uint8_t* lens, int count)
+    {
+        sub.clear();
+        uint32_t pos = 0;  // next code, left-aligned to 16 bits
+        for (int len = 1; len <= 16; len++)
+        {
+            uint32_t span = 1u << (16 - len);
+            for (int sym = 0; sym < count; sym++)
+            {
+                if (lens[sym] != len) continue;
+                if (pos + span > (1u << 16)) return false;  // over-subscribed
+                uint32_t entry = (uint32_t)sym | ((uint32_t)len << 16);
+                if (len <= HUFF_PRIMARY_BITS)
+                {
+                    uint32_t first = pos >> HUFF_SUB_BITS;
+                    for (uint32_t i = 0; i < span >> HUFF_SUB_BITS; i++) primary[first + i] = entry;
+                }
+                else
+                {
+                    uint32_t& slot = primary[pos >> HUFF_SUB_BITS];
+                    // Codes are assigned in order, so a prefix's subtable is
+                    // always the newest one
+                    if (!(pos & ((1u << HUFF_SUB_BITS) - 1)))
+                    {
+                        slot = HUFF_SUBTABLE | (uint32_t)(sub.size() >> HUFF_SUB_BITS);
+                        sub.resize(sub.size() + (1u << HUFF_SUB_BITS));
+                    }
+                    uint32_t* t = &sub[(slot & ~HUFF_SUBTABLE) << HUFF_SUB_BITS];
+                    uint32_t first = pos & ((1u << HUFF_SUB_BITS) - 1);
+                    for (uint32_t i = 0; i < span; i++) t[first + i] = entry;
+                }
+                pos += span;
+            }
+        }
+        empty = pos == 0;
+        return empty || pos == (1u << 16);  // incomplete codes are corrupt
+    }
+
+    bool decode(BitReader& br, uint32_t& sym) const
+    {
+        if (empty) return false;
+        uint32_t bits = br.peek(16);
+        uint32_t e = primary[bits >> HUFF_SUB_BITS];
+        if (e & HUFF_SUBTABLE)
+            e = sub[((e & ~HUFF_SUBTABLE) << HUFF_SUB_BITS) | (bits & ((1u << HUFF_SUB_BITS) - 1))];
+        br.remove((int)(e >> 16));
+        sym = e & 0xFFFF;
+        return true;
+    }
+};
+
+struct LzxDecoder
+{
+    const LzxTables& T = lzx_tables();
+    BitReader br;
+    std::string* error = nullptr;
+
+    int      position_slots = 0;
+    uint8_t  pretree_len[LZX_PRETREE_SYMBOLS] = {};
+    uint8_t  maintree_len[LZX_MAINTREE_MAX] = {};
+    uint8_t  length_len[LZX_NUM_SECONDARY_LENGTHS] = {};
+    uint8_t  aligned_len[LZX_ALIGNED_SYMBOLS] = {};
+    HuffTable pretree, maintree, lengths, aligned;
+
+    bool fail(const char* msg)
+    {
+        *error = msg;
+        return false;
+    }
+
+    // Tree lengths are delta-coded against the previous block's, through
+    // a pretree sent just before them.
+    bool read_lengths(uint8_t* lens, int first, int last)
+    {
+        for (int i = 0; i < LZX_PRETREE_SYMBOLS; i++) pretree_len[i] = (uint8_t)br.read(4);
+        if (!pretree.build(pretree_len, LZX_PRETREE_SYMBOLS)) return fail("bad pretree");
+        for (int x = first; x < last;)
+        {
+            uint32_t z;
+            if (!pretree.decode(br, z)) return fail("empty pretree");
+            if (z == 17 || z == 18)
+            {
+                int run = z == 17 ? (int)br.read(4) + 4 : (int)br.read(5) + 20;
+                if (x + run > last) return fail("tree length run overflows");
+                while (run--) lens[x++] = 0;
+            }
+            else if (z == 19)
+            {
+                int run = (int)br.read(1) + 4;
+                if (x + run > last) return fail("tree length run overflows");
+                if (!pretree.decode(br, z) || z > 16) return fail("bad tree length");
+                int v = lens[x] - (int)z;
+                if (v < 0) v += 17;
+                while (run--) lens[x++] = (uint8_t)v;
+            }
+            else
+            {
+                int v = lens[x] - (int)z;
+                if (v < 0) v += 17;
+                lens[x++] = (uint8_t)v;
+            }
+        }
+        return true;
+    }
+
+    bool run(const uint8_t* in, size_t in_size, uint8_t* out, size_t out_size, uint32_t window_size)
+    {
+        int window_bits = 0;
+        while ((1u << window_bits) < window_size) window_bits++;
+        if ((1u << window_bits) != window_size || window_bits < 15 || window_bits > 21)
+            return fail("unsupported LZX window size");
+        static const int kSlots[] = {30, 32, 34, 36, 38, 42, 50};
+        position_slots = kSlots[window_bits - 15];
+        const int maintree_size = LZX_NUM_CHARS + position_slots * 8;
+
+        br.init(in, in_size, 0);
+        uint32_t intel_filesize = 0;
+        if (br.read(1))
+        {
+            uint32_t hi = br.read(16);
+            intel_filesize = (hi << 16) | br.read(16);
+        }
+        bool intel_started = false;
+        std::vector<uint8_t> translate_frame;  // per frame: undo E8 afterwards
+
+        uint32_t r0 = 1, r1 = 1, r2 = 1;
+        int      block_type = 0;
+        uint32_t block_length = 0, block_remaining = 0;
+        bool     raw = false;          // inside an uncompressed block
+        size_t   raw_pos = 0;          // its input offset
+        size_t   pos = 0;
+
+        while (pos < out_size)
+        {
+            size_t frame_end = pos + LZX_FRAME_SIZE < out_size ? pos + LZX_FRAME_SIZE : out_size;
+            while (pos < frame_end)
+            {
+                if (block_remaining == 0)
+                {
+                    // Leaving an uncompressed block: skip its pad byte and
+                    // resume bit reading after it
+                    if (block_type == LZX_BLOCK_UNCOMPRESSED)
+                    {
+                        if (block_length & 1) raw_pos++;
+                        br.init(in, in_size, raw_pos);
+                        raw = false;
+                    }
+                    block_type = (int)br.read(3);
+                    uint32_t hi = br.read(16);
+                    block_length = block_remaining = (hi << 8) | br.read(8);
+                    if (block_length == 0) return fail("empty LZX block");
+
+                    if (block_type == LZX_BLOCK_ALIGNED)
+                    {
+                        for (int i = 0; i < LZX_ALIGNED_SYMBOLS; i++) aligned_len[i] = (uint8_t)br.read(3);
+                        if (!aligned.build(aligned_len, LZX_ALIGNED_SYMBOLS)) return fail("bad aligned tree");
+                    }
+                    if (block_type == LZX_BLOCK_VERBATIM || block_type == LZX_BLOCK_ALIGNED)
+                    {
+                        if (!read_lengths(maintree_len, 0, LZX_NUM_CHARS) ||
+                            !read_lengths(maintree_len, LZX_NUM_CHARS, maintree_size))
+                            return false;
+                        if (!maintree.build(maintree_len, maintree_size) || maintree.empty)
+                            return fail("bad main tree");
+                        if (maintree_len[0xE8] != 0) intel_started = true;
+                        if (!read_lengths(length_len, 0, LZX_NUM_SECONDARY_LENGTHS)) return false;
+                        if (!lengths.build(length_len, LZX_NUM_SECONDARY_LENGTHS)) return fail("bad length tree");
+                    }
+                    else if (block_type == LZX_BLOCK_UNCOMPRESSED)
+                    {
+                        intel_started = true;
+                        // 1-16 bits of padding up to a word boundary
+                        if ((br.bits & 15) == 0) br.read(16);
+                        else br.align();
+                        raw_pos = br.byte_pos();
+                        if (raw_pos + 12 > in_size) return fail("truncated uncompressed block");
+                        const uint8_t* rp = in + raw_pos;
+                        uint32_t r[3];
+                        for (int i = 0; i < 3; i++)
+                            r[i] = rp[4 * i] | (rp[4 * i + 1] << 8) | (rp[4 * i + 2] << 16) |
+                                   ((uint32_t)rp[4 * i + 3] << 24);
+                        r0 = r[0]; r1 = r[1]; r2 = r[2];
+                        raw_pos += 12;
+                        raw = true;
+                    }
+                    else
+                    {
+                        return fail("bad LZX block type");
+                    }
+                }
+
+                size_t frame_left = frame_end - pos;
+                if (raw)
+                {
+                    size_t n = block_remaining < frame_left ? block_remaining : frame_left;
+                    if (raw_pos + n > in_size) return fail("truncated uncompressed block");
+                    memcpy(out + pos, in + raw_pos, n);
+                    raw_pos += n;
+                    pos += n;
+                    block_remaining -= (uint32_t)n;
+                    continue;
+                }
+
+                // Verbatim / aligned: decode until the block or frame ends
+                size_t run_end = pos + (block_remaining < frame_left ? block_remaining : frame_left);
+                size_t run_start = pos;
+                while (pos < run_end)
+                {
+                    uint32_t sym = 0;
+                    maintree.decode(br, sym);
+                    if (sym < (uint32_t)LZX_NUM_CHARS)
+                    {
+                        out[pos++] = (uint8_t)sym;
+                        continue;
+                    }
+                    sym -= LZX_NUM_CHARS;
+                    uint32_t match_length = sym & LZX_NUM_PRIMARY_LENGTHS;
+                    if (match_length == (uint32_t)LZX_NUM_PRIMARY_LENGTHS)
+                    {
+                        uint32_t footer;
+                        if (!lengths.decode(br, footer)) return fail("match length without length tree");
+                        match_length += footer;
+                    }
+                    match_length += LZX_MIN_MATCH;
+
+                    uint32_t slot = sym >> 3;
+                    uint32_t match_offset;
+                    if (slot > 2)
+                    {
+                        uint32_t extra = slot >= 36 ? 17 : T.extra_bits[slot];
+                        match_offset = T.position_base[slot] - 2;
+                        if (block_type == LZX_BLOCK_ALIGNED && extra >= 3)
+                        {
+                            if (extra > 3) match_offset += br.read((int)extra - 3) << 3;
+                            uint32_t a;
+                            if (!aligned.decode(br, a)) return fail("offset without aligned tree");
+                            match_offset += a;
+                        }
+                        else if (extra > 0)
+                        {
+                            match_offset += br.read((int)extra);
+                        }
+                        else
+                        {
+                            match_offset = 1;
+                        }
+                        r2 = r1; r1 = r0; r0 = match_offset;
+                    }
+                    else if (slot == 0)
+                    {
+                        match_offset = r0;
+                    }
+                    else if (slot == 1)
+                    {
+                        match_offset = r1;
+                        r1 = r0; r0 = match_offset;
+                    }
+                    else
+                    {
+                        match_offset = r2;
+                        r2 = r0; r0 = match_offset;
+                    }
+
+                    if (match_offset > pos || match_offset > window_size) return fail("match before start of output");
+                    if (pos + match_length > frame_end) return fail("match crosses a frame boundary");
+                    const uint8_t* src = out + pos - match_offset;
+                    uint8_t* dst = out + pos;
+                    if (match_offset >= match_length)
+                    {
+                        memcpy(dst, src, match_length);
+                    }
+                    else
+                    {
+                        for (uint32_t i = 0; i < match_length; i++) dst[i] = src[i];
+                    }
+                    pos += match_length;
+                }
+                uint32_t used = (uint32_t)(pos - run_start);
+                if (used > block_remaining) return fail("match overruns its block");
+                block_remaining -= used;
+                if (br.overrun()) return fail("LZX input overrun");
+            }
+
+            translate_frame.push_back(intel_started ? 1 : 0);
+            // Streams re-align to a word at each frame boundary
+            if (!raw) br.align();
+        }
+
+        if (intel_filesize)
+        {
+            for (size_t f = 0; f < translate_frame.size() && f < 32768; f++)
+            {
+                size_t start = f * LZX_FRAME_SIZE;
+                size_t size = out_size - start < LZX_FRAME_SIZE ? out_size - start : LZX_FRAME_SIZE;
+                if (!translate_frame[f] || size <= 10) continue;
+                uint8_t* data = out + start;
+                uint8_t* data_end = data + size - 10;
+                int32_t curpos = (int32_t)start;
+                int32_t filesize = (int32_t)intel_filesize;
+                while (data < data_end)
+                {
+                    if (*data++ != 0xE8)
+                    {
+                        curpos++;
+                        continue;
+                    }
+                    int32_t abs_off = (int32_t)(data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24));
+                    if (abs_off >= -curpos && abs_off < filesize)
+                    {
+                        int32_t rel_off = abs_off >= 0 ? abs_off - curpos : abs_off + filesize;
+                        data[0] = (uint8_t)rel_off;
+                        data[1] = (uint8_t)(rel_off >> 8);
+                        data[2] = (uint8_t)(rel_off >> 16);
+                        data[3] = (uint8_t)(rel_off >> 24);
+                    }
+                    data += 4;
+                    curpos += 5;
+                }
+            }
+        }
+        return true;
+    }
+};
+
+}  // namespace
+
+bool lzx_decompress(const uint8_t* in, size_t in_size, uint8_t* out, size_t out_size,
+                    uint32_t window_size, std::string& error)
+{
+    auto dec = std::make_unique<LzxDecoder>();
+    dec->error = &error;
+    return dec->run(in, in_size, out, out_size, window_size);
+}
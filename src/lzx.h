@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// LZX decompression (the Microsoft format used by CAB files and by XEX2
+// "normal" compression). Decodes the whole stream into `out`, which also
+// serves as the sliding window, so matches copy straight from earlier
+// output. Huffman symbols are decoded through an 11-bit lookup table.
+//
+// `window_size` is a power of two from 32 KB to 2 MB. Output is produced
+// in 32 KB frames; Intel E8 call translation is undone when the stream
+// header enables it. Returns false (with `error` set) on a corrupt stream.
+bool lzx_decompress(const uint8_t* in, size_t in_size, uint8_t* out, size_t out_size,
+                    uint32_t window_size, std::string& error);
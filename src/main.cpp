@@ -1,9 +1,13 @@
 #include "ppc_config.h"
 #include "ppc_context.h"
 #include "memory.h"
+#include "audio.h"
+#include "xma.h"
 #include "xex_loader.h"
 
+#include <chrono>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <cfenv>
 #include <xmmintrin.h>
@@ -88,6 +92,7 @@ PPC_EXTERN_FUNC(_xstart);
 
 int main(int argc, char* argv[])
 {
+    auto boot_start = std::chrono::steady_clock::now();
 #ifdef _WIN32
     AddVectoredExceptionHandler(1, fp_exception_handler);
     SetUnhandledExceptionFilter(crash_handler);
@@ -97,10 +102,28 @@ int main(int argc, char* argv[])
     setvbuf(stdout, nullptr, _IONBF, 0);
     printf("=== Vigilante 8 Arcade - Static Recompilation ===\n\n");
 
-    // Default PE image path (extracted from XEX using tools/dump_pe.exe)
-    const char* pe_path = "extracted/pe_image.bin";
-    if (argc > 1)
-        pe_path = argv[1];
+    // The XEX itself (decoded and cached by xex_loader), or a PE image
+    // pre-extracted with tools/dump_pe.exe when the path ends in .bin
+    // --audio null|wav:<path>|off selects the XAudio output (src/audio.h),
+    // --xma-threads N the XMA decode workers (src/xma.h). --deterministic
+    // clocks audio by VdSwap and finishes each XMA batch in place, so a
+    // headless run repeats exactly.
+    const char* image_path = "extracted/default.xex";
+    const char* audio_spec = "null";
+    XmaOptions xma_options;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--audio") == 0 && i + 1 < argc)
+            audio_spec = argv[++i];
+        else if (strcmp(argv[i], "--xma-threads") == 0 && i + 1 < argc)
+            xma_options.threads = (unsigned)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--deterministic") == 0)
+            xma_options.deterministic = true;
+        else
+            image_path = argv[i];
+    }
+    size_t path_len = strlen(image_path);
+    bool pre_extracted = path_len >= 4 && strcmp(image_path + path_len - 4, ".bin") == 0;
 
     // Step 1: Allocate PPC memory space (4 GB committed)
     printf("[1/4] Allocating PPC memory space...\n");
@@ -114,7 +137,9 @@ int main(int argc, char* argv[])
 
     // Step 2: Load PE data sections into memory
     printf("\n[2/4] Loading PE data sections...\n");
-    if (!xex_load_data_sections(base, pe_path))
+    bool loaded = pre_extracted ? xex_load_data_sections(base, image_path)
+                                : xex_load_image(base, image_path);
+    if (!loaded)
     {
         fprintf(stderr, "WARNING: PE data loading failed, data sections will be zeroed\n");
     }
@@ -227,6 +252,12 @@ int main(int argc, char* argv[])
         printf("  Main thread converted to fiber\n");
     }
 
+    if (!audio_init(audio_spec, xma_options.deterministic))
+        fprintf(stderr, "WARNING: Audio output failed to start, continuing without it\n");
+    xma_init(base, PPC_XMA_CONTEXT_BASE, xma_options);
+
+    printf("  Boot to entry: %.1f ms\n",
+           std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - boot_start).count());
     printf("=== Launching _xstart ===\n");
     fflush(stdout);
 
@@ -236,6 +267,8 @@ int main(int argc, char* argv[])
     _xstart(ctx, base);
 
     printf("\n=== _xstart returned ===\n");
+    xma_shutdown();
+    audio_shutdown();
 
     // Cleanup
     ppc_memory_free(base);
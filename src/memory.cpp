@@ -10,8 +10,72 @@
 #define WIN32_LEAN_AND_MEAN
 #endif
 #include <windows.h>
+
+#ifndef MEM_RESERVE_PLACEHOLDER
+#define MEM_RESERVE_PLACEHOLDER  0x00040000
+#define MEM_REPLACE_PLACEHOLDER  0x00004000
+#define MEM_PRESERVE_PLACEHOLDER 0x00000002
+#endif
+
+// VirtualAlloc2 / MapViewOfFile3 (Windows 10 1803+) let a file view be
+// placed inside the reserved 4 GB range. Loaded at runtime; without them
+// the range is one committed allocation and the image is copied instead.
+typedef PVOID (WINAPI *VirtualAlloc2_t)(HANDLE, PVOID, SIZE_T, ULONG, ULONG, void*, ULONG);
+typedef PVOID (WINAPI *MapViewOfFile3_t)(HANDLE, HANDLE, PVOID, ULONG64, SIZE_T, ULONG, ULONG, void*, ULONG);
+
+static VirtualAlloc2_t  s_VirtualAlloc2 = nullptr;
+static MapViewOfFile3_t s_MapViewOfFile3 = nullptr;
+static bool s_placeholders = false;   // range split into three allocations
+static bool s_image_mapped = false;
+
+static void load_placeholder_api()
+{
+    HMODULE h = GetModuleHandleA("kernelbase.dll");
+    if (!h) return;
+    s_VirtualAlloc2 = (VirtualAlloc2_t)GetProcAddress(h, "VirtualAlloc2");
+    s_MapViewOfFile3 = (MapViewOfFile3_t)GetProcAddress(h, "MapViewOfFile3");
+}
+
+// Commit [base+off, +size) in place of the placeholder there.
+static bool commit_placeholder(uint8_t* base, uint64_t off, uint64_t size)
+{
+    return s_VirtualAlloc2(nullptr, base + off, size,
+                           MEM_RESERVE | MEM_COMMIT | MEM_REPLACE_PLACEHOLDER,
+                           PAGE_READWRITE, nullptr, 0) != nullptr;
+}
+
+// Reserve the range as placeholders split around the image region, then
+// commit each part. The image region can later be swapped for a view.
+static uint8_t* alloc_with_placeholders()
+{
+    load_placeholder_api();
+    if (!s_VirtualAlloc2 || !s_MapViewOfFile3) return nullptr;
+    auto* base = static_cast<uint8_t*>(
+        s_VirtualAlloc2(nullptr, nullptr, PPC_MEM_TOTAL_SIZE,
+                        MEM_RESERVE | MEM_RESERVE_PLACEHOLDER, PAGE_NOACCESS, nullptr, 0));
+    if (!base) return nullptr;
+    const uint64_t image_end = PPC_MEM_IMAGE_BASE + PPC_MEM_IMAGE_SIZE;
+    if (!VirtualFree(base, PPC_MEM_IMAGE_BASE, MEM_RELEASE | MEM_PRESERVE_PLACEHOLDER) ||
+        !VirtualFree(base + PPC_MEM_IMAGE_BASE, PPC_MEM_IMAGE_SIZE,
+                     MEM_RELEASE | MEM_PRESERVE_PLACEHOLDER) ||
+        !commit_placeholder(base, 0, PPC_MEM_IMAGE_BASE) ||
+        !commit_placeholder(base, PPC_MEM_IMAGE_BASE, PPC_MEM_IMAGE_SIZE) ||
+        !commit_placeholder(base, image_end, PPC_MEM_TOTAL_SIZE - image_end))
+    {
+        // Partially split ranges are released part by part
+        VirtualFree(base, 0, MEM_RELEASE);
+        VirtualFree(base + PPC_MEM_IMAGE_BASE, 0, MEM_RELEASE);
+        VirtualFree(base + image_end, 0, MEM_RELEASE);
+        return nullptr;
+    }
+    s_placeholders = true;
+    return base;
+}
 #else
+#include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 uint8_t* ppc_memory_alloc()
@@ -24,8 +88,10 @@ uint8_t* ppc_memory_alloc()
     // pages on first access, so this doesn't actually use 4 GB of RAM.
     // This is necessary because the PPC code can access any address in the 32-bit
     // space (globals, heap, stack, etc.) and we need all of it to be accessible.
-    base = static_cast<uint8_t*>(
-        VirtualAlloc(nullptr, PPC_MEM_TOTAL_SIZE, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+    base = alloc_with_placeholders();
+    if (!base)
+        base = static_cast<uint8_t*>(
+            VirtualAlloc(nullptr, PPC_MEM_TOTAL_SIZE, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
     if (!base)
     {
         fprintf(stderr, "Failed to allocate 4 GB virtual address space (error %lu)\n", GetLastError());
@@ -63,12 +129,63 @@ void ppc_memory_free(uint8_t* base)
     if (!base) return;
 
 #ifdef _WIN32
+    if (s_placeholders)
+    {
+        if (s_image_mapped) UnmapViewOfFile(base + PPC_MEM_IMAGE_BASE);
+        else VirtualFree(base + PPC_MEM_IMAGE_BASE, 0, MEM_RELEASE);
+        VirtualFree(base + PPC_MEM_IMAGE_BASE + PPC_MEM_IMAGE_SIZE, 0, MEM_RELEASE);
+        s_placeholders = false;
+        s_image_mapped = false;
+    }
     VirtualFree(base, 0, MEM_RELEASE);
 #else
     munmap(base, PPC_MEM_TOTAL_SIZE);
 #endif
 }
 
+bool ppc_memory_map_image(uint8_t* base, const char* path)
+{
+    uint8_t* dest = base + PPC_MEM_IMAGE_BASE;
+#ifdef _WIN32
+    if (!s_placeholders || s_image_mapped) return false;
+
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size = {};
+    HANDLE mapping = nullptr;
+    if (GetFileSizeEx(file, &size) && (uint64_t)size.QuadPart == PPC_MEM_IMAGE_SIZE)
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping) return false;
+
+    // Turn the committed image region back into a placeholder and put the
+    // view in its place; if that fails, commit it again.
+    bool mapped = false;
+    if (VirtualFree(dest, PPC_MEM_IMAGE_SIZE, MEM_RELEASE | MEM_PRESERVE_PLACEHOLDER))
+    {
+        mapped = s_MapViewOfFile3(mapping, GetCurrentProcess(), dest, 0, PPC_MEM_IMAGE_SIZE,
+                                  MEM_REPLACE_PLACEHOLDER, PAGE_WRITECOPY, nullptr, 0) != nullptr;
+        if (!mapped)
+            commit_placeholder(base, PPC_MEM_IMAGE_BASE, PPC_MEM_IMAGE_SIZE);
+    }
+    CloseHandle(mapping);  // the view keeps the section alive
+    s_image_mapped = mapped;
+    return mapped;
+#else
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0 && (uint64_t)st.st_size == PPC_MEM_IMAGE_SIZE;
+    // MAP_FIXED replaces that part of the anonymous 4 GB mapping
+    if (ok)
+        ok = mmap(dest, PPC_MEM_IMAGE_SIZE, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_FIXED, fd, 0) != MAP_FAILED;
+    close(fd);
+    return ok;
+#endif
+}
+
 void ppc_populate_func_table(uint8_t* base)
 {
     // PPCFuncMappings is defined in the generated ppc_func_mapping.cpp
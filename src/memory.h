@@ -31,6 +31,10 @@ constexpr uint32_t PPC_KPCR_SIZE    = 0x1000;           // 4 KB
 constexpr uint32_t PPC_KTHREAD_BASE = 0x92001000;
 constexpr uint32_t PPC_KTHREAD_SIZE = 0x1000;           // 4 KB
 
+// XMA hardware contexts handed out by XMACreateContext (320 x 64 bytes)
+constexpr uint32_t PPC_XMA_CONTEXT_BASE = 0x92002000;
+constexpr uint32_t PPC_XMA_CONTEXT_SIZE = 0x5000;       // 20 KB
+
 // Function lookup table lives right after the image
 constexpr uint64_t PPC_FUNC_TABLE_OFFSET = PPC_MEM_IMAGE_BASE + PPC_MEM_IMAGE_SIZE;
 constexpr uint64_t PPC_FUNC_TABLE_SIZE   = PPC_MEM_CODE_SIZE * 2; // 8 bytes per 4-byte instruction
@@ -42,6 +46,12 @@ uint8_t* ppc_memory_alloc();
 // Free the PPC memory space.
 void ppc_memory_free(uint8_t* base);
 
+// Back the image region (PPC_MEM_IMAGE_BASE, PPC_MEM_IMAGE_SIZE bytes) with
+// a copy-on-write view of `path`, which must be exactly that size: pages
+// are read from the file on first touch and copied only when written.
+// On failure the region keeps its ordinary zeroed memory.
+bool ppc_memory_map_image(uint8_t* base, const char* path);
+
 // Populate the function lookup table from PPCFuncMappings[].
 // This fills base[PPC_FUNC_TABLE_OFFSET..] with function pointers
 // so PPC_LOOKUP_FUNC / PPC_CALL_INDIRECT_FUNC work at runtime.
@@ -0,0 +1,518 @@
+#include "xex2.h"
+#include "lzx.h"
+
+#include <cstring>
+#include <thread>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define XEX2_HAVE_AESNI 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#if defined(__GNUC__) || defined(__clang__)
+#define XEX2_TARGET_AES __attribute__((target("aes,sse2")))
+#else
+#define XEX2_TARGET_AES
+#endif
+#endif
+
+// Xbox 360 retail key protecting each XEX's per-file AES key
+static const uint8_t XEX2_RETAIL_KEY[16] = {
+    0x20, 0xB1, 0x85, 0xA5, 0x9D, 0x28, 0xFD, 0xC3,
+    0x40, 0x58, 0x3F, 0xBB, 0x08, 0x96, 0xBF, 0x91
+};
+
+static const uint32_t XEX2_SEC_AES_KEY = 0x150;
+
+static uint32_t read_be32(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint16_t read_be16(const uint8_t* p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+// ============================================================================
+// AES-128 (decryption only)
+// ============================================================================
+
+static const uint8_t AES_SBOX[256] = {
+    0x63,0x7c,0x77,0x7b,0xf2,0x6b,0x6f,0xc5,0x30,0x01,0x67,0x2b,0xfe,0xd7,0xab,0x76,
+    0xca,0x82,0xc9,0x7d,0xfa,0x59,0x47,0xf0,0xad,0xd4,0xa2,0xaf,0x9c,0xa4,0x72,0xc0,
+    0xb7,0xfd,0x93,0x26,0x36,0x3f,0xf7,0xcc,0x34,0xa5,0xe5,0xf1,0x71,0xd8,0x31,0x15,
+    0x04,0xc7,0x23,0xc3,0x18,0x96,0x05,0x9a,0x07,0x12,0x80,0xe2,0xeb,0x27,0xb2,0x75,
+    0x09,0x83,0x2c,0x1a,0x1b,0x6e,0x5a,0xa0,0x52,0x3b,0xd6,0xb3,0x29,0xe3,0x2f,0x84,
+    0x53,0xd1,0x00,0xed,0x20,0xfc,0xb1,0x5b,0x6a,0xcb,0xbe,0x39,0x4a,0x4c,0x58,0xcf,
+    0xd0,0xef,0xaa,0xfb,0x43,0x4d,0x33,0x85,0x45,0xf9,0x02,0x7f,0x50,0x3c,0x9f,0xa8,
+    0x51,0xa3,0x40,0x8f,0x92,0x9d,0x38,0xf5,0xbc,0xb6,0xda,0x21,0x10,0xff,0xf3,0xd2,
+    0xcd,0x0c,0x13,0xec,0x5f,0x97,0x44,0x17,0xc4,0xa7,0x7e,0x3d,0x64,0x5d,0x19,0x73,
+    0x60,0x81,0x4f,0xdc,0x22,0x2a,0x90,0x88,0x46,0xee,0xb8,0x14,0xde,0x5e,0x0b,0xdb,
+    0xe0,0x32,0x3a,0x0a,0x49,0x06,0x24,0x5c,0xc2,0xd3,0xac,0x62,0x91,0x95,0xe4,0x79,
+    0xe7,0xc8,0x37,0x6d,0x8d,0xd5,0x4e,0xa9,0x6c,0x56,0xf4,0xea,0x65,0x7a,0xae,0x08,
+    0xba,0x78,0x25,0x2e,0x1c,0xa6,0xb4,0xc6,0xe8,0xdd,0x74,0x1f,0x4b,0xbd,0x8b,0x8a,
+    0x70,0x3e,0xb5,0x66,0x48,0x03,0xf6,0x0e,0x61,0x35,0x57,0xb9,0x86,0xc1,0x1d,0x9e,
+    0xe1,0xf8,0x98,0x11,0x69,0xd9,0x8e,0x94,0x9b,0x1e,0x87,0xe9,0xce,0x55,0x28,0xdf,
+    0x8c,0xa1,0x89,0x0d,0xbf,0xe6,0x42,0x68,0x41,0x99,0x2d,0x0f,0xb0,0x54,0xbb,0x16,
+};
+
+static uint8_t aes_xtime(uint8_t x)
+{
+    return (uint8_t)((x << 1) ^ ((x & 0x80) ? 0x1B : 0));
+}
+
+static uint8_t aes_mul(uint8_t a, uint8_t b)
+{
+    uint8_t r = 0;
+    while (b)
+    {
+        if (b & 1) r ^= a;
+        a = aes_xtime(a);
+        b >>= 1;
+    }
+    return r;
+}
+
+// Decryption tables: inverse S-box and the InvMixColumns column
+// contributions combined with it (one 32-bit lookup per state byte).
+struct AesTables
+{
+    uint8_t  inv_sbox[256];
+    uint32_t td[4][256];
+
+    AesTables()
+    {
+        for (int i = 0; i < 256; i++) inv_sbox[AES_SBOX[i]] = (uint8_t)i;
+        for (int i = 0; i < 256; i++)
+        {
+            uint8_t s = inv_sbox[i];
+            uint32_t col = ((uint32_t)aes_mul(s, 0x0E)) |
+                           ((uint32_t)aes_mul(s, 0x09) << 8) |
+                           ((uint32_t)aes_mul(s, 0x0D) << 16) |
+                           ((uint32_t)aes_mul(s, 0x0B) << 24);
+            for (int t = 0; t < 4; t++)
+            {
+                td[t][i] = col;
+                col = (col << 8) | (col >> 24);
+            }
+        }
+    }
+};
+
+static const AesTables& aes_tables()
+{
+    static const AesTables tables;
+    return tables;
+}
+
+// Round keys as little-endian column words, in encryption order.
+static void aes128_expand_key(const uint8_t key[16], uint32_t rk[44])
+{
+    static const uint8_t rcon[10] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1B, 0x36};
+    for (int i = 0; i < 4; i++)
+        rk[i] = key[4 * i] | (key[4 * i + 1] << 8) | (key[4 * i + 2] << 16) | ((uint32_t)key[4 * i + 3] << 24);
+    for (int i = 4; i < 44; i++)
+    {
+        uint32_t t = rk[i - 1];
+        if (i % 4 == 0)
+        {
+            t = (t >> 8) | (t << 24);  // RotWord
+            t = AES_SBOX[t & 0xFF] | (AES_SBOX[(t >> 8) & 0xFF] << 8) |
+                (AES_SBOX[(t >> 16) & 0xFF] << 16) | ((uint32_t)AES_SBOX[t >> 24] << 24);
+            t ^= rcon[i / 4 - 1];
+        }
+        rk[i] = rk[i - 4] ^ t;
+    }
+}
+
+// Equivalent inverse cipher: middle round keys get InvMixColumns so every
+// round is four table lookups per column.
+static void aes128_decrypt_keys(const uint8_t key[16], uint32_t dk[44])
+{
+    const AesTables& T = aes_tables();
+    uint32_t rk[44];
+    aes128_expand_key(key, rk);
+    for (int r = 0; r <= 10; r++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            uint32_t w = rk[(10 - r) * 4 + c];
+            if (r > 0 && r < 10)
+            {
+                w = T.td[0][AES_SBOX[w & 0xFF]] ^ T.td[1][AES_SBOX[(w >> 8) & 0xFF]] ^
+                    T.td[2][AES_SBOX[(w >> 16) & 0xFF]] ^ T.td[3][AES_SBOX[w >> 24]];
+            }
+            dk[r * 4 + c] = w;
+        }
+    }
+}
+
+static void aes128_decrypt_block(const uint32_t dk[44], const uint8_t in[16], uint8_t out[16])
+{
+    const AesTables& T = aes_tables();
+    uint32_t s[4], t[4];
+    for (int c = 0; c < 4; c++)
+    {
+        uint32_t w;
+        memcpy(&w, in + 4 * c, 4);
+        s[c] = w ^ dk[c];
+    }
+    for (int r = 1; r < 10; r++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            t[c] = T.td[0][s[c] & 0xFF] ^ T.td[1][(s[(c + 3) & 3] >> 8) & 0xFF] ^
+                   T.td[2][(s[(c + 2) & 3] >> 16) & 0xFF] ^ T.td[3][s[(c + 1) & 3] >> 24] ^
+                   dk[r * 4 + c];
+        }
+        memcpy(s, t, sizeof(s));
+    }
+    for (int c = 0; c < 4; c++)
+    {
+        uint32_t w = (uint32_t)T.inv_sbox[s[c] & 0xFF] |
+                     ((uint32_t)T.inv_sbox[(s[(c + 3) & 3] >> 8) & 0xFF] << 8) |
+                     ((uint32_t)T.inv_sbox[(s[(c + 2) & 3] >> 16) & 0xFF] << 16) |
+                     ((uint32_t)T.inv_sbox[s[(c + 1) & 3] >> 24] << 24);
+        w ^= dk[40 + c];
+        memcpy(out + 4 * c, &w, 4);
+    }
+}
+
+static void aes128_cbc_decrypt_portable(const uint32_t dk[44], uint8_t* data, size_t size,
+                                        const uint8_t iv_in[16])
+{
+    uint8_t iv[16];
+    memcpy(iv, iv_in, 16);
+    for (size_t off = 0; off + 16 <= size; off += 16)
+    {
+        uint8_t block[16], plain[16];
+        memcpy(block, data + off, 16);
+        aes128_decrypt_block(dk, block, plain);
+        for (int i = 0; i < 16; i++) data[off + i] = plain[i] ^ iv[i];
+        memcpy(iv, block, 16);
+    }
+}
+
+#ifdef XEX2_HAVE_AESNI
+static bool cpu_has_aesni()
+{
+#if defined(_MSC_VER)
+    int regs[4];
+    __cpuid(regs, 1);
+    return (regs[2] >> 25) & 1;
+#else
+    unsigned a, b, c, d;
+    return __get_cpuid(1, &a, &b, &c, &d) && ((c >> 25) & 1);
+#endif
+}
+
+// The equivalent-inverse-cipher schedule from aes128_decrypt_keys is
+// exactly what AESDEC expects. CBC decryption has no chain dependency,
+// so four blocks are kept in flight to hide the AESDEC latency.
+XEX2_TARGET_AES
+static void aes128_cbc_decrypt_aesni(const uint32_t dk[44], uint8_t* data, size_t size,
+                                     const uint8_t iv_in[16])
+{
+    __m128i k[11];
+    for (int r = 0; r <= 10; r++) k[r] = _mm_loadu_si128((const __m128i*)(dk + 4 * r));
+    __m128i iv = _mm_loadu_si128((const __m128i*)iv_in);
+
+    size_t off = 0;
+    for (; off + 64 <= size; off += 64)
+    {
+        __m128i* p = (__m128i*)(data + off);
+        __m128i c0 = _mm_loadu_si128(p + 0), c1 = _mm_loadu_si128(p + 1);
+        __m128i c2 = _mm_loadu_si128(p + 2), c3 = _mm_loadu_si128(p + 3);
+        __m128i b0 = _mm_xor_si128(c0, k[0]), b1 = _mm_xor_si128(c1, k[0]);
+        __m128i b2 = _mm_xor_si128(c2, k[0]), b3 = _mm_xor_si128(c3, k[0]);
+        for (int r = 1; r < 10; r++)
+        {
+            b0 = _mm_aesdec_si128(b0, k[r]);
+            b1 = _mm_aesdec_si128(b1, k[r]);
+            b2 = _mm_aesdec_si128(b2, k[r]);
+            b3 = _mm_aesdec_si128(b3, k[r]);
+        }
+        b0 = _mm_aesdeclast_si128(b0, k[10]);
+        b1 = _mm_aesdeclast_si128(b1, k[10]);
+        b2 = _mm_aesdeclast_si128(b2, k[10]);
+        b3 = _mm_aesdeclast_si128(b3, k[10]);
+        _mm_storeu_si128(p + 0, _mm_xor_si128(b0, iv));
+        _mm_storeu_si128(p + 1, _mm_xor_si128(b1, c0));
+        _mm_storeu_si128(p + 2, _mm_xor_si128(b2, c1));
+        _mm_storeu_si128(p + 3, _mm_xor_si128(b3, c2));
+        iv = c3;
+    }
+    for (; off + 16 <= size; off += 16)
+    {
+        __m128i* p = (__m128i*)(data + off);
+        __m128i c = _mm_loadu_si128(p);
+        __m128i b = _mm_xor_si128(c, k[0]);
+        for (int r = 1; r < 10; r++) b = _mm_aesdec_si128(b, k[r]);
+        b = _mm_aesdeclast_si128(b, k[10]);
+        _mm_storeu_si128(p, _mm_xor_si128(b, iv));
+        iv = c;
+    }
+}
+#endif
+
+bool xex2_aesni_available()
+{
+#ifdef XEX2_HAVE_AESNI
+    static const bool available = cpu_has_aesni();
+    return available;
+#else
+    return false;
+#endif
+}
+
+static unsigned xex2_thread_count(unsigned requested)
+{
+    if (requested) return requested;
+    unsigned hw = std::thread::hardware_concurrency();
+    return hw ? hw : 1;
+}
+
+// Below this a thread costs more than it saves
+static const size_t XEX2_PARALLEL_MIN_BYTES = 1 << 20;
+
+void xex2_aes128_cbc_decrypt(const uint8_t key[16], uint8_t* data, size_t size,
+                             const Xex2DecodeOptions& options)
+{
+    uint32_t dk[44];
+    aes128_decrypt_keys(key, dk);
+    auto decrypt = aes128_cbc_decrypt_portable;
+#ifdef XEX2_HAVE_AESNI
+    if (options.aesni && xex2_aesni_available()) decrypt = aes128_cbc_decrypt_aesni;
+#endif
+
+    size = size & ~(size_t)15;
+    unsigned threads = xex2_thread_count(options.threads);
+    size_t blocks = size / 16;
+    if (threads > blocks) threads = (unsigned)blocks;
+    const uint8_t zero_iv[16] = {};
+    if (threads <= 1 || size < XEX2_PARALLEL_MIN_BYTES)
+    {
+        decrypt(dk, data, size, zero_iv);
+        return;
+    }
+
+    // Each range's IV is the ciphertext block before it; save those before
+    // any range is decrypted in place.
+    std::vector<size_t> start(threads + 1);
+    std::vector<uint8_t> ivs(threads * 16, 0);
+    for (unsigned t = 0; t <= threads; t++) start[t] = blocks * t / threads * 16;
+    for (unsigned t = 1; t < threads; t++) memcpy(&ivs[t * 16], data + start[t] - 16, 16);
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; t++)
+        pool.emplace_back(decrypt, dk, data + start[t], start[t + 1] - start[t], &ivs[t * 16]);
+    decrypt(dk, data, start[1], zero_iv);
+    for (auto& th : pool) th.join();
+}
+
+// ============================================================================
+// XEX2
+// ============================================================================
+
+bool xex2_parse(const uint8_t* data, size_t size, Xex2Info& info, std::string& error)
+{
+    info = {};
+    if (size < 24 || memcmp(data, "XEX2", 4) != 0)
+    {
+        error = "not a XEX2 file";
+        return false;
+    }
+    info.pe_data_offset = read_be32(data + 8);
+    info.security_offset = read_be32(data + 16);
+    uint32_t header_count = read_be32(data + 20);
+    if ((uint64_t)24 + (uint64_t)header_count * 8 > size)
+    {
+        error = "optional headers past end of file";
+        return false;
+    }
+    for (uint32_t i = 0; i < header_count; i++)
+    {
+        const uint8_t* h = data + 24 + i * 8;
+        uint32_t key = read_be32(h) >> 8;
+        uint32_t value = read_be32(h + 4);
+        if (key == 0x000003) info.ffi_offset = value;
+        else if (key == 0x000101) info.entry_point = value;
+        else if (key == 0x000102) info.image_base = value;
+    }
+    if (!info.ffi_offset || (uint64_t)info.ffi_offset + 8 > size)
+    {
+        error = "file format info header not found";
+        return false;
+    }
+    if ((uint64_t)info.security_offset + XEX2_SEC_AES_KEY + 16 > size ||
+        info.pe_data_offset > size)
+    {
+        error = "security info past end of file";
+        return false;
+    }
+    info.ffi_size = read_be32(data + info.ffi_offset);
+    info.encryption = read_be16(data + info.ffi_offset + 4);
+    info.compression = read_be16(data + info.ffi_offset + 6);
+    info.image_size = read_be32(data + info.security_offset + 4);
+    info.load_address = read_be32(data + info.security_offset + 0x110);
+    return true;
+}
+
+// Normal compression: the decrypted data is a chain of blocks, each
+// starting with the next block's { size, SHA-1 } and then holding LZX
+// chunks { be16 size, bytes } up to a zero size. The chunks concatenated
+// form one LZX stream.
+static bool xex2_deblock(const std::vector<uint8_t>& pe, uint32_t first_block_size,
+                         std::vector<uint8_t>& stream, std::string& error)
+{
+    stream.clear();
+    stream.reserve(pe.size());
+    size_t pos = 0;
+    for (uint32_t block_size = first_block_size; block_size;)
+    {
+        if (block_size < 24 || pos + block_size > pe.size())
+        {
+            error = "compressed block past end of file";
+            return false;
+        }
+        const uint8_t* block = pe.data() + pos;
+        uint32_t next_size = read_be32(block);
+        for (size_t p = 24; p + 2 <= block_size;)
+        {
+            uint16_t chunk = read_be16(block + p);
+            p += 2;
+            if (!chunk) break;
+            if (p + chunk > block_size)
+            {
+                error = "compressed chunk past end of block";
+                return false;
+            }
+            stream.insert(stream.end(), block + p, block + p + chunk);
+            p += chunk;
+        }
+        pos += block_size;
+        block_size = next_size;
+    }
+    return true;
+}
+
+bool xex2_decode(const uint8_t* data, size_t size, std::vector<uint8_t>& image,
+                 Xex2Info& info, std::string& error, const Xex2DecodeOptions& options)
+{
+    if (!xex2_parse(data, size, info, error)) return false;
+    if (info.compression > 2)
+    {
+        error = "delta-compressed XEX is not supported";
+        return false;
+    }
+    uint32_t window_size = 0, first_block_size = 0;
+    if (info.compression == 2)
+    {
+        if (info.ffi_size < 36 || (uint64_t)info.ffi_offset + 36 > size)
+        {
+            error = "file format info too short for normal compression";
+            return false;
+        }
+        window_size = read_be32(data + info.ffi_offset + 8);
+        first_block_size = read_be32(data + info.ffi_offset + 12);
+    }
+
+    // Everything from the PE data offset on is one CBC stream
+    size_t pe_size = size - info.pe_data_offset;
+    std::vector<uint8_t> pe((pe_size + 15) & ~(size_t)15, 0);
+    memcpy(pe.data(), data + info.pe_data_offset, pe_size);
+    if (info.encryption != 1)
+    {
+        pe.resize(pe_size);  // the Python tool only pads what it decrypts
+    }
+    else
+    {
+        uint8_t file_key[16];
+        memcpy(file_key, data + info.security_offset + XEX2_SEC_AES_KEY, 16);
+        xex2_aes128_cbc_decrypt(XEX2_RETAIL_KEY, file_key, 16);
+        xex2_aes128_cbc_decrypt(file_key, pe.data(), pe.size(), options);
+    }
+
+    if (info.compression == 0)
+    {
+        size_t n = pe.size() < info.image_size ? pe.size() : info.image_size;
+        image.assign(pe.begin(), pe.begin() + n);
+        return true;
+    }
+
+    if (info.compression == 2)
+    {
+        // One LZX stream: matches reach back across blocks, so this part
+        // stays serial
+        std::vector<uint8_t> stream;
+        if (!xex2_deblock(pe, first_block_size, stream, error)) return false;
+        image.assign(info.image_size, 0);
+        return lzx_decompress(stream.data(), stream.size(), image.data(), image.size(),
+                              window_size, error);
+    }
+
+    // Basic compression: { data_size, zero_size } pairs after the 8-byte
+    // file format header, terminated by {0, 0}. Every block's source and
+    // destination are known up front, so the copies run in parallel.
+    struct Copy { size_t src, dst, size; };
+    std::vector<Copy> copies;
+    image.assign(info.image_size, 0);
+    size_t src = 0, dst = 0, total = 0;
+    for (uint64_t p = info.ffi_offset + 8;
+         p + 8 <= (uint64_t)info.ffi_offset + info.ffi_size && p + 8 <= size; p += 8)
+    {
+        uint32_t data_size = read_be32(data + p);
+        uint32_t zero_size = read_be32(data + p + 4);
+        if (data_size == 0 && zero_size == 0) break;
+        size_t avail = src < pe.size() ? pe.size() - src : 0;
+        size_t n = data_size < avail ? data_size : avail;
+        if (dst < image.size())
+        {
+            size_t fit = image.size() - dst < n ? image.size() - dst : n;
+            copies.push_back({src, dst, fit});
+            total += fit;
+        }
+        if (n < data_size) break;  // truncated file: keep what there is
+        src += data_size;
+        dst += (size_t)data_size + zero_size;
+    }
+
+    unsigned threads = xex2_thread_count(options.threads);
+    if (threads > copies.size()) threads = (unsigned)copies.size();
+    auto copy_range = [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++)
+            memcpy(image.data() + copies[i].dst, pe.data() + copies[i].src, copies[i].size);
+    };
+    if (threads <= 1 || total < XEX2_PARALLEL_MIN_BYTES)
+    {
+        copy_range(0, copies.size());
+        return true;
+    }
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; t++)
+        pool.emplace_back(copy_range, copies.size() * t / threads, copies.size() * (t + 1) / threads);
+    copy_range(0, copies.size() / threads);
+    for (auto& th : pool) th.join();
+    return true;
+}
+
+uint64_t xex2_content_hash(const uint8_t* data, size_t size)
+{
+    // FNV-1a over 64-bit words, then the tail bytes
+    const uint64_t prime = 0x100000001B3ull;
+    uint64_t h = 0xCBF29CE484222325ull ^ size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t w;
+        memcpy(&w, data + i, 8);
+        h = (h ^ w) * prime;
+        h ^= h >> 29;
+    }
+    for (; i < size; i++) h = (h ^ data[i]) * prime;
+    return h;
+}
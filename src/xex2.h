@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Native XEX2 decoding: header parsing, AES-128-CBC decryption of the PE
+// data (AES-NI when the CPU has it) and basic or LZX decompression. Produces the same memory-layout PE
+// image as tools/extract_pe.py (file offset == RVA), so it can be mapped
+// straight into the guest image region.
+
+struct Xex2Info
+{
+    uint32_t pe_data_offset = 0;
+    uint32_t security_offset = 0;
+    uint32_t image_base = 0;      // optional header 0x102 (0 if absent)
+    uint32_t entry_point = 0;     // optional header 0x101
+    uint32_t image_size = 0;      // security info + 4
+    uint32_t load_address = 0;    // security info + 0x110
+    uint16_t encryption = 0;      // 0 = none, 1 = normal
+    uint16_t compression = 0;     // 0 = none, 1 = basic, 2 = normal (LZX), 3 = delta
+    uint32_t ffi_offset = 0;      // file format info
+    uint32_t ffi_size = 0;
+};
+
+struct Xex2DecodeOptions
+{
+    unsigned threads = 0;    // 0 = one per hardware thread
+    bool     aesni = true;   // false forces the portable AES code
+};
+
+// Parse the XEX2 headers. Returns false (with `error` set) if the file
+// is not a XEX2 this decoder understands.
+bool xex2_parse(const uint8_t* data, size_t size, Xex2Info& info, std::string& error);
+
+// Decrypt and decompress the PE image. `image` receives image_size bytes
+// (fewer only if an uncompressed file is truncated, as the Python tool).
+// Decryption and basic-block copies are split across threads; the LZX
+// stream is inherently serial.
+bool xex2_decode(const uint8_t* data, size_t size, std::vector<uint8_t>& image,
+                 Xex2Info& info, std::string& error, const Xex2DecodeOptions& options = {});
+
+// AES-128 in CBC mode with a zero IV, decrypting `size` bytes (a multiple
+// of 16) in place.
+void xex2_aes128_cbc_decrypt(const uint8_t key[16], uint8_t* data, size_t size,
+                             const Xex2DecodeOptions& options = {});
+
+// True if the CPU supports the AES-NI instructions.
+bool xex2_aesni_available();
+
+// 64-bit content hash used to name cached images.
+uint64_t xex2_content_hash(const uint8_t* data, size_t size);
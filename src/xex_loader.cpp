@@ -1,11 +1,20 @@
 #include "xex_loader.h"
 #include "memory.h"
+#include "xex2.h"
 
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <string>
 #include <vector>
 
+#ifdef _WIN32
+#include <io.h>
+#define unlink _unlink
+#else
+#include <unistd.h>
+#endif
+
 // Load data sections from a pre-extracted PE image file.
 //
 // The PE image should be extracted from the XEX using tools/dump_pe.exe:
@@ -144,3 +153,85 @@ bool xex_load_data_sections(uint8_t* base, const char* pe_path)
     printf("  Loaded %zu data sections, %zu bytes total\n", sections_loaded, total_loaded);
     return true;
 }
+
+static bool read_file(const char* path, std::vector<uint8_t>& out)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    out.resize(size > 0 ? (size_t)size : 0);
+    bool ok = fread(out.data(), 1, out.size(), f) == out.size();
+    fclose(f);
+    return ok;
+}
+
+// Write via a temporary name so a crash never leaves a short cache behind.
+static bool write_file_atomic(const std::string& path, const uint8_t* data, size_t size)
+{
+    std::string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (!f) return false;
+    bool ok = fwrite(data, 1, size, f) == size;
+    ok = fclose(f) == 0 && ok;
+    if (ok)
+    {
+        unlink(path.c_str());
+        ok = rename(tmp.c_str(), path.c_str()) == 0;
+    }
+    if (!ok) unlink(tmp.c_str());
+    return ok;
+}
+
+bool xex_load_image(uint8_t* base, const char* xex_path)
+{
+    std::vector<uint8_t> xex;
+    if (!read_file(xex_path, xex))
+    {
+        fprintf(stderr, "Failed to open XEX: %s\n", xex_path);
+        return false;
+    }
+
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%016llx.img",
+             (unsigned long long)xex2_content_hash(xex.data(), xex.size()));
+    std::string cache_path = std::string(xex_path) + suffix;
+
+    // Warm boot: the cache is already there
+    if (ppc_memory_map_image(base, cache_path.c_str()))
+    {
+        printf("  Mapped cached image %s\n", cache_path.c_str());
+        return true;
+    }
+
+    // Cold boot: decode, write the cache, then map it like a warm boot
+    Xex2Info info;
+    std::vector<uint8_t> image;
+    std::string error;
+    if (!xex2_decode(xex.data(), xex.size(), image, info, error))
+    {
+        fprintf(stderr, "Failed to decode %s: %s\n", xex_path, error.c_str());
+        return false;
+    }
+    printf("  Decoded %s: image 0x%X bytes, entry 0x%08X\n",
+           xex_path, info.image_size, info.entry_point);
+    if (image.size() > PPC_MEM_IMAGE_SIZE)
+    {
+        fprintf(stderr, "  Image larger than the guest image region (0x%zX > 0x%llX)\n",
+                image.size(), (unsigned long long)PPC_MEM_IMAGE_SIZE);
+        return false;
+    }
+    image.resize(PPC_MEM_IMAGE_SIZE, 0);
+
+    if (write_file_atomic(cache_path, image.data(), image.size()) &&
+        ppc_memory_map_image(base, cache_path.c_str()))
+    {
+        printf("  Wrote and mapped cached image %s\n", cache_path.c_str());
+        return true;
+    }
+
+    fprintf(stderr, "  Image cache unavailable, copying the decoded image\n");
+    memcpy(base + PPC_MEM_IMAGE_BASE, image.data(), image.size());
+    return true;
+}
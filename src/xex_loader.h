@@ -13,3 +13,16 @@
 //
 // Returns true on success.
 bool xex_load_data_sections(uint8_t* base, const char* pe_path);
+
+// Load the image straight from the XEX, no extraction step.
+//
+// The first boot decrypts and decompresses `xex_path` natively (src/xex2.h)
+// and writes the memory-layout image to a cache next to it, named by a
+// hash of the XEX contents:
+//   extracted/default.xex.<hash>.img
+// Every boot then maps that cache copy-on-write over the whole guest image
+// region (ppc_memory_map_image), so nothing is read or copied up front.
+// If the cache cannot be written or mapped, the decoded image is copied.
+//
+// Returns true on success.
+bool xex_load_image(uint8_t* base, const char* xex_path);
@@ -0,0 +1,632 @@
+#include "xma.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// Context dwords (big-endian in guest memory), as the XDK lays them out:
+//   0: input buffer 0 packet count :12, loop count :8, input buffer 0 valid :1,
+//      input buffer 1 valid :1, output block count :5, output write offset :5
+//   1: input buffer 1 packet count :12, loop subframes :8, subframe decode count :4,
+//      output padding :3, sample rate :2, stereo :1, :1, output buffer valid :1
+//   2: input buffer read offset (bits) :26, error status :5, error set :1
+//   3: loop start :26, parser error :6
+//   4: loop end :26, packet metadata :5, current input buffer :1
+//   5: input buffer 0   6: input buffer 1   7: output buffer   8: work buffer
+//   9: output read offset :5, ...
+static constexpr uint32_t CONTEXT_WORDS = 10;
+static constexpr uint32_t OUTPUT_BLOCK = 256;        // output ring unit, bytes
+static constexpr uint32_t MAX_OUTPUT_BLOCKS = 31;
+static constexpr uint32_t PACKET_BITS = XMA_PACKET_SIZE * 8;
+static constexpr uint32_t FRAME_LENGTH_BITS = 15;
+static constexpr uint32_t FRAME_PADDING = 0x7FFF;
+static constexpr uint32_t MAX_PAYLOAD_BYTES = (FRAME_PADDING + 7) / 8;
+
+static inline uint32_t load_be32(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline void store_be32(uint8_t* p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+struct XmaContext
+{
+    bool     allocated = false;
+    bool     in_batch = false;   // in the batch the workers have (main thread)
+    uint32_t address = 0;
+
+    // Batch job, filled in on the main thread before the batch is published
+    uint32_t w[CONTEXT_WORDS] = {};
+    uint32_t max_frames = 0;
+
+    // Results, written by a worker and read after the batch fence
+    uint32_t read_offset = 0;
+    uint32_t current_buffer = 0;
+    bool     consumed[2] = {};
+    uint32_t frames = 0;
+    bool     error = false;
+    uint32_t decode_errors = 0;
+    uint8_t  pcm[MAX_OUTPUT_BLOCKS * OUTPUT_BLOCK];
+};
+
+static uint8_t* s_base = nullptr;
+static uint32_t s_context_array = 0;
+static XmaContext s_contexts[XMA_MAX_CONTEXTS];
+static XmaOptions s_options;
+static uint32_t s_in_use = 0;
+static uint32_t s_peak = 0;
+
+// Worker pool. A batch is a list of context indices; jobs are claimed with
+// a CAS on (generation << 32 | next index), so a worker still finishing
+// one batch can never claim from the next with a stale size.
+static std::vector<std::thread> s_workers;
+static std::mutex s_mutex;
+static std::condition_variable s_work_cv;
+static std::condition_variable s_done_cv;
+static bool s_stop = false;
+static uint32_t s_generation = 0;
+static uint32_t s_batch[XMA_MAX_CONTEXTS];
+static uint32_t s_batch_size = 0;
+static uint64_t s_batch_fence = 0;
+static std::atomic<uint64_t> s_claim{0};
+static std::atomic<uint32_t> s_jobs_left{0};
+static std::atomic<uint64_t> s_completed{0};
+static std::atomic<int64_t> s_batch_end_ns{0};
+
+// Main thread only
+static uint64_t s_submitted = 0;
+static bool s_in_flight = false;
+static uint64_t s_last_frame = 0;
+static Clock::time_point s_batch_start;
+static XmaStats s_stats;
+static double s_batch_ms_total = 0;
+
+// ============================================================================
+// Frame walking
+// ============================================================================
+
+static inline uint32_t packet_frame_offset(const uint8_t* packet)
+{
+    return (load_be32(packet) >> 11) & 0x7FFF;
+}
+
+// Next packet of this stream; the skip count steps over packets that
+// belong to other streams of a multichannel file
+static inline uint32_t next_packet(const uint8_t* buf, uint32_t packet)
+{
+    return packet + 1 + buf[packet * XMA_PACKET_SIZE + 3];
+}
+
+// `n` bits (n <= 25) at bit `pos`, all within one packet
+static inline uint32_t peek_bits(const uint8_t* buf, uint32_t pos, uint32_t n)
+{
+    const uint8_t* p = buf + (pos >> 3);
+    uint32_t shift = pos & 7;
+    uint32_t last = (pos + n - 1) >> 3;
+    uint32_t window = 0;
+    for (uint32_t i = 0; i < 4 && (pos >> 3) + i <= last; i++)
+        window |= (uint32_t)p[i] << (24 - 8 * i);
+    return (window << shift) >> (32 - n);
+}
+
+// Position in a context's input stream. A frame may continue from the end
+// of one input buffer into the first packet of the other.
+struct StreamCursor
+{
+    const uint8_t* buf[2];
+    uint32_t       packets[2];
+    bool           valid[2];
+    uint32_t       cur;
+    uint32_t       pos;       // bit offset in buf[cur], packet headers included
+    bool           crossed;   // moved into the other buffer mid-frame
+};
+
+static bool cursor_cross(StreamCursor& s)
+{
+    if (s.crossed || !s.valid[s.cur ^ 1] || !s.packets[s.cur ^ 1]) return false;
+    s.cur ^= 1;
+    s.crossed = true;
+    s.pos = 32;
+    return true;
+}
+
+// Step `bits` stream bits forward, over packet headers. Returns false if
+// the data ends first (the rest is in a buffer the game has not submitted).
+static bool cursor_advance(StreamCursor& s, uint32_t bits)
+{
+    while (bits)
+    {
+        if (s.pos >= s.packets[s.cur] * PACKET_BITS && !cursor_cross(s)) return false;
+        uint32_t packet = s.pos / PACKET_BITS;
+        uint32_t left = (packet + 1) * PACKET_BITS - s.pos;
+        if (bits < left)
+        {
+            s.pos += bits;
+            return true;
+        }
+        bits -= left;
+        packet = next_packet(s.buf[s.cur], packet);
+        if (packet < s.packets[s.cur])
+            s.pos = packet * PACKET_BITS + 32;
+        else if (!bits)
+            s.pos = s.packets[s.cur] * PACKET_BITS;
+        else if (!cursor_cross(s))
+            return false;
+    }
+    return true;
+}
+
+// `n` stream bits (n <= 25) at the cursor, without moving it
+static bool cursor_read(StreamCursor s, uint32_t n, uint32_t& value)
+{
+    value = 0;
+    while (n)
+    {
+        if (s.pos >= s.packets[s.cur] * PACKET_BITS && !cursor_cross(s)) return false;
+        uint32_t take = std::min(n, PACKET_BITS - s.pos % PACKET_BITS);
+        value = (value << take) | peek_bits(s.buf[s.cur], s.pos, take);
+        n -= take;
+        if (n) cursor_advance(s, take);
+    }
+    return true;
+}
+
+// `n` stream bits at the cursor into `out`, MSB first, zero-padded to a byte
+static bool cursor_copy(StreamCursor s, uint32_t n, uint8_t* out)
+{
+    for (uint32_t done = 0; done < n; done += 16)
+    {
+        uint32_t take = std::min(16u, n - done), value;
+        if (!cursor_read(s, take, value)) return false;
+        value <<= 16 - take;
+        out[done / 8] = (uint8_t)(value >> 8);
+        if (take > 8) out[done / 8 + 1] = (uint8_t)value;
+        cursor_advance(s, take);
+    }
+    return true;
+}
+
+// Hand one frame to the decoder and store its samples big-endian, as the
+// output ring holds them. `s` is at the frame's length field.
+static void decode_frame(const StreamCursor& s, uint32_t length, uint32_t index, XmaContext& c,
+                         uint32_t channels, uint8_t* out)
+{
+    uint32_t count = XMA_FRAME_SAMPLES * channels;
+    if (s_options.decoder)
+    {
+        thread_local uint8_t payload[MAX_PAYLOAD_BYTES];
+        thread_local int16_t samples[XMA_FRAME_SAMPLES * 2];
+        StreamCursor body = s;
+        uint32_t bits = length - FRAME_LENGTH_BITS;
+        if (cursor_advance(body, FRAME_LENGTH_BITS) && cursor_copy(body, bits, payload) &&
+            s_options.decoder->decode({index, payload, bits, channels}, samples))
+        {
+            for (uint32_t i = 0; i < count; i++)
+            {
+                out[i * 2] = (uint8_t)((uint16_t)samples[i] >> 8);
+                out[i * 2 + 1] = (uint8_t)samples[i];
+            }
+            return;
+        }
+        c.decode_errors++;
+    }
+    memset(out, 0, count * 2);
+}
+
+// Done with the current input buffer: hand it back and start the other
+// one at its first frame
+static void finish_buffer(StreamCursor& s, XmaContext& c)
+{
+    s.valid[s.cur] = false;
+    c.consumed[s.cur] = true;
+    s.cur ^= 1;
+    s.pos = 0;
+}
+
+// Decode up to max_frames frames. Stops early when the next frame is not
+// complete in the submitted buffers; everything after a corrupt frame
+// length in a buffer is dropped with the buffer.
+static void decode_context(XmaContext& c, uint32_t index)
+{
+    const uint32_t* w = c.w;
+    StreamCursor s = {
+        {s_base + w[5], s_base + w[6]},
+        {w[0] & 0xFFF, w[1] & 0xFFF},
+        {((w[0] >> 20) & 1) != 0, ((w[0] >> 21) & 1) != 0},
+        w[4] >> 31,
+        w[2] & 0x3FFFFFF,
+        false,
+    };
+    uint32_t channels = ((w[1] >> 29) & 1) + 1;
+    uint32_t frame_bytes = XMA_FRAME_SAMPLES * 2 * channels;
+
+    c.frames = 0;
+    c.error = false;
+    c.decode_errors = 0;
+    c.consumed[0] = c.consumed[1] = false;
+    while (c.frames < c.max_frames)
+    {
+        if (!s.valid[s.cur])
+        {
+            if (!s.valid[s.cur ^ 1]) break;
+            s.cur ^= 1;
+            s.pos = 0;
+        }
+        const uint8_t* b = s.buf[s.cur];
+        if (s.pos >= s.packets[s.cur] * PACKET_BITS)
+        {
+            finish_buffer(s, c);
+            continue;
+        }
+
+        // At a packet header: go to the first frame that starts in the packet
+        if (s.pos % PACKET_BITS < 32)
+        {
+            uint32_t packet = s.pos / PACKET_BITS;
+            uint32_t offset = packet_frame_offset(b + packet * XMA_PACKET_SIZE);
+            if (offset == FRAME_PADDING)
+            {
+                s.pos = next_packet(b, packet) * PACKET_BITS;
+                continue;
+            }
+            s.pos = packet * PACKET_BITS + 32 + offset;
+            if (s.pos >= (packet + 1) * PACKET_BITS)
+            {
+                c.error = true;
+                finish_buffer(s, c);
+                continue;
+            }
+        }
+
+        s.crossed = false;
+        uint32_t length = 0;
+        if (!cursor_read(s, FRAME_LENGTH_BITS, length)) break;
+        if (length == FRAME_PADDING)
+        {
+            // Padding: the rest of this packet is unused
+            s.pos = next_packet(b, s.pos / PACKET_BITS) * PACKET_BITS;
+            continue;
+        }
+        if (length <= FRAME_LENGTH_BITS)
+        {
+            c.error = true;
+            finish_buffer(s, c);
+            continue;
+        }
+        StreamCursor next = s;
+        if (!cursor_advance(next, length)) break;
+        decode_frame(s, length, index, c, channels, c.pcm + c.frames * frame_bytes);
+        if (next.crossed)
+        {
+            next.valid[s.cur] = false;
+            c.consumed[s.cur] = true;
+        }
+        s = next;
+        c.frames++;
+    }
+    c.read_offset = s.pos;
+    c.current_buffer = s.cur;
+}
+
+// ============================================================================
+// Worker pool
+// ============================================================================
+
+static void run_jobs(uint32_t generation, uint32_t size)
+{
+    uint64_t claim = s_claim.load(std::memory_order_acquire);
+    for (;;)
+    {
+        uint32_t job = (uint32_t)claim;
+        if ((uint32_t)(claim >> 32) != generation || job >= size) return;
+        if (!s_claim.compare_exchange_weak(claim, claim + 1, std::memory_order_acq_rel))
+            continue;
+
+        decode_context(s_contexts[s_batch[job]], s_batch[job]);
+        if (s_jobs_left.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            s_batch_end_ns.store(Clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+            s_completed.store(s_batch_fence, std::memory_order_release);
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_done_cv.notify_all();
+        }
+        claim = s_claim.load(std::memory_order_acquire);
+    }
+}
+
+static void worker_thread()
+{
+    uint32_t seen = 0;
+    for (;;)
+    {
+        uint32_t generation, size;
+        {
+            std::unique_lock<std::mutex> lock(s_mutex);
+            s_work_cv.wait(lock, [&] { return s_stop || s_generation != seen; });
+            if (s_stop) return;
+            generation = seen = s_generation;
+            size = s_batch_size;
+        }
+        run_jobs(generation, size);
+    }
+}
+
+uint64_t xma_fence_submitted()
+{
+    return s_submitted;
+}
+
+bool xma_fence_done(uint64_t fence)
+{
+    return s_completed.load(std::memory_order_acquire) >= fence;
+}
+
+void xma_wait_fence(uint64_t fence)
+{
+    if (xma_fence_done(fence)) return;
+    uint32_t generation, size;
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        generation = s_generation;
+        size = s_batch_size;
+    }
+    run_jobs(generation, size);
+    std::unique_lock<std::mutex> lock(s_mutex);
+    s_done_cv.wait(lock, [&] { return xma_fence_done(fence); });
+}
+
+// ============================================================================
+// Batches
+// ============================================================================
+
+// Whole frames that fit in the output ring, keeping one block free so a
+// full ring is distinguishable from an empty one
+static uint32_t frames_that_fit(const uint32_t* w)
+{
+    uint32_t blocks = (w[0] >> 22) & 31;
+    uint32_t write = w[0] >> 27;
+    uint32_t read = w[9] & 31;
+    uint32_t frame_blocks = XMA_FRAME_SAMPLES * 2 * (((w[1] >> 29) & 1) + 1) / OUTPUT_BLOCK;
+    if (!blocks || write >= blocks || read >= blocks) return 0;
+    uint32_t used = (write + blocks - read) % blocks;
+    return (blocks - 1 - used) / frame_blocks;
+}
+
+static void submit_batch()
+{
+    uint32_t size = 0;
+    for (uint32_t i = 0; i < XMA_MAX_CONTEXTS; i++)
+    {
+        XmaContext& c = s_contexts[i];
+        if (!c.allocated) continue;
+        const uint8_t* p = s_base + c.address;
+        uint32_t w0 = load_be32(p), w1 = load_be32(p + 4);
+        if (!(w1 >> 31) || !((w0 >> 20) & 3)) continue;   // output invalid / no input
+        for (uint32_t k = 0; k < CONTEXT_WORDS; k++)
+            c.w[k] = load_be32(p + k * 4);
+        c.max_frames = frames_that_fit(c.w);
+        if (!c.max_frames) continue;
+        c.in_batch = true;
+        s_batch[size++] = i;
+    }
+    if (!size) return;
+
+    uint64_t fence = ++s_submitted;
+    s_in_flight = true;
+    s_batch_start = Clock::now();
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_generation++;
+        s_batch_size = size;
+        s_batch_fence = fence;
+        s_jobs_left.store(size, std::memory_order_relaxed);
+        s_claim.store((uint64_t)s_generation << 32, std::memory_order_release);
+    }
+    s_work_cv.notify_all();
+}
+
+static inline void hash_u32(uint64_t& h, uint32_t v)
+{
+    for (int i = 0; i < 4; i++, v >>= 8)
+        h = (h ^ (v & 0xFF)) * 0x100000001B3ull;
+}
+
+// Output blocks are whole multiples of 8 bytes, so the PCM is hashed a
+// word at a time
+static inline void hash_pcm(uint64_t& h, const uint8_t* p, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; i += 8)
+    {
+        uint64_t v;
+        memcpy(&v, p + i, 8);
+        h = (h ^ v) * 0x100000001B3ull;
+    }
+}
+
+// Copy the batch's PCM into the guest output rings and update the fields
+// the hardware owns. Guest-owned fields are re-read, not restored from the
+// snapshot, since the game may have changed them while the batch ran.
+static void write_back()
+{
+    s_in_flight = false;
+    double ms = std::chrono::duration<double, std::milli>(
+        Clock::time_point(Clock::duration(s_batch_end_ns.load(std::memory_order_relaxed))) - s_batch_start).count();
+    s_stats.batches++;
+    s_batch_ms_total += ms;
+    s_stats.batch_ms_mean = s_batch_ms_total / s_stats.batches;
+    s_stats.batch_ms_max = std::max(s_stats.batch_ms_max, ms);
+
+    for (uint32_t j = 0; j < s_batch_size; j++)
+    {
+        uint32_t i = s_batch[j];
+        XmaContext& c = s_contexts[i];
+        c.in_batch = false;
+        if (!c.allocated) continue;   // released while the batch ran
+        uint8_t* p = s_base + c.address;
+        uint32_t w0 = load_be32(p), w2 = load_be32(p + 8), w4 = load_be32(p + 16);
+
+        uint32_t blocks = (c.w[0] >> 22) & 31;
+        uint32_t write = c.w[0] >> 27;
+        uint32_t n = c.frames * XMA_FRAME_SAMPLES * 2 * (((c.w[1] >> 29) & 1) + 1) / OUTPUT_BLOCK;
+        uint8_t* out = s_base + c.w[7];
+        uint32_t first = std::min(n, blocks - write);
+        memcpy(out + write * OUTPUT_BLOCK, c.pcm, first * OUTPUT_BLOCK);
+        memcpy(out, c.pcm + first * OUTPUT_BLOCK, (n - first) * OUTPUT_BLOCK);
+        write = (write + n) % blocks;
+
+        if (c.consumed[0]) w0 &= ~(1u << 20);
+        if (c.consumed[1]) w0 &= ~(1u << 21);
+        w0 = (w0 & ~(31u << 27)) | (write << 27);
+        w2 = (w2 & ~0x3FFFFFFu) | (c.read_offset & 0x3FFFFFF);
+        w4 = (w4 & 0x7FFFFFFFu) | (c.current_buffer << 31);
+        store_be32(p, w0);
+        store_be32(p + 8, w2);
+        store_be32(p + 16, w4);
+
+        s_stats.contexts++;
+        s_stats.frames += c.frames;
+        s_stats.errors += c.error;
+        s_stats.decode_errors += c.decode_errors;
+        hash_pcm(s_stats.state_hash, c.pcm, n * OUTPUT_BLOCK);
+        hash_u32(s_stats.state_hash, i);
+        hash_u32(s_stats.state_hash, c.frames);
+        hash_u32(s_stats.state_hash, w0);
+        hash_u32(s_stats.state_hash, w2);
+        hash_u32(s_stats.state_hash, w4);
+    }
+}
+
+void xma_pump(uint64_t audio_frame)
+{
+    if (!s_base) return;
+    if (s_in_flight && xma_fence_done(s_submitted)) write_back();
+    if (audio_frame == s_last_frame) return;
+    s_last_frame = audio_frame;
+    if (s_in_flight)
+    {
+        s_stats.late++;
+        return;
+    }
+    submit_batch();
+    if (s_options.deterministic && s_in_flight)
+    {
+        xma_wait_fence(s_submitted);
+        write_back();
+    }
+}
+
+// ============================================================================
+// Contexts
+// ============================================================================
+
+bool xma_init(uint8_t* base, uint32_t context_array, const XmaOptions& options)
+{
+    if (s_base) return true;
+    s_base = base;
+    s_context_array = context_array;
+    s_options = options;
+    for (auto& c : s_contexts) c.allocated = c.in_batch = false;
+    s_in_use = s_peak = 0;
+    s_submitted = 0;
+    s_completed.store(0, std::memory_order_relaxed);
+    s_in_flight = false;
+    s_last_frame = 0;
+    s_batch_ms_total = 0;
+    s_stats = XmaStats();
+    s_stats.state_hash = 0xCBF29CE484222325ull;
+
+    unsigned threads = options.threads;
+    if (!threads)
+        threads = std::min(4u, std::max(1u, std::thread::hardware_concurrency()) - 1);
+    threads = std::max(threads, 1u);
+    s_stop = false;
+    for (unsigned i = 0; i < threads; i++)
+        s_workers.emplace_back(worker_thread);
+    s_options.threads = threads;
+    printf("  XMA: %u contexts at 0x%08X, %u decode worker%s%s, decoder: %s\n", XMA_MAX_CONTEXTS,
+           context_array, threads, threads == 1 ? "" : "s", options.deterministic ? ", deterministic" : "",
+           options.decoder ? options.decoder->name() : "none (frames are silence)");
+    return true;
+}
+
+void xma_shutdown()
+{
+    if (!s_base) return;
+    if (s_in_flight)
+    {
+        xma_wait_fence(s_submitted);
+        write_back();
+    }
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_stop = true;
+    }
+    s_work_cv.notify_all();
+    for (auto& t : s_workers) t.join();
+    s_workers.clear();
+    xma_print_stats();
+    s_base = nullptr;
+}
+
+uint32_t xma_create_context()
+{
+    if (!s_base) return 0;
+    for (uint32_t i = 0; i < XMA_MAX_CONTEXTS; i++)
+    {
+        // A context released while its batch runs is reused once the
+        // batch is written back, so the decoder never sees two streams
+        XmaContext& c = s_contexts[i];
+        if (c.allocated || c.in_batch) continue;
+        c.allocated = true;
+        c.address = s_context_array + i * XMA_CONTEXT_SIZE;
+        memset(s_base + c.address, 0, XMA_CONTEXT_SIZE);
+        if (s_options.decoder) s_options.decoder->reset(i);
+        if (++s_in_use > s_peak) s_peak = s_in_use;
+        return c.address;
+    }
+    s_stats.refused++;
+    return 0;
+}
+
+void xma_release_context(uint32_t context)
+{
+    uint32_t i = (context - s_context_array) / XMA_CONTEXT_SIZE;
+    if (!s_base || context < s_context_array || i >= XMA_MAX_CONTEXTS || !s_contexts[i].allocated) return;
+    s_contexts[i].allocated = false;
+    s_in_use--;
+}
+
+XmaStats xma_stats()
+{
+    return s_stats;
+}
+
+void xma_print_stats()
+{
+    fprintf(stderr, "[XMA] %llu batches (%llu late), %llu context decodes, %llu frames, %llu errors, "
+                    "%llu decode errors\n",
+            (unsigned long long)s_stats.batches, (unsigned long long)s_stats.late,
+            (unsigned long long)s_stats.contexts, (unsigned long long)s_stats.frames,
+            (unsigned long long)s_stats.errors, (unsigned long long)s_stats.decode_errors);
+    fprintf(stderr, "[XMA]   contexts: %u in use, peak %u, %llu refused\n", s_in_use, s_peak,
+            (unsigned long long)s_stats.refused);
+    if (s_stats.batches)
+    {
+        fprintf(stderr, "[XMA]   batch submit -> fence  mean %.3f ms  max %.3f ms  (%u workers)\n",
+                s_stats.batch_ms_mean, s_stats.batch_ms_max, s_options.threads);
+    }
+}
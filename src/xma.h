@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+
+// XMA decoder contexts. XMACreateContext hands out 64-byte hardware
+// context structs from a fixed guest array; the game fills them in with
+// its own inline code (input buffers, output ring, valid bits). The
+// legacy runtime has no MMIO, so there is no kick register to watch:
+// instead, once per audio frame, xma_pump() collects every context whose
+// fields say it has work (an input buffer valid, the output buffer valid
+// with room for a frame) into a batch. A worker pool decodes the batch in
+// parallel, each context into its own host PCM buffer. Once the batch's
+// fence has passed, the PCM is copied into the guest output rings and the
+// hardware-owned fields (read offset, current buffer, input valid bits,
+// write offset) are written back, on the main thread between guest
+// instructions.
+//
+// The workers walk the XMA packet and frame structure as the hardware does
+// (packet headers and skip counts, 15-bit frame lengths, padding, buffer
+// switches) and hand each whole frame's payload to the XmaFrameDecoder in
+// XmaOptions. That decoder turns the WMA Pro-based payload into samples.
+// The runtime has none yet, and without one every frame comes out as 512
+// samples of silence per channel. Loop points and subframe decode counts
+// are ignored.
+
+static constexpr uint32_t XMA_MAX_CONTEXTS  = 320;
+static constexpr uint32_t XMA_CONTEXT_SIZE  = 64;
+static constexpr uint32_t XMA_PACKET_SIZE   = 2048;
+static constexpr uint32_t XMA_FRAME_SAMPLES = 512;
+
+// One frame as the workers hand it to the decoder: the payload after the
+// 15-bit length, packet headers removed, MSB first and zero-padded to a
+// whole byte.
+struct XmaFrame
+{
+    uint32_t       context;    // 0 .. XMA_MAX_CONTEXTS - 1
+    const uint8_t* payload;
+    uint32_t       bits;
+    uint32_t       channels;   // 1 or 2
+};
+
+// The decoder seam. Frames of one context arrive in stream order and never
+// two at once, but different contexts are decoded on different workers at
+// the same time, so per-stream state must be kept per context.
+struct XmaFrameDecoder
+{
+    virtual ~XmaFrameDecoder() = default;
+    virtual const char* name() const = 0;
+
+    // `context` now holds a new stream: drop what was kept for the old one.
+    // Called from xma_create_context(), never while the context is in a
+    // running batch.
+    virtual void reset(uint32_t context) = 0;
+
+    // Decode one frame into XMA_FRAME_SAMPLES * channels interleaved
+    // samples. False if the frame can't be decoded; it is then silence and
+    // counted in XmaStats::decode_errors. Called on the workers.
+    virtual bool decode(const XmaFrame& frame, int16_t* pcm) = 0;
+};
+
+struct XmaOptions
+{
+    unsigned threads = 0;         // decode workers; 0 = hardware threads - 1, at most 4
+    bool deterministic = false;   // finish each batch inside xma_pump(), so results
+                                  // land at the same guest point whatever the timing
+    XmaFrameDecoder* decoder = nullptr;   // null: frames decode to silence
+};
+
+// Start the worker pool. `context_array` is the guest address of the
+// XMA_MAX_CONTEXTS * XMA_CONTEXT_SIZE bytes the contexts are handed out from.
+bool xma_init(uint8_t* base, uint32_t context_array, const XmaOptions& options = {});
+
+// Stop the workers and print the statistics. Safe to call more than once.
+void xma_shutdown();
+
+// Allocate a zeroed context; returns its guest address, or 0 when all are taken.
+uint32_t xma_create_context();
+void xma_release_context(uint32_t context);
+
+// Called from the main thread at every yield. Writes back a finished batch
+// (one atomic load when there is none) and, the first time it sees a new
+// `audio_frame`, submits the next batch. A batch still running when the
+// next frame comes is counted as late and that frame gets no new batch.
+void xma_pump(uint64_t audio_frame);
+
+// Completion fences: every batch gets the next sequence number, and a
+// fence has passed once every context in its batch is decoded.
+uint64_t xma_fence_submitted();
+bool xma_fence_done(uint64_t fence);
+void xma_wait_fence(uint64_t fence);   // helps decode while waiting
+
+struct XmaStats
+{
+    uint64_t batches = 0;
+    uint64_t contexts = 0;        // context decodes over all batches
+    uint64_t frames = 0;          // XMA frames decoded
+    uint64_t late = 0;            // audio frames that found the previous batch still running
+    uint64_t errors = 0;          // corrupt frame lengths
+    uint64_t decode_errors = 0;   // frames the decoder refused
+    uint64_t refused = 0;         // xma_create_context() calls with every context taken
+    double   batch_ms_mean = 0;   // submit -> fence, per batch
+    double   batch_ms_max = 0;
+    uint64_t state_hash = 0;      // over every written-back context state and its PCM,
+                                  // in batch order
+};
+
+XmaStats xma_stats();
+void xma_print_stats();
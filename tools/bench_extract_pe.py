@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+"""
+Benchmark the native XEX2 extractor against tools/extract_pe.py.
+
+Runs both extractors on the same XEX (the retail default.xex by default),
+checks the images are byte-identical and reports the best and median wall
+time of each, plus the native tool with the portable AES code and with a
+single thread to show where the time goes. Both are timed as whole
+processes, the way the build pipeline runs them.
+
+Without the retail XEX, pass --synthetic to benchmark a generated one
+(tools/make_test_xex.py, basic compression so the Python tool can read it).
+
+Usage: python bench_extract_pe.py [input.xex] [--native PATH] [--runs N]
+                                  [--synthetic]
+"""
+
+import argparse
+import os
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+TOOLS_DIR = os.path.dirname(os.path.abspath(__file__))
+DEFAULT_XEX = os.path.join(TOOLS_DIR, '..', 'extracted', 'default.xex')
+DEFAULT_NATIVE = os.path.join(TOOLS_DIR, 'extract_pe.exe' if os.name == 'nt' else 'extract_pe')
+
+
+def time_runs(cmd, runs):
+    times = []
+    for _ in range(runs):
+        start = time.perf_counter()
+        result = subprocess.run(cmd, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+        times.append(time.perf_counter() - start)
+        if result.returncode != 0:
+            print(f"ERROR: {' '.join(cmd)} failed:\n{result.stderr.decode(errors='replace')}")
+            sys.exit(1)
+    return times
+
+
+def read(path):
+    with open(path, 'rb') as f:
+        return f.read()
+
+
+def main():
+    ap = argparse.ArgumentParser(description='Native vs Python XEX2 extraction benchmark')
+    ap.add_argument('xex', nargs='?', default=DEFAULT_XEX)
+    ap.add_argument('--native', default=DEFAULT_NATIVE, help='path to the built extract_pe')
+    ap.add_argument('--runs', type=int, default=5)
+    ap.add_argument('--synthetic', action='store_true', help='generate a test XEX instead')
+    args = ap.parse_args()
+
+    if not os.path.exists(args.native):
+        print(f"ERROR: {args.native} not found. Build it first (see tools/extract_pe.cpp).")
+        return 1
+
+    with tempfile.TemporaryDirectory() as tmp:
+        xex = args.xex
+        if args.synthetic:
+            xex = os.path.join(tmp, 'synthetic.xex')
+            subprocess.run([sys.executable, os.path.join(TOOLS_DIR, 'make_test_xex.py'), xex,
+                            '--compression', 'basic'], check=True, stdout=subprocess.DEVNULL)
+        elif not os.path.exists(xex):
+            print(f"ERROR: {xex} not found (use --synthetic without the retail XEX)")
+            return 1
+
+        py_out = os.path.join(tmp, 'python.bin')
+        native_out = os.path.join(tmp, 'native.bin')
+        configs = [
+            ('python', [sys.executable, os.path.join(TOOLS_DIR, 'extract_pe.py'), xex, py_out]),
+            ('native', [args.native, xex, native_out, '--quiet']),
+            ('native, portable AES', [args.native, xex, native_out, '--quiet', '--no-aesni']),
+            ('native, 1 thread', [args.native, xex, native_out, '--quiet', '--threads', '1']),
+        ]
+
+        print(f"{xex}: {os.path.getsize(xex)} bytes, {args.runs} runs each")
+        results = {}
+        for name, cmd in configs:
+            times = time_runs(cmd, args.runs)
+            results[name] = times
+            print(f"  {name:22s} best {min(times) * 1000:8.1f} ms  median {statistics.median(times) * 1000:8.1f} ms")
+
+        if read(py_out) != read(native_out):
+            print("MISMATCH: native image differs from extract_pe.py")
+            return 1
+        speedup = min(results['python']) / min(results['native'])
+        print(f"  images identical ({os.path.getsize(native_out)} bytes), native {speedup:.1f}x faster")
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
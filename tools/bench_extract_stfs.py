@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+"""
+Compare the native STFS extractor with tools/extract_stfs.py.
+
+Extracts the same package with both, checks the output trees are identical
+(same paths, same bytes) and reports the wall time of each, plus the native
+tool with portable SHA-1, on one thread, and without verification. Without
+a package argument it builds one with tools/make_test_stfs.py.
+
+Usage: python bench_extract_stfs.py [package] [--native PATH] [--runs N]
+                                    [--size-mb N] [--copies 1|2]
+"""
+
+import argparse
+import filecmp
+import os
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+TOOLS_DIR = os.path.dirname(os.path.abspath(__file__))
+DEFAULT_NATIVE = os.path.join(TOOLS_DIR, 'extract_stfs')
+
+
+def run(cmd, out_dir):
+    shutil.rmtree(out_dir, ignore_errors=True)
+    start = time.perf_counter()
+    result = subprocess.run(cmd, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+    elapsed = time.perf_counter() - start
+    if result.returncode != 0:
+        print(f"ERROR: {' '.join(cmd)} exited with {result.returncode}:\n"
+              f"{result.stderr.decode(errors='replace')}")
+        sys.exit(1)
+    return elapsed
+
+
+def tree_diff(a, b):
+    """Paths that differ between two directory trees (empty if identical)."""
+    cmp = filecmp.dircmp(a, b)
+    diffs = [os.path.join(a, p) for p in cmp.left_only + cmp.right_only]
+    _, mismatch, errors = filecmp.cmpfiles(a, b, cmp.common_files, shallow=False)
+    diffs += [os.path.join(a, p) for p in mismatch + errors]
+    for sub in cmp.common_dirs:
+        diffs += tree_diff(os.path.join(a, sub), os.path.join(b, sub))
+    return diffs
+
+
+def main():
+    ap = argparse.ArgumentParser(description='Native vs Python STFS extraction')
+    ap.add_argument('package', nargs='?')
+    ap.add_argument('--native', default=DEFAULT_NATIVE, help='path to the built extract_stfs')
+    ap.add_argument('--runs', type=int, default=3)
+    ap.add_argument('--size-mb', type=int, default=64)
+    ap.add_argument('--copies', type=int, choices=[1, 2], default=1)
+    args = ap.parse_args()
+
+    if not os.path.exists(args.native):
+        print(f"ERROR: {args.native} not found. Build it first (see tools/extract_stfs.cpp).")
+        return 1
+
+    with tempfile.TemporaryDirectory() as tmp:
+        package = args.package
+        if not package:
+            package = os.path.join(tmp, 'synthetic.live')
+            subprocess.run([sys.executable, os.path.join(TOOLS_DIR, 'make_test_stfs.py'), package,
+                            '--size-mb', str(args.size_mb), '--copies', str(args.copies)],
+                           check=True, stdout=subprocess.DEVNULL)
+        package = os.path.abspath(package)
+
+        py_dir = os.path.join(tmp, 'python')
+        native_dir = os.path.join(tmp, 'native')
+        configs = [
+            ('python', [sys.executable, os.path.join(TOOLS_DIR, 'extract_stfs.py'), package, py_dir], py_dir),
+            ('native', [args.native, package, native_dir], native_dir),
+            ('native, portable SHA-1', [args.native, package, native_dir, '--no-simd'], native_dir),
+            ('native, 1 thread', [args.native, package, native_dir, '--threads', '1'], native_dir),
+            ('native, no verify', [args.native, package, native_dir, '--no-verify'], native_dir),
+        ]
+
+        print(f"{package}: {os.path.getsize(package)} bytes, {args.runs} runs each")
+        best = {}
+        for name, cmd, out_dir in configs:
+            times = [run(cmd, out_dir) for _ in range(args.runs)]
+            best[name] = min(times)
+            print(f"  {name:24s} best {min(times) * 1000:8.1f} ms  median {statistics.median(times) * 1000:8.1f} ms")
+
+        diffs = tree_diff(py_dir, native_dir)
+        if diffs:
+            print("MISMATCH:")
+            for d in diffs[:20]:
+                print(f"  {d}")
+            return 1
+        print(f"  trees identical, native {best['python'] / best['native']:.1f}x faster")
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+"""
+Regression run for the native ABI helper finder, with timings against
+tools/find_abi_addrs.py.
+
+Builds synthetic images with tools/make_test_abi.py (CRT and scattered
+layouts, with and without setjmp/longjmp, PE headers and decoys, several
+seeds) and checks the native tool's [main] block against
+the generator's expected one, then that the SIMD and scalar scans agree.
+Any difference fails the run. The Python tool is run on the same images
+for comparison: its VMX128 check only counts 32+ addi/opcode-4 pairs, so
+it can take a cut-short decoy for __savevmx_64/__restvmx_64.
+
+Usage: python bench_find_abi_addrs.py [--native PATH] [--seeds N] [--no-python]
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+TOOLS_DIR = os.path.dirname(os.path.abspath(__file__))
+DEFAULT_NATIVE = os.path.join(TOOLS_DIR, 'find_abi_addrs.exe' if os.name == 'nt' else 'find_abi_addrs')
+
+FIXTURES = [
+    ('crt, no decoys', ['--decoys', '0']),
+    ('crt', []),
+    ('random', ['--layout', 'random']),
+    ('crt+setjmp', ['--setjmp']),
+    ('random+setjmp, no PE', ['--layout', 'random', '--setjmp', '--no-pe']),
+    ('crt, many decoys', ['--decoys', '400']),
+]
+
+
+def main_block(output):
+    """The key lines of the first TOML block"""
+    lines = []
+    for line in output.splitlines():
+        if line.startswith('[') or (lines and not line.strip()):
+            break
+        if '_address' in line:
+            lines.append(line.strip())
+    return lines
+
+
+def run(cmd):
+    start = time.perf_counter()
+    result = subprocess.run(cmd, capture_output=True, text=True)
+    return result, time.perf_counter() - start
+
+
+def main():
+    ap = argparse.ArgumentParser(description='Native ABI helper finder regression and timing')
+    ap.add_argument('--native', default=DEFAULT_NATIVE, help='path to the built find_abi_addrs')
+    ap.add_argument('--seeds', type=int, default=3)
+    ap.add_argument('--no-python', action='store_true', help='skip the Python tool')
+    args = ap.parse_args()
+
+    if not os.path.exists(args.native):
+        print(f"ERROR: {args.native} not found. Build it first (see tools/find_abi_addrs.cpp).")
+        return 1
+
+    failures = 0
+    native_times, python_times = [], []
+    with tempfile.TemporaryDirectory() as tmp:
+        image = os.path.join(tmp, 'image.bin')
+        expect = os.path.join(tmp, 'expect.toml')
+        for name, extra in FIXTURES:
+            for seed in range(1, args.seeds + 1):
+                subprocess.run([sys.executable, os.path.join(TOOLS_DIR, 'make_test_abi.py'), image,
+                                '--expect', expect, '--seed', str(seed)] + extra,
+                               check=True, stdout=subprocess.DEVNULL)
+                with open(expect) as f:
+                    expected = [line.strip() for line in f if line.strip()]
+
+                native, t = run([args.native, image, '--quiet'])
+                native_times.append(t)
+                scalar, _ = run([args.native, image, '--quiet', '--no-simd'])
+                got = main_block(native.stdout)
+                status = 'ok'
+                if native.returncode != 0 or got != expected:
+                    status = 'FAIL'
+                elif main_block(scalar.stdout) != got:
+                    status = 'FAIL (scalar scan differs)'
+
+                py_status = ''
+                if not args.no_python:
+                    py, t = run([sys.executable, os.path.join(TOOLS_DIR, 'find_abi_addrs.py'), image])
+                    python_times.append(t)
+                    py_status = 'python agrees' if main_block(py.stdout.split('-' * 50)[-2]) == expected \
+                        else 'python differs'
+                print(f"  {name:24s} seed {seed}: {status:6s} {py_status}")
+                if status != 'ok':
+                    failures += 1
+                    for line in sorted(set(expected) ^ set(got)):
+                        print(f"      {'expected' if line in expected else 'got     '} {line}")
+
+    print(f"native: median {sorted(native_times)[len(native_times) // 2] * 1000:.1f} ms per image")
+    if python_times:
+        print(f"python: median {sorted(python_times)[len(python_times) // 2] * 1000:.1f} ms per image")
+    print(f"{failures} failures" if failures else "all fixtures pass")
+    return 1 if failures else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
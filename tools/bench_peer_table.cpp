@@ -0,0 +1,151 @@
+// Microbenchmark for the vig8 peer table (project/src/peer_table.h).
+// Compares lock-free lookups against the old vector + shared_mutex linear
+// scan with 1,000 synthetic peers, idle and with a concurrent writer
+// refreshing peers the way the discovery thread does.
+// Compile: g++ -O2 -std=c++20 -pthread -I project/src tools/bench_peer_table.cpp -o bench_peer_table
+// Usage: bench_peer_table [num_peers] [lookups]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+#include "peer_table.h"
+
+using Clock = std::chrono::steady_clock;
+
+// The previous implementation, kept here as the baseline.
+struct LinearPeers {
+    std::vector<PeerInfo>     peers;
+    mutable std::shared_mutex mutex;
+
+    bool Find(uint32_t ip_net, PeerInfo* out) const {
+        std::shared_lock lock(mutex);
+        for (auto& p : peers) {
+            if (p.xnaddr.ina == ip_net) { *out = p; return true; }
+        }
+        return false;
+    }
+    void Upsert(const XNADDR_LAN& addr, const uint8_t* xnkid) {
+        std::unique_lock lock(mutex);
+        for (auto& p : peers) {
+            if (p.xnaddr.ina == addr.ina) {
+                p.xnaddr = addr;
+                std::memcpy(p.xnkid, xnkid, 8);
+                return;
+            }
+        }
+        PeerInfo info = {};
+        info.xnaddr = addr;
+        std::memcpy(info.xnkid, xnkid, 8);
+        peers.push_back(info);
+    }
+};
+
+static uint32_t PeerIP(int i) {
+    // 10.x.y.z in network byte order
+    uint32_t host = 0x0A000000u | (uint32_t)(i + 2);
+    return ((host & 0xFF) << 24) | ((host & 0xFF00) << 8) |
+           ((host >> 8) & 0xFF00) | (host >> 24);
+}
+
+static XNADDR_LAN PeerAddr(int i) {
+    XNADDR_LAN a = {};
+    a.ina = PeerIP(i);
+    a.inaOnline = a.ina;
+    a.abEnet[1] = 0x50;
+    return a;
+}
+
+template <typename Table>
+static double RunLookups(const Table& table, int num_peers, long lookups) {
+    // Mix of hits (90%) and misses, like the game translating both known
+    // and freshly seen addresses.
+    uint32_t rng = 12345;
+    uint64_t found = 0;
+    PeerInfo info;
+    auto t0 = Clock::now();
+    for (long n = 0; n < lookups; n++) {
+        rng = rng * 1664525u + 1013904223u;
+        int idx = (int)((rng >> 8) % (uint32_t)(num_peers + num_peers / 9));
+        found += table.Find(PeerIP(idx), &info);
+    }
+    auto t1 = Clock::now();
+    if (found == 0) fprintf(stderr, "no hits?\n");
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / lookups;
+}
+
+template <typename Writer>
+static void WithWriter(Writer write_one, int num_peers, std::atomic<bool>& stop) {
+    uint8_t kid[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    int i = 0;
+    while (!stop.load(std::memory_order_relaxed)) {
+        XNADDR_LAN a = PeerAddr(i);
+        kid[0] = (uint8_t)i;  // change the payload so readers must retry
+        write_one(a, kid);
+        i = (i + 1) % num_peers;
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int  num_peers = argc > 1 ? atoi(argv[1]) : 1000;
+    long lookups   = argc > 2 ? atol(argv[2]) : 2000000;
+    if (num_peers <= 0 || num_peers > (int)PeerTable::kMaxPeers) {
+        fprintf(stderr, "num_peers must be 1..%u\n", PeerTable::kMaxPeers);
+        return 1;
+    }
+
+    static PeerTable table;
+    LinearPeers linear;
+    uint8_t kid[8] = {};
+    for (int i = 0; i < num_peers; i++) {
+        table.Upsert(PeerAddr(i), kid, 0);
+        linear.Upsert(PeerAddr(i), kid);
+    }
+    printf("%d peers, %ld lookups per run\n\n", num_peers, lookups);
+
+    printf("idle:\n");
+    printf("  linear+shared_mutex  %8.1f ns/lookup\n", RunLookups(linear, num_peers, lookups));
+    printf("  hash+seqlock         %8.1f ns/lookup\n", RunLookups(table, num_peers, lookups));
+
+    printf("with concurrent writer:\n");
+    {
+        std::atomic<bool> stop{false};
+        std::thread w([&] {
+            WithWriter([&](const XNADDR_LAN& a, const uint8_t* k) { linear.Upsert(a, k); },
+                       num_peers, stop);
+        });
+        printf("  linear+shared_mutex  %8.1f ns/lookup\n", RunLookups(linear, num_peers, lookups));
+        stop = true;
+        w.join();
+    }
+    {
+        std::atomic<bool> stop{false};
+        std::thread w([&] {
+            WithWriter([&](const XNADDR_LAN& a, const uint8_t* k) { table.Upsert(a, k, 0); },
+                       num_peers, stop);
+        });
+        printf("  hash+seqlock         %8.1f ns/lookup\n", RunLookups(table, num_peers, lookups));
+        stop = true;
+        w.join();
+    }
+
+    // Expiry: everyone but the first 10 goes quiet; those 10 get connected
+    // and must survive regardless of age.
+    for (int i = 0; i < 10; i++) table.MarkConnected(PeerIP(i), 0);
+    auto t0 = Clock::now();
+    size_t removed = table.ExpireIdle(60000, 30000);
+    auto t1 = Clock::now();
+    PeerInfo info;
+    bool ok = table.Size() == 10 && removed == (size_t)num_peers - 10;
+    for (int i = 0; i < num_peers; i++) ok &= table.Find(PeerIP(i), &info) == (i < 10);
+    printf("\nexpire: removed %zu in %.1f us, %zu left, lookups %s\n", removed,
+           std::chrono::duration<double, std::micro>(t1 - t0).count(), table.Size(),
+           ok ? "consistent" : "INCONSISTENT");
+    return ok ? 0 : 1;
+}
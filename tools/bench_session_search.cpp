@@ -0,0 +1,140 @@
+// Microbenchmark for XGISessionSearch's session cache
+// (project/src/session_cache.h). Fills the cache the way a busy relay
+// would — thousands of relay sessions plus a few LAN hosts, random slot
+// counts — then times ranked queries with the game's usual result counts
+// and checks the ranking: LAN first, RTT band ascending, full lobbies
+// never returned. Half the LAN hosts advertise a game-mode context (v3
+// beacons); a query for one mode must drop the hosts in the other and put
+// the one sharing its property first.
+// Compile: g++ -O2 -std=c++20 -pthread -I project/src -I ../xlive/client tools/bench_session_search.cpp -o bench_session_search
+// Usage: bench_session_search [num_sessions] [queries]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "session_cache.h"
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr int LAN_HOSTS = 8;
+static constexpr uint32_t GAME_MODE = 0x0000800B;   // X_CONTEXT_GAME_MODE
+static constexpr uint32_t TRACK     = 0x10000001;
+
+static uint32_t HostIP(int i) {
+    // 10.x.y.z in network byte order
+    uint32_t host = 0x0A000000u | (uint32_t)(i + 2);
+    return ((host & 0xFF) << 24) | ((host & 0xFF00) << 8) |
+           ((host >> 8) & 0xFF00) | (host >> 24);
+}
+
+static XNADDR_LAN HostAddr(int i) {
+    XNADDR_LAN a = {};
+    a.ina = HostIP(i);
+    a.inaOnline = a.ina;
+    return a;
+}
+
+static void MakeKid(int i, uint8_t* kid) {
+    std::memset(kid, 0, 8);
+    std::memcpy(kid, &i, sizeof(i));
+    kid[7] = 0xA5;
+}
+
+// Stand-in for NetTelemetryRttUs: a fixed pseudo-random RTT per host, with
+// every tenth host never measured.
+static uint32_t FakeRttUs(uint32_t ina) {
+    uint32_t h = ina * 2654435761u;
+    return (h % 10 == 0) ? 0 : 5000 + h % 150000;
+}
+
+int main(int argc, char** argv) {
+    int num_sessions = argc > 1 ? std::atoi(argv[1]) : 4000;
+    int queries      = argc > 2 ? std::atoi(argv[2]) : 2000;
+
+    std::mt19937 rng(1234);
+    std::vector<xlive::Session> relay(num_sessions);
+    for (int i = 0; i < num_sessions; i++) {
+        xlive::Session& s = relay[i];
+        std::memset(&s, 0, sizeof(s));
+        MakeKid(i, s.xnkid);
+        XNADDR_LAN a = HostAddr(i);
+        std::memcpy(s.host_xnaddr, &a, sizeof(a));
+        s.max_players = 4;
+        s.current_players = (uint8_t)(1 + rng() % 4);   // a quarter are full
+    }
+
+    SessionCache cache;
+    auto t0 = Clock::now();
+    cache.ApplySnapshot(relay.data(), num_sessions, 0);
+    // Hosts 0-3 send v2 beacons; 4-7 advertise mode 1 or 2, and host 7
+    // the track property too
+    for (int i = 0; i < LAN_HOSTS; i++) {
+        uint8_t kid[8];
+        MakeKid(num_sessions + i, kid);
+        SessionTerms terms;
+        if (i >= LAN_HOSTS / 2) {
+            terms.contexts.emplace_back(GAME_MODE, i % 2 ? 1u : 2u);
+            if (i == LAN_HOSTS - 1) terms.properties.push_back({TRACK, 1, 7});
+        }
+        cache.NoteLanHost(kid, HostAddr(num_sessions + i), 0, 1, 4,
+                          i >= LAN_HOSTS / 2 ? &terms : nullptr);
+    }
+    double fill_ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    printf("cache: %zu sessions, snapshot applied in %.2f ms\n", cache.Size(), fill_ms);
+
+    for (size_t max : {8, 50, 500}) {
+        SessionQuery q;
+        q.max = max;
+        std::vector<CachedSession> out;
+        auto start = Clock::now();
+        for (int i = 0; i < queries; i++) out = cache.Query(q, FakeRttUs);
+        double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / queries;
+
+        // Verify the ranking of the last answer.
+        bool ok = !out.empty() && out.size() <= max;
+        uint32_t last_band = 0;
+        bool seen_relay = false;
+        for (auto& s : out) {
+            XNADDR_LAN host;
+            std::memcpy(&host, s.host_xnaddr, sizeof(host));
+            uint32_t rtt = FakeRttUs(host.ina);
+            uint32_t band = rtt ? rtt / SessionCache::RTT_BAND_US : UINT32_MAX;
+            if (s.current_players >= s.max_players) ok = false;
+            if (s.source == CachedSession::Source::Lan) {
+                if (seen_relay) ok = false;
+                continue;
+            }
+            if (!seen_relay) last_band = band;
+            seen_relay = true;
+            if (band < last_band) ok = false;
+            last_band = band;
+        }
+        printf("max=%-4zu returned=%-4zu %8.1f us/query  ranking %s\n",
+               max, out.size(), us, ok ? "ok" : "WRONG");
+        if (!ok) return 1;
+    }
+
+    // Mode 1 with track 7: hosts 5 and 7 (7 first), then the v2 hosts 0-3
+    SessionQuery q;
+    q.max = 50;
+    q.terms.contexts.emplace_back(GAME_MODE, 1u);
+    q.terms.properties.push_back({TRACK, 1, 7});
+    auto out = cache.Query(q, FakeRttUs);
+    std::vector<int> lan;
+    for (auto& s : out) {
+        if (s.source != CachedSession::Source::Lan) continue;
+        int i;
+        std::memcpy(&i, s.xnkid, sizeof(i));
+        lan.push_back(i - num_sessions);
+    }
+    bool ok = lan.size() == 6 && lan[0] == 7 && out.size() == q.max &&
+              std::find(lan.begin(), lan.end(), 4) == lan.end() &&
+              std::find(lan.begin(), lan.end(), 6) == lan.end();
+    printf("terms: %zu LAN hosts for mode 1, matching property first: %s\n",
+           lan.size(), ok ? "ok" : "WRONG");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,482 @@
+// Standalone benchmark for the legacy runtime's XMA context manager and
+// decode worker pool (src/xma.cpp).
+//
+// Finds XMA streams in a corpus (RIFF/WAVE files with an XMA or XMA2 fmt
+// chunk, little- or big-endian, standalone or packed inside bundles such
+// as sounds.ib), maps them into a scratch guest memory and plays them
+// through --contexts simultaneous contexts the way a game would: input
+// buffers of --chunk packets are refilled as the decoder hands them back,
+// and the output rings are drained every audio frame. Each audio frame
+// pumps one decode batch.
+//
+// The runtime has no WMA Pro decoder, so by default the bench plugs a
+// stand-in into the XmaFrameDecoder seam that does a transform decoder's
+// work per frame: 512 signed Exp-Golomb coefficients per channel read bit
+// by bit from the payload (wrapping around it), a 1024-point IMDCT through
+// a 256-point complex FFT, and a sine-windowed overlap-add with the
+// context's previous frame. Its samples mean nothing, but its cost has the
+// shape of real decoding. --decoder none measures the framing alone.
+//
+// The corpus is played once with one worker and once with --threads
+// workers, both in deterministic mode; the context state and PCM written
+// back after every batch are hashed, and the two runs must agree. With
+// --expect (from tools/make_test_xma.py) the decoded frame counts are
+// checked, and with the stand-in decoder the CRC-32 of the payloads each
+// context was handed too. Exits with 2 when a check fails.
+//
+// Compile: g++ -O2 -std=c++20 -I src tools/bench_xma_decode.cpp src/xma.cpp -o bench_xma_decode -pthread
+// Usage: bench_xma_decode [corpus_dir_or_file ...] [--contexts N] [--threads N] [--chunk PACKETS]
+//                         [--decoder transform|none] [--expect FILE]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "xma.h"
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr uint32_t CONTEXT_ARRAY = 0x10000;
+static constexpr uint32_t OUTPUT_BLOCKS = 31;
+static constexpr uint32_t OUTPUT_SIZE = OUTPUT_BLOCKS * 256;
+
+struct Stream {
+    size_t   file;          // index into the loaded files
+    size_t   offset;        // of the data chunk in the file
+    uint32_t packets;
+    uint32_t channels;
+    uint32_t guest = 0;     // address of the packets in scratch memory
+};
+
+// ============================================================================
+// Stand-in decoder
+// ============================================================================
+
+static constexpr uint32_t COEFFS = XMA_FRAME_SAMPLES;   // per channel and frame
+static constexpr uint32_t FFT_SIZE = COEFFS / 2;
+static constexpr float PI = 3.14159265358979f;
+
+using Complex = std::complex<float>;
+
+struct TransformTables {
+    Complex  twiddle[FFT_SIZE / 2];
+    Complex  pre[FFT_SIZE];
+    Complex  post[FFT_SIZE];
+    uint32_t reverse[FFT_SIZE];
+    float    window[COEFFS * 2];
+
+    TransformTables() {
+        for (uint32_t k = 0; k < FFT_SIZE / 2; k++) twiddle[k] = std::polar(1.0f, -2 * PI * k / FFT_SIZE);
+        for (uint32_t k = 0; k < FFT_SIZE; k++) {
+            pre[k] = std::polar(1.0f, -PI * k / COEFFS);
+            post[k] = std::polar(1.0f, -PI * (k + 0.25f) / COEFFS);
+            uint32_t r = 0;
+            for (uint32_t b = 1; b < FFT_SIZE; b <<= 1) r = (r << 1) | ((k & b) != 0);
+            reverse[k] = r;
+        }
+        for (uint32_t n = 0; n < COEFFS * 2; n++) window[n] = std::sin(PI * (n + 0.5f) / (COEFFS * 2));
+    }
+};
+static const TransformTables s_tables;
+
+static void fft(Complex* a) {
+    for (uint32_t i = 0; i < FFT_SIZE; i++) {
+        if (i < s_tables.reverse[i]) std::swap(a[i], a[s_tables.reverse[i]]);
+    }
+    for (uint32_t len = 2; len <= FFT_SIZE; len <<= 1) {
+        uint32_t step = FFT_SIZE / len;
+        for (uint32_t i = 0; i < FFT_SIZE; i += len) {
+            for (uint32_t j = 0; j < len / 2; j++) {
+                Complex u = a[i + j], v = a[i + j + len / 2] * s_tables.twiddle[j * step];
+                a[i + j] = u + v;
+                a[i + j + len / 2] = u - v;
+            }
+        }
+    }
+}
+
+// DCT-IV of COEFFS values through a FFT_SIZE-point complex FFT
+static void dct4(const float* x, float* y) {
+    Complex z[FFT_SIZE];
+    for (uint32_t k = 0; k < FFT_SIZE; k++) z[k] = Complex(x[2 * k], x[COEFFS - 1 - 2 * k]) * s_tables.pre[k];
+    fft(z);
+    for (uint32_t n = 0; n < FFT_SIZE; n++) {
+        Complex u = z[n] * s_tables.post[n];
+        y[2 * n] = u.real();
+        y[COEFFS - 1 - 2 * n] = -u.imag();
+    }
+}
+
+static uint32_t crc32(uint32_t crc, const uint8_t* p, size_t n) {
+    static const auto table = [] {
+        std::vector<uint32_t> t(256);
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = (c >> 1) ^ (0xEDB88320u & (0u - (c & 1)));
+            t[i] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    while (n--) crc = table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+// Payload bits, MSB first, starting over at the end
+struct BitReader {
+    const uint8_t* p;
+    uint32_t       bits;
+    uint32_t       pos = 0;
+
+    uint32_t bit() {
+        if (pos >= bits) pos = 0;
+        uint32_t b = (p[pos >> 3] >> (7 - (pos & 7))) & 1;
+        pos++;
+        return b;
+    }
+    int32_t signed_golomb() {
+        uint32_t zeros = 0;
+        while (zeros < 12 && !bit()) zeros++;
+        uint32_t v = 1;
+        for (uint32_t i = 0; i < zeros; i++) v = (v << 1) | bit();
+        v -= 1;
+        return (v & 1) ? (int32_t)(v + 1) / 2 : -(int32_t)(v / 2);
+    }
+};
+
+struct TransformDecoder : XmaFrameDecoder {
+    float    overlap[XMA_MAX_CONTEXTS][2][COEFFS];
+    uint32_t payload_crc[XMA_MAX_CONTEXTS];
+
+    const char* name() const override { return "bench transform stand-in"; }
+
+    void reset(uint32_t context) override {
+        memset(overlap[context], 0, sizeof(overlap[context]));
+        payload_crc[context] = 0;
+    }
+
+    bool decode(const XmaFrame& frame, int16_t* pcm) override {
+        payload_crc[frame.context] = crc32(payload_crc[frame.context], frame.payload, (frame.bits + 7) / 8);
+        BitReader in{frame.payload, frame.bits};
+        for (uint32_t ch = 0; ch < frame.channels; ch++) {
+            float coeffs[COEFFS], y[COEFFS];
+            for (uint32_t k = 0; k < COEFFS; k++) coeffs[k] = in.signed_golomb() * (64.0f / (k + 8));
+            dct4(coeffs, y);
+
+            // IMDCT output n is the DCT-IV at n + COEFFS/2, mirrored: the
+            // first half overlaps the previous frame, the second is kept
+            float* prev = overlap[frame.context][ch];
+            for (uint32_t n = 0; n < COEFFS * 2; n++) {
+                uint32_t m = n + COEFFS / 2;
+                float v = m < COEFFS ? y[m] : m < COEFFS * 2 ? -y[COEFFS * 2 - 1 - m] : -y[m - COEFFS * 2];
+                v *= s_tables.window[n];
+                if (n < COEFFS) {
+                    float s = std::clamp(prev[n] + v, -32768.0f, 32767.0f);
+                    pcm[n * frame.channels + ch] = (int16_t)s;
+                } else {
+                    prev[n - COEFFS] = v;
+                }
+            }
+        }
+        return true;
+    }
+};
+
+// ============================================================================
+// Corpus
+// ============================================================================
+
+static bool read_file(const std::string& path, std::vector<uint8_t>& out) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    out.resize(size > 0 ? (size_t)size : 0);
+    bool ok = fread(out.data(), 1, out.size(), f) == out.size();
+    fclose(f);
+    return ok;
+}
+
+static uint32_t load32(const uint8_t* p, bool be) {
+    return be ? ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3]
+              : ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0];
+}
+
+static uint16_t load16(const uint8_t* p, bool be) {
+    return be ? (uint16_t)((p[0] << 8) | p[1]) : (uint16_t)((p[1] << 8) | p[0]);
+}
+
+static void store_be32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24); p[1] = (uint8_t)(v >> 16); p[2] = (uint8_t)(v >> 8); p[3] = (uint8_t)v;
+}
+
+// Parse the RIFF at `pos`; returns its total size, or 0 if it is not an
+// XMA WAVE. The byte order is whichever gives a RIFF size that fits.
+static size_t parse_riff(const std::vector<uint8_t>& file, size_t pos, size_t index,
+                         std::vector<Stream>& streams) {
+    size_t avail = file.size() - pos;
+    if (avail < 12 || memcmp(&file[pos + 8], "WAVE", 4)) return 0;
+    for (bool be : {false, true}) {
+        size_t riff_size = load32(&file[pos + 4], be);
+        if (riff_size + 8 > avail || riff_size < 4) continue;
+        uint16_t tag = 0, channels = 0;
+        size_t data = 0, data_size = 0;
+        for (size_t c = pos + 12; c + 8 <= pos + 8 + riff_size;) {
+            uint32_t size = load32(&file[c + 4], be);
+            if (c + 8 + size > pos + 8 + riff_size) break;
+            if (!memcmp(&file[c], "fmt ", 4) && size >= 16) {
+                tag = load16(&file[c + 8], be);
+                channels = load16(&file[c + 10], be);
+            } else if (!memcmp(&file[c], "data", 4)) {
+                data = c + 8;
+                data_size = size;
+            }
+            c += 8 + size + (size & 1);
+        }
+        if ((tag != 0x165 && tag != 0x166) || !data || data_size < 2048) continue;
+        // Multichannel XMA is split into stereo/mono streams by the game;
+        // treat anything wider as stereo
+        streams.push_back({index, data, (uint32_t)std::min<size_t>(data_size / 2048, 0xFFF00),
+                           channels >= 2 ? 2u : 1u});
+        return riff_size + 8;
+    }
+    return 0;
+}
+
+static void scan_file(const std::string& path, std::vector<std::vector<uint8_t>>& files,
+                      std::vector<Stream>& streams) {
+    std::vector<uint8_t> data;
+    if (!read_file(path, data) || data.size() < 12) return;
+    size_t before = streams.size();
+    for (size_t pos = 0; pos + 12 <= data.size();) {
+        const uint8_t* hit = (const uint8_t*)memchr(&data[pos], 'R', data.size() - 11 - pos);
+        if (!hit) break;
+        pos = hit - data.data();
+        size_t size = memcmp(hit, "RIFF", 4) ? 0 : parse_riff(data, pos, files.size(), streams);
+        pos += size ? size : 1;
+    }
+    if (streams.size() > before) files.push_back(std::move(data));
+}
+
+struct Feed {
+    uint32_t stream;
+    uint32_t next_packet = 0;
+};
+
+// Refill free input buffers from the stream and drain the output ring.
+// Returns false once the stream is exhausted and both buffers handed back.
+static bool guest_service(uint8_t* base, uint32_t context, const Stream& s, Feed& feed, uint32_t chunk) {
+    uint8_t* p = base + context;
+    uint32_t w0 = load32(p, true), w1 = load32(p + 4, true);
+    for (int b = 0; b < 2; b++) {
+        if ((w0 >> (20 + b)) & 1 || feed.next_packet >= s.packets) continue;
+        uint32_t n = std::min(chunk, s.packets - feed.next_packet);
+        store_be32(p + 20 + b * 4, s.guest + feed.next_packet * 2048);
+        if (b == 0) w0 = (w0 & ~0xFFFu) | n;
+        else w1 = (w1 & ~0xFFFu) | n;
+        w0 |= 1u << (20 + b);
+        feed.next_packet += n;
+    }
+    store_be32(p, w0);
+    store_be32(p + 4, w1);
+    store_be32(p + 36, w0 >> 27);   // everything written so far has been played
+    return ((w0 >> 20) & 3) || feed.next_packet < s.packets;
+}
+
+struct RunResult {
+    XmaStats stats;
+    double   seconds = 0;
+    uint64_t audio_frames = 0;
+    std::vector<uint32_t> payload_crc;   // per context, with the stand-in decoder
+};
+
+static RunResult run(uint8_t* base, uint32_t output_base, const std::vector<Stream>& streams,
+                     uint32_t contexts, unsigned threads, uint32_t chunk, TransformDecoder* decoder) {
+    RunResult r;
+    XmaOptions options;
+    options.threads = threads;
+    options.deterministic = true;
+    options.decoder = decoder;
+    xma_init(base, CONTEXT_ARRAY, options);
+
+    std::vector<uint32_t> ctx(contexts);
+    std::vector<Feed> feeds(contexts);
+    for (uint32_t i = 0; i < contexts; i++) {
+        ctx[i] = xma_create_context();
+        feeds[i].stream = i % streams.size();
+        const Stream& s = streams[feeds[i].stream];
+        uint8_t* p = base + ctx[i];
+        store_be32(p, OUTPUT_BLOCKS << 22);
+        store_be32(p + 4, (1u << 31) | ((s.channels == 2) << 29) | (3u << 27));
+        store_be32(p + 28, output_base + i * OUTPUT_SIZE);
+    }
+
+    auto t0 = Clock::now();
+    bool active = true;
+    while (active && r.audio_frames < 10000000) {
+        active = false;
+        for (uint32_t i = 0; i < contexts; i++) {
+            active |= guest_service(base, ctx[i], streams[feeds[i].stream], feeds[i], chunk);
+        }
+        xma_pump(++r.audio_frames);
+    }
+    r.seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+    r.stats = xma_stats();
+    for (uint32_t i = 0; i < contexts && decoder; i++) {
+        r.payload_crc.push_back(decoder->payload_crc[(ctx[i] - CONTEXT_ARRAY) / XMA_CONTEXT_SIZE]);
+    }
+    for (uint32_t i = 0; i < contexts; i++) xma_release_context(ctx[i]);
+    xma_shutdown();
+    return r;
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> inputs;
+    uint32_t contexts = 64, chunk = 8;
+    unsigned threads = std::max(1u, std::min(8u, std::thread::hardware_concurrency()));
+    const char* expect_path = nullptr;
+    const char* decoder_name = "transform";
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--contexts") && i + 1 < argc) contexts = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc) threads = (unsigned)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--chunk") && i + 1 < argc) chunk = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--expect") && i + 1 < argc) expect_path = argv[++i];
+        else if (!strcmp(argv[i], "--decoder") && i + 1 < argc) decoder_name = argv[++i];
+        else if (!strcmp(argv[i], "--help") || !strcmp(argv[i], "-h")) {
+            printf("Usage: bench_xma_decode [corpus_dir_or_file ...] [--contexts N] [--threads N] "
+                   "[--chunk PACKETS] [--decoder transform|none] [--expect FILE]\n");
+            return 0;
+        } else inputs.push_back(argv[i]);
+    }
+    if (strcmp(decoder_name, "transform") && strcmp(decoder_name, "none")) {
+        printf("ERROR: Unknown decoder '%s' (transform or none)\n", decoder_name);
+        return 1;
+    }
+    if (inputs.empty()) inputs.push_back("extracted/data");
+    contexts = std::clamp<uint32_t>(contexts, 1, XMA_MAX_CONTEXTS);
+    chunk = std::clamp<uint32_t>(chunk, 1, 0xFFF);
+
+    auto t0 = Clock::now();
+    std::vector<std::vector<uint8_t>> files;
+    std::vector<Stream> streams;
+    for (const auto& in : inputs) {
+        std::error_code ec;
+        if (std::filesystem::is_directory(in, ec)) {
+            std::vector<std::string> paths;
+            for (const auto& e : std::filesystem::recursive_directory_iterator(in, ec)) {
+                if (e.is_regular_file()) paths.push_back(e.path().string());
+            }
+            std::sort(paths.begin(), paths.end());
+            for (const auto& p : paths) scan_file(p, files, streams);
+        } else {
+            scan_file(in, files, streams);
+        }
+    }
+    if (streams.empty()) {
+        printf("ERROR: No XMA streams found in the corpus\n");
+        return 1;
+    }
+
+    // Scratch guest memory: context array, output rings, then the packets
+    uint32_t output_base = CONTEXT_ARRAY + XMA_MAX_CONTEXTS * XMA_CONTEXT_SIZE;
+    uint64_t top = output_base + (uint64_t)contexts * OUTPUT_SIZE;
+    for (auto& s : streams) {
+        top = (top + 2047) & ~2047ull;
+        s.guest = (uint32_t)top;
+        top += (uint64_t)s.packets * 2048;
+    }
+    if (top >= 0xF0000000ull) {
+        printf("ERROR: Corpus too large for a 32-bit guest address space\n");
+        return 1;
+    }
+    std::vector<uint8_t> memory(top);
+    uint64_t packets = 0;
+    for (const auto& s : streams) {
+        memcpy(&memory[s.guest], &files[s.file][s.offset], (size_t)s.packets * 2048);
+        packets += s.packets;
+    }
+    double load_ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    printf("Corpus: %zu streams (%llu packets, %.1f MB) from %zu files, loaded in %.1f ms\n", streams.size(),
+           (unsigned long long)packets, packets * 2048 / 1048576.0, files.size(), load_ms);
+    printf("Playing through %u contexts, %u-packet input buffers, decoder: %s\n\n", contexts, chunk,
+           decoder_name);
+
+    // 1.3 MB of overlap buffers, so on the heap
+    std::unique_ptr<TransformDecoder> decoder;
+    if (!strcmp(decoder_name, "transform")) decoder = std::make_unique<TransformDecoder>();
+    RunResult single = run(memory.data(), output_base, streams, contexts, 1, chunk, decoder.get());
+    RunResult multi = run(memory.data(), output_base, streams, contexts, threads, chunk, decoder.get());
+
+    auto report = [&](const char* name, unsigned n, const RunResult& r) {
+        double audio_seconds = (double)r.stats.frames * XMA_FRAME_SAMPLES / 48000.0;
+        printf("%-8s %2u worker%s  %8.1f ms  %6llu batches  batch mean %.3f ms max %.3f ms  "
+               "%9.0f frames/s  %6.0fx realtime  hash %016llX\n",
+               name, n, n == 1 ? " " : "s", r.seconds * 1000, (unsigned long long)r.stats.batches,
+               r.stats.batch_ms_mean, r.stats.batch_ms_max, r.stats.frames / r.seconds,
+               audio_seconds / r.seconds, (unsigned long long)r.stats.state_hash);
+    };
+    report("single", 1, single);
+    report("pool", threads, multi);
+    printf("\n%llu frames decoded, %llu errors, %llu decode errors, %llu audio frames\n",
+           (unsigned long long)multi.stats.frames, (unsigned long long)multi.stats.errors,
+           (unsigned long long)multi.stats.decode_errors, (unsigned long long)multi.audio_frames);
+    printf("Speedup: %.2fx\n", single.seconds / multi.seconds);
+
+    int status = 0;
+    if (single.stats.state_hash != multi.stats.state_hash || single.stats.frames != multi.stats.frames ||
+        single.payload_crc != multi.payload_crc) {
+        printf("FAIL: runs with 1 and %u workers differ\n", threads);
+        status = 2;
+    }
+    if (expect_path) {
+        std::vector<uint8_t> text;
+        std::vector<uint64_t> expected;
+        std::vector<uint32_t> expected_crc;
+        if (!read_file(expect_path, text)) {
+            printf("ERROR: Failed to load %s\n", expect_path);
+            return 1;
+        }
+        text.push_back(0);
+        for (const char* p = (const char*)text.data(); (p = strstr(p, "frames =")) != nullptr; p += 8) {
+            expected.push_back(strtoull(p + 8, nullptr, 10));
+        }
+        for (const char* p = (const char*)text.data(); (p = strstr(p, "payload_crc =")) != nullptr; p += 13) {
+            expected_crc.push_back((uint32_t)strtoul(p + 13, nullptr, 16));
+        }
+        if (expected.size() != streams.size()) {
+            printf("FAIL: %zu streams expected, %zu found\n", expected.size(), streams.size());
+            status = 2;
+        } else {
+            uint64_t want = 0;
+            for (uint32_t i = 0; i < contexts; i++) want += expected[i % streams.size()];
+            if (want != multi.stats.frames) {
+                printf("FAIL: %llu frames expected, %llu decoded\n", (unsigned long long)want,
+                       (unsigned long long)multi.stats.frames);
+                status = 2;
+            } else {
+                printf("Frame counts match the corpus\n");
+            }
+        }
+        if (decoder && expected_crc.size() == streams.size()) {
+            uint32_t bad = 0;
+            for (uint32_t i = 0; i < contexts; i++) bad += multi.payload_crc[i] != expected_crc[i % streams.size()];
+            if (bad) {
+                printf("FAIL: %u of %u contexts were handed payloads that differ from the corpus\n", bad, contexts);
+                status = 2;
+            } else {
+                printf("Frame payloads match the corpus\n");
+            }
+        }
+    }
+    return status;
+}
@@ -1,37 +1,70 @@
-// Simple tool to extract the decompressed PE image from an XEX2 file
-// using the XenonRecomp's XenonUtils library.
-// Compile: cl /EHsc /I XenonRecomp\XenonUtils /I XenonRecomp\thirdparty\TinySHA1
-//          /I XenonRecomp\thirdparty\tiny-AES-c extract_pe.cpp XenonRecomp\build\XenonUtils\XenonUtils.lib
+// Native XEX2 extractor: decrypts and decompresses the PE image from an
+// XEX2 file. Same output as tools/extract_pe.py (byte-identical for the
+// none/basic formats that tool supports) in a fraction of the time, and
+// also decodes LZX "normal" compression. Uses the runtime's own decoder
+// (src/xex2.cpp): AES-NI when the CPU has it, decryption and basic-block
+// copies split across threads.
+// Compile: g++ -O2 -std=c++20 -pthread -I src tools/extract_pe.cpp src/xex2.cpp src/lzx.cpp -o extract_pe
+// Usage: extract_pe <input.xex> <output.bin> [--threads N] [--no-aesni] [--quiet]
 
+#include <chrono>
 #include <cstdio>
-#include <file.h>
-#include <image.h>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "xex2.h"
+
+using Clock = std::chrono::steady_clock;
+
+static bool read_file(const char* path, std::vector<uint8_t>& out)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    out.resize(size > 0 ? (size_t)size : 0);
+    bool ok = fread(out.data(), 1, out.size(), f) == out.size();
+    fclose(f);
+    return ok;
+}
 
 int main(int argc, char** argv)
 {
     if (argc < 3)
     {
-        printf("Usage: extract_pe <input.xex> <output.bin>\n");
+        printf("Usage: extract_pe <input.xex> <output.bin> [--threads N] [--no-aesni] [--quiet]\n");
         return 1;
     }
+    Xex2DecodeOptions options;
+    bool quiet = false;
+    for (int i = 3; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--threads") && i + 1 < argc) options.threads = (unsigned)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--no-aesni")) options.aesni = false;
+        else if (!strcmp(argv[i], "--quiet")) quiet = true;
+    }
 
-    const auto file = LoadFile(argv[1]);
-    if (file.empty())
+    auto t0 = Clock::now();
+    std::vector<uint8_t> file;
+    if (!read_file(argv[1], file))
     {
         printf("ERROR: Failed to load %s\n", argv[1]);
         return 1;
     }
 
-    auto image = Image::ParseImage(file.data(), file.size());
-    if (image.data == nullptr)
+    auto t1 = Clock::now();
+    Xex2Info info;
+    std::vector<uint8_t> image;
+    std::string error;
+    if (!xex2_decode(file.data(), file.size(), image, info, error, options))
     {
-        printf("ERROR: Failed to parse XEX image\n");
+        printf("ERROR: %s\n", error.c_str());
         return 1;
     }
-
-    printf("Base: 0x%llX\n", (unsigned long long)image.base);
-    printf("Size: 0x%X\n", image.size);
-    printf("Entry: 0x%llX\n", (unsigned long long)image.entry_point);
+    auto t2 = Clock::now();
 
     FILE* out = fopen(argv[2], "wb");
     if (!out)
@@ -39,10 +72,25 @@ int main(int argc, char** argv)
         printf("ERROR: Failed to open output file %s\n", argv[2]);
         return 1;
     }
-
-    fwrite(image.data.get(), 1, image.size, out);
+    fwrite(image.data(), 1, image.size(), out);
     fclose(out);
+    auto t3 = Clock::now();
 
-    printf("Wrote %u bytes to %s\n", image.size, argv[2]);
+    if (!quiet)
+    {
+        static const char* kComp[] = {"None", "Basic", "Normal (LZX)", "Delta"};
+        auto ms = [](Clock::time_point a, Clock::time_point b) {
+            return std::chrono::duration<double, std::milli>(b - a).count();
+        };
+        printf("XEX2 file: %zu bytes\n", file.size());
+        printf("  Entry point: 0x%08X\n", info.entry_point);
+        printf("  Image base: 0x%08X\n", info.image_base);
+        printf("  Encryption: %s\n", info.encryption == 1 ? "Normal" : "None");
+        printf("  Compression: %s\n", info.compression < 4 ? kComp[info.compression] : "Unknown");
+        printf("  Image size: 0x%X (%u bytes)\n", info.image_size, info.image_size);
+        printf("  AES: %s\n", options.aesni && xex2_aesni_available() ? "AES-NI" : "portable");
+        printf("  Read %.1f ms, decode %.1f ms, write %.1f ms\n", ms(t0, t1), ms(t1, t2), ms(t2, t3));
+    }
+    printf("Wrote %zu bytes to %s\n", image.size(), argv[2]);
     return 0;
 }
@@ -0,0 +1,553 @@
+// Native STFS extractor for Xbox 360 LIVE/PIRS packages.
+// Same output tree as tools/extract_stfs.py: files are located with the
+// same wxPirs block arithmetic (data blocks laid out contiguously, skipping
+// the interleaved hash tables), so the two agree byte for byte.
+//
+// The package is memory-mapped and every file's block runs (at most 170
+// blocks between two hash tables) are resolved up front into one job list.
+// Worker threads then take jobs in any order: each SHA-1s its blocks
+// against the level-0 hash table entries (SHA-NI when the CPU has it),
+// checks the entries chain block to block, and writes the run at its final
+// offset with copy_file_range (pwrite from the mapping where that is not
+// available). Hash tables themselves are checked against the level above
+// and the top one against the volume descriptor. POSIX only.
+//
+// Compile: g++ -O2 -std=c++20 -pthread tools/extract_stfs.cpp -o extract_stfs
+// Usage: extract_stfs <package> [output_dir] [--threads N] [--no-verify] [--no-simd]
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define STFS_HAVE_SHANI 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+static const uint32_t BLOCK_SIZE = 0x1000;
+static const uint32_t HASHES_PER_TABLE = 170;
+static const uint32_t HASH_ENTRY_SIZE = 24;      // sha1[20], status, next block (be24)
+static const uint32_t BLOCK_END = 0xFFFFFF;
+static const uint32_t VOLUME_DESCRIPTOR = 0x379;
+
+struct Options {
+    unsigned threads = 0;        // 0 = hardware concurrency
+    bool     verify = true;
+    bool     simd = true;
+};
+static Options g_opts;
+
+// ============================================================================
+// SHA-1
+// ============================================================================
+
+static inline uint32_t rol32(uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
+
+static void sha1_blocks_portable(uint32_t h[5], const uint8_t* data, size_t blocks) {
+    for (; blocks--; data += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++)
+            w[i] = ((uint32_t)data[4 * i] << 24) | (data[4 * i + 1] << 16) | (data[4 * i + 2] << 8) | data[4 * i + 3];
+        for (int i = 16; i < 80; i++) w[i] = rol32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20)      { f = (b & c) | (~b & d);          k = 0x5A827999; }
+            else if (i < 40) { f = b ^ c ^ d;                   k = 0x6ED9EBA1; }
+            else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+            else             { f = b ^ c ^ d;                   k = 0xCA62C1D6; }
+            uint32_t t = rol32(a, 5) + f + e + k + w[i];
+            e = d; d = c; c = rol32(b, 30); b = a; a = t;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+}
+
+#ifdef STFS_HAVE_SHANI
+static bool cpu_has_shani() {
+    unsigned a, b, c, d;
+    if (!__get_cpuid(1, &a, &b, &c, &d) || !(c & (1u << 19))) return false;  // SSE4.1
+    if (!__get_cpuid_count(7, 0, &a, &b, &c, &d)) return false;
+    return (b >> 29) & 1;
+}
+
+// Four rounds per SHA1RNDS4; the message schedule runs one group ahead
+// through SHA1MSG1/SHA1MSG2, the next E comes from SHA1NEXTE.
+template <int F>
+__attribute__((target("sha,sse4.1"))) static inline __m128i sha1_rounds4(__m128i abcd, __m128i e) {
+    return _mm_sha1rnds4_epu32(abcd, e, F);
+}
+
+__attribute__((target("sha,sse4.1")))
+static void sha1_blocks_shani(uint32_t h[5], const uint8_t* data, size_t blocks) {
+    const __m128i bswap = _mm_set_epi64x(0x0001020304050607ULL, 0x08090A0B0C0D0E0FULL);
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)h), 0x1B);
+    __m128i e0 = _mm_set_epi32((int)h[4], 0, 0, 0);
+
+    for (; blocks--; data += 64) {
+        const __m128i abcd_save = abcd, e_save = e0;
+        __m128i w[4], prev = abcd;
+#pragma GCC unroll 20
+        for (int i = 0; i < 20; i++) {
+            if (i < 4) {
+                w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16 * i)), bswap);
+            } else {
+                __m128i t = _mm_xor_si128(_mm_sha1msg1_epu32(w[i & 3], w[(i + 1) & 3]), w[(i + 2) & 3]);
+                w[i & 3] = _mm_sha1msg2_epu32(t, w[(i + 3) & 3]);
+            }
+            __m128i e = i == 0 ? _mm_add_epi32(e0, w[0]) : _mm_sha1nexte_epu32(prev, w[i & 3]);
+            prev = abcd;
+            switch (i / 5) {
+            case 0:  abcd = sha1_rounds4<0>(abcd, e); break;
+            case 1:  abcd = sha1_rounds4<1>(abcd, e); break;
+            case 2:  abcd = sha1_rounds4<2>(abcd, e); break;
+            default: abcd = sha1_rounds4<3>(abcd, e); break;
+            }
+        }
+        e0 = _mm_sha1nexte_epu32(prev, e_save);
+        abcd = _mm_add_epi32(abcd, abcd_save);
+    }
+
+    _mm_storeu_si128((__m128i*)h, _mm_shuffle_epi32(abcd, 0x1B));
+    h[4] = (uint32_t)_mm_extract_epi32(e0, 3);
+}
+#endif
+
+using Sha1BlocksFn = void (*)(uint32_t*, const uint8_t*, size_t);
+static Sha1BlocksFn g_sha1_blocks = sha1_blocks_portable;
+
+static void sha1(const uint8_t* data, size_t size, uint8_t out[20]) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    size_t full = size / 64;
+    g_sha1_blocks(h, data, full);
+
+    uint8_t tail[128] = {};
+    size_t rest = size - full * 64;
+    memcpy(tail, data + full * 64, rest);
+    tail[rest] = 0x80;
+    size_t tail_blocks = rest + 9 <= 64 ? 1 : 2;
+    uint64_t bits = (uint64_t)size * 8;
+    for (int i = 0; i < 8; i++) tail[tail_blocks * 64 - 1 - i] = (uint8_t)(bits >> (8 * i));
+    g_sha1_blocks(h, tail, tail_blocks);
+
+    for (int i = 0; i < 5; i++) {
+        out[4 * i] = (uint8_t)(h[i] >> 24);
+        out[4 * i + 1] = (uint8_t)(h[i] >> 16);
+        out[4 * i + 2] = (uint8_t)(h[i] >> 8);
+        out[4 * i + 3] = (uint8_t)h[i];
+    }
+}
+
+// ============================================================================
+// Package layout
+// ============================================================================
+
+static uint32_t read_be16(const uint8_t* p) { return (p[0] << 8) | p[1]; }
+static uint32_t read_be24(const uint8_t* p) { return (p[0] << 16) | (p[1] << 8) | p[2]; }
+static uint32_t read_be32(const uint8_t* p) { return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; }
+static uint32_t read_le24(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16); }
+
+struct Package {
+    const uint8_t* data = nullptr;
+    uint64_t       size = 0;
+    int            fd = -1;
+    uint64_t       start = 0;    // data block 0
+    uint64_t       offset = 0;   // bytes per hash table slot (one or two copies)
+
+    // wxPirs: every 170 blocks skip a hash table slot, every 170^2 another
+    uint64_t block_offset(uint32_t block) const {
+        uint64_t skip = 0;
+        for (uint32_t b = block; b >= HASHES_PER_TABLE;) {
+            b /= HASHES_PER_TABLE;
+            skip += (uint64_t)(b + 1) * offset;
+        }
+        return start + (uint64_t)block * BLOCK_SIZE + skip;
+    }
+
+    // Hash table slots sit directly before the data they cover: level 0
+    // right before its group, level 1 before that (after the first group
+    // for the first table), level 2 before the level-1 table at 28900.
+    uint64_t table_offset(int level, uint32_t index) const {
+        const uint32_t span = level == 0 ? HASHES_PER_TABLE : HASHES_PER_TABLE * HASHES_PER_TABLE;
+        if (level == 0) return block_offset(index * span) - offset;
+        if (level == 1) return block_offset(index == 0 ? HASHES_PER_TABLE : index * span) - 2 * offset;
+        return block_offset(HASHES_PER_TABLE * HASHES_PER_TABLE) - 3 * offset;
+    }
+
+    int copies() const { return (int)(offset / BLOCK_SIZE); }
+
+    const uint8_t* at(uint64_t off, uint64_t len) const {
+        return off + len <= size ? data + off : nullptr;
+    }
+};
+
+struct Entry {
+    std::string name;
+    bool        is_dir = false;
+    uint32_t    start_block = 0;
+    uint32_t    blocks = 0;
+    uint16_t    path = 0;
+    uint32_t    size = 0;
+};
+
+struct OutFile {
+    std::string path;
+    uint32_t    start_block = 0;
+    uint64_t    size = 0;        // bytes actually present in the package
+    int         fd = -1;
+};
+
+struct Job {
+    uint32_t file;
+    uint32_t first_block;
+    uint32_t blocks;
+    uint64_t out_offset;
+};
+
+// Python decodes names as ASCII with errors='replace'
+static std::string decode_name(const uint8_t* p, int len) {
+    std::string s;
+    for (int i = 0; i < len; i++) {
+        if (p[i] < 0x80) s += (char)p[i];
+        else s += "\xEF\xBF\xBD";
+    }
+    return s;
+}
+
+// ============================================================================
+// Verification
+// ============================================================================
+
+static std::atomic<uint64_t> g_blocks_verified{0};
+static std::atomic<uint64_t> g_hash_mismatches{0};
+static std::atomic<uint64_t> g_chain_breaks{0};
+static std::mutex g_log_mutex;
+static int g_logged = 0;
+
+static void report(const char* fmt, uint32_t a, uint32_t b = 0) {
+    std::lock_guard<std::mutex> lock(g_log_mutex);
+    if (g_logged++ < 20) {
+        printf("  WARNING: ");
+        printf(fmt, a, b);
+        printf("\n");
+    }
+}
+
+// The entry for `index` in whichever copy of the table holds `hash`
+static const uint8_t* find_entry(const Package& pkg, uint64_t table, uint32_t index, const uint8_t hash[20]) {
+    for (int c = 0; c < pkg.copies(); c++) {
+        const uint8_t* e = pkg.at(table + (uint64_t)c * BLOCK_SIZE + index * HASH_ENTRY_SIZE, HASH_ENTRY_SIZE);
+        if (e && !memcmp(e, hash, 20)) return e;
+    }
+    return nullptr;
+}
+
+static bool verify_block(const Package& pkg, uint32_t block, const uint8_t* data, bool last, bool chain) {
+    uint8_t hash[20];
+    uint8_t buf[BLOCK_SIZE] = {};
+    uint64_t off = pkg.block_offset(block);
+    if (!data) {
+        // Truncated package: hash what is there, zero-padded
+        if (off < pkg.size) memcpy(buf, pkg.data + off, (size_t)std::min<uint64_t>(BLOCK_SIZE, pkg.size - off));
+        data = buf;
+    }
+    sha1(data, BLOCK_SIZE, hash);
+    g_blocks_verified++;
+    uint64_t table = pkg.table_offset(0, block / HASHES_PER_TABLE);
+    const uint8_t* e = find_entry(pkg, table, block % HASHES_PER_TABLE, hash);
+    if (!e) {
+        g_hash_mismatches++;
+        report("SHA-1 mismatch for block %u", block);
+        return false;
+    }
+    uint32_t next = read_be24(e + 21);
+    if (chain && next != (last ? BLOCK_END : block + 1)) {
+        g_chain_breaks++;
+        report("block %u chains to %u, not the next block", block, next);
+        return false;
+    }
+    return true;
+}
+
+// Each hash table block against its entry one level up; the top table
+// against the volume descriptor.
+static void verify_tables(const Package& pkg, uint32_t total_blocks) {
+    int top = total_blocks <= HASHES_PER_TABLE ? 0
+            : total_blocks <= HASHES_PER_TABLE * HASHES_PER_TABLE ? 1 : 2;
+    for (int level = 0; level <= top; level++) {
+        uint32_t span = level == 0 ? HASHES_PER_TABLE : level == 1 ? HASHES_PER_TABLE * HASHES_PER_TABLE : 0;
+        uint32_t count = level == top ? 1 : (total_blocks + span - 1) / span;
+        for (uint32_t i = 0; i < count; i++) {
+            uint64_t table = pkg.table_offset(level, i);
+            bool ok = false;
+            for (int c = 0; c < pkg.copies() && !ok; c++) {
+                const uint8_t* t = pkg.at(table + (uint64_t)c * BLOCK_SIZE, BLOCK_SIZE);
+                if (!t) continue;
+                uint8_t hash[20];
+                sha1(t, BLOCK_SIZE, hash);
+                if (level == top) {
+                    const uint8_t* want = pkg.at(VOLUME_DESCRIPTOR + 8, 20);
+                    ok = want && !memcmp(want, hash, 20);
+                } else {
+                    ok = find_entry(pkg, pkg.table_offset(level + 1, i / HASHES_PER_TABLE),
+                                    i % HASHES_PER_TABLE, hash) != nullptr;
+                }
+            }
+            if (!ok) {
+                g_hash_mismatches++;
+                report("SHA-1 mismatch for level %u hash table %u", (uint32_t)level, i);
+            }
+        }
+    }
+}
+
+// ============================================================================
+// Extraction
+// ============================================================================
+
+static bool write_run(const Package& pkg, const OutFile& f, uint64_t in_off, uint64_t out_off, uint64_t len) {
+#ifdef __linux__
+    {
+        loff_t in = (loff_t)in_off, out = (loff_t)out_off;
+        uint64_t left = len;
+        while (left) {
+            ssize_t n = copy_file_range(pkg.fd, &in, f.fd, &out, left, 0);
+            if (n <= 0) break;
+            left -= (uint64_t)n;
+        }
+        if (!left) return true;
+        in_off = (uint64_t)in;
+        out_off = (uint64_t)out;
+        len = left;
+    }
+#endif
+    const uint8_t* src = pkg.data + in_off;
+    while (len) {
+        ssize_t n = pwrite(f.fd, src, len, (off_t)out_off);
+        if (n <= 0) return false;
+        src += n;
+        out_off += (uint64_t)n;
+        len -= (uint64_t)n;
+    }
+    return true;
+}
+
+static void run_job(const Package& pkg, const std::vector<OutFile>& files, const Job& job, std::atomic<bool>& io_error) {
+    const OutFile& f = files[job.file];
+    uint64_t in_off = pkg.block_offset(job.first_block);
+    uint64_t len = std::min<uint64_t>((uint64_t)job.blocks * BLOCK_SIZE, f.size - job.out_offset);
+
+    if (g_opts.verify) {
+        uint32_t last_block = f.start_block + (uint32_t)((f.size + BLOCK_SIZE - 1) / BLOCK_SIZE) - 1;
+        for (uint32_t i = 0; i < job.blocks; i++) {
+            uint32_t b = job.first_block + i;
+            verify_block(pkg, b, pkg.at(pkg.block_offset(b), BLOCK_SIZE), b == last_block, true);
+        }
+    }
+    if (len && !write_run(pkg, f, in_off, job.out_offset, len)) io_error = true;
+}
+
+static bool map_package(const char* path, Package& pkg) {
+    pkg.fd = open(path, O_RDONLY);
+    if (pkg.fd < 0) return false;
+    struct stat st;
+    if (fstat(pkg.fd, &st) != 0) return false;
+    pkg.size = (uint64_t)st.st_size;
+    if (!pkg.size) return false;
+    void* p = mmap(nullptr, pkg.size, PROT_READ, MAP_SHARED, pkg.fd, 0);
+    if (p == MAP_FAILED) return false;
+    madvise(p, pkg.size, MADV_SEQUENTIAL);
+    pkg.data = (const uint8_t*)p;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("Usage: extract_stfs <package> [output_dir] [--threads N] [--no-verify] [--no-simd]\n");
+        return 1;
+    }
+    std::string input = argv[1], output;
+    for (int i = 2; i < argc; i++) {
+        if (!strcmp(argv[i], "--threads") && i + 1 < argc) g_opts.threads = (unsigned)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--no-verify")) g_opts.verify = false;
+        else if (!strcmp(argv[i], "--no-simd")) g_opts.simd = false;
+        else if (output.empty()) output = argv[i];
+    }
+    if (output.empty()) {
+        std::filesystem::path parent = std::filesystem::path(input).parent_path();
+        output = ((parent.empty() ? std::filesystem::path(".") : parent) / "extracted").string();
+    }
+#ifdef STFS_HAVE_SHANI
+    if (g_opts.simd && cpu_has_shani()) g_sha1_blocks = sha1_blocks_shani;
+#endif
+
+    auto t0 = Clock::now();
+    Package pkg;
+    if (!map_package(input.c_str(), pkg)) {
+        printf("ERROR: Failed to open %s\n", input.c_str());
+        return 1;
+    }
+    if (pkg.size < 4 || (memcmp(pkg.data, "LIVE", 4) && memcmp(pkg.data, "PIRS", 4))) {
+        printf("ERROR: Not a LIVE/PIRS file\n");
+        return 1;
+    }
+    if (pkg.size < 0xD000) {
+        printf("ERROR: File too small: %llu bytes (need at least 0xD000)\n", (unsigned long long)pkg.size);
+        return 1;
+    }
+
+    // wxPirs: the root entry's path indicator tells whether data starts
+    // after one hash table (read-only packages) or a pair of them
+    bool single = read_be16(pkg.data + 0xC032) == 0xFFFF;
+    pkg.start = single ? 0xC000 : 0xD000;
+    pkg.offset = single ? 0x1000 : 0x2000;
+
+    // The first entry's start block doubles as the file table's length
+    uint32_t table_blocks = pkg.data[pkg.start + 0x2F] | (pkg.data[pkg.start + 0x30] << 8);
+    uint64_t table_bytes = std::min<uint64_t>((uint64_t)table_blocks * BLOCK_SIZE, pkg.size - pkg.start);
+
+    std::vector<Entry> entries;
+    for (uint64_t i = 0; i < table_bytes / 64; i++) {
+        const uint8_t* cur = pkg.data + pkg.start + i * 64;
+        int name_len = cur[40] & 0x3F;
+        if (name_len == 0) break;
+        Entry e;
+        e.is_dir = cur[40] & 0x80;
+        e.name = decode_name(cur, std::min(name_len, 40));
+        e.blocks = read_le24(cur + 41);
+        e.start_block = read_le24(cur + 47);
+        e.path = (uint16_t)read_be16(cur + 50);
+        e.size = read_be32(cur + 52);
+        if (e.blocks != read_le24(cur + 44))
+            printf("  WARNING: %s: cluster sizes don't match\n", e.name.c_str());
+        entries.push_back(e);
+        if (name_len > 40) entries.back().name.clear();  // skipped below, as Python does
+    }
+
+    // Directory paths, output files and their block runs, all up front
+    namespace fs = std::filesystem;
+    std::map<uint32_t, std::string> paths = {{0xFFFF, ""}};
+    std::vector<OutFile> files;
+    std::map<std::string, size_t> by_path;  // a repeated name overwrites, as in Python
+    fs::create_directories(output);
+    for (uint32_t i = 0; i < entries.size(); i++) {
+        const Entry& e = entries[i];
+        if (e.name.empty()) continue;
+        auto parent = paths.find(e.path);
+        std::string dir = parent != paths.end() ? parent->second : "";
+        if (e.is_dir) {
+            paths[i] = dir + e.name + "/";
+            fs::create_directories(fs::path(output) / paths[i]);
+            continue;
+        }
+        if (e.start_block < 1) {
+            printf("  WARNING: %s: starting cluster must be >= 1, skipping\n", e.name.c_str());
+            continue;
+        }
+
+        OutFile f;
+        f.path = (fs::path(output) / dir / e.name).string();
+        f.start_block = e.start_block;
+        // Bytes present: blocks are read in order, so the first short read
+        // (end of a truncated package) ends the file
+        uint32_t nblocks = (uint32_t)((e.size + BLOCK_SIZE - 1) / BLOCK_SIZE);
+        for (uint32_t b = 0; b < nblocks; b++) {
+            uint64_t want = std::min<uint64_t>(BLOCK_SIZE, (uint64_t)e.size - (uint64_t)b * BLOCK_SIZE);
+            uint64_t off = pkg.block_offset(e.start_block + b);
+            uint64_t have = off < pkg.size ? std::min<uint64_t>(want, pkg.size - off) : 0;
+            f.size += have;
+            if (have < want) break;
+        }
+        auto seen = by_path.find(f.path);
+        if (seen != by_path.end()) {
+            files[seen->second] = f;
+        } else {
+            by_path[f.path] = files.size();
+            files.push_back(f);
+        }
+    }
+
+    std::vector<Job> jobs;
+    for (uint32_t i = 0; i < files.size(); i++) {
+        OutFile& f = files[i];
+        uint32_t present = (uint32_t)((f.size + BLOCK_SIZE - 1) / BLOCK_SIZE);
+        for (uint32_t b = 0; b < present;) {
+            uint32_t block = f.start_block + b;
+            uint32_t run = std::min(present - b, HASHES_PER_TABLE - block % HASHES_PER_TABLE);
+            jobs.push_back({i, block, run, (uint64_t)b * BLOCK_SIZE});
+            b += run;
+        }
+        fs::create_directories(fs::path(f.path).parent_path());
+        f.fd = open(f.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (f.fd < 0) {
+            printf("ERROR: Failed to create %s\n", f.path.c_str());
+            return 1;
+        }
+        if (f.size && ftruncate(f.fd, (off_t)f.size) != 0) {
+            printf("ERROR: Failed to size %s\n", f.path.c_str());
+            return 1;
+        }
+    }
+    auto t1 = Clock::now();
+
+    // Largest runs first so the tail of the schedule is short ones
+    std::stable_sort(jobs.begin(), jobs.end(), [](const Job& a, const Job& b) { return a.blocks > b.blocks; });
+    unsigned threads = g_opts.threads ? g_opts.threads : std::max(1u, std::thread::hardware_concurrency());
+    std::atomic<size_t> next{0};
+    std::atomic<bool> io_error{false};
+    auto worker = [&]() {
+        for (size_t j; (j = next++) < jobs.size();) run_job(pkg, files, jobs[j], io_error);
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; t++) pool.emplace_back(worker);
+    if (g_opts.verify) {
+        for (uint32_t b = 0; b < table_blocks; b++)
+            verify_block(pkg, b, pkg.at(pkg.block_offset(b), BLOCK_SIZE), b + 1 == table_blocks, true);
+        uint32_t allocated = read_be32(pkg.data + VOLUME_DESCRIPTOR + 0x1C);
+        verify_tables(pkg, std::max(allocated, 1u));
+    }
+    worker();
+    for (auto& th : pool) th.join();
+
+    uint64_t total = 0;
+    for (auto& f : files) {
+        total += f.size;
+        close(f.fd);
+    }
+    auto t2 = Clock::now();
+
+    auto ms = [](Clock::time_point a, Clock::time_point b) {
+        return std::chrono::duration<double, std::milli>(b - a).count();
+    };
+    printf("Extracted %zu file(s), %llu bytes to %s\n", files.size(), (unsigned long long)total, output.c_str());
+    printf("  %zu block runs on %u thread(s): plan %.1f ms, copy %.1f ms\n",
+           jobs.size(), threads, ms(t0, t1), ms(t1, t2));
+    if (g_opts.verify) {
+        printf("  Verified %llu blocks (%s SHA-1): %llu hash mismatches, %llu chain breaks\n",
+               (unsigned long long)g_blocks_verified.load(),
+               g_sha1_blocks == sha1_blocks_portable ? "portable" : "SHA-NI",
+               (unsigned long long)g_hash_mismatches.load(), (unsigned long long)g_chain_breaks.load());
+    }
+    if (io_error) {
+        printf("ERROR: write failed\n");
+        return 1;
+    }
+    return g_hash_mismatches || g_chain_breaks ? 2 : 0;
+}
@@ -0,0 +1,486 @@
+// Native version of tools/find_abi_addrs.py: finds the PowerPC ABI
+// register save/restore helpers (__savegprlr_14, __restfpr_14,
+// __savevmx_64, ...) and setjmp/longjmp in a decompressed PE image.
+//
+// Only executable sections are scanned (from the PE section table; the
+// whole image without one). Every helper begins with a fixed instruction
+// word (std r14,-152(r1); addi r11,r0,-1024; ...), so one pass compares
+// each word of .text against all the anchors at once, eight words per
+// AVX2 compare (four with SSE2), and only anchor hits are decoded and
+// checked against the full sequence: every register's store or load at
+// its stack offset, the LR save/restore and the closing blr. The VMX128
+// forms are matched exactly (stvx128/lvx128 vrN,r11,r12 for each N).
+//
+// Prints the [main] keys for config/vig8.toml and every detected entry
+// point (__savegprlr_14 .. __savegprlr_31 and so on) as a second TOML
+// block, for special-casing the helpers in the recompiler. With --config,
+// the addresses already in the config are checked in place first and
+// only helpers that moved are searched for; the exit status is 2 when
+// the config no longer matches the image. --update rewrites those keys.
+//
+// Compile: g++ -O2 -std=c++20 tools/find_abi_addrs.cpp -o find_abi_addrs
+// Usage: find_abi_addrs <pe_image.bin> [--config vig8.toml] [--update] [--full]
+//                       [--no-simd] [--quiet]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ABI_HAVE_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+static const uint32_t BASE_ADDR = 0x82000000;
+static const uint32_t BLR = 0x4E800020;
+static const uint32_t MTLR_R12 = 0x7D8803A6;
+
+// ============================================================================
+// Instruction encodings
+// ============================================================================
+
+static uint32_t d_form(uint32_t op, uint32_t rt, uint32_t ra, int32_t d) {
+    return (op << 26) | (rt << 21) | (ra << 16) | ((uint32_t)d & 0xFFFF);
+}
+
+static uint32_t x_form(uint32_t op, uint32_t rt, uint32_t ra, uint32_t rb, uint32_t xo) {
+    return (op << 26) | (rt << 21) | (ra << 16) | (rb << 11) | (xo << 1);
+}
+
+// stvx128/lvx128 vD,r11,r12: the 7-bit register is split into bits 21-25
+// and 2-3; the rest is fixed.
+static bool is_vmx128(uint32_t w, bool store, uint32_t reg) {
+    uint32_t vd = ((w >> 21) & 0x1F) | (((w >> 2) & 3) << 5);
+    return (w & 0xFC0007F3) == (store ? 0x100001C3u : 0x100000C3u) &&
+           ((w >> 16) & 0x1F) == 11 && ((w >> 11) & 0x1F) == 12 && vd == reg;
+}
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+enum Kind {
+    SAVEGPRLR, RESTGPRLR, SAVEFPR, RESTFPR, SAVEVMX_14, RESTVMX_14,
+    SAVEVMX_64, RESTVMX_64, SETJMP, LONGJMP, KIND_COUNT
+};
+
+struct HelperInfo {
+    const char* name;      // entry point name prefix
+    const char* key;       // [main] key in the recompiler config
+    uint32_t    first_reg; // register saved by the first entry
+    uint32_t    entries;   // one per register (1 for setjmp/longjmp)
+    uint32_t    stride;    // bytes between entries
+    uint32_t    anchor;    // first instruction word
+};
+
+static const HelperInfo HELPERS[KIND_COUNT] = {
+    {"__savegprlr", "savegprlr_14_address", 14, 18, 4, d_form(62, 14, 1, -152)},   // std r14,-152(r1)
+    {"__restgprlr", "restgprlr_14_address", 14, 18, 4, d_form(58, 14, 1, -152)},   // ld r14,-152(r1)
+    {"__savefpr",   "savefpr_14_address",   14, 18, 4, d_form(54, 14, 12, -144)},  // stfd f14,-144(r12)
+    {"__restfpr",   "restfpr_14_address",   14, 18, 4, d_form(50, 14, 12, -144)},  // lfd f14,-144(r12)
+    {"__savevmx",   "savevmx_14_address",   14, 18, 8, d_form(14, 11, 0, -288)},   // addi r11,r0,-288
+    {"__restvmx",   "restvmx_14_address",   14, 18, 8, d_form(14, 11, 0, -288)},
+    {"__savevmx",   "savevmx_64_address",   64, 64, 8, d_form(14, 11, 0, -1024)},  // addi r11,r0,-1024
+    {"__restvmx",   "restvmx_64_address",   64, 64, 8, d_form(14, 11, 0, -1024)},
+    {"setjmp",      "setjmp_address",       0,  1,  0, d_form(36, 1, 3, 0)},       // stw r1,0(r3)
+    {"longjmp",     "longjmp_address",      0,  1,  0, d_form(32, 1, 3, 0)},       // lwz r1,0(r3)
+};
+
+struct Image {
+    const uint8_t* data = nullptr;
+    size_t         size = 0;
+
+    // Big-endian word at guest address `addr`; false past the image
+    bool insn(uint32_t addr, uint32_t& w) const {
+        uint64_t off = (uint64_t)addr - BASE_ADDR;
+        if (addr < BASE_ADDR || off + 4 > size) return false;
+        const uint8_t* p = data + off;
+        w = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+        return true;
+    }
+    bool is(uint32_t addr, uint32_t expected) const {
+        uint32_t w;
+        return insn(addr, w) && w == expected;
+    }
+};
+
+// Count of the 49 words after `addr` with primary opcode `op` and base r3
+static int count_r3_accesses(const Image& img, uint32_t addr, uint32_t op) {
+    int n = 0;
+    for (uint32_t k = 1; k < 50; k++) {
+        uint32_t w;
+        if (!img.insn(addr + k * 4, w)) break;
+        if ((w >> 26) == op && ((w >> 16) & 0x1F) == 3) n++;
+    }
+    return n;
+}
+
+// Whether the full sequence of `kind` starts at `addr`
+static bool match(const Image& img, Kind kind, uint32_t addr) {
+    const HelperInfo& h = HELPERS[kind];
+    if (!img.is(addr, h.anchor)) return false;
+    uint32_t end = addr + h.entries * h.stride;
+    switch (kind) {
+    case SAVEGPRLR:
+    case RESTGPRLR: {
+        bool save = kind == SAVEGPRLR;
+        for (uint32_t r = 14; r < 32; r++) {
+            if (!img.is(addr + (r - 14) * 4, d_form(save ? 62 : 58, r, 1, -(int32_t)(32 - r) * 8 - 8))) return false;
+        }
+        if (save) return img.is(end, d_form(36, 12, 1, -8)) && img.is(end + 4, BLR);
+        return img.is(end, d_form(32, 12, 1, -8)) && img.is(end + 4, MTLR_R12) && img.is(end + 8, BLR);
+    }
+    case SAVEFPR:
+    case RESTFPR:
+        for (uint32_t r = 14; r < 32; r++) {
+            if (!img.is(addr + (r - 14) * 4, d_form(kind == SAVEFPR ? 54 : 50, r, 12, -(int32_t)(32 - r) * 8))) return false;
+        }
+        return img.is(end, BLR);
+    case SAVEVMX_14:
+    case RESTVMX_14:
+        for (uint32_t r = 14; r < 32; r++) {
+            uint32_t at = addr + (r - 14) * 8;
+            if (!img.is(at, d_form(14, 11, 0, -(int32_t)(32 - r) * 16)) ||
+                !img.is(at + 4, x_form(31, r, 11, 12, kind == SAVEVMX_14 ? 231 : 103))) return false;
+        }
+        return img.is(end, BLR);
+    case SAVEVMX_64:
+    case RESTVMX_64:
+        for (uint32_t r = 64; r < 128; r++) {
+            uint32_t at = addr + (r - 64) * 8, w;
+            if (!img.is(at, d_form(14, 11, 0, -(int32_t)(128 - r) * 16)) ||
+                !img.insn(at + 4, w) || !is_vmx128(w, kind == SAVEVMX_64, r)) return false;
+        }
+        return img.is(end, BLR);
+    case SETJMP:
+        return count_r3_accesses(img, addr, 36) >= 15;
+    case LONGJMP:
+        return count_r3_accesses(img, addr, 32) >= 15;
+    default:
+        return false;
+    }
+}
+
+// ============================================================================
+// Anchor scan
+// ============================================================================
+
+// Distinct anchors in memory byte order, so words compare without a swap
+struct Anchors {
+    uint32_t words[KIND_COUNT];
+    int      count = 0;
+};
+
+static uint32_t to_memory_order(uint32_t be) {
+    uint8_t b[4] = {(uint8_t)(be >> 24), (uint8_t)(be >> 16), (uint8_t)(be >> 8), (uint8_t)be};
+    uint32_t w;
+    memcpy(&w, b, 4);
+    return w;
+}
+
+static Anchors make_anchors(const bool wanted[KIND_COUNT]) {
+    Anchors a;
+    for (int k = 0; k < KIND_COUNT; k++) {
+        if (!wanted[k]) continue;
+        uint32_t w = to_memory_order(HELPERS[k].anchor);
+        bool dup = false;
+        for (int i = 0; i < a.count; i++) dup |= a.words[i] == w;
+        if (!dup) a.words[a.count++] = w;
+    }
+    return a;
+}
+
+// Appends the word index of every anchor hit in `words` words at `p`
+static void scan_scalar(const uint8_t* p, size_t begin, size_t words, const Anchors& a,
+                        std::vector<uint32_t>& hits) {
+    for (size_t i = begin; i < words; i++) {
+        uint32_t w;
+        memcpy(&w, p + i * 4, 4);
+        for (int k = 0; k < a.count; k++) {
+            if (w == a.words[k]) { hits.push_back((uint32_t)i); break; }
+        }
+    }
+}
+
+#ifdef ABI_HAVE_X86
+static void scan_sse2(const uint8_t* p, size_t words, const Anchors& a, std::vector<uint32_t>& hits) {
+    __m128i anchor[KIND_COUNT];
+    for (int k = 0; k < a.count; k++) anchor[k] = _mm_set1_epi32((int)a.words[k]);
+    size_t i = 0;
+    for (; i + 4 <= words; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + i * 4));
+        __m128i eq = _mm_setzero_si128();
+        for (int k = 0; k < a.count; k++) eq = _mm_or_si128(eq, _mm_cmpeq_epi32(v, anchor[k]));
+        unsigned m = (unsigned)_mm_movemask_ps(_mm_castsi128_ps(eq));
+        for (; m; m &= m - 1) hits.push_back((uint32_t)(i + __builtin_ctz(m)));
+    }
+    scan_scalar(p, i, words, a, hits);
+}
+
+__attribute__((target("avx2")))
+static void scan_avx2(const uint8_t* p, size_t words, const Anchors& a, std::vector<uint32_t>& hits) {
+    __m256i anchor[KIND_COUNT];
+    for (int k = 0; k < a.count; k++) anchor[k] = _mm256_set1_epi32((int)a.words[k]);
+    size_t i = 0;
+    for (; i + 8 <= words; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(p + i * 4));
+        __m256i eq = _mm256_setzero_si256();
+        for (int k = 0; k < a.count; k++) eq = _mm256_or_si256(eq, _mm256_cmpeq_epi32(v, anchor[k]));
+        unsigned m = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(eq));
+        for (; m; m &= m - 1) hits.push_back((uint32_t)(i + __builtin_ctz(m)));
+    }
+    scan_scalar(p, i, words, a, hits);
+}
+
+static bool cpu_has_avx2() {
+    unsigned a, b, c, d;
+    if (!__get_cpuid(1, &a, &b, &c, &d)) return false;
+    if (!((c >> 27) & 1) || !((c >> 28) & 1)) return false;  // OSXSAVE, AVX
+    unsigned lo, hi;
+    __asm__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    if ((lo & 6) != 6) return false;  // OS saves YMM state
+    if (!__get_cpuid_count(7, 0, &a, &b, &c, &d)) return false;
+    return (b >> 5) & 1;
+}
+#endif
+
+struct Section {
+    std::string name;
+    uint32_t    address, size;
+};
+
+// Executable sections from the PE headers (the image is in memory layout)
+static std::vector<Section> code_sections(const Image& img) {
+    std::vector<Section> out;
+    auto le32 = [&](size_t off) {
+        return (uint32_t)img.data[off] | ((uint32_t)img.data[off + 1] << 8) |
+               ((uint32_t)img.data[off + 2] << 16) | ((uint32_t)img.data[off + 3] << 24);
+    };
+    if (img.size < 0x40 || img.data[0] != 'M' || img.data[1] != 'Z') return out;
+    uint32_t pe = le32(0x3C);
+    if ((uint64_t)pe + 24 > img.size || memcmp(img.data + pe, "PE\0\0", 4)) return out;
+    uint32_t count = img.data[pe + 6] | (img.data[pe + 7] << 8);
+    uint32_t optional_size = img.data[pe + 20] | (img.data[pe + 21] << 8);
+    uint64_t table = (uint64_t)pe + 24 + optional_size;
+    if (table + (uint64_t)count * 40 > img.size) return out;
+    for (uint32_t i = 0; i < count; i++) {
+        size_t h = table + i * 40;
+        uint32_t vsize = le32(h + 8), rva = le32(h + 12), flags = le32(h + 36);
+        if (vsize == 0) vsize = le32(h + 16);
+        if (!(flags & 0x20000020) || rva >= img.size) continue;  // CNT_CODE | MEM_EXECUTE
+        if (vsize > img.size - rva) vsize = (uint32_t)(img.size - rva);
+        out.push_back({std::string((const char*)img.data + h, strnlen((const char*)img.data + h, 8)),
+                       BASE_ADDR + rva, vsize});
+    }
+    return out;
+}
+
+// First match of each wanted kind, in address order. Returns the bytes scanned.
+static size_t scan(const Image& img, const std::vector<Section>& sections, bool simd,
+                   bool wanted[KIND_COUNT], uint32_t found[KIND_COUNT]) {
+    Anchors anchors = make_anchors(wanted);
+    if (!anchors.count) return 0;
+    size_t scanned = 0;
+    std::vector<uint32_t> hits;
+    for (const auto& s : sections) {
+        const uint8_t* p = img.data + (s.address - BASE_ADDR);
+        size_t words = s.size / 4;
+        hits.clear();
+#ifdef ABI_HAVE_X86
+        static const bool avx2 = cpu_has_avx2();
+        if (simd && avx2) scan_avx2(p, words, anchors, hits);
+        else if (simd) scan_sse2(p, words, anchors, hits);
+        else
+#endif
+        scan_scalar(p, 0, words, anchors, hits);
+        scanned += words * 4;
+
+        for (uint32_t i : hits) {
+            uint32_t addr = s.address + i * 4;
+            for (int k = 0; k < KIND_COUNT; k++) {
+                if (wanted[k] && match(img, (Kind)k, addr)) {
+                    found[k] = addr;
+                    wanted[k] = false;
+                }
+            }
+        }
+    }
+    return scanned;
+}
+
+// ============================================================================
+// Config
+// ============================================================================
+
+// `key = 0x...` lines of the config; 0 where a key is absent or commented out
+static void read_config(const std::string& text, uint32_t addrs[KIND_COUNT]) {
+    std::istringstream in(text);
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line[start] == '#') continue;
+        for (int k = 0; k < KIND_COUNT; k++) {
+            size_t len = strlen(HELPERS[k].key);
+            if (line.compare(start, len, HELPERS[k].key) != 0) continue;
+            size_t eq = line.find('=', start + len);
+            if (eq == std::string::npos || line.find_first_not_of(" \t", start + len) != eq) continue;
+            addrs[k] = (uint32_t)strtoul(line.c_str() + eq + 1, nullptr, 0);
+        }
+    }
+}
+
+// Sets each helper's key line (commented out or not) to the detected
+// address; keys of helpers not found are left alone.
+static std::string update_config(const std::string& text, const uint32_t found[KIND_COUNT]) {
+    std::istringstream in(text);
+    std::string line, out;
+    while (std::getline(in, line)) {
+        size_t start = line.find_first_not_of(" \t#");
+        for (int k = 0; start != std::string::npos && k < KIND_COUNT; k++) {
+            size_t len = strlen(HELPERS[k].key);
+            if (!found[k] || line.compare(start, len, HELPERS[k].key) != 0) continue;
+            size_t eq = line.find('=', start + len);
+            if (eq == std::string::npos || line.find_first_not_of(" \t", start + len) != eq) continue;
+            char buf[64];
+            snprintf(buf, sizeof(buf), "%s = 0x%08X", HELPERS[k].key, found[k]);
+            line = buf;
+            break;
+        }
+        out += line;
+        out += '\n';
+    }
+    return out;
+}
+
+static bool read_file(const std::string& path, std::string& out) {
+    std::ifstream f(path, std::ios::binary);
+    if (!f) return false;
+    std::ostringstream ss;
+    ss << f.rdbuf();
+    out = ss.str();
+    return true;
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("Usage: find_abi_addrs <pe_image.bin> [--config vig8.toml] [--update] [--full]\n"
+               "                      [--no-simd] [--quiet]\n");
+        return 1;
+    }
+    std::string image_path = argv[1], config_path;
+    bool update = false, full = false, simd = true, quiet = false;
+    for (int i = 2; i < argc; i++) {
+        if (!strcmp(argv[i], "--config") && i + 1 < argc) config_path = argv[++i];
+        else if (!strcmp(argv[i], "--update")) update = true;
+        else if (!strcmp(argv[i], "--full")) full = true;
+        else if (!strcmp(argv[i], "--no-simd")) simd = false;
+        else if (!strcmp(argv[i], "--quiet")) quiet = true;
+    }
+
+    auto t0 = Clock::now();
+    std::string file, config;
+    if (!read_file(image_path, file)) {
+        printf("ERROR: Failed to load %s\n", image_path.c_str());
+        return 1;
+    }
+    if (!config_path.empty() && !read_file(config_path, config)) {
+        printf("ERROR: Failed to load %s\n", config_path.c_str());
+        return 1;
+    }
+    Image img;
+    img.data = (const uint8_t*)file.data();
+    img.size = file.size();
+    auto t1 = Clock::now();
+
+    // Addresses from the config that still hold their helper need no scan
+    uint32_t configured[KIND_COUNT] = {}, found[KIND_COUNT] = {};
+    bool wanted[KIND_COUNT];
+    int verified = 0;
+    if (!config_path.empty()) read_config(config, configured);
+    for (int k = 0; k < KIND_COUNT; k++) {
+        wanted[k] = true;
+        if (!full && configured[k] && match(img, (Kind)k, configured[k])) {
+            found[k] = configured[k];
+            wanted[k] = false;
+            verified++;
+        }
+    }
+    auto t2 = Clock::now();
+
+    std::vector<Section> sections = code_sections(img);
+    bool have_pe = !sections.empty();
+    if (!have_pe) sections.push_back({"image", BASE_ADDR, (uint32_t)img.size});
+    size_t scanned = scan(img, sections, simd, wanted, found);
+    auto t3 = Clock::now();
+
+    bool stale = false;
+    for (int k = 0; k < KIND_COUNT; k++) stale |= found[k] != configured[k];
+
+    auto ms = [](Clock::time_point a, Clock::time_point b) {
+        return std::chrono::duration<double, std::milli>(b - a).count();
+    };
+    if (!quiet) {
+        printf("PE image: %s (%zu bytes), %s\n", image_path.c_str(), img.size,
+               have_pe ? "code sections from PE headers" : "no PE headers, scanning the whole image");
+        for (const auto& s : sections) printf("  %-8s 0x%08X 0x%06X\n", s.name.c_str(), s.address, s.size);
+        if (!config_path.empty()) {
+            printf("Config: %s, %d/%d addresses verified in place\n", config_path.c_str(), verified, KIND_COUNT);
+        }
+        const char* kernel = "scalar";
+#ifdef ABI_HAVE_X86
+        if (simd) kernel = cpu_has_avx2() ? "avx2" : "sse2";
+#endif
+        printf("Scanned 0x%zX bytes (%s); read %.1f ms, verify %.2f ms, scan %.2f ms\n\n",
+               scanned, kernel, ms(t0, t1), ms(t1, t2), ms(t2, t3));
+        for (int k = 0; k < KIND_COUNT; k++) {
+            const HelperInfo& h = HELPERS[k];
+            char name[32];
+            if (h.entries > 1) snprintf(name, sizeof(name), "%s_%u", h.name, h.first_reg);
+            else snprintf(name, sizeof(name), "%s", h.name);
+            if (!found[k]) printf("  %-16s NOT FOUND\n", name);
+            else printf("  %-16s 0x%08X  %u entr%s%s\n", name, found[k], h.entries, h.entries > 1 ? "ies" : "y",
+                        configured[k] && configured[k] != found[k] ? "  (moved)" : "");
+        }
+        printf("\n");
+    }
+
+    printf("# ABI register save/restore helpers ([main] in config/vig8.toml)\n");
+    for (int k = 0; k < KIND_COUNT; k++) {
+        if (found[k]) printf("%s = 0x%08X\n", HELPERS[k].key, found[k]);
+        else printf("# %s = NOT FOUND\n", HELPERS[k].key);
+    }
+    printf("\n# Every helper entry point: __savegprlr_N saves rN..r31, and so on\n[abi_helpers]\n");
+    for (int k = 0; k < KIND_COUNT; k++) {
+        const HelperInfo& h = HELPERS[k];
+        if (!found[k]) continue;
+        for (uint32_t i = 0; i < h.entries; i++) {
+            if (h.entries > 1) printf("%s_%u = 0x%08X\n", h.name, h.first_reg + i, found[k] + i * h.stride);
+            else printf("%s = 0x%08X\n", h.name, found[k]);
+        }
+    }
+
+    if (config_path.empty()) return 0;
+    if (update && stale) {
+        std::ofstream out(config_path, std::ios::binary);
+        out << update_config(config, found);
+        if (!out) {
+            printf("ERROR: Failed to write %s\n", config_path.c_str());
+            return 1;
+        }
+        printf("\nUpdated %s\n", config_path.c_str());
+        return 0;
+    }
+    return stale ? 2 : 0;
+}
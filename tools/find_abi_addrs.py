@@ -19,7 +19,10 @@ for GPR save/restore. Key observations:
   - The LR is saved/restored via stw/lwz r12 (32-bit)
   - Stack offsets: -(32-reg)*8 - 8 for GPR, -(32-reg)*8 for FPR
 
-Usage: py find_abi_addrs.py
+Usage: py find_abi_addrs.py [pe_image.bin]
+
+The native find_abi_addrs (find_abi_addrs.cpp) does the same scan in a few
+milliseconds and also checks and updates config/vig8.toml.
 """
 
 import struct
@@ -514,6 +517,10 @@ def find_longjmp(data):
 # ============================================================================
 
 def main():
+    global PE_PATH
+    if len(sys.argv) > 1:
+        PE_PATH = sys.argv[1]
+
     # Ensure PE is extracted
     if not os.path.exists(PE_PATH):
         print("PE binary not found at %s" % PE_PATH)
@@ -0,0 +1,211 @@
+// Native version of tools/find_missing_vtable_funcs.py: finds vtable
+// entries pointing at code with no recompiled function.
+//
+// Reads the section table from the image's PE headers and scans every
+// non-code section (.rdata, .data, ...) for runs of two or more big-endian
+// pointers into the recompiled code range, with AVX2/SSE4.1 compares on
+// byte-swapped words (project/src/vtable_scan.cpp, shared with the
+// runtime's [debug] vtable_check). Targets are checked against the
+// PPCFuncMappings table in generated/vig8_init.cpp. Falls back to the
+// Python tool's fixed range (everything below PPC_CODE_BASE) when the
+// image has no PE headers.
+//
+// Exits with 2 when any vtable target is missing, so a build script can
+// fail on a coverage regression.
+//
+// Compile: g++ -O2 -std=c++20 -I project/src -I generated tools/find_missing_vtable_funcs.cpp project/src/vtable_scan.cpp -o find_missing_vtable_funcs
+// Usage: find_missing_vtable_funcs [pe_image.bin] [vig8_init.cpp] [--no-simd] [--quiet]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "vig8_config.h"
+#include "vtable_scan.h"
+
+using Clock = std::chrono::steady_clock;
+
+static const uint32_t IMAGE_BASE = (uint32_t)PPC_IMAGE_BASE;
+static const uint32_t CODE_START = (uint32_t)PPC_CODE_BASE;
+static const uint32_t CODE_END = (uint32_t)(PPC_CODE_BASE + PPC_CODE_SIZE);
+static const uint32_t LIBRARY_START = 0x82300000;  // CRT/XDK code from here on
+
+static bool read_file(const char* path, std::vector<uint8_t>& out) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    out.resize(size > 0 ? (size_t)size : 0);
+    bool ok = fread(out.data(), 1, out.size(), f) == out.size();
+    fclose(f);
+    return ok;
+}
+
+// Every `{ 0xADDR,` in vig8_init.cpp, sorted
+static std::vector<uint32_t> parse_function_table(const std::vector<uint8_t>& text) {
+    std::vector<uint32_t> addrs;
+    const char* p = (const char*)text.data();
+    const char* end = p + text.size();
+    while ((p = (const char*)memchr(p, '{', end - p)) != nullptr) {
+        p++;
+        while (p < end && (*p == ' ' || *p == '\t')) p++;
+        if (end - p < 3 || p[0] != '0' || (p[1] != 'x' && p[1] != 'X')) continue;
+        char* digits_end;
+        unsigned long v = strtoul(p + 2, &digits_end, 16);
+        const char* q = digits_end;
+        if (q == p + 2) continue;
+        while (q < end && (*q == ' ' || *q == '\t')) q++;
+        if (q < end && *q == ',') addrs.push_back((uint32_t)v);
+        p = q;
+    }
+    std::sort(addrs.begin(), addrs.end());
+    addrs.erase(std::unique(addrs.begin(), addrs.end()), addrs.end());
+    return addrs;
+}
+
+struct Missing {
+    uint32_t              target;
+    bool                  thunk;
+    VtableThunk           info;
+    std::vector<uint32_t> refs;
+};
+
+static std::string ref_list(const std::vector<uint32_t>& refs) {
+    std::string s;
+    char buf[16];
+    for (size_t i = 0; i < refs.size() && i < 3; i++) {
+        snprintf(buf, sizeof(buf), "%s0x%08X", i ? ", " : "", refs[i]);
+        s += buf;
+    }
+    return s;
+}
+
+static void print_group(const char* title, const std::vector<Missing>& missing, bool thunks,
+                        bool library) {
+    size_t n = 0;
+    for (const auto& m : missing) {
+        if (m.thunk == thunks && (m.target >= LIBRARY_START) == library) n++;
+    }
+    printf("\n--- %s (%zu) ---\n", title, n);
+    for (const auto& m : missing) {
+        if (m.thunk != thunks || (m.target >= LIBRARY_START) != library) continue;
+        printf("  0x%08X", m.target);
+        if (thunks) printf("  addi r3,r3,%d; b 0x%08X", m.info.adjust, m.info.target);
+        if (!library) printf("  (%zu refs: %s)", m.refs.size(), ref_list(m.refs).c_str());
+        printf("\n");
+    }
+}
+
+int main(int argc, char** argv) {
+    const char* pe_path = "extracted/pe_image.bin";
+    const char* init_path = "generated/vig8_init.cpp";
+    bool simd = true, quiet = false;
+    int positional = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--no-simd")) simd = false;
+        else if (!strcmp(argv[i], "--quiet")) quiet = true;
+        else if (!strcmp(argv[i], "--help") || !strcmp(argv[i], "-h")) {
+            printf("Usage: find_missing_vtable_funcs [pe_image.bin] [vig8_init.cpp] [--no-simd] [--quiet]\n");
+            return 0;
+        } else if (positional == 0) { pe_path = argv[i]; positional++; }
+        else if (positional == 1) { init_path = argv[i]; positional++; }
+    }
+
+    auto t0 = Clock::now();
+    std::vector<uint8_t> init_text, image;
+    if (!read_file(init_path, init_text)) {
+        printf("ERROR: Failed to load %s\n", init_path);
+        return 1;
+    }
+    if (!read_file(pe_path, image)) {
+        printf("ERROR: Failed to load %s\n", pe_path);
+        return 1;
+    }
+    auto t1 = Clock::now();
+    std::vector<uint32_t> known = parse_function_table(init_text);
+    auto t2 = Clock::now();
+
+    std::vector<VtableSection> sections;
+    bool have_pe = VtableParseSections(image.data(), image.size(), IMAGE_BASE, sections);
+    if (!have_pe) {
+        sections.clear();
+        uint32_t size = (uint32_t)std::min<size_t>(image.size(), CODE_START - IMAGE_BASE);
+        sections.push_back({"data", IMAGE_BASE, size, false});
+    }
+    std::vector<VtableSlot> slots;
+    size_t pointers = 0, scanned = 0;
+    for (const auto& s : sections) {
+        if (s.code) continue;
+        pointers += VtableScan(image.data() + (s.address - IMAGE_BASE), s.size, s.address,
+                               CODE_START, CODE_END, 2, slots, simd);
+        scanned += s.size;
+    }
+    auto t3 = Clock::now();
+
+    std::map<uint32_t, std::vector<uint32_t>> refs;
+    for (const auto& slot : slots) {
+        if (!std::binary_search(known.begin(), known.end(), slot.target)) {
+            refs[slot.target].push_back(slot.address);
+        }
+    }
+    std::vector<Missing> missing;
+    for (auto& [target, r] : refs) {
+        Missing m{target, false, {}, std::move(r)};
+        size_t off = target - IMAGE_BASE;
+        if (off + 8 <= image.size()) m.thunk = VtableIsThunk(image.data() + off, target, m.info);
+        missing.push_back(std::move(m));
+    }
+    auto t4 = Clock::now();
+
+    auto ms = [](Clock::time_point a, Clock::time_point b) {
+        return std::chrono::duration<double, std::milli>(b - a).count();
+    };
+    size_t thunks = std::count_if(missing.begin(), missing.end(), [](const Missing& m) { return m.thunk; });
+
+    if (quiet) {
+        printf("%zu missing vtable entries (%zu thunks, %zu functions)\n",
+               missing.size(), thunks, missing.size() - thunks);
+        return missing.empty() ? 0 : 2;
+    }
+
+    printf("Function table: %zu known addresses\n", known.size());
+    printf("Image: 0x%zX bytes, %s\n", image.size(),
+           have_pe ? "sections from PE headers" : "no PE headers, scanning below the code");
+    for (const auto& s : sections) {
+        printf("  %-8s 0x%08X 0x%06X%s\n", s.name.c_str(), s.address, s.size, s.code ? "  code" : "");
+    }
+    printf("Scanned 0x%zX bytes (%s): %zu code-range pointers, %zu in vtable clusters\n",
+           scanned, simd ? VtableScanKernel() : "scalar", pointers, slots.size());
+    printf("Read %.1f ms, parse table %.1f ms, scan %.2f ms, check %.2f ms\n",
+           ms(t0, t1), ms(t1, t2), ms(t2, t3), ms(t3, t4));
+
+    printf("\n================================================================================\n");
+    printf("RESULTS: %zu missing vtable entries\n", missing.size());
+    printf("  %zu C++ virtual adjustor thunks\n", thunks);
+    printf("  %zu function entry points\n", missing.size() - thunks);
+    printf("================================================================================\n");
+    print_group("GAME-LOGIC THUNKS", missing, true, false);
+    print_group("GAME-LOGIC FUNCTIONS", missing, false, false);
+    print_group("LIBRARY/CRT THUNKS", missing, true, true);
+    print_group("LIBRARY/CRT FUNCTIONS", missing, false, true);
+
+    printf("\n# Missing vtable function entries found by find_missing_vtable_funcs\n");
+    for (const auto& m : missing) {
+        if (m.thunk) printf("# 0x%08X  # thunk: addi r3,%d; b 0x%08X\n", m.target, m.info.adjust, m.info.target);
+        else printf("# 0x%08X\n", m.target);
+    }
+
+    printf("\nPreviously known missing functions:\n");
+    for (uint32_t addr : {0x821A17D0u, 0x821664F0u, 0x8216BEA8u}) {
+        bool in_table = std::binary_search(known.begin(), known.end(), addr);
+        printf("  0x%08X: %s, %s\n", addr, in_table ? "IN TABLE" : "MISSING",
+               refs.count(addr) ? "in vtable data" : "not in vtable clusters");
+    }
+    return missing.empty() ? 0 : 2;
+}
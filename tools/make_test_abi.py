@@ -0,0 +1,207 @@
+#!/usr/bin/env python3
+"""
+Build a synthetic PE image for testing the ABI helper finders
+(find_abi_addrs.py and the native find_abi_addrs).
+
+The .text section is random instruction words with the save/restore
+helpers assembled into it: __savegprlr_14/__restgprlr_14 (std/ld r14-r31
+off r1, LR through r12), __savefpr_14/__restfpr_14 (stfd/lfd off r12),
+__savevmx_14/__restvmx_14 (addi r11 + stvx/lvx) and __savevmx_64/
+__restvmx_64 (addi r11 + stvx128/lvx128), optionally setjmp/longjmp.
+Decoys are mixed in: lone anchor words and sequences that break off
+partway, which a finder must reject. --layout crt packs the helpers back
+to back the way the Xbox 360 CRT does; random scatters them.
+
+--expect writes the [main] TOML block a correct finder prints.
+
+Usage: python make_test_abi.py <output> [--expect FILE] [--size-mb N]
+                               [--layout crt|random] [--setjmp] [--no-pe]
+                               [--decoys N] [--seed N]
+"""
+
+import argparse
+import random
+import struct
+
+BASE_ADDR = 0x82000000
+TEXT_RVA = 0x90000
+BLR = 0x4E800020
+MTLR_R12 = 0x7D8803A6
+
+
+def d_form(op, rt, ra, d):
+    return (op << 26) | (rt << 21) | (ra << 16) | (d & 0xFFFF)
+
+
+def x_form(op, rt, ra, rb, xo):
+    return (op << 26) | (rt << 21) | (ra << 16) | (rb << 11) | (xo << 1)
+
+
+def vmx128(store, reg):
+    """stvx128/lvx128 vReg, r11, r12"""
+    return ((4 << 26) | ((reg & 31) << 21) | (11 << 16) | (12 << 11)
+            | (0x1C3 if store else 0x0C3) | (((reg >> 5) & 3) << 2))
+
+
+def gprlr(save):
+    words = [d_form(62 if save else 58, r, 1, -(32 - r) * 8 - 8) for r in range(14, 32)]
+    if save:
+        return words + [d_form(36, 12, 1, -8), BLR]
+    return words + [d_form(32, 12, 1, -8), MTLR_R12, BLR]
+
+
+def fpr(save):
+    return [d_form(54 if save else 50, r, 12, -(32 - r) * 8) for r in range(14, 32)] + [BLR]
+
+
+def vmx14(save):
+    words = []
+    for r in range(14, 32):
+        words += [d_form(14, 11, 0, -(32 - r) * 16), x_form(31, r, 11, 12, 231 if save else 103)]
+    return words + [BLR]
+
+
+def vmx64(save):
+    words = []
+    for r in range(64, 128):
+        words += [d_form(14, 11, 0, -(128 - r) * 16), vmx128(save, r)]
+    return words + [BLR]
+
+
+def jmp(rng, save):
+    """stw/lwz r1,0(r3) then 20 more stores/loads off r3 (nonvolatile GPRs, LR, CR)"""
+    op = 36 if save else 32
+    words = [d_form(op, 1, 3, 0)]
+    for i in range(20):
+        words.append(d_form(op, 12 + i % 20, 3, 4 + i * 4))
+        if rng.random() < 0.3:
+            words.append(0x60000000)  # nop
+    return words + [BLR]
+
+
+HELPERS = [
+    # (key, make(rng) -> instruction words)
+    ('savegprlr_14', lambda rng: gprlr(True)),
+    ('restgprlr_14', lambda rng: gprlr(False)),
+    ('savefpr_14', lambda rng: fpr(True)),
+    ('restfpr_14', lambda rng: fpr(False)),
+    ('savevmx_14', lambda rng: vmx14(True)),
+    ('savevmx_64', lambda rng: vmx64(True)),
+    ('restvmx_14', lambda rng: vmx14(False)),
+    ('restvmx_64', lambda rng: vmx64(False)),
+]
+JMP = [('setjmp', lambda rng: jmp(rng, True)), ('longjmp', lambda rng: jmp(rng, False))]
+
+KEY_ORDER = ['savegprlr_14', 'restgprlr_14', 'savefpr_14', 'restfpr_14', 'savevmx_14',
+             'restvmx_14', 'savevmx_64', 'restvmx_64', 'setjmp', 'longjmp']
+
+
+def decoy(rng):
+    """A helper cut short or with one register wrong"""
+    _, make = rng.choice(HELPERS + JMP)
+    words = make(rng)
+    if words[0] in (d_form(36, 1, 3, 0), d_form(32, 1, 3, 0)):
+        return words[:rng.randint(1, 12)]          # too few r3 accesses
+    cut = rng.randint(4, len(words) - 1)
+    words = words[:cut]
+    if rng.random() < 0.5:
+        words[-1] ^= 1 << 21                        # wrong register
+    return words
+
+
+def put(text, off, words):
+    struct.pack_into('>%dI' % len(words), text, off, *words)
+
+
+def build(args):
+    rng = random.Random(args.seed)
+    size = max(args.size_mb << 20, TEXT_RVA + 0x40000)
+    text_size = size - TEXT_RVA
+    image = bytearray(size)
+    image[0x1000:TEXT_RVA] = rng.randbytes(TEXT_RVA - 0x1000)
+    text = bytearray(rng.randbytes(text_size))
+
+    helpers = HELPERS + (JMP if args.setjmp else [])
+    used = []                                       # (start, end) byte ranges in .text
+
+    def free(off, n):
+        return all(off + n <= s or off >= e for s, e in used)
+
+    def place(words, off=None):
+        n = len(words) * 4
+        while off is None:
+            cand = rng.randrange(0, text_size - n - 16) & ~15
+            if free(cand, n):
+                off = cand
+        put(text, off, words)
+        used.append((off, off + n))
+        return off
+
+    # Decoys go in first; with --layout crt the helpers then sit at the end
+    # of .text, after most of them, so a finder that takes the first anchor
+    # hit without checking the whole sequence reports a decoy
+    for _ in range(args.decoys):
+        place(decoy(rng))
+        for w in rng.sample([h(rng)[0] for _, h in helpers], 2):
+            place([w])                              # lone anchor word
+
+    expected = {}
+    if args.layout == 'crt':
+        code = [(key, make(rng)) for key, make in helpers]
+        total = sum(len(words) * 4 for _, words in code)
+        off = text_size - total - 0x1000
+        while not free(off, total):
+            off -= 0x1000
+        for key, words in code:
+            place(words, off)
+            expected[key] = BASE_ADDR + TEXT_RVA + off
+            off += len(words) * 4
+    else:
+        for key, make in helpers:
+            expected[key] = BASE_ADDR + TEXT_RVA + place(make(rng))
+
+    image[TEXT_RVA:] = text
+    if not args.no_pe:
+        image[0:2] = b'MZ'
+        struct.pack_into('<I', image, 0x3C, 0x100)
+        image[0x100:0x104] = b'PE\0\0'
+        sections = [(b'.rdata', 0x1000, TEXT_RVA - 0x1000, 0x40000040),
+                    (b'.text', TEXT_RVA, text_size, 0x60000020)]
+        struct.pack_into('<HHIIIHH', image, 0x104, 0x1F2, len(sections), 0, 0, 0, 0xE0, 0x102)
+        for i, (name, rva, vsize, flags) in enumerate(sections):
+            h = 0x118 + 0xE0 + 40 * i
+            image[h:h + len(name)] = name
+            struct.pack_into('<IIII', image, h + 8, vsize, rva, vsize, rva)
+            struct.pack_into('<I', image, h + 36, flags)
+    return bytes(image), expected
+
+
+def toml_block(expected):
+    lines = []
+    for key in KEY_ORDER:
+        if key in expected:
+            lines.append(f"{key}_address = 0x{expected[key]:08X}")
+        else:
+            lines.append(f"# {key}_address = NOT FOUND")
+    return "\n".join(lines) + "\n"
+
+
+if __name__ == '__main__':
+    ap = argparse.ArgumentParser(description='Build a synthetic PE image with PPC ABI helpers')
+    ap.add_argument('output')
+    ap.add_argument('--expect', help='write the expected TOML [main] block here')
+    ap.add_argument('--size-mb', type=int, default=4)
+    ap.add_argument('--layout', choices=['crt', 'random'], default='crt')
+    ap.add_argument('--setjmp', action='store_true', help='also place setjmp/longjmp')
+    ap.add_argument('--no-pe', action='store_true', help='no PE headers')
+    ap.add_argument('--decoys', type=int, default=40)
+    ap.add_argument('--seed', type=int, default=1)
+    args = ap.parse_args()
+
+    image, expected = build(args)
+    with open(args.output, 'wb') as f:
+        f.write(image)
+    if args.expect:
+        with open(args.expect, 'w') as f:
+            f.write(toml_block(expected))
+    print(f"Wrote {len(image)} bytes to {args.output} ({len(expected)} helpers)")
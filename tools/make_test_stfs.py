@@ -0,0 +1,195 @@
+#!/usr/bin/env python3
+"""
+Build a synthetic STFS LIVE package for testing the extractors.
+
+Random directory tree and files (empty, sub-block, exact-block, and large
+ones spanning many 170-block hash groups), laid out the way read-only LIVE
+packages are: file table at data block 0, files in contiguous block runs,
+hash tables interleaved with the data, every table filled in with real
+SHA-1s and block chains, and the top table's hash in the volume
+descriptor. --copies 2 writes the two-tables-per-slot layout instead.
+
+Usage: python make_test_stfs.py <output> [--size-mb N] [--files N]
+                                [--copies 1|2] [--seed N]
+"""
+
+import argparse
+import hashlib
+import random
+import struct
+
+BLOCK = 0x1000
+PER_TABLE = 170
+VOLUME_DESCRIPTOR = 0x379
+BLOCK_END = 0xFFFFFF
+
+
+class Layout:
+    """wxPirs block arithmetic, as in extract_stfs.py."""
+
+    def __init__(self, copies):
+        self.copies = copies
+        self.start = 0xC000 if copies == 1 else 0xD000
+        self.offset = BLOCK * copies
+
+    def block(self, b):
+        skip, x = 0, b
+        while x >= PER_TABLE:
+            x //= PER_TABLE
+            skip += (x + 1) * self.offset
+        return self.start + b * BLOCK + skip
+
+    def table(self, level, index):
+        if level == 0:
+            return self.block(index * PER_TABLE) - self.offset
+        if level == 1:
+            first = PER_TABLE if index == 0 else index * PER_TABLE * PER_TABLE
+            return self.block(first) - 2 * self.offset
+        return self.block(PER_TABLE * PER_TABLE) - 3 * self.offset
+
+
+WORDS = ['data', 'maps', 'audio', 'models', 'ui', 'fx', 'car', 'arena', 'desert',
+         'canyon', 'music', 'intro', 'hud', 'font', 'shader', 'lang', 'level']
+
+
+def make_tree(rng, files, total_bytes):
+    """Returns (dirs, files): dirs as (name, parent_dir_index or None),
+    files as (name, parent_dir_index or None, size)."""
+    dirs = []
+    for _ in range(max(1, files // 6)):
+        parent = rng.choice([None] + list(range(len(dirs))))
+        dirs.append((f"{rng.choice(WORDS)}{len(dirs)}", parent))
+
+    sizes = [0, 1, BLOCK - 1, BLOCK, BLOCK + 1, PER_TABLE * BLOCK, PER_TABLE * BLOCK + 7]
+    while len(sizes) < files:
+        sizes.append(rng.randint(1, 3 * PER_TABLE * BLOCK))
+    # One large file takes what is left of the size budget
+    sizes.append(max(total_bytes - sum(sizes), 0))
+    rng.shuffle(sizes)
+
+    out = []
+    for i, size in enumerate(sizes):
+        name = f"{rng.choice(WORDS)}_{i}.{rng.choice(['bin', 'dat', 'xpr', 'wav'])}"
+        if i == 3:
+            name = 'caf\xe9_' + name  # non-ASCII byte in the name
+        parent = None if i == 0 or not dirs or rng.random() < 0.2 else rng.randrange(len(dirs))
+        out.append((name, parent, size))
+    return dirs, out
+
+
+def entry(name, is_dir, blocks, start, path, size):
+    raw = name.encode('latin-1')
+    e = bytearray(64)
+    e[0:len(raw)] = raw
+    e[40] = len(raw) | (0x80 if is_dir else 0x40)
+    e[41:44] = struct.pack('<I', blocks)[:3]
+    e[44:47] = struct.pack('<I', blocks)[:3]
+    e[47:50] = struct.pack('<I', start)[:3]
+    struct.pack_into('>HIII', e, 50, path, size, 0x3A2B1C00, 0x3A2B1C00)
+    return bytes(e)
+
+
+def build(args):
+    rng = random.Random(args.seed)
+    layout = Layout(args.copies)
+    dirs, files = make_tree(rng, args.files, args.size_mb << 20)
+
+    # Entry order: one root file first (its start block doubles as the
+    # file table length for wxPirs-style readers), then directories
+    # (parents first), then the remaining files.
+    n_entries = len(files) + len(dirs)
+    table_blocks = (n_entries * 64 + BLOCK - 1) // BLOCK
+    dir_entry = lambda d: 1 + d
+    entries = []
+    chains = [(0, table_blocks)]                 # (first block, count)
+    next_block = table_blocks
+    placed = []
+    for name, parent, size in files:
+        blocks = (size + BLOCK - 1) // BLOCK
+        placed.append((name, parent, size, next_block, blocks))
+        if blocks:
+            chains.append((next_block, blocks))
+        next_block += blocks
+    total_blocks = next_block
+
+    first = placed[0]
+    entries.append(entry(first[0], False, first[4], first[3], 0xFFFF, first[2]))
+    for name, parent in dirs:
+        entries.append(entry(name, True, 0, 0, 0xFFFF if parent is None else dir_entry(parent), 0))
+    for name, parent, size, start, blocks in placed[1:]:
+        path = 0xFFFF if parent is None else dir_entry(parent)
+        entries.append(entry(name, False, blocks, max(start, 1), path, size))
+
+    out_size = layout.block(total_blocks - 1) + BLOCK
+    pkg = bytearray(out_size)
+    pkg[0:4] = b'LIVE'
+
+    def put_block(b, data):
+        off = layout.block(b)
+        pkg[off:off + len(data)] = data
+
+    table = b''.join(entries)
+    for i in range(table_blocks):
+        put_block(i, table[i * BLOCK:(i + 1) * BLOCK])
+    for name, parent, size, start, blocks in placed:
+        if size:
+            put_block(start, rng.randbytes(size))
+
+    # Level 0: each data block's hash and the next block in its chain
+    nexts = {}
+    for first_block, count in chains:
+        for b in range(first_block, first_block + count):
+            nexts[b] = b + 1 if b + 1 < first_block + count else BLOCK_END
+
+    def write_table(off, entries_bytes):
+        for c in range(layout.copies):
+            pkg[off + c * BLOCK:off + c * BLOCK + len(entries_bytes)] = entries_bytes
+
+    def table_block(off):
+        return bytes(pkg[off:off + BLOCK])
+
+    groups = (total_blocks + PER_TABLE - 1) // PER_TABLE
+    for g in range(groups):
+        t = bytearray()
+        for b in range(g * PER_TABLE, min(total_blocks, (g + 1) * PER_TABLE)):
+            off = layout.block(b)
+            t += hashlib.sha1(bytes(pkg[off:off + BLOCK])).digest()
+            t += bytes([0x80]) + struct.pack('>I', nexts.get(b, BLOCK_END))[1:]
+        write_table(layout.table(0, g), t)
+
+    top_level = 0 if total_blocks <= PER_TABLE else 1 if total_blocks <= PER_TABLE ** 2 else 2
+    count = groups
+    for level in range(1, top_level + 1):
+        parents = (count + PER_TABLE - 1) // PER_TABLE
+        for p in range(parents):
+            t = bytearray()
+            for i in range(p * PER_TABLE, min(count, (p + 1) * PER_TABLE)):
+                t += hashlib.sha1(table_block(layout.table(level - 1, i))).digest()
+                t += b'\x00\x00\x00\x00'
+            write_table(layout.table(level, p), t)
+        count = parents
+    top = hashlib.sha1(table_block(layout.table(top_level, 0))).digest()
+
+    vd = bytearray(0x24)
+    vd[0] = 0x24
+    vd[2] = 1 if args.copies == 1 else 0      # block separation
+    struct.pack_into('<H', vd, 3, table_blocks)
+    vd[8:28] = top
+    struct.pack_into('>II', vd, 0x1C, total_blocks, 0)
+    pkg[VOLUME_DESCRIPTOR:VOLUME_DESCRIPTOR + 0x24] = vd
+    return bytes(pkg), len(placed), total_blocks
+
+
+if __name__ == '__main__':
+    ap = argparse.ArgumentParser(description='Build a synthetic STFS LIVE package')
+    ap.add_argument('output')
+    ap.add_argument('--size-mb', type=int, default=32)
+    ap.add_argument('--files', type=int, default=40)
+    ap.add_argument('--copies', type=int, choices=[1, 2], default=1)
+    ap.add_argument('--seed', type=int, default=1)
+    args = ap.parse_args()
+
+    pkg, nfiles, nblocks = build(args)
+    with open(args.output, 'wb') as f:
+        f.write(pkg)
+    print(f"Wrote {len(pkg)} bytes to {args.output} ({nfiles} files, {nblocks} blocks)")
@@ -0,0 +1,450 @@
+#!/usr/bin/env python3
+"""
+Generate a synthetic XEX2 for testing the extractors.
+
+The image is random but shaped like a game executable: an MZ header, code
+made of a small instruction vocabulary with E8 bytes sprinkled in, strided
+data records, strings and zero-filled runs. It is wrapped the way retail
+XEX2 files are: an encrypted file key in the security info, AES-128-CBC
+over everything from the PE data offset, and one of three compressions:
+
+  none   image stored as-is
+  basic  { data_size, zero_size } blocks; zero runs are dropped
+  lzx    "normal" compression: a chain of SHA-1 linked blocks carrying an
+         LZX stream. The encoder here is deliberately simple (greedy
+         matching, random-shaped Huffman codes) but emits every block type,
+         repeated offsets, frame-spanning blocks and E8 translation, so it
+         exercises all of a decoder's paths.
+
+--expect writes the decoded image the extractor should produce.
+tools/extract_pe.py only understands none/basic (it copies LZX data
+through undecoded); compare LZX output against --expect instead.
+
+Usage: python make_test_xex.py <output.xex> [--compression none|basic|lzx]
+                               [--size BYTES] [--seed N] [--no-encrypt]
+                               [--expect image.bin]
+"""
+
+import argparse
+import hashlib
+import random
+import struct
+import sys
+
+try:
+    from Crypto.Cipher import AES
+except ImportError:
+    try:
+        from Cryptodome.Cipher import AES
+    except ImportError:
+        print("ERROR: pycryptodome is required. Install with: pip install pycryptodome")
+        sys.exit(1)
+
+
+XEX2_RETAIL_KEY = bytes([
+    0x20, 0xB1, 0x85, 0xA5, 0x9D, 0x28, 0xFD, 0xC3,
+    0x40, 0x58, 0x3F, 0xBB, 0x08, 0x96, 0xBF, 0x91
+])
+IMAGE_BASE = 0x82000000
+SEC_INFO_OFFSET = 0x100
+FFI_OFFSET = 0x300
+LZX_WINDOW = 0x8000
+
+
+# ----------------------------------------------------------------------------
+# Image
+# ----------------------------------------------------------------------------
+
+def make_image(size, rng):
+    """Returns [(data, zero_count)] segments totalling `size` bytes."""
+    vocab = [rng.getrandbits(32).to_bytes(4, 'big') for _ in range(48)]
+    vocab += [b'\xE8' + rng.getrandbits(24).to_bytes(3, 'little') for _ in range(8)]
+    words = [b'player', b'session', b'texture', b'render', b'sound', b'vehicle',
+             b'weapon', b'network', b'lobby', b'script', b'\x00', b'_', b'.', b'/']
+
+    header = bytearray(0x400)
+    header[0:2] = b'MZ'
+    struct.pack_into('<I', header, 0x3C, 0x80)
+    header[0x80:0x84] = b'PE\x00\x00'
+    segments = [(bytes(header), 0)]
+    total = len(header)
+
+    while total < size:
+        kind = rng.random()
+        n = rng.randint(0x100, 0x10000)
+        if kind < 0.5:
+            # Code: vocabulary words, one in eight with a random immediate
+            data = b''.join(vocab[rng.randrange(len(vocab))] if rng.random() < 0.875
+                            else rng.getrandbits(32).to_bytes(4, 'big')
+                            for _ in range(n // 4))
+        elif kind < 0.7:
+            # Records with a fixed stride and a few changing fields
+            stride = rng.choice([12, 16, 24, 40])
+            rec = bytearray(rng.getrandbits(8) for _ in range(stride))
+            out = bytearray()
+            for i in range(n // stride):
+                struct.pack_into('>I', rec, 0, i)
+                if rng.random() < 0.3:
+                    rec[rng.randrange(4, stride)] = rng.getrandbits(8)
+                out += rec
+            data = bytes(out)
+        elif kind < 0.85:
+            data = b''.join(rng.choice(words) for _ in range(n // 6))
+        else:
+            data = bytes(rng.getrandbits(8) for _ in range(n // 8))
+        zeros = rng.choice([0, 0, rng.randint(1, 0x4000)])
+        segments.append((data, zeros))
+        total += len(data) + zeros
+
+    # Trim to the exact size
+    out, total = [], 0
+    for data, zeros in segments:
+        data = data[:size - total]
+        total += len(data)
+        zeros = min(zeros, size - total)
+        total += zeros
+        if data or zeros:
+            out.append((data, zeros))
+        if total == size:
+            break
+    return out
+
+
+# ----------------------------------------------------------------------------
+# LZX encoder
+# ----------------------------------------------------------------------------
+
+LZX_FRAME = 32768
+
+EXTRA_BITS = []
+POSITION_BASE = []
+_j = 0
+for _i in range(0, 51, 2):
+    EXTRA_BITS += [_j, _j]
+    if _i != 0 and _j < 17:
+        _j += 1
+EXTRA_BITS = EXTRA_BITS[:51]
+_base = 0
+for _i in range(51):
+    POSITION_BASE.append(_base)
+    _base += 1 << EXTRA_BITS[_i]
+POSITION_SLOTS = {15: 30, 16: 32, 17: 34, 18: 36, 19: 38, 20: 42, 21: 50}
+
+
+class BitWriter:
+    """16-bit little-endian words, filled most significant bit first."""
+
+    def __init__(self):
+        self.out = bytearray()
+        self.acc = 0
+        self.n = 0
+
+    def bits(self, value, count):
+        self.acc = (self.acc << count) | value
+        self.n += count
+        while self.n >= 16:
+            self.n -= 16
+            self.out += struct.pack('<H', (self.acc >> self.n) & 0xFFFF)
+        self.acc &= (1 << self.n) - 1
+
+    def align(self):
+        if self.n:
+            self.bits(0, 16 - self.n)
+
+
+def random_lengths(count, rng, max_len=16):
+    """A random complete prefix code over `count` symbols. Grown by
+    splitting leaves, often the newest (deepest) one, so some codes reach
+    max_len the way skewed real trees do."""
+    leaves = [0]
+    while len(leaves) < count:
+        i = len(leaves) - 1 if rng.random() < 0.3 else rng.randrange(len(leaves))
+        if leaves[i] >= max_len:
+            i = min(range(len(leaves)), key=leaves.__getitem__)
+        depth = leaves.pop(i) + 1
+        leaves += [depth, depth]
+    rng.shuffle(leaves)
+    return leaves
+
+
+def canonical_codes(lens):
+    codes = [0] * len(lens)
+    code = 0
+    for length in range(1, 17):
+        for sym, l in enumerate(lens):
+            if l == length:
+                codes[sym] = code
+                code += 1
+        code <<= 1
+    return codes
+
+
+class LzxEncoder:
+    def __init__(self, window_size, rng, e8_filesize):
+        self.rng = rng
+        self.slots = POSITION_SLOTS[window_size.bit_length() - 1]
+        self.window = window_size
+        self.main_size = 256 + self.slots * 8
+        self.main_prev = [0] * self.main_size
+        self.length_prev = [0] * 249
+        self.r = [1, 1, 1]
+        self.e8_filesize = e8_filesize
+        self.w = BitWriter()
+
+    def write_lengths(self, prev, new, first, last):
+        pre_lens = random_lengths(20, self.rng, 15)
+        pre_codes = canonical_codes(pre_lens)
+        for l in pre_lens:
+            self.w.bits(l, 4)
+
+        def sym(z):
+            self.w.bits(pre_codes[z], pre_lens[z])
+
+        x = first
+        while x < last:
+            run = 5 if x + 5 <= last and len(set(new[x:x + 5])) == 1 else \
+                  4 if x + 4 <= last and len(set(new[x:x + 4])) == 1 else 0
+            if run and self.rng.random() < 0.5:
+                # Code 19: a run of 4-5 equal lengths, delta against the first
+                sym(19)
+                self.w.bits(run - 4, 1)
+                sym((prev[x] - new[x]) % 17)
+                for i in range(run):
+                    prev[x + i] = new[x]
+                x += run
+            else:
+                sym((prev[x] - new[x]) % 17)
+                prev[x] = new[x]
+                x += 1
+
+    def find_match(self, data, pos, limit, table):
+        best_len, best_off = 0, 0
+        cands = list(self.r)
+        key = data[pos:pos + 3]
+        if key in table:
+            cands.append(pos - table[key])
+        for off in cands:
+            # Slot 29 tops out at window - 3
+            if off < 1 or off > pos or off > self.window - 3:
+                continue
+            n = 0
+            while n < limit and data[pos + n - off] == data[pos + n]:
+                n += 1
+            if n > best_len:
+                best_len, best_off = n, off
+        return best_len, best_off
+
+    def compressed_block(self, data, start, end, aligned, table):
+        w = self.w
+        w.bits(2 if aligned else 1, 3)
+        w.bits((end - start) >> 8, 16)
+        w.bits((end - start) & 0xFF, 8)
+        if aligned:
+            aligned_lens = random_lengths(8, self.rng, 7)
+            for l in aligned_lens:
+                w.bits(l, 3)
+            aligned_codes = canonical_codes(aligned_lens)
+
+        main_lens = random_lengths(self.main_size, self.rng)
+        length_lens = random_lengths(249, self.rng)
+        self.write_lengths(self.main_prev, main_lens, 0, 256)
+        self.write_lengths(self.main_prev, main_lens, 256, self.main_size)
+        self.write_lengths(self.length_prev, length_lens, 0, 249)
+        main_codes = canonical_codes(main_lens)
+        length_codes = canonical_codes(length_lens)
+
+        pos = start
+        while pos < end:
+            if pos % LZX_FRAME == 0 and pos != start:
+                w.align()
+            frame_end = (pos // LZX_FRAME + 1) * LZX_FRAME
+            limit = min(257, end - pos, frame_end - pos)
+            length, off = self.find_match(data, pos, limit, table) if limit >= 3 else (0, 0)
+            for i in range(pos, pos + max(length, 1)):
+                table[data[i:i + 3]] = i
+            if length < 3:
+                s = data[pos]
+                w.bits(main_codes[s], main_lens[s])
+                pos += 1
+                continue
+
+            if off == self.r[0]:
+                slot = 0
+            elif off == self.r[1]:
+                slot = 1
+                self.r[0], self.r[1] = self.r[1], self.r[0]
+            elif off == self.r[2]:
+                slot = 2
+                self.r[0], self.r[2] = self.r[2], self.r[0]
+            else:
+                formatted = off + 2
+                slot = 3
+                while slot + 1 < self.slots and POSITION_BASE[slot + 1] <= formatted:
+                    slot += 1
+                self.r = [off, self.r[0], self.r[1]]
+            header = min(length - 2, 7)
+            s = 256 + slot * 8 + header
+            w.bits(main_codes[s], main_lens[s])
+            if header == 7:
+                ls = length - 9
+                w.bits(length_codes[ls], length_lens[ls])
+            if slot > 2:
+                footer = off + 2 - POSITION_BASE[slot]
+                extra = EXTRA_BITS[slot]
+                if aligned and extra >= 3:
+                    w.bits(footer >> 3, extra - 3)
+                    w.bits(aligned_codes[footer & 7], aligned_lens[footer & 7])
+                elif extra:
+                    w.bits(footer, extra)
+            pos += length
+
+    def uncompressed_block(self, data, start, end, table):
+        w = self.w
+        w.bits(3, 3)
+        w.bits((end - start) >> 8, 16)
+        w.bits((end - start) & 0xFF, 8)
+        if w.n == 0:
+            w.bits(0, 16)  # 1-16 bits of padding, never 0
+        w.align()
+        for r in self.r:
+            w.out += struct.pack('<I', r)
+        w.out += data[start:end]
+        if (end - start) & 1:
+            w.out += b'\x00'
+        for i in range(start, end):
+            table[data[i:i + 3]] = i
+
+    def e8_translate(self, data):
+        """Forward call translation; the decoder undoes this per frame."""
+        out = bytearray(data)
+        size = self.e8_filesize
+        for frame_start in range(0, len(out), LZX_FRAME):
+            frame_size = min(LZX_FRAME, len(out) - frame_start)
+            if frame_size <= 10 or frame_start // LZX_FRAME >= 32768:
+                continue
+            i, end = frame_start, frame_start + frame_size - 10
+            while i < end:
+                if out[i] != 0xE8:
+                    i += 1
+                    continue
+                curpos = i
+                rel = struct.unpack_from('<i', out, i + 1)[0]
+                if -curpos <= rel < size:
+                    absolute = rel + curpos if rel < size - curpos else rel - size
+                    struct.pack_into('<i', out, i + 1, absolute)
+                i += 5
+        return bytes(out)
+
+    def encode(self, data):
+        if self.e8_filesize:
+            self.w.bits(1, 1)
+            self.w.bits(self.e8_filesize >> 16, 16)
+            self.w.bits(self.e8_filesize & 0xFFFF, 16)
+            data = self.e8_translate(data)
+        else:
+            self.w.bits(0, 1)
+        table = {}
+        pos = 0
+        while pos < len(data):
+            end = min(len(data), pos + self.rng.randint(1, 70000))
+            kind = self.rng.random()
+            if kind < 0.15:
+                self.uncompressed_block(data, pos, end, table)
+            else:
+                self.compressed_block(data, pos, end, kind < 0.5, table)
+            # Frame boundaries re-align the stream
+            if end % LZX_FRAME == 0:
+                self.w.align()
+            pos = end
+        self.w.align()
+        return bytes(self.w.out)
+
+
+def lzx_blocks(stream, rng):
+    """Split an LZX stream into the XEX normal-compression block chain."""
+    chunks_per_block = []
+    pos = 0
+    while pos < len(stream):
+        chunks = []
+        for _ in range(rng.randint(1, 4)):
+            if pos >= len(stream):
+                break
+            n = min(len(stream) - pos, rng.randint(1, 0x8000))
+            chunks.append(stream[pos:pos + n])
+            pos += n
+        chunks_per_block.append(chunks)
+
+    # Built back to front: each block carries the next one's size and hash
+    blocks = []
+    next_size, next_hash = 0, b'\x00' * 20
+    for chunks in reversed(chunks_per_block):
+        body = b''.join(struct.pack('>H', len(c)) + c for c in chunks) + b'\x00\x00'
+        body += b'\x00' * rng.randint(0, 64)
+        block = struct.pack('>I', next_size) + next_hash + body
+        blocks.append(block)
+        next_size, next_hash = len(block), hashlib.sha1(block).digest()
+    blocks.reverse()
+    return b''.join(blocks), next_size, next_hash
+
+
+# ----------------------------------------------------------------------------
+# XEX2
+# ----------------------------------------------------------------------------
+
+def make_xex(compression, size, seed, encrypt):
+    rng = random.Random(seed)
+    segments = make_image(size, rng)
+    image = b''.join(data + b'\x00' * zeros for data, zeros in segments)
+
+    if compression == 'none':
+        pe = image
+        ffi = struct.pack('>IHH', 8, 1 if encrypt else 0, 0)
+    elif compression == 'basic':
+        pe = b''.join(data for data, _ in segments)
+        desc = b''.join(struct.pack('>II', len(d), z) for d, z in segments)
+        ffi = struct.pack('>IHH', 8 + len(desc) + 8, 1 if encrypt else 0, 1) + desc + b'\x00' * 8
+    else:
+        stream = LzxEncoder(LZX_WINDOW, rng, rng.choice([0, 12000000])).encode(image)
+        pe, first_size, first_hash = lzx_blocks(stream, rng)
+        ffi = struct.pack('>IHH', 36, 1 if encrypt else 0, 2)
+        ffi += struct.pack('>II', LZX_WINDOW, first_size) + first_hash
+
+    header_size = (FFI_OFFSET + len(ffi) + 0xFFF) & ~0xFFF
+    hdr = bytearray(header_size)
+    hdr[0:4] = b'XEX2'
+    struct.pack_into('>IIIII', hdr, 4, 0, header_size, 0, SEC_INFO_OFFSET, 3)
+    struct.pack_into('>II', hdr, 24, (0x000003 << 8) | 0xFF, FFI_OFFSET)
+    struct.pack_into('>II', hdr, 32, 0x000101 << 8, IMAGE_BASE + 0x1234)
+    struct.pack_into('>II', hdr, 40, (0x000102 << 8) | 1, IMAGE_BASE)
+    struct.pack_into('>I', hdr, SEC_INFO_OFFSET + 4, len(image))
+    struct.pack_into('>I', hdr, SEC_INFO_OFFSET + 0x110, IMAGE_BASE)
+    hdr[FFI_OFFSET:FFI_OFFSET + len(ffi)] = ffi
+
+    if encrypt:
+        file_key = bytes(rng.getrandbits(8) for _ in range(16))
+        # CBC with a zero IV over one block is ECB
+        hdr[SEC_INFO_OFFSET + 0x150:SEC_INFO_OFFSET + 0x160] = \
+            AES.new(XEX2_RETAIL_KEY, AES.MODE_ECB).encrypt(file_key)
+        pe += b'\x00' * ((16 - len(pe) % 16) % 16)
+        pe = AES.new(file_key, AES.MODE_CBC, b'\x00' * 16).encrypt(pe)
+    return bytes(hdr) + pe, image
+
+
+if __name__ == '__main__':
+    ap = argparse.ArgumentParser(description='Generate a synthetic XEX2 file')
+    ap.add_argument('output')
+    ap.add_argument('--compression', choices=['none', 'basic', 'lzx'], default='basic')
+    ap.add_argument('--size', type=lambda s: int(s, 0), default=0x300000)
+    ap.add_argument('--seed', type=int, default=1)
+    ap.add_argument('--no-encrypt', action='store_true')
+    ap.add_argument('--expect', help='also write the expected PE image here')
+    args = ap.parse_args()
+
+    xex, image = make_xex(args.compression, args.size, args.seed, not args.no_encrypt)
+    with open(args.output, 'wb') as f:
+        f.write(xex)
+    print(f"Wrote {len(xex)} bytes to {args.output} "
+          f"({args.compression}, image 0x{len(image):X})")
+    if args.expect:
+        with open(args.expect, 'wb') as f:
+            f.write(image)
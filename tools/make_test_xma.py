@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+"""
+Build a synthetic XMA corpus for the XMA decode benchmark
+(bench_xma_decode) and the legacy runtime's XMA contexts (src/xma.cpp).
+
+Each stream is a sequence of 2048-byte XMA packets. Every packet starts
+with the 32-bit header (frame count, bit offset of the first frame that
+starts in the packet, metadata, skip count); frames are a 15-bit length
+(in bits, the length field included) followed by random payload, packed
+back to back across packet boundaries, with 0x7FFF padding at the end.
+The payload is not real WMA Pro data; a decoder behind the runtime's
+frame-decoder seam sees it as random bits.
+
+Streams are wrapped in RIFF/WAVE files with an XMA2WAVEFORMATEX fmt
+chunk, alternately little-endian (PC tools) and big-endian (as stored on
+the console), and packed into one bundle with junk between them, the way
+the game keeps its sounds in sounds.ib. --separate writes one .wav per
+stream instead.
+
+--expect writes, per stream in bundle order, a `frames = N` line and a
+`payload_crc = X` line: the CRC-32 of the stream's frame payloads (each
+without its length field, MSB first, zero-padded to a byte), in order.
+That is what the decoder is handed.
+
+Usage: python make_test_xma.py <output_dir> [--streams N] [--seconds S]
+                               [--stereo-ratio R] [--separate]
+                               [--expect FILE] [--seed N]
+"""
+
+import argparse
+import os
+import random
+import struct
+import zlib
+
+PACKET_SIZE = 2048
+PACKET_BITS = PACKET_SIZE * 8
+PAYLOAD_BITS = PACKET_BITS - 32
+FRAME_SAMPLES = 512
+SAMPLE_RATE = 48000
+PADDING = 0x7FFF
+
+
+def build_stream(rng, frames, stereo):
+    """Packets for `frames` frames, as bytes, and the CRC-32 of their payloads"""
+    bits, nbits, starts, crc = 0, 0, [], 0
+    lo, hi = (1200, 5000) if stereo else (600, 3000)
+    for _ in range(frames):
+        length = rng.randint(lo, hi)
+        starts.append(nbits)
+        payload = rng.getrandbits(length - 15)
+        pad = -(length - 15) % 8
+        crc = zlib.crc32((payload << pad).to_bytes((length - 15 + pad) // 8, 'big'), crc)
+        bits = (bits << length) | (length << (length - 15)) | payload
+        nbits += length
+
+    # Pad to the end of the packet; a tail too short for a length field
+    # runs on into one more packet of padding
+    tail = -nbits % PAYLOAD_BITS
+    if 0 < tail < 15:
+        tail += PAYLOAD_BITS
+    bits = (bits << tail) | ((1 << tail) - 1)
+    nbits += tail
+
+    out = bytearray()
+    start_index = 0
+    for p in range(nbits // PAYLOAD_BITS):
+        begin, end = p * PAYLOAD_BITS, (p + 1) * PAYLOAD_BITS
+        count, first = 0, PADDING
+        while start_index < len(starts) and starts[start_index] < end:
+            if count == 0:
+                first = starts[start_index] - begin
+            count += 1
+            start_index += 1
+        header = (count << 26) | (first << 11) | (1 << 8) | 0
+        payload = (bits >> (nbits - end)) & ((1 << PAYLOAD_BITS) - 1)
+        out += struct.pack('>I', header) + payload.to_bytes(PAYLOAD_BITS // 8, 'big')
+    return bytes(out), crc
+
+
+def riff(data, channels, frames, big_endian):
+    """RIFF/WAVE with an XMA2WAVEFORMATEX fmt chunk"""
+    e = '>' if big_endian else '<'
+    samples = frames * FRAME_SAMPLES
+    fmt = struct.pack(e + 'HHIIHHH', 0x166, channels, SAMPLE_RATE, len(data) * SAMPLE_RATE // max(samples, 1),
+                      channels * 2, 16, 34)
+    fmt += struct.pack(e + 'HIIIIIIIBBH', 1, 0x3 if channels == 2 else 0x4, samples, len(data),
+                       0, samples, 0, 0, 0, 4, 1)
+    body = b'WAVE' + b'fmt ' + struct.pack(e + 'I', len(fmt)) + fmt + b'data' + struct.pack(e + 'I', len(data)) + data
+    return b'RIFF' + struct.pack(e + 'I', len(body)) + body
+
+
+if __name__ == '__main__':
+    ap = argparse.ArgumentParser(description='Build a synthetic XMA corpus')
+    ap.add_argument('output_dir')
+    ap.add_argument('--streams', type=int, default=12)
+    ap.add_argument('--seconds', type=float, default=3.0, help='length of each stream')
+    ap.add_argument('--stereo-ratio', type=float, default=0.25)
+    ap.add_argument('--separate', action='store_true', help='one .wav per stream instead of a bundle')
+    ap.add_argument('--expect', help='write the per-stream frame counts here')
+    ap.add_argument('--seed', type=int, default=1)
+    args = ap.parse_args()
+
+    rng = random.Random(args.seed)
+    os.makedirs(args.output_dir, exist_ok=True)
+    bundle = bytearray(rng.randbytes(64))
+    counts, crcs = [], []
+    total = 0
+    for i in range(args.streams):
+        stereo = rng.random() < args.stereo_ratio
+        frames = max(1, int(args.seconds * SAMPLE_RATE / FRAME_SAMPLES * rng.uniform(0.5, 1.5)))
+        data, crc = build_stream(rng, frames, stereo)
+        wav = riff(data, 2 if stereo else 1, frames, big_endian=bool(i & 1))
+        counts.append(frames)
+        crcs.append(crc)
+        total += len(data)
+        if args.separate:
+            with open(os.path.join(args.output_dir, f'stream_{i:03d}.wav'), 'wb') as f:
+                f.write(wav)
+        else:
+            bundle += wav + rng.randbytes(rng.randrange(16, 600))
+    if not args.separate:
+        with open(os.path.join(args.output_dir, 'sounds.ib'), 'wb') as f:
+            f.write(bundle)
+    if args.expect:
+        with open(args.expect, 'w') as f:
+            f.write(''.join(f"frames = {n}\npayload_crc = {c:08X}\n" for n, c in zip(counts, crcs)))
+    print(f"Wrote {args.streams} streams, {sum(counts)} frames, {total // PACKET_SIZE} packets to {args.output_dir}")
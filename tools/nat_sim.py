@@ -0,0 +1,251 @@
+#!/usr/bin/env python3
+"""
+NAT simulator for testing direct peer paths (UDP hole punching).
+
+Builds this topology out of Linux network namespaces (needs root):
+
+    v8h1 192.168.1.10 -- v8nat1 (masquerade) --+
+                                               +-- v8wan -- v8relay 100.64.3.2
+    v8h2 192.168.2.10 -- v8nat2 (masquerade) --+
+
+Each NAT masquerades its LAN behind its WAN address (100.64.1.2 and
+100.64.2.2), so neither host can reach the other's LAN address. --wan-delay
+is added in each direction on both NAT uplinks and --relay-delay on the
+link to v8relay, which stands where a relay would sit, so relaying would
+be a real extra hop.
+
+v8relay runs this script's own STUN responder (`nat_sim.py stun`, RFC 5389
+Binding only). It only answers STUN and keeps no sessions. Both instances
+use the responder as stun_server and publish the public endpoint it
+reports. Their unicast discovery targets are the other NAT's WAN address,
+so beacons flow (and open each NAT) without an xlive relay. Pass
+--xlive-relay host:port to also register sessions with a real relay
+reachable from the namespaces.
+
+Host is v8h1 and the joiner is v8h2, driven by controller scripts as in
+syslink_harness.py. After --duration seconds the script reports each
+instance's direct paths (state, endpoint, probe RTT). It compares that with
+the round trip through the relay: the sum of both hosts' ping RTTs to it.
+
+Usage:
+  sudo python3 nat_sim.py run --exe build/vig8_test --game /games/vig8 \\
+      --host-script host.txt --join-script join.txt \\
+      --duration 90 --wan-delay 10 --relay-delay 25
+  sudo python3 nat_sim.py down      # remove leftover namespaces
+  python3 nat_sim.py stun [--port 3478]   # the STUN responder on its own
+"""
+
+import argparse
+import json
+import os
+import re
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+NAMESPACES = ["v8h1", "v8h2", "v8nat1", "v8nat2", "v8wan", "v8relay"]
+HOSTS = [("v8h1", "192.168.1.10"), ("v8h2", "192.168.2.10")]
+NAT_WAN = ["100.64.1.2", "100.64.2.2"]
+RELAY_IP = "100.64.3.2"
+RELAY_PORT = 36000
+STUN_PORT = 3478
+STUN_COOKIE = 0x2112A442
+
+
+def sh(*cmd, check=True):
+    return subprocess.run(cmd, check=check, capture_output=True, text=True)
+
+
+def ns(name, *cmd, check=True):
+    return sh("ip", "netns", "exec", name, *cmd, check=check)
+
+
+def link(a, a_if, a_ip, b, b_if, b_ip, delay_ms=0):
+    sh("ip", "link", "add", a_if, "netns", a, "type", "veth", "peer", b_if, "netns", b)
+    for n, ifname, ip in ((a, a_if, a_ip), (b, b_if, b_ip)):
+        ns(n, "ip", "addr", "add", ip, "dev", ifname)
+        ns(n, "ip", "link", "set", ifname, "up")
+        if delay_ms:
+            ns(n, "tc", "qdisc", "add", "dev", ifname, "root", "netem", "delay", "%dms" % delay_ms)
+
+
+def down():
+    for n in NAMESPACES:
+        sh("ip", "netns", "del", n, check=False)
+
+
+def up(args):
+    down()
+    for n in NAMESPACES:
+        sh("ip", "netns", "add", n)
+        ns(n, "ip", "link", "set", "lo", "up")
+    for n in ("v8wan", "v8nat1", "v8nat2"):
+        ns(n, "sysctl", "-qw", "net.ipv4.ip_forward=1")
+
+    link("v8wan", "to-nat1", "100.64.1.1/24", "v8nat1", "wan", NAT_WAN[0] + "/24", args.wan_delay)
+    link("v8wan", "to-nat2", "100.64.2.1/24", "v8nat2", "wan", NAT_WAN[1] + "/24", args.wan_delay)
+    link("v8wan", "to-relay", "100.64.3.1/24", "v8relay", "wan", RELAY_IP + "/24", args.relay_delay)
+    link("v8nat1", "lan", "192.168.1.1/24", "v8h1", "eth0", HOSTS[0][1] + "/24")
+    link("v8nat2", "lan", "192.168.2.1/24", "v8h2", "eth0", HOSTS[1][1] + "/24")
+
+    for i, nat in enumerate(("v8nat1", "v8nat2")):
+        ns(nat, "ip", "route", "add", "default", "via", "100.64.%d.1" % (i + 1))
+        ns(nat, "iptables", "-t", "nat", "-A", "POSTROUTING", "-o", "wan", "-j", "MASQUERADE")
+        ns(HOSTS[i][0], "ip", "route", "add", "default", "via", "192.168.%d.1" % (i + 1))
+    ns("v8relay", "ip", "route", "add", "default", "via", "100.64.3.1")
+
+
+def toml_str(s):
+    return '"' + s.replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+def write_settings(path, args, i, stats_path):
+    script = args.host_script if i == 0 else args.join_script
+    relay_host, relay_port = "", RELAY_PORT
+    if args.xlive_relay:
+        relay_host, _, port = args.xlive_relay.partition(":")
+        relay_port = int(port or RELAY_PORT)
+    lines = [
+        "[game]",
+        "full_game = true",
+        "",
+        "[network]",
+        "lan_port = %d" % args.port,
+        "relay_enabled = %s" % ("true" if args.xlive_relay else "false"),
+        "relay_host = %s" % toml_str(relay_host),
+        "relay_port = %d" % relay_port,
+        "bind_address = %s" % toml_str(HOSTS[i][1]),
+        "discovery_peers = [%s]" % toml_str("%s:%d" % (NAT_WAN[1 - i], args.port)),
+        "stun_server = %s" % toml_str("%s:%d" % (RELAY_IP, STUN_PORT)),
+        "",
+        "[test]",
+        "stats_file = %s" % toml_str(stats_path),
+    ]
+    if script:
+        lines.append("input_script = %s" % toml_str(os.path.abspath(script)))
+    with open(path, "w") as f:
+        f.write("\n".join(lines) + "\n")
+
+
+def ping_rtt_ms(name, ip):
+    out = ns(name, "ping", "-c", "5", "-i", "0.2", ip, check=False).stdout
+    m = re.search(r"= [\d.]+/([\d.]+)/", out)
+    return float(m.group(1)) if m else None
+
+
+def report(procs):
+    print("\n=== direct paths ===")
+    for p in procs:
+        try:
+            with open(p["stats"]) as f:
+                stats = json.load(f)
+        except (OSError, ValueError):
+            print("%s: no stats" % p["ns"])
+            continue
+        paths = stats.get("direct_paths", [])
+        if not paths:
+            print("%s: no direct paths" % p["ns"])
+        for d in paths:
+            rtt = "%.1f ms" % (d["rtt_us"] / 1000.0) if d["rtt_us"] >= 0 else "-"
+            print("%s: peer %s %s via %s, rtt %s, attempts %d"
+                  % (p["ns"], d["ip"], d["state"], d["endpoint"], rtt, d["attempts"]))
+
+    legs = [ping_rtt_ms(name, RELAY_IP) for name, _ in HOSTS]
+    if None not in legs:
+        print("relay path rtt (h1->relay + relay->h2): %.1f ms" % sum(legs))
+
+
+def stun_serve(port):
+    """Answer STUN Binding requests with the address they came from"""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("0.0.0.0", port))
+    print("[nat_sim] STUN responder on udp/%d" % port, flush=True)
+    while True:
+        data, (ip, src_port) = sock.recvfrom(2048)
+        if len(data) < 20:
+            continue
+        msg_type, _, cookie = struct.unpack(">HHI", data[:8])
+        if msg_type != 0x0001 or cookie != STUN_COOKIE:
+            continue
+        addr = struct.unpack(">I", socket.inet_aton(ip))[0]
+        xor_mapped = struct.pack(">HHBBHI", 0x0020, 8, 0, 0x01,
+                                 src_port ^ (STUN_COOKIE >> 16), addr ^ STUN_COOKIE)
+        header = struct.pack(">HHI", 0x0101, len(xor_mapped), STUN_COOKIE) + data[8:20]
+        sock.sendto(header + xor_mapped, (ip, src_port))
+
+
+def run(args):
+    up(args)
+    workdir = args.workdir or tempfile.mkdtemp(prefix="vig8_nat_")
+    os.makedirs(workdir, exist_ok=True)
+    stun_log = open(os.path.join(workdir, "stun.log"), "w")
+    stun = subprocess.Popen(["ip", "netns", "exec", "v8relay", sys.executable,
+                             os.path.abspath(__file__), "stun", "--port", str(STUN_PORT)],
+                            stdout=stun_log, stderr=subprocess.STDOUT)
+    time.sleep(0.5)
+
+    procs = []
+    for i, (name, ip) in enumerate(HOSTS):
+        settings = os.path.join(workdir, "instance%d.toml" % i)
+        stats = os.path.join(workdir, "instance%d_stats.json" % i)
+        log = open(os.path.join(workdir, "instance%d.log" % i), "w")
+        write_settings(settings, args, i, stats)
+        p = subprocess.Popen(["ip", "netns", "exec", name, args.exe, args.game, settings],
+                             stdout=log, stderr=subprocess.STDOUT)
+        procs.append({"proc": p, "log": log, "stats": stats, "ns": name})
+        print("[nat_sim] instance %d: %s (%s) pid %d" % (i, name, ip, p.pid))
+
+    try:
+        time.sleep(args.duration)
+    finally:
+        for p in procs + [{"proc": stun, "log": stun_log}]:
+            p["proc"].terminate()
+        for p in procs + [{"proc": stun, "log": stun_log}]:
+            try:
+                p["proc"].wait(timeout=10)
+            except subprocess.TimeoutExpired:
+                p["proc"].kill()
+            p["log"].close()
+        report(procs)
+        if not args.keep:
+            down()
+        print("[nat_sim] logs in %s" % workdir)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__,
+                                 formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = ap.add_subparsers(dest="cmd", required=True)
+    r = sub.add_parser("run", help="build the topology and run host + joiner")
+    r.add_argument("--exe", required=True, help="path to vig8_test")
+    r.add_argument("--game", required=True, help="extracted game directory")
+    r.add_argument("--xlive-relay", help="host:port of an xlive relay for session registration")
+    r.add_argument("--port", type=int, default=3074, help="LAN port of both instances")
+    r.add_argument("--duration", type=float, default=60.0, help="seconds to run")
+    r.add_argument("--wan-delay", type=int, default=10, help="one-way delay per NAT uplink (ms)")
+    r.add_argument("--relay-delay", type=int, default=20, help="one-way delay to the relay (ms)")
+    r.add_argument("--host-script", help="controller script for the host")
+    r.add_argument("--join-script", help="controller script for the joiner")
+    r.add_argument("--workdir", help="keep settings/logs/stats here instead of a temp dir")
+    r.add_argument("--keep", action="store_true", help="leave the namespaces up afterwards")
+    sub.add_parser("down", help="remove the namespaces")
+    st = sub.add_parser("stun", help="run only the STUN responder")
+    st.add_argument("--port", type=int, default=STUN_PORT)
+    args = ap.parse_args()
+
+    if args.cmd == "stun":
+        stun_serve(args.port)
+        return
+    if os.geteuid() != 0:
+        sys.exit("nat_sim needs root (network namespaces)")
+    if args.cmd == "down":
+        down()
+    else:
+        run(args)
+
+
+if __name__ == "__main__":
+    main()
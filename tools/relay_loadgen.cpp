@@ -0,0 +1,375 @@
+// Load generator for tools/relay_server.cpp (project/src/relay_protocol.h,
+// the protocol vig8 speaks with relay_protocol = "relay_server").
+// Opens many relay clients from a few threads and measures, in phases:
+//   1. connect + HELLO          connections/s
+//   2. REGISTER                 sessions/s (each client registers --sessions)
+//   3. SEARCH for --duration    searches/s and results per search
+//   4. UDP relay (--udp-pairs)  delivered packets/s, Mbit/s, loss, latency
+// Requests are pipelined across each thread's connections: a thread writes
+// one request on every connection, then reads every reply. Linux only;
+// raise `ulimit -n` above --clients.
+//
+// Compile: g++ -O2 -std=c++20 -pthread -I project/src tools/relay_loadgen.cpp -o relay_loadgen
+// Usage: relay_loadgen [--host 127.0.0.1] [--port 36000] [--threads 8]
+//                      [--clients 1000] [--sessions 10] [--duration 10]
+//                      [--search-max 8] [--udp-pairs 0] [--udp-size 200]
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "relay_protocol.h"
+
+using namespace relay;
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string host = "127.0.0.1";
+    int port = DEFAULT_PORT;
+    int threads = 8;
+    int clients = 1000;
+    int sessions = 10;
+    double duration = 10.0;
+    int search_max = 8;
+    int udp_pairs = 0;
+    int udp_size = 200;
+};
+static Options g_opts;
+
+struct Client {
+    int      fd = -1;
+    uint32_t id = 0;
+    uint32_t token = 0;
+};
+
+static double Seconds(Clock::time_point a, Clock::time_point b) {
+    return std::chrono::duration<double>(b - a).count();
+}
+
+static int64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now().time_since_epoch()).count();
+}
+
+// ============================================================================
+// Blocking TCP framing
+// ============================================================================
+
+static bool WriteAll(int fd, const uint8_t* p, size_t n) {
+    while (n) {
+        ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+        if (w <= 0) return false;
+        p += w;
+        n -= (size_t)w;
+    }
+    return true;
+}
+
+static bool ReadAll(int fd, uint8_t* p, size_t n) {
+    while (n) {
+        ssize_t r = recv(fd, p, n, 0);
+        if (r <= 0) return false;
+        p += r;
+        n -= (size_t)r;
+    }
+    return true;
+}
+
+static bool SendFrame(int fd, uint8_t type, const uint8_t* payload, size_t len) {
+    uint8_t buf[3 + 64];
+    PutU16(buf, (uint16_t)(len + 1));
+    buf[2] = type;
+    std::memcpy(buf + 3, payload, len);
+    return WriteAll(fd, buf, 3 + len);
+}
+
+static bool ReadFrame(int fd, uint8_t* type, std::vector<uint8_t>* payload) {
+    uint8_t hdr[3];
+    if (!ReadAll(fd, hdr, 3)) return false;
+    size_t len = GetU16(hdr);
+    if (len == 0) return false;
+    *type = hdr[2];
+    payload->resize(len - 1);
+    return ReadAll(fd, payload->data(), len - 1);
+}
+
+static int Connect() {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)g_opts.port);
+    inet_pton(AF_INET, g_opts.host.c_str(), &addr.sin_addr);
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+// ============================================================================
+// Phases (run per thread over that thread's clients)
+// ============================================================================
+
+static std::atomic<uint64_t> g_errors{0};
+static std::atomic<uint64_t> g_registered{0};
+static std::atomic<uint64_t> g_searches{0};
+static std::atomic<uint64_t> g_results{0};
+
+static void PhaseConnect(std::vector<Client>& cs) {
+    uint8_t ver[4];
+    PutU32(ver, PROTOCOL_VERSION);
+    for (auto& c : cs) {
+        c.fd = Connect();
+        if (c.fd < 0 || !SendFrame(c.fd, MSG_HELLO, ver, 4)) g_errors++;
+    }
+    std::vector<uint8_t> p;
+    for (auto& c : cs) {
+        uint8_t type;
+        if (c.fd < 0) continue;
+        if (!ReadFrame(c.fd, &type, &p) || type != MSG_WELCOME || p.size() < 8) {
+            g_errors++;
+            continue;
+        }
+        c.id = GetU32(p.data());
+        c.token = GetU32(p.data() + 4);
+    }
+}
+
+static void PhaseRegister(std::vector<Client>& cs) {
+    for (int s = 0; s < g_opts.sessions; s++) {
+        for (auto& c : cs) {
+            if (!c.id) continue;
+            SessionRecord rec = {};
+            PutU32(rec.xnkid, c.id);
+            PutU32(rec.xnkid + 4, (uint32_t)s);
+            PutU32(rec.host_xnaddr, 0x0A000000u | c.id);  // fake 10.x.y.z host
+            rec.current_players = 1;
+            rec.max_players = 4;
+            if (!SendFrame(c.fd, MSG_REGISTER, (const uint8_t*)&rec, sizeof(rec))) g_errors++;
+        }
+        std::vector<uint8_t> p;
+        for (auto& c : cs) {
+            if (!c.id) continue;
+            uint8_t type;
+            if (!ReadFrame(c.fd, &type, &p) || type != MSG_ACK || p.empty() || p[0] != ACK_OK) {
+                g_errors++;
+            } else {
+                g_registered++;
+            }
+        }
+    }
+}
+
+static void PhaseSearch(std::vector<Client>& cs, Clock::time_point end) {
+    uint8_t req[2];
+    PutU16(req, (uint16_t)g_opts.search_max);
+    std::vector<uint8_t> p;
+    while (Clock::now() < end) {
+        for (auto& c : cs) {
+            if (c.id && !SendFrame(c.fd, MSG_SEARCH, req, 2)) g_errors++;
+        }
+        for (auto& c : cs) {
+            if (!c.id) continue;
+            uint8_t type;
+            if (!ReadFrame(c.fd, &type, &p) || type != MSG_RESULTS || p.size() < 2) {
+                g_errors++;
+                continue;
+            }
+            g_searches++;
+            g_results += GetU16(p.data());
+        }
+    }
+}
+
+// ============================================================================
+// UDP relay phase
+// ============================================================================
+
+static std::atomic<uint64_t> g_udp_sent{0};
+static std::atomic<uint64_t> g_udp_recv{0};
+static std::atomic<uint64_t> g_udp_bytes{0};
+static std::atomic<uint64_t> g_udp_lat_ns{0};
+static std::atomic<uint64_t> g_udp_lat_max_ns{0};
+
+struct UdpEnd {
+    int      fd = -1;
+    uint32_t id = 0;
+};
+
+static sockaddr_in ServerAddr() {
+    sockaddr_in a = {};
+    a.sin_family = AF_INET;
+    a.sin_port = htons((uint16_t)g_opts.port);
+    inet_pton(AF_INET, g_opts.host.c_str(), &a.sin_addr);
+    return a;
+}
+
+static UdpEnd OpenUdpEnd(const Client& c) {
+    UdpEnd e;
+    e.id = c.id;
+    e.fd = socket(AF_INET, SOCK_DGRAM, 0);
+    int sz = 4 << 20;
+    setsockopt(e.fd, SOL_SOCKET, SO_RCVBUF, &sz, sizeof(sz));
+    fcntl(e.fd, F_SETFL, fcntl(e.fd, F_GETFL, 0) | O_NONBLOCK);
+    sockaddr_in srv = ServerAddr();
+    uint8_t bind_msg[UDP_HEADER + 4];
+    bind_msg[0] = UDP_BIND;
+    PutU32(bind_msg + 1, c.id);
+    PutU32(bind_msg + UDP_HEADER, c.token);
+    for (int i = 0; i < 3; i++) {  // BIND is unacknowledged; repeat it
+        sendto(e.fd, bind_msg, sizeof(bind_msg), 0, (sockaddr*)&srv, sizeof(srv));
+    }
+    return e;
+}
+
+static void DrainUdp(const UdpEnd& e) {
+    uint8_t buf[65536];
+    for (;;) {
+        ssize_t n = recv(e.fd, buf, sizeof(buf), 0);
+        if (n < 0) break;
+        if (n < UDP_HEADER + 8 || buf[0] != UDP_DATA) continue;
+        int64_t sent_ns;
+        std::memcpy(&sent_ns, buf + UDP_HEADER, 8);
+        uint64_t lat = (uint64_t)std::max<int64_t>(0, NowNs() - sent_ns);
+        g_udp_recv++;
+        g_udp_bytes += (uint64_t)n - UDP_HEADER;
+        g_udp_lat_ns += lat;
+        uint64_t prev = g_udp_lat_max_ns.load(std::memory_order_relaxed);
+        while (lat > prev && !g_udp_lat_max_ns.compare_exchange_weak(prev, lat)) {}
+    }
+}
+
+// Each pair sends bursts A -> B and drains B. A short burst keeps the
+// sender from simply overrunning socket buffers.
+static void PhaseUdp(std::vector<std::pair<UdpEnd, UdpEnd>>& pairs, Clock::time_point end) {
+    sockaddr_in srv = ServerAddr();
+    int size = std::max(g_opts.udp_size, 8) + UDP_HEADER;
+    std::vector<uint8_t> pkt((size_t)size, 0x5A);
+    pkt[0] = UDP_DATA;
+    while (Clock::now() < end) {
+        for (auto& [a, b] : pairs) {
+            PutU32(pkt.data() + 1, b.id);
+            for (int i = 0; i < 16; i++) {
+                int64_t now = NowNs();
+                std::memcpy(pkt.data() + UDP_HEADER, &now, 8);
+                if (sendto(a.fd, pkt.data(), pkt.size(), 0, (sockaddr*)&srv, sizeof(srv)) > 0) {
+                    g_udp_sent++;
+                }
+            }
+            DrainUdp(b);
+        }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    for (auto& [a, b] : pairs) DrainUdp(b);
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        auto next = [&]() { return i + 1 < argc ? argv[++i] : "0"; };
+        if (a == "--host") g_opts.host = next();
+        else if (a == "--port") g_opts.port = atoi(next());
+        else if (a == "--threads") g_opts.threads = atoi(next());
+        else if (a == "--clients") g_opts.clients = atoi(next());
+        else if (a == "--sessions") g_opts.sessions = atoi(next());
+        else if (a == "--duration") g_opts.duration = atof(next());
+        else if (a == "--search-max") g_opts.search_max = atoi(next());
+        else if (a == "--udp-pairs") g_opts.udp_pairs = atoi(next());
+        else if (a == "--udp-size") g_opts.udp_size = atoi(next());
+        else {
+            fprintf(stderr, "Usage: %s [--host H] [--port N] [--threads N] [--clients N] "
+                            "[--sessions N] [--duration S] [--search-max N] [--udp-pairs N] "
+                            "[--udp-size B]\n", argv[0]);
+            return 1;
+        }
+    }
+    g_opts.threads = std::max(1, std::min(g_opts.threads, g_opts.clients));
+    g_opts.udp_pairs = std::min(g_opts.udp_pairs, g_opts.clients / 2);
+
+    // Clients are dealt round-robin to threads
+    std::vector<std::vector<Client>> per_thread((size_t)g_opts.threads);
+    for (int i = 0; i < g_opts.clients; i++) per_thread[(size_t)(i % g_opts.threads)].emplace_back();
+
+    auto run = [&](auto fn) {
+        std::vector<std::thread> ts;
+        auto t0 = Clock::now();
+        for (int t = 0; t < g_opts.threads; t++) ts.emplace_back([&, t]() { fn(t); });
+        for (auto& th : ts) th.join();
+        return Seconds(t0, Clock::now());
+    };
+
+    double dt = run([&](int t) { PhaseConnect(per_thread[(size_t)t]); });
+    printf("connect   %d clients in %.2f s (%.0f/s), errors %llu\n", g_opts.clients, dt,
+           g_opts.clients / dt, (unsigned long long)g_errors.load());
+
+    dt = run([&](int t) { PhaseRegister(per_thread[(size_t)t]); });
+    printf("register  %llu sessions in %.2f s (%.0f sessions/s), errors %llu\n",
+           (unsigned long long)g_registered.load(), dt, g_registered.load() / dt,
+           (unsigned long long)g_errors.load());
+
+    auto end = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                                  std::chrono::duration<double>(g_opts.duration));
+    dt = run([&](int t) { PhaseSearch(per_thread[(size_t)t], end); });
+    uint64_t searches = g_searches.load();
+    printf("search    %llu searches in %.2f s (%.0f/s), %.1f results each, errors %llu\n",
+           (unsigned long long)searches, dt, searches / dt,
+           searches ? (double)g_results.load() / searches : 0.0,
+           (unsigned long long)g_errors.load());
+
+    if (g_opts.udp_pairs > 0) {
+        // Pair client 2k with 2k+1; each thread drives the pairs whose
+        // sender it owns.
+        std::vector<Client*> all;
+        for (int i = 0; i < g_opts.clients; i++) {
+            all.push_back(&per_thread[(size_t)(i % g_opts.threads)][(size_t)(i / g_opts.threads)]);
+        }
+        std::vector<std::vector<std::pair<UdpEnd, UdpEnd>>> udp((size_t)g_opts.threads);
+        for (int p = 0; p < g_opts.udp_pairs; p++) {
+            Client* a = all[(size_t)(2 * p)];
+            Client* b = all[(size_t)(2 * p + 1)];
+            if (!a->id || !b->id) continue;
+            udp[(size_t)(p % g_opts.threads)].push_back({OpenUdpEnd(*a), OpenUdpEnd(*b)});
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));  // let BINDs land
+
+        end = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                                 std::chrono::duration<double>(g_opts.duration));
+        dt = run([&](int t) { PhaseUdp(udp[(size_t)t], end); });
+        uint64_t sent = g_udp_sent.load(), recv = g_udp_recv.load();
+        printf("udp relay %d pairs, %llu sent, %llu delivered (%.0f pkt/s, %.1f Mbit/s), "
+               "loss %.2f%%, latency avg %.1f us max %.1f us\n",
+               g_opts.udp_pairs, (unsigned long long)sent, (unsigned long long)recv,
+               recv / dt, g_udp_bytes.load() * 8 / dt / 1e6,
+               sent ? 100.0 * (double)(sent - std::min(sent, recv)) / sent : 0.0,
+               recv ? g_udp_lat_ns.load() / 1e3 / recv : 0.0, g_udp_lat_max_ns.load() / 1e3);
+        for (auto& v : udp) {
+            for (auto& [a, b] : v) { close(a.fd); close(b.fd); }
+        }
+    }
+
+    for (auto& v : per_thread) {
+        for (auto& c : v) if (c.fd >= 0) close(c.fd);
+    }
+    return g_errors.load() ? 1 : 0;
+}
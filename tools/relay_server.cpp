@@ -0,0 +1,586 @@
+// Standalone test relay server: session register/search/unregister and
+// optional UDP relay. It speaks project/src/relay_protocol.h, not the xlive
+// relay's protocol; vig8 uses it as its relay with [network]
+// relay_protocol = "relay_server", and tools/relay_loadgen.cpp load-tests it.
+//
+// A fixed pool of worker threads, each with its own epoll loop and its own
+// SO_REUSEPORT TCP listener and UDP socket on the same port, so the kernel
+// spreads connections and datagram flows across workers with no shared
+// accept queue. Sessions live in a sharded table; a connection's sessions
+// are unregistered when it closes. Linux only.
+//
+// Compile: g++ -O2 -std=c++20 -pthread -I project/src tools/relay_server.cpp -o relay_server
+// Usage: relay_server [--port 36000] [--threads N] [--udp] [--max-per-client 16]
+//                     [--stats-interval 5]
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "relay_protocol.h"
+
+using namespace relay;
+using Clock = std::chrono::steady_clock;
+
+// ============================================================================
+// Options and counters
+// ============================================================================
+
+struct Options {
+    int  port = DEFAULT_PORT;
+    int  threads = 0;            // 0 = hardware concurrency
+    bool udp = false;
+    int  max_per_client = 16;
+    int  stats_interval = 5;
+};
+static Options g_opts;
+
+static std::atomic<bool>     g_running{true};
+static std::atomic<uint64_t> g_clients{0};
+static std::atomic<uint64_t> g_accepted{0};
+static std::atomic<uint64_t> g_registers{0};
+static std::atomic<uint64_t> g_unregisters{0};
+static std::atomic<uint64_t> g_searches{0};
+static std::atomic<uint64_t> g_udp_in{0};
+static std::atomic<uint64_t> g_udp_out{0};
+static std::atomic<uint64_t> g_udp_bytes{0};
+static std::atomic<uint64_t> g_udp_dropped{0};
+
+static void Count(std::atomic<uint64_t>& c, uint64_t v = 1) {
+    c.fetch_add(v, std::memory_order_relaxed);
+}
+
+// ============================================================================
+// Session table
+// ============================================================================
+//
+// 64 shards by XNKID, each its own mutex. Searches walk shards starting
+// from a rotating index so repeated searches spread over the whole table
+// instead of always returning the same first few sessions.
+
+static constexpr int SHARDS = 64;
+
+struct SessionEntry {
+    SessionRecord rec;
+    uint32_t      owner;   // client id
+};
+
+struct SessionShard {
+    std::mutex                                 mutex;
+    std::unordered_map<uint64_t, SessionEntry> sessions;
+};
+static SessionShard          g_session_shards[SHARDS];
+static std::atomic<uint64_t> g_session_count{0};
+static std::atomic<uint32_t> g_search_cursor{0};
+
+static SessionShard& ShardFor(uint64_t key) {
+    return g_session_shards[(key * 0x9E3779B97F4A7C15ull) >> 58];
+}
+
+static AckStatus SessionUpsert(const SessionRecord& rec, uint32_t owner, bool* inserted) {
+    uint64_t key = XnkidKey(rec.xnkid);
+    SessionShard& sh = ShardFor(key);
+    std::lock_guard lock(sh.mutex);
+    auto [it, ins] = sh.sessions.try_emplace(key);
+    if (!ins && it->second.owner != owner) return ACK_NOT_OWNER;
+    it->second.rec = rec;
+    it->second.owner = owner;
+    *inserted = ins;
+    if (ins) Count(g_session_count);
+    return ACK_OK;
+}
+
+static bool SessionRemove(uint64_t key, uint32_t owner) {
+    SessionShard& sh = ShardFor(key);
+    std::lock_guard lock(sh.mutex);
+    auto it = sh.sessions.find(key);
+    if (it == sh.sessions.end() || it->second.owner != owner) return false;
+    sh.sessions.erase(it);
+    g_session_count.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+// Joinable sessions (not full), up to `max`.
+static int SessionSearch(SessionRecord* out, int max) {
+    int n = 0;
+    uint32_t start = g_search_cursor.fetch_add(1, std::memory_order_relaxed);
+    for (int i = 0; i < SHARDS && n < max; i++) {
+        SessionShard& sh = g_session_shards[(start + i) % SHARDS];
+        std::lock_guard lock(sh.mutex);
+        for (auto& [key, e] : sh.sessions) {
+            if (n >= max) break;
+            if (e.rec.current_players < e.rec.max_players) out[n++] = e.rec;
+        }
+    }
+    return n;
+}
+
+// ============================================================================
+// UDP endpoints
+// ============================================================================
+
+static uint64_t AddrKey(const sockaddr_in& a) {
+    return ((uint64_t)a.sin_addr.s_addr << 16) | a.sin_port;
+}
+
+struct Endpoint {
+    sockaddr_in addr;
+    uint32_t    token;
+    bool        bound;
+};
+
+struct EndpointShard {
+    std::mutex                             mutex;
+    std::unordered_map<uint32_t, Endpoint> by_id;
+    std::unordered_map<uint64_t, uint32_t> by_addr;
+};
+static EndpointShard g_endpoints[SHARDS];
+
+static EndpointShard& EndpointShardFor(uint32_t id) { return g_endpoints[id % SHARDS]; }
+static EndpointShard& AddrShardFor(uint64_t key) {
+    return g_endpoints[(key * 0x9E3779B97F4A7C15ull) >> 58];
+}
+
+// The by_addr index lives in the shard of the address, by_id in the shard
+// of the id, so the two are updated under separate locks.
+static void EndpointCreate(uint32_t id, uint32_t token) {
+    EndpointShard& sh = EndpointShardFor(id);
+    std::lock_guard lock(sh.mutex);
+    sh.by_id[id] = Endpoint{{}, token, false};
+}
+
+static void EndpointBind(uint32_t id, uint32_t token, const sockaddr_in& from) {
+    sockaddr_in old = {};
+    bool had_old = false;
+    {
+        EndpointShard& sh = EndpointShardFor(id);
+        std::lock_guard lock(sh.mutex);
+        auto it = sh.by_id.find(id);
+        if (it == sh.by_id.end() || it->second.token != token) return;
+        if (it->second.bound) {
+            if (AddrKey(it->second.addr) == AddrKey(from)) return;
+            old = it->second.addr;
+            had_old = true;
+        }
+        it->second.addr = from;
+        it->second.bound = true;
+    }
+    if (had_old) {
+        EndpointShard& sh = AddrShardFor(AddrKey(old));
+        std::lock_guard lock(sh.mutex);
+        sh.by_addr.erase(AddrKey(old));
+    }
+    EndpointShard& sh = AddrShardFor(AddrKey(from));
+    std::lock_guard lock(sh.mutex);
+    sh.by_addr[AddrKey(from)] = id;
+}
+
+static void EndpointRemove(uint32_t id) {
+    sockaddr_in addr = {};
+    bool bound = false;
+    {
+        EndpointShard& sh = EndpointShardFor(id);
+        std::lock_guard lock(sh.mutex);
+        auto it = sh.by_id.find(id);
+        if (it == sh.by_id.end()) return;
+        addr = it->second.addr;
+        bound = it->second.bound;
+        sh.by_id.erase(it);
+    }
+    if (bound) {
+        EndpointShard& sh = AddrShardFor(AddrKey(addr));
+        std::lock_guard lock(sh.mutex);
+        auto it = sh.by_addr.find(AddrKey(addr));
+        if (it != sh.by_addr.end() && it->second == id) sh.by_addr.erase(it);
+    }
+}
+
+static bool EndpointLookupId(uint32_t id, sockaddr_in* out) {
+    EndpointShard& sh = EndpointShardFor(id);
+    std::lock_guard lock(sh.mutex);
+    auto it = sh.by_id.find(id);
+    if (it == sh.by_id.end() || !it->second.bound) return false;
+    *out = it->second.addr;
+    return true;
+}
+
+static bool EndpointLookupAddr(const sockaddr_in& from, uint32_t* id) {
+    EndpointShard& sh = AddrShardFor(AddrKey(from));
+    std::lock_guard lock(sh.mutex);
+    auto it = sh.by_addr.find(AddrKey(from));
+    if (it == sh.by_addr.end()) return false;
+    *id = it->second;
+    return true;
+}
+
+// ============================================================================
+// Connections
+// ============================================================================
+
+static std::atomic<uint32_t> g_next_client_id{1};
+
+struct Conn {
+    int                   fd = -1;
+    uint32_t              id = 0;       // 0 until HELLO
+    std::vector<uint8_t>  rbuf;
+    std::vector<uint8_t>  wbuf;
+    size_t                woff = 0;
+    bool                  want_out = false;
+    std::vector<uint64_t> owned;        // XNKID keys registered here
+};
+
+static void SetNonBlocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+static void QueueFrame(Conn& c, uint8_t type, const uint8_t* payload, size_t len) {
+    uint8_t hdr[3];
+    PutU16(hdr, (uint16_t)(len + 1));
+    hdr[2] = type;
+    c.wbuf.insert(c.wbuf.end(), hdr, hdr + 3);
+    c.wbuf.insert(c.wbuf.end(), payload, payload + len);
+}
+
+static void QueueAck(Conn& c, AckStatus st) {
+    uint8_t b = st;
+    QueueFrame(c, MSG_ACK, &b, 1);
+}
+
+// Returns false if the connection should be closed.
+static bool HandleFrame(Conn& c, uint8_t type, const uint8_t* p, size_t len) {
+    if (c.id == 0 && type != MSG_HELLO) return false;
+    switch (type) {
+    case MSG_HELLO: {
+        if (len < 4 || c.id != 0 || GetU32(p) != PROTOCOL_VERSION) return false;
+        c.id = g_next_client_id.fetch_add(1, std::memory_order_relaxed);
+        thread_local std::mt19937 rng(std::random_device{}());
+        uint32_t token = rng();
+        if (g_opts.udp) EndpointCreate(c.id, token);
+        uint8_t out[8];
+        PutU32(out, c.id);
+        PutU32(out + 4, token);
+        QueueFrame(c, MSG_WELCOME, out, sizeof(out));
+        return true;
+    }
+    case MSG_REGISTER: {
+        if (len < sizeof(SessionRecord)) { QueueAck(c, ACK_BAD); return true; }
+        SessionRecord rec;
+        std::memcpy(&rec, p, sizeof(rec));
+        uint64_t key = XnkidKey(rec.xnkid);
+        bool known = false;
+        for (uint64_t k : c.owned) known |= k == key;
+        if (!known && (int)c.owned.size() >= g_opts.max_per_client) {
+            QueueAck(c, ACK_LIMIT);
+            return true;
+        }
+        bool inserted = false;
+        AckStatus st = SessionUpsert(rec, c.id, &inserted);
+        if (st == ACK_OK && inserted) c.owned.push_back(key);
+        Count(g_registers);
+        QueueAck(c, st);
+        return true;
+    }
+    case MSG_UNREG: {
+        if (len < 8) { QueueAck(c, ACK_BAD); return true; }
+        uint64_t key = XnkidKey(p);
+        bool ok = SessionRemove(key, c.id);
+        if (ok) {
+            for (size_t i = 0; i < c.owned.size(); i++) {
+                if (c.owned[i] == key) { c.owned[i] = c.owned.back(); c.owned.pop_back(); break; }
+            }
+        }
+        Count(g_unregisters);
+        QueueAck(c, ok ? ACK_OK : ACK_NOT_FOUND);
+        return true;
+    }
+    case MSG_SEARCH: {
+        if (len < 2) return false;
+        int max = std::min<int>(GetU16(p), (MAX_FRAME - 3) / (int)sizeof(SessionRecord));
+        std::vector<uint8_t> out(2 + (size_t)max * sizeof(SessionRecord));
+        int n = SessionSearch((SessionRecord*)(out.data() + 2), max);
+        PutU16(out.data(), (uint16_t)n);
+        out.resize(2 + (size_t)n * sizeof(SessionRecord));
+        Count(g_searches);
+        QueueFrame(c, MSG_RESULTS, out.data(), out.size());
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+static void CloseConn(int epfd, Conn* c) {
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, nullptr);
+    close(c->fd);
+    for (uint64_t key : c->owned) SessionRemove(key, c->id);
+    if (c->id && g_opts.udp) EndpointRemove(c->id);
+    g_clients.fetch_sub(1, std::memory_order_relaxed);
+    delete c;
+}
+
+// Flush as much of the write buffer as the socket takes; arm EPOLLOUT
+// only while a backlog remains.
+static bool FlushConn(int epfd, Conn* c) {
+    while (c->woff < c->wbuf.size()) {
+        ssize_t n = send(c->fd, c->wbuf.data() + c->woff, c->wbuf.size() - c->woff, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+        c->woff += (size_t)n;
+    }
+    if (c->woff == c->wbuf.size()) {
+        c->wbuf.clear();
+        c->woff = 0;
+    }
+    bool want_out = !c->wbuf.empty();
+    if (want_out != c->want_out) {
+        epoll_event ev = {};
+        ev.events = EPOLLIN | EPOLLRDHUP | (want_out ? (uint32_t)EPOLLOUT : 0u);
+        ev.data.ptr = c;
+        epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+        c->want_out = want_out;
+    }
+    return true;
+}
+
+// Read everything available and handle each complete frame.
+static bool ReadConn(Conn* c) {
+    uint8_t buf[16384];
+    for (;;) {
+        ssize_t n = recv(c->fd, buf, sizeof(buf), 0);
+        if (n == 0) return false;
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+        c->rbuf.insert(c->rbuf.end(), buf, buf + n);
+    }
+    size_t pos = 0;
+    while (c->rbuf.size() - pos >= 2) {
+        size_t flen = GetU16(c->rbuf.data() + pos);
+        if (flen == 0) return false;
+        if (c->rbuf.size() - pos < 2 + flen) break;
+        const uint8_t* f = c->rbuf.data() + pos + 2;
+        if (!HandleFrame(*c, f[0], f + 1, flen - 1)) return false;
+        pos += 2 + flen;
+    }
+    c->rbuf.erase(c->rbuf.begin(), c->rbuf.begin() + (ptrdiff_t)pos);
+    return true;
+}
+
+// ============================================================================
+// UDP relay
+// ============================================================================
+
+// At most UDP_BATCH datagrams per wakeup so a flood can't starve the
+// worker's TCP connections; epoll is level-triggered and fires again.
+static constexpr int UDP_BATCH = 256;
+
+static void ServiceUdp(int udp_fd) {
+    static thread_local uint8_t buf[65536];
+    for (int i = 0; i < UDP_BATCH; i++) {
+        sockaddr_in from = {};
+        socklen_t flen = sizeof(from);
+        ssize_t n = recvfrom(udp_fd, buf, sizeof(buf), 0, (sockaddr*)&from, &flen);
+        if (n < 0) break;
+        if (n < UDP_HEADER) continue;
+        Count(g_udp_in);
+        uint32_t id = GetU32(buf + 1);
+        if (buf[0] == UDP_BIND) {
+            if (n >= UDP_HEADER + 4) EndpointBind(id, GetU32(buf + UDP_HEADER), from);
+            continue;
+        }
+        if (buf[0] != UDP_DATA) continue;
+        uint32_t src;
+        sockaddr_in dst;
+        if (!EndpointLookupAddr(from, &src) || !EndpointLookupId(id, &dst)) {
+            Count(g_udp_dropped);
+            continue;
+        }
+        PutU32(buf + 1, src);  // rewrite destination id to source id
+        if (sendto(udp_fd, buf, (size_t)n, 0, (const sockaddr*)&dst, sizeof(dst)) == n) {
+            Count(g_udp_out);
+            Count(g_udp_bytes, (uint64_t)n - UDP_HEADER);
+        } else {
+            Count(g_udp_dropped);
+        }
+    }
+}
+
+// ============================================================================
+// Workers
+// ============================================================================
+
+static int OpenSocket(int type) {
+    int fd = socket(AF_INET, type, 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons((uint16_t)g_opts.port);
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 ||
+        (type == SOCK_STREAM && listen(fd, 4096) < 0)) {
+        close(fd);
+        return -1;
+    }
+    if (type == SOCK_DGRAM) {
+        int sz = 4 << 20;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &sz, sizeof(sz));
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sz, sizeof(sz));
+    }
+    SetNonBlocking(fd);
+    return fd;
+}
+
+// Sentinel epoll tags for the listener and UDP socket
+static char g_tag_listen, g_tag_udp;
+
+static void WorkerLoop(int listen_fd, int udp_fd) {
+    int epfd = epoll_create1(0);
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.ptr = &g_tag_listen;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &ev);
+    if (udp_fd >= 0) {
+        ev.data.ptr = &g_tag_udp;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, udp_fd, &ev);
+    }
+
+    std::vector<Conn*> conns;  // for cleanup at exit
+    epoll_event events[256];
+    while (g_running.load(std::memory_order_relaxed)) {
+        int n = epoll_wait(epfd, events, 256, 500);
+        for (int i = 0; i < n; i++) {
+            void* tag = events[i].data.ptr;
+            if (tag == &g_tag_listen) {
+                for (;;) {
+                    int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK);
+                    if (fd < 0) break;
+                    int one = 1;
+                    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                    Conn* c = new Conn();
+                    c->fd = fd;
+                    epoll_event cev = {};
+                    cev.events = EPOLLIN | EPOLLRDHUP;
+                    cev.data.ptr = c;
+                    epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &cev);
+                    conns.push_back(c);
+                    Count(g_clients);
+                    Count(g_accepted);
+                }
+                continue;
+            }
+            if (tag == &g_tag_udp) {
+                ServiceUdp(udp_fd);
+                continue;
+            }
+            Conn* c = (Conn*)tag;
+            bool ok = true;
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) ok = ReadConn(c);
+            if (ok) ok = FlushConn(epfd, c);
+            if (!ok) {
+                // Unordered erase from the cleanup list, then free
+                for (size_t k = 0; k < conns.size(); k++) {
+                    if (conns[k] == c) { conns[k] = conns.back(); conns.pop_back(); break; }
+                }
+                CloseConn(epfd, c);
+            }
+        }
+    }
+    for (Conn* c : conns) CloseConn(epfd, c);
+    close(epfd);
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+static void OnSignal(int) { g_running.store(false); }
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        auto next = [&]() { return i + 1 < argc ? atoi(argv[++i]) : 0; };
+        if (a == "--port") g_opts.port = next();
+        else if (a == "--threads") g_opts.threads = next();
+        else if (a == "--udp") g_opts.udp = true;
+        else if (a == "--max-per-client") g_opts.max_per_client = next();
+        else if (a == "--stats-interval") g_opts.stats_interval = next();
+        else {
+            fprintf(stderr, "Usage: %s [--port N] [--threads N] [--udp] [--max-per-client N] "
+                            "[--stats-interval S]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (g_opts.threads <= 0) g_opts.threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    if (g_opts.stats_interval <= 0) g_opts.stats_interval = 5;
+
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+    signal(SIGPIPE, SIG_IGN);
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < g_opts.threads; t++) {
+        int lfd = OpenSocket(SOCK_STREAM);
+        int ufd = g_opts.udp ? OpenSocket(SOCK_DGRAM) : -1;
+        if (lfd < 0 || (g_opts.udp && ufd < 0)) {
+            fprintf(stderr, "Failed to bind port %d: %s\n", g_opts.port, strerror(errno));
+            g_running.store(false);
+            break;
+        }
+        workers.emplace_back([lfd, ufd]() {
+            WorkerLoop(lfd, ufd);
+            close(lfd);
+            if (ufd >= 0) close(ufd);
+        });
+    }
+    printf("relay_server: port %d, %d worker(s), udp relay %s\n", g_opts.port,
+           (int)workers.size(), g_opts.udp ? "on" : "off");
+    fflush(stdout);
+
+    uint64_t last_reg = 0, last_search = 0, last_udp = 0, last_bytes = 0;
+    auto last = Clock::now();
+    while (g_running.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        auto now = Clock::now();
+        double dt = std::chrono::duration<double>(now - last).count();
+        if (dt < g_opts.stats_interval) continue;
+        uint64_t reg = g_registers.load(), search = g_searches.load();
+        uint64_t udp = g_udp_out.load(), bytes = g_udp_bytes.load();
+        printf("clients %llu  sessions %llu  register/s %.0f  search/s %.0f  "
+               "relay pkt/s %.0f  relay Mbit/s %.1f  dropped %llu\n",
+               (unsigned long long)g_clients.load(), (unsigned long long)g_session_count.load(),
+               (reg - last_reg) / dt, (search - last_search) / dt, (udp - last_udp) / dt,
+               (bytes - last_bytes) * 8 / dt / 1e6, (unsigned long long)g_udp_dropped.load());
+        fflush(stdout);
+        last_reg = reg; last_search = search; last_udp = udp; last_bytes = bytes;
+        last = now;
+    }
+
+    for (auto& w : workers) w.join();
+    printf("relay_server: stopped (%llu connections served)\n",
+           (unsigned long long)g_accepted.load());
+    return 0;
+}
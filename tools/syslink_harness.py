@@ -0,0 +1,224 @@
+#!/usr/bin/env python3
+"""
+Loopback system-link test harness for Vigilante 8 Arcade.
+
+Starts N headless vig8_test instances on one machine, each bound to its own
+loopback address (127.0.0.10, .11, ...) on the same LAN port, with unicast
+discovery pointed at the others. Optional impairment (latency, jitter, loss,
+reorder, bandwidth cap) is applied to each instance's outgoing traffic.
+--tunnel turns on the batched, compressed game-traffic tunnel on every
+instance.
+
+Instance 0 is the host and the rest are joiners. Menu navigation comes from
+controller scripts (see project/src/script_input.h for the format):
+  --host-script   played on instance 0
+  --join-script   played on every other instance
+
+Each instance writes a stats JSON once a second. After --duration seconds the
+harness stops the instances and reports:
+  - when the host created its session
+  - when each joiner first got a search hit and first connected
+  - per-peer packet/byte counts, drops and reorders
+  - with --tunnel, the guest vs wire byte counts and added queueing delay
+
+Exit code is 0 if every joiner discovered the host, 1 otherwise.
+No network access is needed; everything stays on 127.0.0.0/8.
+
+Usage:
+  py syslink_harness.py --exe build/vig8_test --game E:\\vig8\\extracted \\
+      --instances 2 --latency 40 --jitter 10 --loss 1 \\
+      --host-script host.txt --join-script join.txt --duration 90
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+# ============================================================================
+# Constants
+# ============================================================================
+
+BASE_IP_LAST_OCTET = 10
+
+
+def instance_ip(i):
+    return "127.0.0.%d" % (BASE_IP_LAST_OCTET + i)
+
+
+def toml_str(s):
+    return '"' + s.replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+# ============================================================================
+# Instance setup
+# ============================================================================
+
+def write_settings(path, args, i, stats_path):
+    ips = [instance_ip(n) for n in range(args.instances)]
+    peers = ["%s:%d" % (ip, args.port) for n, ip in enumerate(ips) if n != i]
+    script = args.host_script if i == 0 else args.join_script
+
+    lines = [
+        "[game]",
+        "full_game = true",
+        "",
+        "[network]",
+        "lan_port = %d" % args.port,
+        "relay_enabled = false",
+        "bind_address = %s" % toml_str(ips[i]),
+        "discovery_peers = [%s]" % ", ".join(toml_str(p) for p in peers),
+        "tunnel = %s" % ("true" if args.tunnel else "false"),
+        "",
+        "[impair]",
+        "latency_ms = %d" % args.latency,
+        "jitter_ms = %d" % args.jitter,
+        "loss_pct = %s" % float(args.loss),
+        "reorder_pct = %s" % float(args.reorder),
+        "bandwidth_kbps = %d" % args.bandwidth,
+        "seed = %d" % (args.seed + i),
+        "",
+        "[test]",
+        "stats_file = %s" % toml_str(stats_path),
+    ]
+    if script:
+        lines.append("input_script = %s" % toml_str(os.path.abspath(script)))
+    with open(path, "w") as f:
+        f.write("\n".join(lines) + "\n")
+
+
+def launch(args, workdir):
+    procs = []
+    for i in range(args.instances):
+        settings = os.path.join(workdir, "instance%d.toml" % i)
+        stats = os.path.join(workdir, "instance%d_stats.json" % i)
+        log = open(os.path.join(workdir, "instance%d.log" % i), "w")
+        write_settings(settings, args, i, stats)
+        p = subprocess.Popen([args.exe, args.game, settings],
+                             stdout=log, stderr=subprocess.STDOUT)
+        procs.append({"proc": p, "log": log, "stats": stats, "ip": instance_ip(i)})
+        print("[harness] instance %d: %s pid %d" % (i, instance_ip(i), p.pid))
+    return procs
+
+
+def stop(procs):
+    for p in procs:
+        if p["proc"].poll() is None:
+            p["proc"].terminate()
+    deadline = time.time() + 5
+    for p in procs:
+        try:
+            p["proc"].wait(timeout=max(0.1, deadline - time.time()))
+        except subprocess.TimeoutExpired:
+            p["proc"].kill()
+            p["proc"].wait()
+        p["log"].close()
+
+
+def read_stats(path):
+    try:
+        with open(path) as f:
+            return json.load(f)
+    except (OSError, ValueError):
+        return None
+
+
+# ============================================================================
+# Report
+# ============================================================================
+
+def fmt_ms(v):
+    return "-" if v is None or v < 0 else "%d ms" % v
+
+
+def report(procs):
+    host_ip = procs[0]["ip"]
+    ok = True
+    for i, p in enumerate(procs):
+        s = read_stats(p["stats"])
+        role = "host" if i == 0 else "join"
+        print("\n=== instance %d (%s, %s) ===" % (i, role, p["ip"]))
+        if s is None:
+            print("  no stats written (exit code %s)" % p["proc"].returncode)
+            ok = False
+            continue
+        print("  uptime            %s" % fmt_ms(s.get("uptime_ms")))
+        print("  session created   %s" % fmt_ms(s.get("session_created_ms")))
+        print("  first search hit  %s" % fmt_ms(s.get("first_search_hit_ms")))
+
+        found_host = False
+        for peer in s.get("peers", []):
+            print("  peer %-15s disc %-9s conn %-9s tx %6d/%-9d rx %6d/%-9d drop %d reord %d" % (
+                peer["ip"], fmt_ms(peer["discovered_ms"]), fmt_ms(peer["connected_ms"]),
+                peer["tx_packets"], peer["tx_bytes"], peer["rx_packets"], peer["rx_bytes"],
+                peer["dropped"], peer["reordered"]))
+            if peer["ip"] == host_ip and peer["discovered_ms"] >= 0:
+                found_host = True
+        t = s.get("tunnel")
+        if t:
+            ratio = t["wire_bytes"] / t["raw_bytes"] if t["raw_bytes"] else 0.0
+            print("  tunnel            %d datagrams in %d packets, %d -> %d bytes (%.0f%%), "
+                  "hold avg %d us max %d us, rx %d/%d err %d" % (
+                      t["datagrams"], t["packets"], t["raw_bytes"], t["wire_bytes"],
+                      ratio * 100, t["hold_avg_us"], t["hold_max_us"],
+                      t["rx_datagrams"], t["rx_packets"], t["rx_errors"]))
+        if i > 0 and not found_host:
+            print("  FAIL: host %s never discovered" % host_ip)
+            ok = False
+    return ok
+
+
+# ============================================================================
+# Main
+# ============================================================================
+
+def main():
+    ap = argparse.ArgumentParser(description="Loopback system-link test harness")
+    ap.add_argument("--exe", required=True, help="path to vig8_test")
+    ap.add_argument("--game", required=True, help="extracted game directory")
+    ap.add_argument("--instances", type=int, default=2)
+    ap.add_argument("--port", type=int, default=3074, help="LAN port shared by all instances")
+    ap.add_argument("--duration", type=float, default=60.0, help="seconds to run")
+    ap.add_argument("--latency", type=int, default=0, help="one-way added latency (ms)")
+    ap.add_argument("--jitter", type=int, default=0, help="+/- jitter (ms)")
+    ap.add_argument("--loss", type=float, default=0.0, help="packet loss (%%)")
+    ap.add_argument("--reorder", type=float, default=0.0, help="reordered packets (%%)")
+    ap.add_argument("--bandwidth", type=int, default=0, help="egress cap (kbit/s), 0 = off")
+    ap.add_argument("--seed", type=int, default=1)
+    ap.add_argument("--tunnel", action="store_true",
+                    help="batch and compress game traffic between instances")
+    ap.add_argument("--host-script", help="controller script for instance 0")
+    ap.add_argument("--join-script", help="controller script for the other instances")
+    ap.add_argument("--workdir", help="keep settings/logs/stats here instead of a temp dir")
+    args = ap.parse_args()
+
+    if args.instances < 2:
+        ap.error("--instances must be at least 2")
+
+    workdir = args.workdir or tempfile.mkdtemp(prefix="vig8_syslink_")
+    os.makedirs(workdir, exist_ok=True)
+    print("[harness] workdir %s" % workdir)
+
+    procs = launch(args, workdir)
+    try:
+        end = time.time() + args.duration
+        while time.time() < end:
+            if all(p["proc"].poll() is not None for p in procs):
+                print("[harness] all instances exited early")
+                break
+            time.sleep(0.5)
+    except KeyboardInterrupt:
+        print("[harness] interrupted")
+    finally:
+        stop(procs)
+
+    ok = report(procs)
+    print("\n[harness] %s" % ("PASS" if ok else "FAIL"))
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,286 @@
+// Checks the background controller poller (project/src/pad_poller.cpp).
+//
+//   synthetic  the "synthetic" backend at 1 kHz: slot 0 is connected, A
+//              pulses with a ~20% duty cycle, the left stick stays on the
+//              unit circle, slots 1-3 are empty.
+//   seqlock    reader threads hammer PadPollerGet while the poller
+//              publishes at 1 kHz; every state read is whole (a packet
+//              number never shows up with two different change times, and
+//              both only move forward).
+//   backoff    a scripted backend: a connected slot is polled every tick,
+//              an empty one at doubling intervals from one period up to
+//              PAD_BACKOFF_MAX, and a pad plugged in mid-backoff is picked
+//              up by the next retry and then polled every tick.
+//   evdev      crafted input_events through PadEvdevApply: stick scaling
+//              over the device's range, Y axes flipped to up-is-positive,
+//              triggers scaled to 0..255 (and digital without a range),
+//              buttons and the hat d-pad.
+//
+// Exits with 2 when a check fails.
+//
+// Compile: g++ -O2 -std=c++20 -pthread -I project/src -I $REXSDK/include tools/test_pad_poller.cpp project/src/pad_poller.cpp -o test_pad_poller
+// Usage: test_pad_poller
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <rex/input/input.h>
+
+#include "pad_poller.h"
+
+#ifndef _WIN32
+#include <linux/input.h>
+#endif
+
+using namespace std::chrono_literals;
+using namespace rex::input;
+using Clock = std::chrono::steady_clock;
+
+static int g_failures = 0;
+
+static void Check(bool ok, const char* what) {
+    printf("  %-58s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok) g_failures++;
+}
+
+static double MsSince(Clock::time_point t0) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+// ---- Synthetic backend and the seqlock ----
+
+static void TestSynthetic() {
+    printf("synthetic (1 kHz, 1 s):\n");
+    Check(PadPollerStart("synthetic", 1000), "backend starts");
+    Check(std::string(PadPollerBackend()) == "synthetic", "reports its name");
+
+    // Readers check every state they see is whole while the main thread
+    // samples the pattern
+    std::atomic<bool> stop{false};
+    std::atomic<int> torn{0};
+    std::atomic<long> reads{0};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 3; r++) {
+        readers.emplace_back([&]() {
+            uint32_t last_packet = 0;
+            int64_t last_ns = 0;
+            long n = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                PadState st = PadPollerGet(0);
+                n++;
+                if (st.packet == last_packet && st.changed_ns != last_ns) torn++;
+                if (st.packet < last_packet) torn++;
+                if (st.packet > last_packet && st.changed_ns <= last_ns) torn++;
+                last_packet = st.packet;
+                last_ns = st.changed_ns;
+            }
+            reads += n;
+        });
+    }
+
+    auto t0 = Clock::now();
+    int samples = 0, pressed = 0, off_circle = 0, empty_slots_ok = 0;
+    while (MsSince(t0) < 1000) {   // two whole A periods
+        PadState st = PadPollerGet(0);
+        if (st.connected) {
+            samples++;
+            if (st.buttons & X_INPUT_GAMEPAD_A) pressed++;
+            double radius = std::hypot((double)st.lx, (double)st.ly);
+            if (std::fabs(radius - 32767.0) > 64.0) off_circle++;
+        }
+        if (!PadPollerGet(1).connected && !PadPollerGet(2).connected && !PadPollerGet(3).connected) {
+            empty_slots_ok++;
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+    stop = true;
+    for (auto& t : readers) t.join();
+    PadState last = PadPollerGet(0);
+    PadPollerStop();
+
+    double duty = samples ? (double)pressed / samples : 0;
+    Check(samples > 0, "slot 0 connected");
+    Check(pressed > 0 && pressed < samples, "A both pressed and released");
+    Check(duty > 0.12 && duty < 0.28, "A pressed ~20% of the time");
+    Check(off_circle == 0, "left stick stays on the unit circle");
+    Check(last.packet > 100, "state republished as it changes");
+    Check(empty_slots_ok > 0 && !PadPollerGet(1).connected, "slots 1-3 empty");
+    printf("    %d samples, A duty %.2f, %d published packets\n", samples, duty, last.packet);
+
+    printf("seqlock (3 readers):\n");
+    Check(torn.load() == 0, "no torn or out-of-order reads");
+    printf("    %ld reads\n", reads.load());
+    Check(!PadPollerGet(0).connected && std::string(PadPollerBackend()) == "none",
+          "stop clears the slots");
+}
+
+// ---- Backoff ----
+
+// Slot 0 always connected, slot 1 never, slot 2 plugged in at kPlugMs.
+// Records when each slot was polled, relative to the first poll.
+class ScriptedBackend final : public PadBackend {
+public:
+    static constexpr double kPlugMs = 300;
+
+    const char* Name() const override { return "scripted"; }
+
+    bool Poll(int slot, PadInput* out) override {
+        std::lock_guard lock(mutex_);
+        if (!started_) {
+            t0_ = Clock::now();
+            started_ = true;
+        }
+        double ms = MsSince(t0_);
+        polls_[slot].push_back(ms);
+        *out = {};
+        if (slot == 0) return true;
+        if (slot == 2 && ms >= kPlugMs) {
+            out->buttons = X_INPUT_GAMEPAD_START;
+            return true;
+        }
+        return false;
+    }
+
+    std::vector<double> Polls(int slot) {
+        std::lock_guard lock(mutex_);
+        return polls_[slot];
+    }
+
+private:
+    std::mutex          mutex_;
+    bool                started_ = false;
+    Clock::time_point   t0_;
+    std::vector<double> polls_[PAD_SLOTS];
+};
+
+static void TestBackoff() {
+    printf("backoff (1 kHz, 4.5 s):\n");
+    auto owned = std::make_unique<ScriptedBackend>();
+    ScriptedBackend* backend = owned.get();
+    PadPollerStartWith(std::move(owned), 1000);
+    auto t0 = Clock::now();
+    double plugged_seen_ms = -1;
+    while (MsSince(t0) < 4500) {
+        if (plugged_seen_ms < 0 && PadPollerGet(2).connected) plugged_seen_ms = MsSince(t0);
+        std::this_thread::sleep_for(1ms);
+    }
+    auto always = backend->Polls(0);
+    auto never = backend->Polls(1);
+    auto plugged = backend->Polls(2);
+    PadPollerStop();
+
+    Check(always.size() > 4000, "connected slot polled every tick");
+    printf("    connected slot: %zu polls\n", always.size());
+
+    // Expected gaps 1, 2, 4, ... 1024 ms, then PAD_BACKOFF_MAX
+    std::vector<double> gaps;
+    for (size_t i = 1; i < never.size(); i++) gaps.push_back(never[i] - never[i - 1]);
+    printf("    empty slot gaps (ms):");
+    for (double g : gaps) printf(" %.0f", g);
+    printf("\n");
+    bool doubling = gaps.size() >= 11;
+    for (size_t i = 3; i < std::min<size_t>(gaps.size(), 11); i++) {
+        double ratio = gaps[i] / gaps[i - 1];
+        if (ratio < 1.6 || ratio > 2.5) doubling = false;
+    }
+    Check(doubling, "empty slot retried at doubling intervals");
+    double cap = std::chrono::duration<double, std::milli>(PAD_BACKOFF_MAX).count();
+    Check(gaps.size() >= 12 && std::fabs(gaps[11] - cap) < 100 &&
+          *std::max_element(gaps.begin(), gaps.end()) < cap + 100,
+          "intervals capped at PAD_BACKOFF_MAX");
+
+    // Slot 2 backs off like slot 1 until it is plugged in at 300 ms, when
+    // its interval has grown to 256 ms
+    size_t first_up = std::find_if(plugged.begin(), plugged.end(),
+                                   [](double ms) { return ms >= ScriptedBackend::kPlugMs; }) - plugged.begin();
+    Check(first_up < plugged.size() && plugged[first_up] < ScriptedBackend::kPlugMs + 300,
+          "plugged-in pad picked up by the next retry");
+    Check(plugged_seen_ms > 0 && plugged_seen_ms < ScriptedBackend::kPlugMs + 300,
+          "and published as connected");
+    Check(plugged.size() - first_up > 3500, "then polled every tick");
+    printf("    plugged at %.0f ms, first polled at %.0f ms\n", ScriptedBackend::kPlugMs,
+           first_up < plugged.size() ? plugged[first_up] : -1.0);
+}
+
+// ---- Evdev mapping ----
+
+#ifndef _WIN32
+static void TestEvdev() {
+    printf("evdev mapping:\n");
+    PadAxisRange range[ABS_CNT] = {};
+    range[ABS_X] = {0, 255};
+    range[ABS_Y] = {0, 255};
+    range[ABS_RX] = {-32768, 32767};
+    range[ABS_RY] = {-32768, 32767};
+    range[ABS_Z] = {0, 1023};
+    // ABS_RZ left without a range: a digital trigger
+
+    PadInput in = {};
+    auto send = [&](uint16_t type, uint16_t code, int32_t value) {
+        input_event ev = {};
+        ev.type = type;
+        ev.code = code;
+        ev.value = value;
+        PadEvdevApply(&in, range, ev);
+    };
+
+    send(EV_ABS, ABS_X, 0);
+    Check(in.lx == -32767, "left stick X: min -> full left");
+    send(EV_ABS, ABS_X, 255);
+    Check(in.lx == 32767, "left stick X: max -> full right");
+    send(EV_ABS, ABS_Y, 0);
+    Check(in.ly == 32767, "left stick Y inverted: evdev up -> +32767");
+    send(EV_ABS, ABS_Y, 255);
+    Check(in.ly == -32767, "left stick Y inverted: evdev down -> -32767");
+    send(EV_ABS, ABS_RX, -32768);
+    Check(in.rx == -32767, "right stick X over a signed range");
+    send(EV_ABS, ABS_RY, -32768);
+    Check(in.ry == 32767, "right stick Y inverted over a signed range");
+    send(EV_ABS, ABS_RY, 0);
+    Check(std::abs(in.ry) <= 1, "right stick Y centred");
+
+    send(EV_ABS, ABS_Z, 0);
+    Check(in.lt == 0, "left trigger: released");
+    send(EV_ABS, ABS_Z, 512);
+    Check(in.lt == 127, "left trigger: 512/1023 -> 127");
+    send(EV_ABS, ABS_Z, 1023);
+    Check(in.lt == 255, "left trigger: fully pressed -> 255");
+    send(EV_ABS, ABS_Z, 4000);
+    Check(in.lt == 255, "left trigger: out of range clamps");
+    send(EV_ABS, ABS_RZ, 1);
+    Check(in.rt == 255, "digital right trigger pressed");
+    send(EV_ABS, ABS_RZ, 0);
+    Check(in.rt == 0, "digital right trigger released");
+
+    send(EV_KEY, BTN_A, 1);
+    send(EV_KEY, BTN_START, 1);
+    Check(in.buttons == (X_INPUT_GAMEPAD_A | X_INPUT_GAMEPAD_START), "buttons pressed");
+    send(EV_KEY, BTN_A, 0);
+    Check(in.buttons == X_INPUT_GAMEPAD_START, "button released");
+    send(EV_ABS, ABS_HAT0X, -1);
+    send(EV_ABS, ABS_HAT0Y, 1);
+    Check(in.buttons == (X_INPUT_GAMEPAD_START | X_INPUT_GAMEPAD_DPAD_LEFT | X_INPUT_GAMEPAD_DPAD_DOWN),
+          "hat -> d-pad left + down");
+    send(EV_ABS, ABS_HAT0X, 1);
+    send(EV_ABS, ABS_HAT0Y, 0);
+    Check(in.buttons == (X_INPUT_GAMEPAD_START | X_INPUT_GAMEPAD_DPAD_RIGHT), "hat -> d-pad right only");
+    send(EV_SYN, SYN_REPORT, 0);
+    Check(in.buttons == (X_INPUT_GAMEPAD_START | X_INPUT_GAMEPAD_DPAD_RIGHT), "SYN_REPORT changes nothing");
+}
+#endif
+
+int main() {
+    TestSynthetic();
+    TestBackoff();
+#ifndef _WIN32
+    TestEvdev();
+#endif
+    printf("%s\n", g_failures ? "FAILED" : "all checks passed");
+    return g_failures ? 2 : 0;
+}
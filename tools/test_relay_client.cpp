@@ -0,0 +1,238 @@
+// Checks the relay client worker (project/src/relay_client.cpp) against a
+// stand-in relay: RelayIsConnected / RelaySearchSessions (relay_link.h)
+// are defined here over an in-memory session list, and the worker's
+// injected delay makes the relay slow.
+//
+//   slow relay   a search against a 600 ms relay is still pending when
+//                RelaySearchAsync returns (the guest gets IO_PENDING), and
+//                the guest-side wait XGISessionSearch uses
+//                (RelayFinishSearchOnGuest) finishes with the relay's list
+//                once it answers, well inside the 3 s search timeout.
+//   timeout      against a 3.5 s relay, the same wait gives up at the 3 s
+//                deadline with the search not done, and a search still
+//                queued behind it when the worker stops finishes with
+//                ok = false.
+//   refresh      the on-demand refresh XGISessionSearch does once the
+//                cached list is stale (RelayRefreshSessions into a
+//                SessionCache): a burst of searches costs the relay one
+//                fetch, searches inside the staleness window and an idle
+//                lobby cost none, and a stale search after the relay's list
+//                changes converges on it.
+//
+// Guest threads are stood in for by the main thread calling NetDrainGuest.
+// Exits with 2 when a check fails.
+//
+// Compile: g++ -O2 -std=c++20 -pthread -I project/src -I ../xlive/client -I $REXSDK/include tools/test_relay_client.cpp project/src/relay_client.cpp project/src/net_scheduler.cpp -o test_relay_client
+// Usage: test_relay_client
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "relay_client.h"
+#include "session_cache.h"
+
+using namespace std::chrono_literals;
+
+// Same budget and first-check delay as XGISessionSearch (net.cpp)
+static constexpr auto SEARCH_TIMEOUT    = 3000ms;
+static constexpr auto SEARCH_NOT_BEFORE = 150ms;
+
+// ---- Stand-in relay ----
+
+static std::mutex                  g_relay_mutex;
+static std::vector<xlive::Session> g_relay_sessions;
+static std::atomic<int>            g_relay_fetches{0};
+
+static xlive::Session MakeSession(int i, uint8_t current, uint8_t max) {
+    xlive::Session s;
+    std::memset(&s, 0, sizeof(s));
+    std::memcpy(s.xnkid, &i, sizeof(i));
+    s.xnkid[7] = 0x5A;
+    uint32_t ina = 0x0A000002u + (uint32_t)i;
+    std::memcpy(s.host_xnaddr, &ina, 4);
+    s.current_players = current;
+    s.max_players = max;
+    return s;
+}
+
+bool RelayIsConnected() { return true; }
+
+int RelaySearchSessions(xlive::Session* out, int max_results) {
+    g_relay_fetches++;
+    std::lock_guard lock(g_relay_mutex);
+    int n = std::min<int>(max_results, (int)g_relay_sessions.size());
+    std::copy_n(g_relay_sessions.begin(), n, out);
+    return n;
+}
+
+// ---- Checks ----
+
+static int g_failures = 0;
+
+static void Check(bool ok, const char* what) {
+    printf("  %-58s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok) g_failures++;
+}
+
+static double MsSince(NetClock::time_point t0) {
+    return std::chrono::duration<double, std::milli>(NetClock::now() - t0).count();
+}
+
+struct Finished {
+    bool   fired = false;
+    bool   answered = false;   // search done when the wait finished
+    double at_ms = 0;
+};
+
+// Issue a search the way XGISessionSearch does and drain guest tasks until
+// the wait finishes. Returns the search so callers can look at it later.
+static std::shared_ptr<RelaySearch> SearchOnGuest(Finished& f, bool& pending_at_return) {
+    auto t0 = NetClock::now();
+    auto search = RelaySearchAsync(64);
+    pending_at_return = !search->done.load(std::memory_order_acquire);
+    RelayFinishSearchOnGuest(search, t0 + SEARCH_NOT_BEFORE, t0 + SEARCH_TIMEOUT, [&f, search, t0]() {
+        f.fired = true;
+        f.answered = search->done.load(std::memory_order_acquire);
+        f.at_ms = MsSince(t0);
+    });
+    while (!f.fired && MsSince(t0) < 6000) {
+        NetDrainGuest();
+        std::this_thread::sleep_for(1ms);
+    }
+    return search;
+}
+
+static void TestSlowRelay() {
+    printf("slow relay (600 ms):\n");
+    RelayClientStart(600);
+    Finished f;
+    bool pending = false;
+    auto search = SearchOnGuest(f, pending);
+    Check(pending, "search pending when issued (IO_PENDING)");
+    Check(f.fired, "guest wait finished");
+    Check(f.answered && search->ok, "finished with the relay's answer");
+    Check(search->sessions.size() == g_relay_sessions.size(), "all relay sessions returned");
+    Check(f.at_ms >= 600 && f.at_ms < 1000, "finished once the relay answered");
+    printf("    completed after %.0f ms\n", f.at_ms);
+    RelayClientStop();
+}
+
+static void TestTimeout() {
+    printf("timeout (relay 3500 ms, search budget 3000 ms):\n");
+    RelayClientStart(3500);
+    Finished f;
+    bool pending = false;
+    auto search = SearchOnGuest(f, pending);
+    auto queued = RelaySearchAsync(64);   // waits behind the slow call
+    Check(pending, "search pending when issued (IO_PENDING)");
+    Check(f.fired && !f.answered, "guest wait gave up without an answer");
+    Check(f.at_ms >= 3000 && f.at_ms < 3400, "gave up at the 3 s deadline");
+    printf("    gave up after %.0f ms\n", f.at_ms);
+    RelayClientStop();
+    Check(search->done.load() && search->ok, "timed-out search still completes on the worker");
+    Check(queued->done.load() && !queued->ok, "search queued at stop finishes with ok = false");
+}
+
+// The cache holds exactly the relay's sessions with the relay's slot counts
+static bool CacheMatchesRelay(const SessionCache& cache) {
+    SessionQuery q;
+    q.max = 1000;
+    q.min_open_slots = 0;
+    auto cached = cache.Query(q, [](uint32_t) { return 0u; });
+    std::lock_guard lock(g_relay_mutex);
+    if (cached.size() != g_relay_sessions.size()) return false;
+    for (const xlive::Session& r : g_relay_sessions) {
+        auto it = std::find_if(cached.begin(), cached.end(), [&](const CachedSession& c) {
+            return std::memcmp(c.xnkid, r.xnkid, 8) == 0;
+        });
+        if (it == cached.end() || it->current_players != r.current_players ||
+            it->max_players != r.max_players) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Milliseconds until the cache matches the relay, or -1 after `limit_ms`
+static double WaitForConvergence(const SessionCache& cache, double limit_ms) {
+    auto t0 = NetClock::now();
+    while (MsSince(t0) < limit_ms) {
+        if (CacheMatchesRelay(cache)) return MsSince(t0);
+        std::this_thread::sleep_for(5ms);
+    }
+    return -1;
+}
+
+// Same window as XGISessionSearch (net.cpp)
+static constexpr int64_t RELAY_STALE_MS = 2000;
+
+// What a search does to the relay part of the cache at cache time `now_ms`.
+// Returns whether it queued a refresh.
+static bool SearchAt(SessionCache& cache, int64_t now_ms) {
+    if (!cache.RelayStale(now_ms, RELAY_STALE_MS)) return false;
+    return RelayRefreshSessions(64, [&cache, now_ms](const std::vector<xlive::Session>& list) {
+        cache.ApplySnapshot(list.data(), (int)list.size(), now_ms);
+    });
+}
+
+static void TestRefresh() {
+    printf("refresh (on demand, %lld ms staleness window, relay 200 ms):\n",
+           (long long)RELAY_STALE_MS);
+    SessionCache cache;
+    RelayClientStart(200);
+    g_relay_fetches = 0;
+
+    int queued = 0;
+    for (int i = 0; i < 50; i++) queued += SearchAt(cache, 0);
+    double ms = WaitForConvergence(cache, 1000);
+    Check(queued == 1 && g_relay_fetches.load() == 1, "a burst of stale searches fetches once");
+    Check(ms >= 0, "and the cache converges on the relay's list");
+    printf("    after %.0f ms\n", ms);
+
+    for (int64_t t = 0; t < RELAY_STALE_MS; t += 100) queued += SearchAt(cache, t);
+    std::this_thread::sleep_for(300ms);
+    Check(queued == 1 && g_relay_fetches.load() == 1, "no fetch inside the staleness window");
+
+    {
+        std::lock_guard lock(g_relay_mutex);
+        g_relay_sessions.erase(g_relay_sessions.begin() + 5, g_relay_sessions.begin() + 8);
+        g_relay_sessions[0].current_players = 3;
+        g_relay_sessions[1].current_players = 4;   // now full
+        for (int i = 100; i < 105; i++) g_relay_sessions.push_back(MakeSession(i, 2, 8));
+    }
+    std::this_thread::sleep_for(500ms);
+    Check(g_relay_fetches.load() == 1 && !CacheMatchesRelay(cache), "no fetch while nobody searches");
+
+    Check(SearchAt(cache, RELAY_STALE_MS), "a stale search queues a refresh");
+    ms = WaitForConvergence(cache, 1000);
+    Check(ms >= 0, "adds, removals and slot changes converge");
+    Check(g_relay_fetches.load() == 2, "with one more fetch");
+    printf("    after %.0f ms\n", ms);
+    RelayClientStop();
+
+    // A refresh dropped unrun by the stop doesn't block the next one
+    RelayClientStart(3500);
+    RelaySearchAsync(64);   // keeps the worker busy past the stop
+    Check(SearchAt(cache, 10 * RELAY_STALE_MS), "refresh queued behind a slow call");
+    RelayClientStop();
+    RelayClientStart();
+    Check(SearchAt(cache, 10 * RELAY_STALE_MS), "queued again after a restart");
+    RelayClientStop();
+}
+
+int main() {
+    for (int i = 0; i < 40; i++) g_relay_sessions.push_back(MakeSession(i, 1, 4));
+    NetTimerStart();
+    TestSlowRelay();
+    TestTimeout();
+    TestRefresh();
+    NetTimerStop();
+    printf("%s\n", g_failures ? "FAILED" : "all checks passed");
+    return g_failures ? 2 : 0;
+}
@@ -0,0 +1,208 @@
+// Checks vig8's relay_server link (project/src/relay_link.cpp, [network]
+// relay_protocol = "relay_server") against a real tools/relay_server,
+// started here on a spare port:
+//
+//   connect      RelayConnect says HELLO and is connected; a port nobody
+//                listens on fails cleanly
+//   register     RelayRegisterSession lists the session with the XNADDR
+//                given at connect, and registering again updates it
+//   search       RelaySearchSessions, and the relay worker's
+//                RelaySearchAsync that XGISessionSearch uses, return our
+//                session and one registered by another relay_server client
+//   disconnect   the server drops our session once we disconnect
+//   server gone  a search after the server exits fails and leaves the link
+//                disconnected
+//
+// The xlive client isn't linked; its calls are stubbed out here. Linux
+// only. Exits with 2 when a check fails.
+//
+// Compile: g++ -O2 -std=c++20 -pthread -I project/src -I ../xlive/client -I $REXSDK/include tools/test_relay_link.cpp project/src/relay_link.cpp project/src/relay_client.cpp project/src/net_scheduler.cpp -o test_relay_link
+// Usage: test_relay_link path/to/relay_server [--port 36917]
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "relay_client.h"
+#include "relay_link.h"
+#include "relay_protocol.h"
+
+using namespace std::chrono_literals;
+
+namespace xlive {
+bool Connect(const char*, uint16_t, uint32_t, const uint8_t*, const char*) { return false; }
+bool IsConnected() { return false; }
+void Disconnect() {}
+bool RegisterSession(const uint8_t*, const uint8_t*, int, uint8_t) { return false; }
+int SearchSessions(Session*, int) { return -1; }
+}  // namespace xlive
+
+static int g_failures = 0;
+
+static void Check(bool ok, const char* what) {
+    printf("  %-58s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok) g_failures++;
+}
+
+// ---- The server ----
+
+static pid_t StartServer(const char* exe, int port) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        std::string p = std::to_string(port);
+        freopen("/dev/null", "w", stdout);
+        execl(exe, exe, "--port", p.c_str(), "--threads", "2", (char*)nullptr);
+        _exit(127);
+    }
+    return pid;
+}
+
+static void StopServer(pid_t pid) {
+    kill(pid, SIGTERM);
+    waitpid(pid, nullptr, 0);
+}
+
+// Another relay_server client: raw protocol, registers one session and
+// stays connected until closed.
+static int OtherHostRegister(int port, const relay::SessionRecord& rec) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    uint8_t buf[3 + sizeof(rec)];
+    relay::PutU16(buf, 5);
+    buf[2] = relay::MSG_HELLO;
+    relay::PutU32(buf + 3, relay::PROTOCOL_VERSION);
+    send(fd, buf, 7, 0);
+    uint8_t reply[16];
+    recv(fd, reply, 3 + 8, MSG_WAITALL);   // WELCOME
+    relay::PutU16(buf, (uint16_t)(1 + sizeof(rec)));
+    buf[2] = relay::MSG_REGISTER;
+    std::memcpy(buf + 3, &rec, sizeof(rec));
+    send(fd, buf, sizeof(buf), 0);
+    if (recv(fd, reply, 3 + 1, MSG_WAITALL) != 4 || reply[3] != relay::ACK_OK) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// ---- Checks ----
+
+static const xlive::Session* Find(const std::vector<xlive::Session>& list, const uint8_t* xnkid) {
+    for (const auto& s : list) {
+        if (std::memcmp(s.xnkid, xnkid, 8) == 0) return &s;
+    }
+    return nullptr;
+}
+
+static std::vector<xlive::Session> Search() {
+    std::vector<xlive::Session> list(64);
+    int n = RelaySearchSessions(list.data(), (int)list.size());
+    list.resize(n > 0 ? (size_t)n : 0);
+    return list;
+}
+
+static bool ConnectRetry(int port, const uint8_t* xnaddr) {
+    for (int i = 0; i < 50; i++) {
+        if (RelayConnect(RelayProtocol::RelayServer, "127.0.0.1", (uint16_t)port, 0, xnaddr, "Player")) {
+            return true;
+        }
+        std::this_thread::sleep_for(20ms);
+    }
+    return false;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s path/to/relay_server [--port N]\n", argv[0]);
+        return 1;
+    }
+    int port = 36917;
+    if (argc >= 4 && std::string(argv[2]) == "--port") port = atoi(argv[3]);
+
+    RelayProtocol protocol = RelayProtocol::Xlive;
+    printf("protocol names:\n");
+    Check(RelayProtocolFromName("relay_server", &protocol) && protocol == RelayProtocol::RelayServer,
+          "\"relay_server\" selects the relay_server link");
+    Check(!RelayProtocolFromName("xlive2", &protocol), "unknown names are refused");
+
+    uint8_t xnaddr[36] = {};
+    xnaddr[0] = 10; xnaddr[3] = 7;
+    xnaddr[16] = 0xAB;   // punch key bytes travel with the XNADDR
+    const uint8_t kid[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+
+    printf("connect:\n");
+    Check(!RelayConnect(RelayProtocol::RelayServer, "127.0.0.1", (uint16_t)port, 0, xnaddr, "Player"),
+          "nothing listening: connect fails");
+    Check(!RelayIsConnected(), "and the link is not connected");
+    pid_t server = StartServer(argv[1], port);
+    Check(ConnectRetry(port, xnaddr), "HELLO to relay_server");
+    Check(RelayIsConnected(), "link connected");
+
+    printf("register and search:\n");
+    Check(RelayRegisterSession(kid, 4), "session registered");
+    auto list = Search();
+    const xlive::Session* ours = Find(list, kid);
+    Check(ours != nullptr, "search returns it");
+    Check(ours && std::memcmp(ours->host_xnaddr, xnaddr, 36) == 0, "with our XNADDR");
+    Check(ours && ours->current_players == 1 && ours->max_players == 4, "and our slot counts");
+    Check(RelayRegisterSession(kid, 8), "registering again updates it");
+    list = Search();
+    Check(list.size() == 1 && Find(list, kid) && Find(list, kid)->max_players == 8,
+          "one session, updated in place");
+
+    relay::SessionRecord other = {};
+    std::memcpy(other.xnkid, "\x11\x22\x33\x44\x55\x66\x77\x88", 8);
+    other.host_xnaddr[0] = 10; other.host_xnaddr[3] = 8;
+    other.current_players = 2;
+    other.max_players = 4;
+    int other_fd = OtherHostRegister(port, other);
+    Check(other_fd >= 0, "another host registers its session");
+
+    RelayClientStart();
+    auto search = RelaySearchAsync(64);
+    for (int i = 0; i < 200 && !search->done.load(); i++) std::this_thread::sleep_for(5ms);
+    Check(search->done.load() && search->ok, "relay worker search completes");
+    const xlive::Session* theirs = Find(search->sessions, other.xnkid);
+    Check(search->sessions.size() == 2 && theirs, "and returns both hosts' sessions");
+    Check(theirs && theirs->current_players == 2 && theirs->host_xnaddr[3] == 8,
+          "the other host's session as it registered it");
+    RelayClientStop();
+
+    printf("disconnect:\n");
+    RelayDisconnect();
+    Check(!RelayIsConnected(), "link disconnected");
+    std::this_thread::sleep_for(50ms);   // the server notices the close
+    Check(ConnectRetry(port, xnaddr), "reconnect");
+    list = Search();
+    Check(!Find(list, kid), "our session was dropped");
+    Check(list.size() == 1 && Find(list, other.xnkid), "the other host's remains");
+    close(other_fd);
+
+    printf("server gone:\n");
+    StopServer(server);
+    Check(RelaySearchSessions(list.data(), (int)list.size()) < 0, "search fails");
+    Check(!RelayIsConnected(), "link disconnected");
+    RelayDisconnect();
+
+    printf("%s\n", g_failures ? "FAILED" : "all checks passed");
+    return g_failures ? 2 : 0;
+}